@@ -12,6 +12,11 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <cstring>
+#include <future>  // NOLINT
+#include <utility>
+
 #include "common/exception.h"
 #include "common/macros.h"
 
@@ -19,11 +24,29 @@ namespace bustub {
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, size_t replacer_k,
                                                      LogManager *log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, replacer_k, log_manager) {}
+
+BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
+                                                     DiskManager *disk_manager, size_t replacer_k,
+                                                     LogManager *log_manager)
+    : pool_size_(pool_size),
+      num_instances_(num_instances),
+      instance_index_(instance_index),
+      next_page_id_(instance_index),
+      disk_manager_(disk_manager),
+      log_manager_(log_manager) {
+  BUSTUB_ASSERT(num_instances > 0, "If BPI is not part of a pool, then the pool size should just be 1");
+  BUSTUB_ASSERT(
+      instance_index < num_instances,
+      "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 0.");
   // we allocate a consecutive memory space for the buffer pool
   pages_ = new Page[pool_size_];
-  page_table_ = new ExtendibleHashTable<page_id_t, frame_id_t>(bucket_size_);
+  page_table_ = new LockFreeHashTable<page_id_t, frame_id_t>(pool_size_);
   replacer_ = new LRUKReplacer(pool_size, replacer_k);
+  io_in_flight_.resize(pool_size_, false);
+  writes_in_flight_.resize(pool_size_, 0);
+  is_prefetched_.resize(pool_size_, false);
+  io_cv_ = new std::condition_variable[pool_size_];
 
   // Initially, every page is in the free list.
   for (size_t i = 0; i < pool_size_; ++i) {
@@ -32,88 +55,171 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManag
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
+  StopPageCleaner();
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    enable_prefetch_ = false;
+  }
+  prefetch_cv_.notify_all();
+  for (auto &worker : prefetch_workers_) {
+    worker.join();
+  }
   delete[] pages_;
+  delete[] io_cv_;
   delete page_table_;
   delete replacer_;
 }
 
-auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
-  std::scoped_lock<std::mutex> lock(latch_);
-  frame_id_t spare_frame_id;
-  if (!free_list_.empty()) {
-    spare_frame_id = *free_list_.begin();
-    free_list_.erase(free_list_.begin());
-  } else {
-    bool ret = replacer_->Evict(&spare_frame_id);
-    if (!ret) {
-      return nullptr;
+auto BufferPoolManagerInstance::AcquireFrame(frame_id_t *frame_id, page_id_t *victim_page_id,
+                                             BufferAccessStrategy *strategy) -> bool {
+  *victim_page_id = INVALID_PAGE_ID;
+  frame_id_t *ring_slot = strategy == nullptr ? nullptr : &strategy->NextSlot(this);
+  if (ring_slot != nullptr && *ring_slot != INVALID_FRAME_ID && replacer_->IsEvictableScanOnly(*ring_slot)) {
+    *frame_id = *ring_slot;
+    replacer_->Remove(*frame_id);
+  } else if (!free_list_.empty()) {
+    *frame_id = free_list_.front();
+    free_list_.pop_front();
+  } else if (!replacer_->Evict(frame_id)) {
+    if (prefetched_frames_.empty()) {
+      return false;
     }
-    // write back
-    if (pages_[spare_frame_id].IsDirty()) {
-      disk_manager_->WritePage(pages_[spare_frame_id].GetPageId(), pages_[spare_frame_id].GetData());
+    // give up on the oldest prefetched page that is read already rather than fail
+    auto prefetched = std::find_if(prefetched_frames_.begin(), prefetched_frames_.end(),
+                                   [&](frame_id_t frame_id) { return pages_[frame_id].GetPinCount() == 0; });
+    if (prefetched == prefetched_frames_.end()) {
+      return false;
     }
-    page_table_->Remove(pages_[spare_frame_id].GetPageId());
+    replacer_->SetEvictable(*prefetched, true);
+    ForgetPrefetch(*prefetched);
+    replacer_->Evict(frame_id);
+  }
+  if (ring_slot != nullptr) {
+    *ring_slot = *frame_id;
+  }
+
+  Page *victim = pages_ + *frame_id;
+  if (victim->GetPageId() == INVALID_PAGE_ID) {
+    // a free frame
+    return true;
+  }
+  page_table_->Remove(victim->GetPageId());
+  stats_.evictions_.fetch_add(1, std::memory_order_relaxed);
+  if (victim->IsDirty()) {
+    // Until the write back is done, the disk copy of the victim is stale, so fetchers of it must wait.
+    *victim_page_id = victim->GetPageId();
+    write_back_table_[*victim_page_id] = {*frame_id, victim->rec_lsn_};
+    stats_.dirty_write_backs_.fetch_add(1, std::memory_order_relaxed);
+    // the cleaner is falling behind, wake it up
+    page_cleaner_cv_.notify_one();
+  }
+  victim->rec_lsn_ = INVALID_LSN;
+  return true;
+}
+
+void BufferPoolManagerInstance::FinishFrameIO(frame_id_t frame_id, page_id_t victim_page_id) {
+  io_in_flight_[frame_id] = false;
+  if (victim_page_id != INVALID_PAGE_ID) {
+    write_back_table_.erase(victim_page_id);
+  }
+  io_cv_[frame_id].notify_all();
+}
+
+auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
+  std::unique_lock<std::mutex> lock(latch_);
+  frame_id_t spare_frame_id;
+  page_id_t victim_page_id;
+  if (!AcquireFrame(&spare_frame_id, &victim_page_id)) {
+    return nullptr;
   }
   // use the spare_frame to create a new page
   // spare_frame to page_id
   page_id_t new_page = AllocatePage();
   *page_id = new_page;
-  // rest the pages
-  pages_[spare_frame_id].ResetMemory();
-  pages_[spare_frame_id].page_id_ = INVALID_PAGE_ID;
-  pages_[spare_frame_id].pin_count_ = 0;
-  pages_[spare_frame_id].is_dirty_ = false;
-  // rest the pages
-  pages_[spare_frame_id].page_id_ = new_page;
-  pages_[spare_frame_id].pin_count_++;
+  Page *page = pages_ + spare_frame_id;
+  page->page_id_ = new_page;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  PinRecLSN(page);
   page_table_->Insert(new_page, spare_frame_id);
   replacer_->SetEvictable(spare_frame_id, false);
   replacer_->RecordAccess(spare_frame_id);
-  return pages_ + spare_frame_id;
+  if (victim_page_id == INVALID_PAGE_ID) {
+    page->ResetMemory();
+    return page;
+  }
+
+  // write back the victim without holding the latch
+  io_in_flight_[spare_frame_id] = true;
+  lock.unlock();
+  WritePageToDisk(victim_page_id, page->GetData());
+  page->ResetMemory();
+  lock.lock();
+  FinishFrameIO(spare_frame_id, victim_page_id);
+  return page;
 }
 
-auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
-  std::scoped_lock<std::mutex> lock(latch_);
+auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * { return FetchPgImp(page_id, nullptr); }
+
+auto BufferPoolManagerInstance::FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+  return FetchPgImp(page_id, strategy);
+}
+
+auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+  std::unique_lock<std::mutex> lock(latch_);
+  const AccessType access_type = strategy == nullptr ? AccessType::Unknown : AccessType::Scan;
   frame_id_t frame_id;
-  if (!page_table_->Find(page_id, frame_id)) {
-    // not in buffer pool
-    // try to get a available frame to contain the data
-    frame_id_t spare_frame_id;
-    if (!free_list_.empty()) {
-      spare_frame_id = *free_list_.begin();
-      free_list_.erase(free_list_.begin());
-    } else {
-      bool ret = replacer_->Evict(&spare_frame_id);
-      if (!ret) {
-        return nullptr;
-      }
-      // write back
-      if (pages_[spare_frame_id].IsDirty()) {
-        disk_manager_->WritePage(pages_[spare_frame_id].GetPageId(), pages_[spare_frame_id].GetData());
-      }
-      page_table_->Remove(pages_[spare_frame_id].GetPageId());
+  while (true) {
+    if (page_table_->Find(page_id, frame_id)) {
+      // in buffer pool
+      pages_[frame_id].pin_count_++;
+      PinRecLSN(pages_ + frame_id);
+      ForgetPrefetch(frame_id);
+      replacer_->RecordAccess(frame_id, access_type);
+      replacer_->SetEvictable(frame_id, false);
+      stats_.hits_.fetch_add(1, std::memory_order_relaxed);
+      // Another thread may still be reading the page in. Our pin keeps the frame, so only wait on the frame itself.
+      WaitForFrame(lock, frame_id, [&] { return !io_in_flight_[frame_id]; });
+      return pages_ + frame_id;
+    }
+    auto write_back = write_back_table_.find(page_id);
+    if (write_back == write_back_table_.end()) {
+      break;
     }
-    // rest the pages
-    pages_[spare_frame_id].ResetMemory();
-    pages_[spare_frame_id].page_id_ = INVALID_PAGE_ID;
-    pages_[spare_frame_id].pin_count_ = 0;
-    pages_[spare_frame_id].is_dirty_ = false;
-    // rest the pages
-    pages_[spare_frame_id].pin_count_++;
-    pages_[spare_frame_id].page_id_ = page_id;
+    // The page was just evicted and is still being written back, read it again once the disk copy is current.
+    WaitForFrame(lock, write_back->second.frame_id_, [&] { return write_back_table_.count(page_id) == 0; });
+  }
 
-    disk_manager_->ReadPage(page_id, pages_[spare_frame_id].data_);
+  // not in buffer pool
+  stats_.misses_.fetch_add(1, std::memory_order_relaxed);
+  // try to get a available frame to contain the data
+  frame_id_t spare_frame_id;
+  page_id_t victim_page_id;
+  if (!AcquireFrame(&spare_frame_id, &victim_page_id, strategy)) {
+    return nullptr;
+  }
+  // Reserve the frame for page_id before releasing the latch. Concurrent fetchers of page_id will find the frame and
+  // wait for the read to finish, and the pin keeps the frame from being evicted.
+  Page *page = pages_ + spare_frame_id;
+  page->page_id_ = page_id;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  PinRecLSN(page);
+  io_in_flight_[spare_frame_id] = true;
+  page_table_->Insert(page_id, spare_frame_id);
+  replacer_->SetEvictable(spare_frame_id, false);
+  replacer_->RecordAccess(spare_frame_id, access_type);
+  lock.unlock();
 
-    page_table_->Insert(page_id, spare_frame_id);
-    replacer_->SetEvictable(spare_frame_id, false);
-    replacer_->RecordAccess(spare_frame_id);
-    return pages_ + spare_frame_id;
+  if (victim_page_id != INVALID_PAGE_ID) {
+    WritePageToDisk(victim_page_id, page->GetData());
   }
-  // in buffer pool
-  pages_[frame_id].pin_count_++;
-  replacer_->RecordAccess(frame_id);
-  replacer_->SetEvictable(frame_id, false);
-  return pages_ + frame_id;
+  page->ResetMemory();
+  ReadPageFromDisk(page_id, page->data_);
+
+  lock.lock();
+  FinishFrameIO(spare_frame_id, victim_page_id);
+  return page;
 }
 
 auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
@@ -127,6 +233,9 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
       pages_[frame_id].pin_count_--;
       if (pages_[frame_id].pin_count_ == 0) {
         replacer_->SetEvictable(frame_id, true);
+        if (!pages_[frame_id].is_dirty_) {
+          pages_[frame_id].rec_lsn_ = INVALID_LSN;
+        }
       }
       return true;
     }
@@ -135,25 +244,80 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
 }
 
 auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
-  std::scoped_lock<std::mutex> lock(latch_);
+  std::unique_lock<std::mutex> lock(latch_);
   frame_id_t frame_id;
-  if (page_table_->Find(page_id, frame_id)) {
-    // std::cout << "FlushPgImp: "
-    //           << "flushing page:" << page_id << " in frame:" << frame_id
-    //           << std::endl;
-    disk_manager_->WritePage(pages_[frame_id].GetPageId(), pages_[frame_id].GetData());
-    pages_[frame_id].is_dirty_ = false;
+  while (page_table_->Find(page_id, frame_id)) {
+    if (io_in_flight_[frame_id]) {
+      // the frame content is not valid yet, and the frame may be reused by the time the I/O is done
+      io_cv_[frame_id].wait(lock, [&] { return !io_in_flight_[frame_id]; });
+      continue;
+    }
+    // pin the page, so that it stays in its frame while being written back without the latch
+    Page *page = pages_ + frame_id;
+    BeginPageWrite(frame_id);
+    lock.unlock();
+    // whoever else has the page pinned may be changing it, so a consistent copy is written, after the log up to its LSN
+    std::vector<char> copy(BUSTUB_PAGE_SIZE);
+    page->RLatch();
+    memcpy(copy.data(), page->GetData(), BUSTUB_PAGE_SIZE);
+    page->RUnlatch();
+    WritePageToDisk(page_id, copy.data());
+    lock.lock();
+    EndPageWrite(frame_id);
     return true;
   }
   return false;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  std::scoped_lock<std::mutex> lock(latch_);
-  for (size_t i = 0; i < pool_size_; i++) {
-    if (pages_[i].GetPageId() != INVALID_PAGE_ID) {
-      disk_manager_->WritePage(pages_[i].GetPageId(), pages_[i].GetData());
-      pages_[i].is_dirty_ = false;
+  std::unique_lock<std::mutex> lock(latch_);
+  // The dirty pages are pinned and written in batches, so that most of the pool stays available to fetches meanwhile.
+  const size_t batch_size = std::max<size_t>(pool_size_ / 4, 1);
+  std::vector<frame_id_t> frames;
+  std::vector<std::pair<page_id_t, const char *>> pages;
+  std::vector<char> copies(batch_size * BUSTUB_PAGE_SIZE);
+  size_t next = 0;
+  while (true) {
+    frames.clear();
+    pages.clear();
+    for (; next < pool_size_ && frames.size() < batch_size; next++) {
+      // A frame with I/O in flight is not valid yet, and a clean page that is still being written is not on disk yet.
+      // The batch so far is written first, a wait never holds pins that a fetch may need.
+      auto frame_id = static_cast<frame_id_t>(next);
+      auto is_settled = [&] { return !io_in_flight_[frame_id] && writes_in_flight_[frame_id] == 0; };
+      if (!is_settled()) {
+        if (!frames.empty()) {
+          break;
+        }
+        io_cv_[frame_id].wait(lock, is_settled);
+      }
+      Page *page = pages_ + frame_id;
+      if (page->GetPageId() == INVALID_PAGE_ID || !page->IsDirty()) {
+        continue;
+      }
+      BeginPageWrite(frame_id);
+      frames.push_back(frame_id);
+      pages.emplace_back(page->GetPageId(), nullptr);
+    }
+    if (frames.empty()) {
+      return;
+    }
+
+    // Copy the pages out under their latches one at a time, like the page cleaner does, and write the copies.
+    lock.unlock();
+    for (size_t i = 0; i < frames.size(); i++) {
+      Page *page = pages_ + frames[i];
+      char *copy = copies.data() + i * BUSTUB_PAGE_SIZE;
+      page->RLatch();
+      memcpy(copy, page->GetData(), BUSTUB_PAGE_SIZE);
+      page->RUnlatch();
+      pages[i].second = copy;
+    }
+    WritePagesToDisk(pages);
+    lock.lock();
+
+    for (frame_id_t frame_id : frames) {
+      EndPageWrite(frame_id);
     }
   }
 }
@@ -162,17 +326,19 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   std::scoped_lock<std::mutex> lock(latch_);
   frame_id_t frame_id;
   if (page_table_->Find(page_id, frame_id)) {
+    // a frame with I/O in flight is always pinned
     if (pages_[frame_id].GetPinCount() > 0) {
       return false;
     }
-    // if (pages_[frame_id].IsDirty()) {
-    //   disk_manager_->WritePage(pages_[frame_id].GetPageId(),
-    //                            pages_[frame_id].GetData());
-    // }
+    if (ForgetPrefetch(frame_id)) {
+      replacer_->SetEvictable(frame_id, true);
+    }
+    page_table_->Remove(page_id);
     pages_[frame_id].ResetMemory();
     pages_[frame_id].page_id_ = INVALID_PAGE_ID;
     pages_[frame_id].pin_count_ = 0;
     pages_[frame_id].is_dirty_ = false;
+    pages_[frame_id].rec_lsn_ = INVALID_LSN;
     replacer_->Remove(frame_id);
     free_list_.push_back(frame_id);
     DeallocatePage(page_id);
@@ -182,6 +348,271 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   return true;
 }
 
-auto BufferPoolManagerInstance::AllocatePage() -> page_id_t { return next_page_id_++; }
+void BufferPoolManagerInstance::StartPageCleaner(double clean_fraction) {
+  BUSTUB_ASSERT(clean_fraction >= 0 && clean_fraction <= 1, "clean fraction must be in [0, 1]");
+  StopPageCleaner();
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    clean_fraction_ = clean_fraction;
+    enable_page_cleaner_ = true;
+  }
+  page_cleaner_thread_ = new std::thread(&BufferPoolManagerInstance::RunPageCleaner, this);
+}
+
+void BufferPoolManagerInstance::StopPageCleaner() {
+  if (page_cleaner_thread_ == nullptr) {
+    return;
+  }
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    enable_page_cleaner_ = false;
+  }
+  page_cleaner_cv_.notify_one();
+  page_cleaner_thread_->join();
+  delete page_cleaner_thread_;
+  page_cleaner_thread_ = nullptr;
+}
+
+void BufferPoolManagerInstance::RunPageCleaner() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (enable_page_cleaner_) {
+    page_cleaner_cv_.wait_for(lock, page_cleaner_interval);
+    if (!enable_page_cleaner_) {
+      break;
+    }
+
+    // Pin the dirty pages among the next victims, so that they stay in their frames while being written back. They
+    // are marked clean up front: whoever dirties them again in the meantime unpins them as dirty.
+    auto window = static_cast<size_t>(clean_fraction_ * static_cast<double>(replacer_->Size()) + 0.5);
+    std::vector<frame_id_t> dirty_frames;
+    for (frame_id_t frame_id : replacer_->NextVictims(window)) {
+      Page *page = pages_ + frame_id;
+      if (page->IsDirty()) {
+        BeginPageWrite(frame_id);
+        dirty_frames.push_back(frame_id);
+      }
+    }
+    if (dirty_frames.empty()) {
+      continue;
+    }
+
+    // Copy the pages out under their latches one at a time, holding several page latches at once could deadlock with
+    // threads that latch pages in a different order. The copies are then written back in one batch.
+    lock.unlock();
+    std::vector<char> copies(dirty_frames.size() * BUSTUB_PAGE_SIZE);
+    std::vector<std::pair<page_id_t, const char *>> pages;
+    for (size_t i = 0; i < dirty_frames.size(); i++) {
+      Page *page = pages_ + dirty_frames[i];
+      char *copy = copies.data() + i * BUSTUB_PAGE_SIZE;
+      page->RLatch();
+      memcpy(copy, page->GetData(), BUSTUB_PAGE_SIZE);
+      page->RUnlatch();
+      pages.emplace_back(page->GetPageId(), copy);
+    }
+    WritePagesToDisk(pages);
+    stats_.pages_cleaned_.fetch_add(dirty_frames.size(), std::memory_order_relaxed);
+    lock.lock();
+
+    for (frame_id_t frame_id : dirty_frames) {
+      EndPageWrite(frame_id);
+    }
+  }
+}
+
+auto BufferPoolManagerInstance::GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> {
+  std::scoped_lock<std::mutex> lock(latch_);
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (size_t i = 0; i < pool_size_; i++) {
+    if (pages_[i].GetPageId() != INVALID_PAGE_ID && pages_[i].rec_lsn_ != INVALID_LSN) {
+      dirty_pages.emplace_back(pages_[i].GetPageId(), pages_[i].rec_lsn_);
+    }
+  }
+  for (const auto &[page_id, write_back] : write_back_table_) {
+    if (write_back.rec_lsn_ != INVALID_LSN) {
+      dirty_pages.emplace_back(page_id, write_back.rec_lsn_);
+    }
+  }
+  return dirty_pages;
+}
+
+auto BufferPoolManagerInstance::GetCleanFrameRatio() -> double {
+  std::scoped_lock<std::mutex> lock(latch_);
+  size_t reusable = free_list_.size();
+  size_t clean = free_list_.size();
+  for (size_t i = 0; i < pool_size_; i++) {
+    if (pages_[i].GetPageId() != INVALID_PAGE_ID && pages_[i].GetPinCount() == 0) {
+      reusable++;
+      clean += static_cast<size_t>(!pages_[i].IsDirty());
+    }
+  }
+  return reusable == 0 ? 1 : static_cast<double>(clean) / static_cast<double>(reusable);
+}
+
+void BufferPoolManagerInstance::PrefetchPages(page_id_t start_page_id, size_t count) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (prefetch_workers_.empty()) {
+    for (int i = 0; i < PREFETCH_WORKERS; i++) {
+      prefetch_workers_.emplace_back(&BufferPoolManagerInstance::RunPrefetchWorker, this);
+    }
+  }
+
+  size_t max_prefetched = std::max<size_t>(pool_size_ / 4, 1);
+  // pages this instance has not allocated yet do not exist
+  auto end_page_id =
+      static_cast<page_id_t>(std::min<int64_t>(static_cast<int64_t>(start_page_id) + count, next_page_id_));
+  for (page_id_t page_id = std::max(start_page_id, 0); page_id < end_page_id; page_id++) {
+    // never take the frame of an earlier prefetch
+    if (prefetched_frames_.size() >= max_prefetched || (free_list_.empty() && replacer_->Size() == 0)) {
+      break;
+    }
+    frame_id_t frame_id;
+    if (page_id % static_cast<page_id_t>(num_instances_) != static_cast<page_id_t>(instance_index_) ||
+        page_table_->Find(page_id, frame_id) || write_back_table_.count(page_id) != 0) {
+      continue;
+    }
+    page_id_t victim_page_id;
+    if (!AcquireFrame(&frame_id, &victim_page_id)) {
+      break;
+    }
+    // Reserve the frame like a fetch miss does. The prefetch holds a pin until the read is done.
+    Page *page = pages_ + frame_id;
+    page->page_id_ = page_id;
+    page->pin_count_ = 1;
+    page->is_dirty_ = false;
+    io_in_flight_[frame_id] = true;
+    page_table_->Insert(page_id, frame_id);
+    replacer_->SetEvictable(frame_id, false);
+    // read-ahead is for scans, the page only gets a history once it is fetched without a strategy
+    replacer_->RecordAccess(frame_id, AccessType::Scan);
+    prefetch_queue_.emplace_back(frame_id, victim_page_id);
+    prefetched_frames_.push_back(frame_id);
+    is_prefetched_[frame_id] = true;
+    stats_.pages_prefetched_.fetch_add(1, std::memory_order_relaxed);
+  }
+  prefetch_cv_.notify_all();
+}
+
+void BufferPoolManagerInstance::RunPrefetchWorker() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    // drain the queue before stopping, queued frames are pinned
+    prefetch_cv_.wait(lock, [&] { return !enable_prefetch_ || !prefetch_queue_.empty(); });
+    if (prefetch_queue_.empty()) {
+      return;
+    }
+    auto [frame_id, victim_page_id] = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+    Page *page = pages_ + frame_id;
+    lock.unlock();
+
+    if (victim_page_id != INVALID_PAGE_ID) {
+      WritePageToDisk(victim_page_id, page->GetData());
+    }
+    page->ResetMemory();
+    ReadPageFromDisk(page->GetPageId(), page->data_);
+
+    lock.lock();
+    FinishFrameIO(frame_id, victim_page_id);
+    // the frame stays out of the replacer until the page is fetched, unless that already happened
+    if (--page->pin_count_ == 0 && !is_prefetched_[frame_id]) {
+      replacer_->SetEvictable(frame_id, true);
+    }
+  }
+}
+
+auto BufferPoolManagerInstance::ForgetPrefetch(frame_id_t frame_id) -> bool {
+  if (!is_prefetched_[frame_id]) {
+    return false;
+  }
+  is_prefetched_[frame_id] = false;
+  prefetched_frames_.remove(frame_id);
+  return true;
+}
+
+void BufferPoolManagerInstance::BeginPageWrite(frame_id_t frame_id) {
+  pages_[frame_id].pin_count_++;
+  pages_[frame_id].is_dirty_ = false;
+  writes_in_flight_[frame_id]++;
+  replacer_->SetEvictable(frame_id, false);
+}
+
+void BufferPoolManagerInstance::EndPageWrite(frame_id_t frame_id) {
+  // whoever else has the page pinned may still change it
+  if (--pages_[frame_id].pin_count_ == 0) {
+    if (!is_prefetched_[frame_id]) {
+      replacer_->SetEvictable(frame_id, true);
+    }
+    if (!pages_[frame_id].is_dirty_) {
+      pages_[frame_id].rec_lsn_ = INVALID_LSN;
+    }
+  }
+  if (--writes_in_flight_[frame_id] == 0) {
+    io_cv_[frame_id].notify_all();
+  }
+}
+
+void BufferPoolManagerInstance::PinRecLSN(Page *page) {
+  if (log_manager_ != nullptr && page->rec_lsn_ == INVALID_LSN) {
+    page->rec_lsn_ = log_manager_->GetNextLSN();
+  }
+}
+
+void BufferPoolManagerInstance::ReadPageFromDisk(page_id_t page_id, char *page_data) {
+  auto start = std::chrono::steady_clock::now();
+  disk_manager_->ReadPage(page_id, page_data);
+  stats_.read_latency_.Record(std::chrono::steady_clock::now() - start);
+}
+
+void BufferPoolManagerInstance::FlushLogForPage(const char *page_data) {
+  if (log_manager_ == nullptr || !enable_logging) {
+    return;
+  }
+  lsn_t page_lsn;
+  memcpy(&page_lsn, page_data + Page::OFFSET_LSN, sizeof(lsn_t));
+  // not every page keeps an LSN there, anything that is not the LSN of a log record in memory is ignored
+  if (page_lsn > log_manager_->GetPersistentLSN() && page_lsn < log_manager_->GetNextLSN()) {
+    log_manager_->WaitForFlush(page_lsn);
+  }
+}
+
+void BufferPoolManagerInstance::WritePageToDisk(page_id_t page_id, const char *page_data) {
+  FlushLogForPage(page_data);
+  auto start = std::chrono::steady_clock::now();
+  disk_manager_->WritePage(page_id, page_data);
+  stats_.write_latency_.Record(std::chrono::steady_clock::now() - start);
+}
+
+void BufferPoolManagerInstance::WritePagesToDisk(const std::vector<std::pair<page_id_t, const char *>> &pages) {
+  std::vector<DiskRequest> requests;
+  std::vector<std::future<void>> writes;
+  std::vector<std::chrono::nanoseconds> latencies(pages.size());
+  requests.reserve(pages.size());
+  writes.reserve(pages.size());
+  for (const auto &page : pages) {
+    FlushLogForPage(page.second);
+  }
+  auto submit_time = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < pages.size(); i++) {
+    // the data of a write is only ever read from
+    requests.push_back({true, const_cast<char *>(pages[i].second), pages[i].first, std::promise<void>(), submit_time,
+                        &latencies[i]});
+    writes.push_back(requests.back().callback_.get_future());
+  }
+  disk_manager_->Submit(std::move(requests));
+  for (size_t i = 0; i < writes.size(); i++) {
+    writes[i].get();
+    stats_.write_latency_.Record(latencies[i]);
+  }
+}
+
+auto BufferPoolManagerInstance::AllocatePage() -> page_id_t {
+  const page_id_t next_page_id = next_page_id_.fetch_add(static_cast<page_id_t>(num_instances_));
+  ValidatePageId(next_page_id);
+  return next_page_id;
+}
+
+void BufferPoolManagerInstance::ValidatePageId(const page_id_t page_id) const {
+  BUSTUB_ASSERT(page_id % num_instances_ == instance_index_, "allocated pages should mod back to this BPI");
+}
 
 }  // namespace bustub
@@ -0,0 +1,101 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.cpp
+//
+// Identification: src/buffer/buffer_pool_stats.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_stats.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+auto LatencyStats::MeanMicros() const -> double {
+  return count_ == 0 ? 0 : static_cast<double>(total_us_) / static_cast<double>(count_);
+}
+
+auto LatencyStats::QuantileMicros(double quantile) const -> uint64_t {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(quantile * static_cast<double>(count_ - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return uint64_t{1} << i;
+    }
+  }
+  return uint64_t{1} << (LATENCY_BUCKETS - 1);
+}
+
+void LatencyStats::Merge(const LatencyStats &other) {
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  total_us_ += other.total_us_;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+  auto micros = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0) / 1000);
+  // the bucket is the number of significant bits of the latency in microseconds
+  size_t bucket = 0;
+  for (uint64_t rest = micros; rest != 0 && bucket < LATENCY_BUCKETS - 1; rest >>= 1) {
+    bucket++;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_us_.fetch_add(micros, std::memory_order_relaxed);
+}
+
+auto LatencyHistogram::Read() const -> LatencyStats {
+  LatencyStats stats;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    stats.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  stats.count_ = count_.load(std::memory_order_relaxed);
+  stats.total_us_ = total_us_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+auto BufferPoolStats::HitRate() const -> double {
+  uint64_t fetches = hits_ + misses_;
+  return fetches == 0 ? 0 : static_cast<double>(hits_) / static_cast<double>(fetches);
+}
+
+void BufferPoolStats::Merge(const BufferPoolStats &other) {
+  pool_size_ += other.pool_size_;
+  hits_ += other.hits_;
+  misses_ += other.misses_;
+  evictions_ += other.evictions_;
+  dirty_write_backs_ += other.dirty_write_backs_;
+  pages_cleaned_ += other.pages_cleaned_;
+  pages_prefetched_ += other.pages_prefetched_;
+  pin_wait_.Merge(other.pin_wait_);
+  read_latency_.Merge(other.read_latency_);
+  write_latency_.Merge(other.write_latency_);
+}
+
+auto BufferPoolCounters::Read(size_t pool_size) const -> BufferPoolStats {
+  BufferPoolStats stats;
+  stats.pool_size_ = pool_size;
+  stats.hits_ = hits_.load(std::memory_order_relaxed);
+  stats.misses_ = misses_.load(std::memory_order_relaxed);
+  stats.evictions_ = evictions_.load(std::memory_order_relaxed);
+  stats.dirty_write_backs_ = dirty_write_backs_.load(std::memory_order_relaxed);
+  stats.pages_cleaned_ = pages_cleaned_.load(std::memory_order_relaxed);
+  stats.pages_prefetched_ = pages_prefetched_.load(std::memory_order_relaxed);
+  stats.pin_wait_ = pin_wait_.Read();
+  stats.read_latency_ = read_latency_.Read();
+  stats.write_latency_ = write_latency_.Read();
+  return stats;
+}
+
+}  // namespace bustub
@@ -23,58 +23,43 @@ LRUKReplacer::LRUKReplacer(size_t num_frames, size_t k) : replacer_size_(num_fra
 
 auto LRUKReplacer::Evict(frame_id_t *frame_id) -> bool {
   std::scoped_lock<std::mutex> lock(latch_);
-  size_t ps = SIZE_MAX;
-  size_t longest_interval = 0;
-  for (size_t i = 0; i < frame_arr_.size(); i++) {
-    if (frame_arr_.at(i).IsInReplacer() && frame_arr_.at(i).GetEvictable()) {
-      if (frame_arr_.at(i).GetLastKthAcc(current_timestamp_) == SIZE_MAX) {
-        // this is not kth
-        if (longest_interval == SIZE_MAX) {
-          // muliple
-          ps = SIZE_MAX;
-          break;
-        }
-        ps = i;
-        longest_interval = frame_arr_.at(i).GetLastKthAcc(current_timestamp_);
-      } else if (frame_arr_.at(i).GetLastKthAcc(current_timestamp_) > longest_interval) {
-        ps = i;
-        longest_interval = frame_arr_.at(i).GetLastKthAcc(current_timestamp_);
-      }
-    }
-  }
-  if (ps != SIZE_MAX) {
-    frame_arr_.at(ps).Evict();
-    *frame_id = static_cast<frame_id_t>(ps);
-    curr_size_--;
-    return true;
-  }
-  // use classic lru
-  longest_interval = 0;
-  for (size_t i = 0; i < frame_arr_.size(); i++) {
-    if (frame_arr_.at(i).IsInReplacer() && frame_arr_.at(i).GetEvictable() &&
-        frame_arr_.at(i).GetLastKthAcc(current_timestamp_) == SIZE_MAX) {
-      if (frame_arr_.at(i).GetLastAcc(current_timestamp_) > longest_interval) {
-        ps = i;
-        longest_interval = frame_arr_.at(i).GetLastAcc(current_timestamp_);
-      }
-    }
-  }
-  if (ps != SIZE_MAX) {
-    frame_arr_.at(ps).Evict();
-    *frame_id = static_cast<frame_id_t>(ps);
-    curr_size_--;
-    return true;
-  }
-  return false;
+  // frames only seen by scans go first, then frames with +inf backward k-distance, the one accessed earliest among them
+  auto &victims = !scan_set_.empty() ? scan_set_ : !history_set_.empty() ? history_set_ : cache_set_;
+  if (victims.empty()) {
+    return false;
+  }
+  frame_id_t victim = victims.begin()->second;
+  victims.erase(victims.begin());
+  frame_arr_.at(victim).Evict();
+  *frame_id = victim;
+  curr_size_--;
+  return true;
 }
 
-void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
+void LRUKReplacer::RecordAccess(frame_id_t frame_id, AccessType access_type) {
   std::scoped_lock<std::mutex> lock(latch_);
   // BUSTUB_ASSERT((static_cast<size_t>(frame_id) > replacer_size_), "frame_id overflow");
   if (static_cast<size_t>(frame_id) >= replacer_size_) {
     return;
   }
-  frame_arr_.at(frame_id).Access(current_timestamp_++);
+  auto &frame = frame_arr_.at(frame_id);
+  if (access_type == AccessType::Scan && frame.IsInReplacer() && !frame.IsScanOnly()) {
+    // a scan does not make a frame with a history any hotter
+    return;
+  }
+  bool evictable = frame.GetEvictable();
+  if (evictable) {
+    // the access changes the frame's position
+    Dequeue(frame_id);
+  }
+  if (access_type == AccessType::Scan) {
+    frame.AccessScan(current_timestamp_++);
+  } else {
+    frame.Access(current_timestamp_++);
+  }
+  if (evictable) {
+    Enqueue(frame_id);
+  }
 }
 
 void LRUKReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
@@ -88,10 +73,12 @@ void LRUKReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
   }
   if (frame_arr_.at(frame_id).GetEvictable() && !set_evictable) {
     curr_size_--;
+    Dequeue(frame_id);
     frame_arr_.at(frame_id).SetEvictable(set_evictable);
   } else if (!frame_arr_.at(frame_id).GetEvictable() && set_evictable) {
     curr_size_++;
     frame_arr_.at(frame_id).SetEvictable(set_evictable);
+    Enqueue(frame_id);
   }
 }
 
@@ -108,14 +95,52 @@ void LRUKReplacer::Remove(frame_id_t frame_id) {
     return;
   }
   curr_size_--;
+  Dequeue(frame_id);
   frame_arr_.at(frame_id).Evict();
 }
 
+auto LRUKReplacer::NextVictims(size_t max_frames) -> std::vector<frame_id_t> {
+  std::scoped_lock<std::mutex> lock(latch_);
+  std::vector<frame_id_t> victims;
+  for (const auto *frames : {&scan_set_, &history_set_, &cache_set_}) {
+    for (auto it = frames->begin(); it != frames->end() && victims.size() < max_frames; ++it) {
+      victims.push_back(it->second);
+    }
+  }
+  return victims;
+}
+
+auto LRUKReplacer::IsEvictableScanOnly(frame_id_t frame_id) -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (static_cast<size_t>(frame_id) >= replacer_size_) {
+    return false;
+  }
+  const auto &frame = frame_arr_.at(frame_id);
+  return frame.IsInReplacer() && frame.GetEvictable() && frame.IsScanOnly();
+}
+
 auto LRUKReplacer::Size() -> size_t {
   std::scoped_lock<std::mutex> lock(latch_);
   return curr_size_;
 }
 
+void LRUKReplacer::Enqueue(frame_id_t frame_id) {
+  const auto &frame = frame_arr_.at(frame_id);
+  SetOf(frame).emplace(frame.GetEarliestAcc(), frame_id);
+}
+
+void LRUKReplacer::Dequeue(frame_id_t frame_id) {
+  const auto &frame = frame_arr_.at(frame_id);
+  SetOf(frame).erase({frame.GetEarliestAcc(), frame_id});
+}
+
+auto LRUKReplacer::SetOf(const Frame &frame) -> std::set<FrameKey> & {
+  if (frame.IsScanOnly()) {
+    return scan_set_;
+  }
+  return frame.HasKAccesses() ? cache_set_ : history_set_;
+}
+
 //========================//
 LRUKReplacer::Frame::Frame(size_t size) : size_(size) {
   last_access_timestamp_.resize(size_);
@@ -129,6 +154,7 @@ LRUKReplacer::Frame::Frame(size_t size) : size_(size) {
 void LRUKReplacer::Frame::Evict() {
   in_replacer_ = false;
   evictable_ = false;
+  scan_only_ = false;
   access_ptr_ = 0;
   for (auto &i : last_access_timestamp_) {
     i = SIZE_MAX;
@@ -139,23 +165,30 @@ void LRUKReplacer::Frame::Access(size_t timestamp) {
   if (!in_replacer_) {
     in_replacer_ = true;
   }
+  if (scan_only_) {
+    // the first real access starts the history
+    scan_only_ = false;
+    last_access_timestamp_.at(0) = SIZE_MAX;
+  }
   last_access_timestamp_.at(access_ptr_) = timestamp;
   access_ptr_ = (access_ptr_ + 1) % size_;
 }
 
-auto LRUKReplacer::Frame::GetLastKthAcc(size_t timestamp) const -> size_t {
-  if (last_access_timestamp_.at(access_ptr_) == SIZE_MAX) {
-    return SIZE_MAX;
+void LRUKReplacer::Frame::AccessScan(size_t timestamp) {
+  if (!in_replacer_) {
+    in_replacer_ = true;
+    scan_only_ = true;
   }
-  return timestamp - last_access_timestamp_.at(access_ptr_);
-}
-auto LRUKReplacer::Frame::GetLastAcc(size_t timestamp) const -> size_t {
-  size_t target_ptr = access_ptr_;
-  while (last_access_timestamp_.at(target_ptr) == SIZE_MAX) {
-    target_ptr++;
-    target_ptr %= size_;
+  if (scan_only_) {
+    last_access_timestamp_.at(0) = timestamp;
   }
-  return timestamp - last_access_timestamp_.at(target_ptr);
 }
 
+auto LRUKReplacer::Frame::GetEarliestAcc() const -> size_t {
+  // with k accesses, access_ptr_ points at the kth last one; with less, the slots are filled from the start
+  return HasKAccesses() ? last_access_timestamp_.at(access_ptr_) : last_access_timestamp_.at(0);
+}
+
+auto LRUKReplacer::Frame::HasKAccesses() const -> bool { return last_access_timestamp_.at(access_ptr_) != SIZE_MAX; }
+
 }  // namespace bustub
@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parallel_buffer_pool_manager.cpp
+//
+// Identification: src/buffer/parallel_buffer_pool_manager.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/parallel_buffer_pool_manager.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size,
+                                                     DiskManager *disk_manager, size_t replacer_k,
+                                                     LogManager *log_manager)
+    : num_instances_(num_instances), pool_size_(pool_size) {
+  BUSTUB_ASSERT(num_instances > 0, "parallel buffer pool needs at least one instance");
+  // Allocate and create individual BufferPoolManagerInstances
+  instances_.reserve(num_instances_);
+  for (size_t i = 0; i < num_instances_; i++) {
+    instances_.emplace_back(new BufferPoolManagerInstance(pool_size_, static_cast<uint32_t>(num_instances_),
+                                                          static_cast<uint32_t>(i), disk_manager, replacer_k,
+                                                          log_manager));
+  }
+}
+
+ParallelBufferPoolManager::~ParallelBufferPoolManager() {
+  for (auto *instance : instances_) {
+    delete instance;
+  }
+}
+
+auto ParallelBufferPoolManager::GetPoolSize() -> size_t { return num_instances_ * pool_size_; }
+
+void ParallelBufferPoolManager::PrefetchPages(page_id_t start_page_id, size_t count) {
+  for (auto *instance : instances_) {
+    instance->PrefetchPages(start_page_id, count);
+  }
+}
+
+auto ParallelBufferPoolManager::FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+  return GetBufferPoolManager(page_id)->FetchPageWithStrategy(page_id, strategy);
+}
+
+auto ParallelBufferPoolManager::GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> {
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (auto *instance : instances_) {
+    auto instance_dirty_pages = instance->GetDirtyPageTable();
+    dirty_pages.insert(dirty_pages.end(), instance_dirty_pages.begin(), instance_dirty_pages.end());
+  }
+  return dirty_pages;
+}
+
+auto ParallelBufferPoolManager::GetStats() -> BufferPoolStats {
+  BufferPoolStats stats;
+  for (auto *instance : instances_) {
+    stats.Merge(instance->GetStats());
+  }
+  return stats;
+}
+
+auto ParallelBufferPoolManager::GetInstanceStats(size_t instance_index) -> BufferPoolStats {
+  BUSTUB_ASSERT(instance_index < num_instances_, "instance index out of range");
+  return instances_[instance_index]->GetStats();
+}
+
+auto ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) -> BufferPoolManagerInstance * {
+  BUSTUB_ASSERT(page_id >= 0, "page id must be valid to be routed to an instance");
+  return instances_[static_cast<size_t>(page_id) % num_instances_];
+}
+
+auto ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) -> Page * {
+  return GetBufferPoolManager(page_id)->FetchPage(page_id);
+}
+
+auto ParallelBufferPoolManager::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
+  return GetBufferPoolManager(page_id)->UnpinPage(page_id, is_dirty);
+}
+
+auto ParallelBufferPoolManager::FlushPgImp(page_id_t page_id) -> bool {
+  return GetBufferPoolManager(page_id)->FlushPage(page_id);
+}
+
+auto ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) -> Page * {
+  // Start from a different instance on every call so that new pages spread evenly over the shards, and give up only
+  // after every instance has been asked once.
+  size_t start = next_instance_.fetch_add(1) % num_instances_;
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto *page = instances_[(start + i) % num_instances_]->NewPage(page_id);
+    if (page != nullptr) {
+      return page;
+    }
+  }
+  return nullptr;
+}
+
+auto ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) -> bool {
+  return GetBufferPoolManager(page_id)->DeletePage(page_id);
+}
+
+void ParallelBufferPoolManager::FlushAllPgsImp() {
+  for (auto *instance : instances_) {
+    instance->FlushAllPages();
+  }
+}
+
+}  // namespace bustub
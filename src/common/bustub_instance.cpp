@@ -12,6 +12,7 @@
 #include "binder/statement/select_statement.h"
 #include "binder/statement/set_show_statement.h"
 #include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/parallel_buffer_pool_manager.h"
 #include "catalog/schema.h"
 #include "catalog/table_generator.h"
 #include "common/bustub_instance.h"
@@ -32,7 +33,9 @@
 #include "recovery/checkpoint_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/disk_manager_async.h"
 #include "storage/disk/disk_manager_memory.h"
+#include "storage/disk/disk_manager_posix.h"
 #include "type/value_factory.h"
 
 namespace bustub {
@@ -41,26 +44,47 @@ auto BustubInstance::MakeExecutorContext(Transaction *txn) -> std::unique_ptr<Ex
   return std::make_unique<ExecutorContext>(txn, catalog_, buffer_pool_manager_, txn_manager_, lock_manager_);
 }
 
-BustubInstance::BustubInstance(const std::string &db_file_name) {
+auto BustubInstance::MakeBufferPoolManager(size_t bpm_num_instances) -> BufferPoolManager * {
+  // We need more frames for GenerateTestTable to work. Therefore, we use 128 instead of the default
+  // buffer pool size specified in `config.h`. Every shard of a parallel buffer pool gets the same number of frames.
+  try {
+    if (bpm_num_instances > 1) {
+      return new ParallelBufferPoolManager(bpm_num_instances, 128, disk_manager_, LRUK_REPLACER_K, log_manager_);
+    }
+    return new BufferPoolManagerInstance(128, disk_manager_, LRUK_REPLACER_K, log_manager_);
+  } catch (NotImplementedException &e) {
+    std::cerr << "BufferPoolManager is not implemented, only mock tables are supported." << std::endl;
+    return nullptr;
+  }
+}
+
+BustubInstance::BustubInstance(const std::string &db_file_name, size_t bpm_num_instances,
+                               DiskManagerType disk_manager_type, DeadlockPolicy deadlock_policy) {
   enable_logging = false;
 
   // Storage related.
-  disk_manager_ = new DiskManager(db_file_name);
+  switch (disk_manager_type) {
+    case DiskManagerType::POSIX:
+      disk_manager_ = new DiskManagerPosix(db_file_name);
+      break;
+    case DiskManagerType::POSIX_DIRECT:
+      disk_manager_ = new DiskManagerPosix(db_file_name, true);
+      break;
+    case DiskManagerType::ASYNC:
+      disk_manager_ = new DiskManagerAsync(db_file_name);
+      break;
+    default:
+      disk_manager_ = new DiskManager(db_file_name);
+      break;
+  }
 
   // Log related.
   log_manager_ = new LogManager(disk_manager_);
 
-  // We need more frames for GenerateTestTable to work. Therefore, we use 128 instead of the default
-  // buffer pool size specified in `config.h`.
-  try {
-    buffer_pool_manager_ = new BufferPoolManagerInstance(128, disk_manager_, LRUK_REPLACER_K, log_manager_);
-  } catch (NotImplementedException &e) {
-    std::cerr << "BufferPoolManager is not implemented, only mock tables are supported." << std::endl;
-    buffer_pool_manager_ = nullptr;
-  }
+  buffer_pool_manager_ = MakeBufferPoolManager(bpm_num_instances);
 
   // Transaction (txn) related.
-  lock_manager_ = new LockManager();
+  lock_manager_ = new LockManager(deadlock_policy);
   txn_manager_ = new TransactionManager(lock_manager_, log_manager_);
 
   // Checkpoint related.
@@ -73,7 +97,7 @@ BustubInstance::BustubInstance(const std::string &db_file_name) {
   execution_engine_ = new ExecutionEngine(buffer_pool_manager_, txn_manager_, catalog_);
 }
 
-BustubInstance::BustubInstance() {
+BustubInstance::BustubInstance(size_t bpm_num_instances, DeadlockPolicy deadlock_policy) {
   enable_logging = false;
 
   // Storage related.
@@ -82,17 +106,10 @@ BustubInstance::BustubInstance() {
   // Log related.
   log_manager_ = new LogManager(disk_manager_);
 
-  // We need more frames for GenerateTestTable to work. Therefore, we use 128 instead of the default
-  // buffer pool size specified in `config.h`.
-  try {
-    buffer_pool_manager_ = new BufferPoolManagerInstance(128, disk_manager_, LRUK_REPLACER_K, log_manager_);
-  } catch (NotImplementedException &e) {
-    std::cerr << "BufferPoolManager is not implemented, only mock tables are supported." << std::endl;
-    buffer_pool_manager_ = nullptr;
-  }
+  buffer_pool_manager_ = MakeBufferPoolManager(bpm_num_instances);
 
   // Transaction (txn) related.
-  lock_manager_ = new LockManager();
+  lock_manager_ = new LockManager(deadlock_policy);
   txn_manager_ = new TransactionManager(lock_manager_, log_manager_);
 
   // Checkpoint related.
@@ -146,6 +163,68 @@ void BustubInstance::CmdDisplayIndices(ResultWriter &writer) {
   writer.EndTable();
 }
 
+void BustubInstance::CmdDisplayStats(ResultWriter &writer) {
+  if (buffer_pool_manager_ == nullptr) {
+    throw Exception("buffer pool manager is not available");
+  }
+  auto stats = buffer_pool_manager_->GetStats();
+  auto latency = [](const LatencyStats &latency) {
+    return fmt::format("n={} mean={:.1f}us p50<={}us p99<={}us max<={}us", latency.count_, latency.MeanMicros(),
+                       latency.QuantileMicros(0.5), latency.QuantileMicros(0.99), latency.QuantileMicros(1));
+  };
+  writer.BeginTable(false);
+  writer.BeginHeader();
+  writer.WriteHeaderCell("stat");
+  writer.WriteHeaderCell("value");
+  writer.EndHeader();
+  for (const auto &[name, value] : std::vector<std::pair<std::string, std::string>>{
+           {"pool_size", fmt::format("{}", stats.pool_size_)},
+           {"hits", fmt::format("{}", stats.hits_)},
+           {"misses", fmt::format("{}", stats.misses_)},
+           {"hit_rate", fmt::format("{:.4f}", stats.HitRate())},
+           {"evictions", fmt::format("{}", stats.evictions_)},
+           {"dirty_write_backs", fmt::format("{}", stats.dirty_write_backs_)},
+           {"pages_cleaned", fmt::format("{}", stats.pages_cleaned_)},
+           {"pages_prefetched", fmt::format("{}", stats.pages_prefetched_)},
+           {"pin_wait", latency(stats.pin_wait_)},
+           {"read_latency", latency(stats.read_latency_)},
+           {"write_latency", latency(stats.write_latency_)},
+       }) {
+    writer.BeginRow();
+    writer.WriteCell(name);
+    writer.WriteCell(value);
+    writer.EndRow();
+  }
+  writer.EndTable();
+
+  // A shard that misses much more than the others points at a skewed page distribution.
+  auto *parallel_bpm = dynamic_cast<ParallelBufferPoolManager *>(buffer_pool_manager_);
+  if (parallel_bpm == nullptr) {
+    return;
+  }
+  writer.BeginTable(false);
+  writer.BeginHeader();
+  writer.WriteHeaderCell("instance");
+  writer.WriteHeaderCell("hits");
+  writer.WriteHeaderCell("misses");
+  writer.WriteHeaderCell("hit_rate");
+  writer.WriteHeaderCell("evictions");
+  writer.WriteHeaderCell("dirty_write_backs");
+  writer.EndHeader();
+  for (size_t i = 0; i < parallel_bpm->GetNumInstances(); i++) {
+    auto instance_stats = parallel_bpm->GetInstanceStats(i);
+    writer.BeginRow();
+    writer.WriteCell(fmt::format("{}", i));
+    writer.WriteCell(fmt::format("{}", instance_stats.hits_));
+    writer.WriteCell(fmt::format("{}", instance_stats.misses_));
+    writer.WriteCell(fmt::format("{:.4f}", instance_stats.HitRate()));
+    writer.WriteCell(fmt::format("{}", instance_stats.evictions_));
+    writer.WriteCell(fmt::format("{}", instance_stats.dirty_write_backs_));
+    writer.EndRow();
+  }
+  writer.EndTable();
+}
+
 void BustubInstance::WriteOneCell(const std::string &cell, ResultWriter &writer) {
   writer.BeginTable(true);
   writer.BeginRow();
@@ -159,6 +238,7 @@ void BustubInstance::CmdDisplayHelp(ResultWriter &writer) {
 
 \dt: show all tables
 \di: show all indices
+\stats: show buffer pool statistics
 \help: show this message again
 
 BusTub shell currently only supports a small set of Postgres queries. We'll set
@@ -175,9 +255,9 @@ see the execution plan of your query.
 auto BustubInstance::ExecuteSql(const std::string &sql, ResultWriter &writer) -> bool {
   auto txn = txn_manager_->Begin();
   auto result = ExecuteSqlTxn(sql, writer, txn);
-  txn_manager_->Commit(txn);
+  bool committed = txn_manager_->Commit(txn);
   delete txn;
-  return result;
+  return result && committed;
 }
 
 auto BustubInstance::ExecuteSqlTxn(const std::string &sql, ResultWriter &writer, Transaction *txn) -> bool {
@@ -191,6 +271,14 @@ auto BustubInstance::ExecuteSqlTxn(const std::string &sql, ResultWriter &writer,
       CmdDisplayIndices(writer);
       return true;
     }
+    if (sql == "\\stats") {
+      CmdDisplayStats(writer);
+      return true;
+    }
+    if (sql == "\\stats") {
+      CmdDisplayStats(writer);
+      return true;
+    }
     if (sql == "\\help") {
       CmdDisplayHelp(writer);
       return true;
@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// coding_util.cpp
+//
+// Identification: src/common/util/coding_util.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/coding_util.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace bustub {
+
+namespace {
+
+/** The reflected CRC32C polynomial. */
+constexpr uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+
+constexpr auto MakeCrc32cTable() -> std::array<uint32_t, 256> {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) != 0 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC32C_TABLE = MakeCrc32cTable();
+
+auto Crc32cTable(uint32_t crc, const char *data, size_t size) -> uint32_t {
+  for (size_t i = 0; i < size; i++) {
+    crc = CRC32C_TABLE[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) auto Crc32cSse42(uint32_t crc, const char *data, size_t size) -> uint32_t {
+  uint64_t crc64 = crc;
+  for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(uint64_t));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; size > 0; data++, size--) {
+    crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*data));
+  }
+  return crc;
+}
+
+auto HasSse42() -> bool {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") != 0;
+}
+#endif
+
+}  // namespace
+
+auto CodingUtil::Crc32c(const char *data, size_t size) -> uint32_t {
+#if defined(__x86_64__)
+  static const bool has_sse42 = HasSse42();
+  if (has_sse42) {
+    return ~Crc32cSse42(~0U, data, size);
+  }
+#endif
+  return ~Crc32cTable(~0U, data, size);
+}
+
+}  // namespace bustub
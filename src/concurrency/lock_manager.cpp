@@ -12,38 +12,657 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <functional>
+
 #include "common/config.h"
+#include "common/macros.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 
 namespace bustub {
 
-auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool { return true; }
+auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  CheckLockAllowed(txn, lock_mode);
+  LockMode held_mode;
+  bool held = GetTableLockMode(txn, oid, &held_mode);
+  if (held && held_mode == lock_mode) {
+    return true;
+  }
+  if (held && !CanUpgrade(held_mode, lock_mode)) {
+    AbortTransaction(txn, AbortReason::INCOMPATIBLE_UPGRADE);
+  }
+
+  auto queue = GetTableQueue(oid);
+  if (!held && !IsStrong(lock_mode) && TryFastPathLock(queue.get(), lock_mode)) {
+    GetTableLockSet(txn, lock_mode)->insert(oid);
+    txn->GetFastPathTableLockSet()->insert(oid);
+    return true;
+  }
+  if (held && txn->GetFastPathTableLockSet()->count(oid) != 0) {
+    MoveFastPathLockToQueue(txn, queue.get(), held_mode, oid);
+  }
+  if (!AcquireLock(txn, queue.get(), new LockRequest(txn->GetTransactionId(), lock_mode, oid), held)) {
+    return false;
+  }
+  if (held) {
+    GetTableLockSet(txn, held_mode)->erase(oid);
+  }
+  GetTableLockSet(txn, lock_mode)->insert(oid);
+  return true;
+}
+
+auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool {
+  LockMode held_mode;
+  if (!GetTableLockMode(txn, oid, &held_mode)) {
+    AbortTransaction(txn, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
+  }
+  for (const auto &row_lock_set : {txn->GetSharedRowLockSet(), txn->GetExclusiveRowLockSet()}) {
+    auto rows = row_lock_set->find(oid);
+    if (rows != row_lock_set->end() && !rows->second.empty()) {
+      AbortTransaction(txn, AbortReason::TABLE_UNLOCKED_BEFORE_UNLOCKING_ROWS);
+    }
+  }
 
-auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool { return true; }
+  auto queue = GetTableQueue(oid);
+  if (txn->GetFastPathTableLockSet()->erase(oid) != 0) {
+    ReleaseFastPathLock(queue.get(), held_mode);
+  } else {
+    ReleaseLock(queue.get(), txn->GetTransactionId());
+  }
+  UpdateStateOnUnlock(txn, held_mode);
+  GetTableLockSet(txn, held_mode)->erase(oid);
+  return true;
+}
 
 auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const RID &rid) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (lock_mode != LockMode::SHARED && lock_mode != LockMode::EXCLUSIVE) {
+    AbortTransaction(txn, AbortReason::ATTEMPTED_INTENTION_LOCK_ON_ROW);
+  }
+  CheckLockAllowed(txn, lock_mode);
+  // an X lock on a row needs an IX, SIX or X lock on its table, an S lock any lock
+  LockMode table_mode;
+  if (!GetTableLockMode(txn, oid, &table_mode) ||
+      (lock_mode == LockMode::EXCLUSIVE && table_mode != LockMode::INTENTION_EXCLUSIVE &&
+       table_mode != LockMode::SHARED_INTENTION_EXCLUSIVE && table_mode != LockMode::EXCLUSIVE)) {
+    AbortTransaction(txn, AbortReason::TABLE_LOCK_NOT_PRESENT);
+  }
+  if (txn->IsRowExclusiveLocked(oid, rid) || (lock_mode == LockMode::SHARED && txn->IsRowSharedLocked(oid, rid))) {
+    return true;
+  }
+  bool upgrade = txn->IsRowSharedLocked(oid, rid);
+
+  auto queue = GetRowQueue(rid);
+  if (!AcquireLock(txn, queue.get(), new LockRequest(txn->GetTransactionId(), lock_mode, oid, rid), upgrade)) {
+    queue.reset();
+    DropRowQueueIfUnused(rid);
+    return false;
+  }
+  if (upgrade) {
+    (*txn->GetSharedRowLockSet())[oid].erase(rid);
+  }
+  (*GetRowLockSet(txn, lock_mode))[oid].insert(rid);
   return true;
 }
 
-auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool { return true; }
+auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool {
+  LockMode held_mode;
+  if (txn->IsRowExclusiveLocked(oid, rid)) {
+    held_mode = LockMode::EXCLUSIVE;
+  } else if (txn->IsRowSharedLocked(oid, rid)) {
+    held_mode = LockMode::SHARED;
+  } else {
+    AbortTransaction(txn, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
+  }
 
-void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {}
+  auto queue = FindRowQueue(rid);
+  BUSTUB_ASSERT(queue != nullptr, "a locked row should have a queue");
+  ReleaseLock(queue.get(), txn->GetTransactionId());
+  queue.reset();
+  DropRowQueueIfUnused(rid);
+  UpdateStateOnUnlock(txn, held_mode);
+  (*GetRowLockSet(txn, held_mode))[oid].erase(rid);
+  return true;
+}
 
-void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {}
+auto LockManager::TryCommit(Transaction *txn) -> bool {
+  std::scoped_lock lock(waits_for_latch_);
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  txn->SetState(TransactionState::COMMITTED);
+  return true;
+}
 
-auto LockManager::HasCycle(txn_id_t *txn_id) -> bool { return false; }
+auto LockManager::AreCompatible(LockMode held_mode, LockMode requested_mode) -> bool {
+  switch (held_mode) {
+    case LockMode::INTENTION_SHARED:
+      return requested_mode != LockMode::EXCLUSIVE;
+    case LockMode::INTENTION_EXCLUSIVE:
+      return requested_mode == LockMode::INTENTION_SHARED || requested_mode == LockMode::INTENTION_EXCLUSIVE;
+    case LockMode::SHARED:
+      return requested_mode == LockMode::INTENTION_SHARED || requested_mode == LockMode::SHARED;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return requested_mode == LockMode::INTENTION_SHARED;
+    case LockMode::EXCLUSIVE:
+      return false;
+  }
+  return false;
+}
+
+auto LockManager::CanUpgrade(LockMode held_mode, LockMode requested_mode) -> bool {
+  switch (held_mode) {
+    case LockMode::INTENTION_SHARED:
+      return requested_mode != LockMode::INTENTION_SHARED;
+    case LockMode::SHARED:
+    case LockMode::INTENTION_EXCLUSIVE:
+      return requested_mode == LockMode::EXCLUSIVE || requested_mode == LockMode::SHARED_INTENTION_EXCLUSIVE;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return requested_mode == LockMode::EXCLUSIVE;
+    case LockMode::EXCLUSIVE:
+      return false;
+  }
+  return false;
+}
+
+void LockManager::AbortTransaction(Transaction *txn, AbortReason abort_reason) {
+  txn->SetState(TransactionState::ABORTED);
+  throw TransactionAbortException(txn->GetTransactionId(), abort_reason);
+}
+
+void LockManager::CheckLockAllowed(Transaction *txn, LockMode lock_mode) {
+  bool shrinking = txn->GetState() == TransactionState::SHRINKING;
+  switch (txn->GetIsolationLevel()) {
+    case IsolationLevel::READ_UNCOMMITTED:
+      if (lock_mode != LockMode::EXCLUSIVE && lock_mode != LockMode::INTENTION_EXCLUSIVE) {
+        AbortTransaction(txn, AbortReason::LOCK_SHARED_ON_READ_UNCOMMITTED);
+      }
+      if (shrinking) {
+        AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+      }
+      break;
+    case IsolationLevel::READ_COMMITTED:
+      if (shrinking && lock_mode != LockMode::INTENTION_SHARED && lock_mode != LockMode::SHARED) {
+        AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+      }
+      break;
+    case IsolationLevel::REPEATABLE_READ:
+    case IsolationLevel::SNAPSHOT_ISOLATION:
+    case IsolationLevel::OPTIMISTIC:
+      if (shrinking) {
+        AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+      }
+      break;
+  }
+}
+
+void LockManager::UpdateStateOnUnlock(Transaction *txn, LockMode lock_mode) {
+  if (txn->GetState() != TransactionState::GROWING) {
+    return;
+  }
+  if (lock_mode == LockMode::EXCLUSIVE ||
+      (lock_mode == LockMode::SHARED && (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+                                         txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION))) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+}
+
+auto LockManager::GetTableLockSet(Transaction *txn, LockMode lock_mode)
+    -> std::shared_ptr<std::unordered_set<table_oid_t>> {
+  switch (lock_mode) {
+    case LockMode::SHARED:
+      return txn->GetSharedTableLockSet();
+    case LockMode::EXCLUSIVE:
+      return txn->GetExclusiveTableLockSet();
+    case LockMode::INTENTION_SHARED:
+      return txn->GetIntentionSharedTableLockSet();
+    case LockMode::INTENTION_EXCLUSIVE:
+      return txn->GetIntentionExclusiveTableLockSet();
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return txn->GetSharedIntentionExclusiveTableLockSet();
+  }
+  return nullptr;
+}
+
+auto LockManager::GetTableLockMode(Transaction *txn, table_oid_t oid, LockMode *lock_mode) -> bool {
+  for (LockMode mode : {LockMode::INTENTION_SHARED, LockMode::INTENTION_EXCLUSIVE, LockMode::SHARED,
+                        LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::EXCLUSIVE}) {
+    if (GetTableLockSet(txn, mode)->count(oid) != 0) {
+      *lock_mode = mode;
+      return true;
+    }
+  }
+  return false;
+}
+
+auto LockManager::GetRowLockSet(Transaction *txn, LockMode lock_mode)
+    -> std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> {
+  return lock_mode == LockMode::EXCLUSIVE ? txn->GetExclusiveRowLockSet() : txn->GetSharedRowLockSet();
+}
+
+auto LockManager::GetTableQueue(table_oid_t oid) -> std::shared_ptr<LockRequestQueue> {
+  {
+    std::shared_lock lock(table_lock_map_latch_);
+    auto queue = table_lock_map_.find(oid);
+    if (queue != table_lock_map_.end()) {
+      return queue->second;
+    }
+  }
+  std::unique_lock lock(table_lock_map_latch_);
+  auto &queue = table_lock_map_[oid];
+  if (queue == nullptr) {
+    queue = std::make_shared<LockRequestQueue>();
+  }
+  return queue;
+}
+
+auto LockManager::GetRowQueue(const RID &rid) -> std::shared_ptr<LockRequestQueue> {
+  RowLockShard &shard = row_lock_shards_[std::hash<RID>()(rid) % NUM_ROW_LOCK_SHARDS];
+  std::scoped_lock lock(shard.latch_);
+  auto &queue = shard.row_lock_map_[rid];
+  if (queue == nullptr) {
+    queue = std::make_shared<LockRequestQueue>();
+  }
+  return queue;
+}
+
+auto LockManager::FindRowQueue(const RID &rid) -> std::shared_ptr<LockRequestQueue> {
+  RowLockShard &shard = row_lock_shards_[std::hash<RID>()(rid) % NUM_ROW_LOCK_SHARDS];
+  std::scoped_lock lock(shard.latch_);
+  auto queue = shard.row_lock_map_.find(rid);
+  return queue == shard.row_lock_map_.end() ? nullptr : queue->second;
+}
+
+void LockManager::DropRowQueueIfUnused(const RID &rid) {
+  RowLockShard &shard = row_lock_shards_[std::hash<RID>()(rid) % NUM_ROW_LOCK_SHARDS];
+  std::scoped_lock lock(shard.latch_);
+  auto queue = shard.row_lock_map_.find(rid);
+  // a thread about to enqueue or waiting holds the queue, and only gets it under the shard latch; granted requests
+  // are in the list, so the queue is unused if the map holds the only reference and the list is empty
+  if (queue == shard.row_lock_map_.end() || queue->second.use_count() != 1) {
+    return;
+  }
+  bool unused;
+  {
+    std::scoped_lock queue_lock(queue->second->latch_);
+    unused = queue->second->request_queue_.empty();
+  }
+  if (unused) {
+    shard.row_lock_map_.erase(queue);
+  }
+}
+
+auto LockManager::TryFastPathLock(LockRequestQueue *queue, LockMode lock_mode) -> bool {
+  auto &fast_path_locks = lock_mode == LockMode::INTENTION_SHARED ? queue->fast_path_is_ : queue->fast_path_ix_;
+  if (queue->strong_requests_.load() != 0) {
+    return false;
+  }
+  // Count the lock first, then check again: a strong request either sees the count, or is seen here.
+  fast_path_locks.fetch_add(1);
+  if (queue->strong_requests_.load() == 0) {
+    return true;
+  }
+  ReleaseFastPathLock(queue, lock_mode);
+  return false;
+}
+
+void LockManager::ReleaseFastPathLock(LockRequestQueue *queue, LockMode lock_mode) {
+  auto &fast_path_locks = lock_mode == LockMode::INTENTION_SHARED ? queue->fast_path_is_ : queue->fast_path_ix_;
+  fast_path_locks.fetch_sub(1);
+  if (queue->strong_requests_.load() != 0) {
+    // a strong request may wait for the count, it checks it under the latch
+    { std::scoped_lock lock(queue->latch_); }
+    queue->cv_.notify_all();
+  }
+}
+
+void LockManager::MoveFastPathLockToQueue(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode,
+                                          table_oid_t oid) {
+  {
+    std::scoped_lock lock(queue->latch_);
+    auto *request = new LockRequest(txn->GetTransactionId(), lock_mode, oid);
+    request->granted_ = true;
+    queue->request_queue_.push_front(request);
+    auto &fast_path_locks = lock_mode == LockMode::INTENTION_SHARED ? queue->fast_path_is_ : queue->fast_path_ix_;
+    fast_path_locks.fetch_sub(1);
+  }
+  // the requests waiting for the fast path locks see whom they wait for now
+  queue->cv_.notify_all();
+  txn->GetFastPathTableLockSet()->erase(oid);
+}
+
+void LockManager::PublishFastPathLocks(Transaction *txn) {
+  std::vector<table_oid_t> oids(txn->GetFastPathTableLockSet()->begin(), txn->GetFastPathTableLockSet()->end());
+  for (table_oid_t oid : oids) {
+    LockMode lock_mode;
+    GetTableLockMode(txn, oid, &lock_mode);
+    MoveFastPathLockToQueue(txn, GetTableQueue(oid).get(), lock_mode, oid);
+  }
+}
+
+auto LockManager::IsGrantable(const LockRequestQueue &queue, const LockRequest &request,
+                              std::vector<txn_id_t> *blockers) -> bool {
+  blockers->clear();
+  bool in_front = true;
+  for (const LockRequest *other : queue.request_queue_) {
+    if (other == &request) {
+      in_front = false;
+    } else if (other->txn_id_ != request.txn_id_ && (other->granted_ || in_front) &&
+               !AreCompatible(other->lock_mode_, request.lock_mode_) &&
+               std::find(blockers->begin(), blockers->end(), other->txn_id_) == blockers->end()) {
+      blockers->push_back(other->txn_id_);
+    }
+  }
+  return blockers->empty() &&
+         (queue.fast_path_is_.load() == 0 || AreCompatible(LockMode::INTENTION_SHARED, request.lock_mode_)) &&
+         (queue.fast_path_ix_.load() == 0 || AreCompatible(LockMode::INTENTION_EXCLUSIVE, request.lock_mode_));
+}
+
+auto LockManager::AcquireLock(Transaction *txn, LockRequestQueue *queue, LockRequest *request, bool upgrade) -> bool {
+  std::unique_lock lock(queue->latch_);
+  auto &requests = queue->request_queue_;
+  if (upgrade) {
+    if (queue->upgrading_ != INVALID_TXN_ID) {
+      delete request;
+      lock.unlock();
+      AbortTransaction(txn, AbortReason::UPGRADE_CONFLICT);
+    }
+    // the granted request of the transaction stays until the upgrade is granted, the upgrade waits in front
+    queue->upgrading_ = txn->GetTransactionId();
+    requests.insert(std::find_if(requests.begin(), requests.end(), [](LockRequest *r) { return !r->granted_; }),
+                    request);
+  } else {
+    requests.push_back(request);
+  }
+  if (IsStrong(request->lock_mode_)) {
+    queue->strong_requests_.fetch_add(1);
+  }
+
+  std::vector<txn_id_t> blockers;
+  bool waited = false;
+  while (txn->GetState() != TransactionState::ABORTED && !IsGrantable(*queue, *request, &blockers)) {
+    if (!txn->GetFastPathTableLockSet()->empty()) {
+      // a cycle could go through a lock that is only counted, so a waiting transaction holds none
+      lock.unlock();
+      PublishFastPathLocks(txn);
+      lock.lock();
+      continue;
+    }
+    waited = true;
+    if (deadlock_policy_ == DeadlockPolicy::DETECTION) {
+      UpdateWaitsFor(txn->GetTransactionId(), queue, blockers);
+    } else {
+      std::vector<std::shared_ptr<LockRequestQueue>> wounded_queues;
+      if (!PreventDeadlock(txn, queue, blockers, &wounded_queues)) {
+        continue;
+      }
+      if (!wounded_queues.empty()) {
+        lock.unlock();
+        for (const auto &wounded_queue : wounded_queues) {
+          { std::scoped_lock wounded_lock(wounded_queue->latch_); }
+          wounded_queue->cv_.notify_all();
+        }
+        lock.lock();
+        continue;
+      }
+    }
+    if (queue->cv_.wait_for(lock, cycle_detection_interval) == std::cv_status::timeout &&
+        deadlock_policy_ == DeadlockPolicy::DETECTION) {
+      RequestCycleDetection();
+    }
+  }
+  if (waited) {
+    // the detection thread cannot pick the transaction as a victim anymore once its edges are gone
+    ClearWaitsFor(txn->GetTransactionId());
+  }
+  bool aborted = txn->GetState() == TransactionState::ABORTED;
+  if (upgrade) {
+    queue->upgrading_ = INVALID_TXN_ID;
+  }
+  auto old_request = requests.end();
+  if (aborted) {
+    old_request = std::find(requests.begin(), requests.end(), request);
+  } else {
+    request->granted_ = true;
+    if (upgrade) {
+      old_request = std::find_if(requests.begin(), requests.end(), [&](LockRequest *r) {
+        return r != request && r->txn_id_ == request->txn_id_;
+      });
+    }
+  }
+  if (old_request != requests.end()) {
+    if (IsStrong((*old_request)->lock_mode_)) {
+      queue->strong_requests_.fetch_sub(1);
+    }
+    delete *old_request;
+    requests.erase(old_request);
+    if (aborted) {
+      RemoveWaitsForEdgesTo(*queue, txn->GetTransactionId());
+    }
+    // the requests behind may be granted now
+    queue->cv_.notify_all();
+  }
+  return !aborted;
+}
+
+void LockManager::ReleaseLock(LockRequestQueue *queue, txn_id_t txn_id) {
+  {
+    std::scoped_lock lock(queue->latch_);
+    auto &requests = queue->request_queue_;
+    auto request =
+        std::find_if(requests.begin(), requests.end(), [&](LockRequest *r) { return r->txn_id_ == txn_id; });
+    if (request == requests.end()) {
+      return;
+    }
+    if (IsStrong((*request)->lock_mode_)) {
+      queue->strong_requests_.fetch_sub(1);
+    }
+    delete *request;
+    requests.erase(request);
+    RemoveWaitsForEdgesTo(*queue, txn_id);
+  }
+  queue->cv_.notify_all();
+}
+
+void LockManager::UpdateWaitsFor(txn_id_t txn_id, LockRequestQueue *queue, const std::vector<txn_id_t> &blockers) {
+  std::scoped_lock lock(waits_for_latch_);
+  auto &edges = waits_for_[txn_id];
+  bool new_edge = std::any_of(blockers.begin(), blockers.end(), [&](txn_id_t blocker) {
+    return std::find(edges.begin(), edges.end(), blocker) == edges.end();
+  });
+  edges = blockers;
+  waiting_queues_[txn_id] = queue->shared_from_this();
+  if (new_edge) {
+    newly_blocked_.push_back(txn_id);
+    cycle_detection_cv_.notify_one();
+  }
+}
+
+void LockManager::ClearWaitsFor(txn_id_t txn_id) {
+  std::scoped_lock lock(waits_for_latch_);
+  waits_for_.erase(txn_id);
+  waiting_queues_.erase(txn_id);
+}
+
+void LockManager::RemoveWaitsForEdgesTo(const LockRequestQueue &queue, txn_id_t txn_id) {
+  std::scoped_lock lock(waits_for_latch_);
+  for (const LockRequest *request : queue.request_queue_) {
+    if (request->granted_) {
+      continue;
+    }
+    auto edges = waits_for_.find(request->txn_id_);
+    if (edges != waits_for_.end()) {
+      edges->second.erase(std::remove(edges->second.begin(), edges->second.end(), txn_id), edges->second.end());
+    }
+  }
+}
+
+auto LockManager::PreventDeadlock(Transaction *txn, LockRequestQueue *queue, const std::vector<txn_id_t> &blockers,
+                                  std::vector<std::shared_ptr<LockRequestQueue>> *wounded_queues) -> bool {
+  // the state of a transaction is set under the graph latch, which the transaction takes to record its queue
+  std::scoped_lock lock(waits_for_latch_);
+  txn_id_t txn_id = txn->GetTransactionId();
+  for (txn_id_t blocker : blockers) {
+    if (deadlock_policy_ == DeadlockPolicy::WAIT_DIE && blocker < txn_id) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    if (deadlock_policy_ == DeadlockPolicy::WOUND_WAIT && blocker > txn_id) {
+      Transaction *wounded = TransactionManager::GetTransaction(blocker);
+      if (wounded->GetState() == TransactionState::ABORTED || wounded->GetState() == TransactionState::COMMITTED) {
+        continue;
+      }
+      // a running transaction finds out at its next lock request, a waiting one is woken up
+      wounded->SetState(TransactionState::ABORTED);
+      auto wounded_queue = waiting_queues_.find(blocker);
+      if (wounded_queue != waiting_queues_.end()) {
+        wounded_queues->push_back(wounded_queue->second);
+      }
+    }
+  }
+  waiting_queues_[txn_id] = queue->shared_from_this();
+  return txn->GetState() != TransactionState::ABORTED;
+}
+
+void LockManager::RequestCycleDetection() {
+  std::scoped_lock lock(waits_for_latch_);
+  full_detection_requested_ = true;
+  cycle_detection_cv_.notify_one();
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock lock(waits_for_latch_);
+  auto &edges = waits_for_[t1];
+  if (std::find(edges.begin(), edges.end(), t2) == edges.end()) {
+    edges.push_back(t2);
+  }
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock lock(waits_for_latch_);
+  auto edges = waits_for_.find(t1);
+  if (edges == waits_for_.end()) {
+    return;
+  }
+  edges->second.erase(std::remove(edges->second.begin(), edges->second.end(), t2), edges->second.end());
+  if (edges->second.empty()) {
+    waits_for_.erase(edges);
+  }
+}
+
+auto LockManager::FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::unordered_set<txn_id_t> *visited,
+                            txn_id_t *victim) -> bool {
+  auto on_path = std::find(path->begin(), path->end(), txn_id);
+  if (on_path != path->end()) {
+    *victim = *std::max_element(on_path, path->end());
+    return true;
+  }
+  if (!visited->insert(txn_id).second) {
+    return false;
+  }
+  auto edges = waits_for_.find(txn_id);
+  if (edges == waits_for_.end()) {
+    return false;
+  }
+  std::vector<txn_id_t> next(edges->second);
+  std::sort(next.begin(), next.end());
+  path->push_back(txn_id);
+  for (txn_id_t next_txn_id : next) {
+    if (FindCycle(next_txn_id, path, visited, victim)) {
+      return true;
+    }
+  }
+  path->pop_back();
+  return false;
+}
+
+auto LockManager::HasCycle(txn_id_t *txn_id) -> bool {
+  std::scoped_lock lock(waits_for_latch_);
+  std::vector<txn_id_t> txn_ids;
+  for (const auto &[waiting_txn_id, edges] : waits_for_) {
+    txn_ids.push_back(waiting_txn_id);
+  }
+  std::sort(txn_ids.begin(), txn_ids.end());
+  std::unordered_set<txn_id_t> visited;
+  for (txn_id_t start : txn_ids) {
+    std::vector<txn_id_t> path;
+    if (FindCycle(start, &path, &visited, txn_id)) {
+      return true;
+    }
+  }
+  return false;
+}
 
 auto LockManager::GetEdgeList() -> std::vector<std::pair<txn_id_t, txn_id_t>> {
-  std::vector<std::pair<txn_id_t, txn_id_t>> edges(0);
+  std::scoped_lock lock(waits_for_latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edges;
+  for (const auto &[t1, waits_for] : waits_for_) {
+    for (txn_id_t t2 : waits_for) {
+      edges.emplace_back(t1, t2);
+    }
+  }
   return edges;
 }
 
+auto LockManager::GetRowQueueCount() -> size_t {
+  size_t count = 0;
+  for (RowLockShard &shard : row_lock_shards_) {
+    std::scoped_lock lock(shard.latch_);
+    count += shard.row_lock_map_.size();
+  }
+  return count;
+}
+
 void LockManager::RunCycleDetection() {
+  std::unique_lock lock(waits_for_latch_);
   while (enable_cycle_detection_) {
-    std::this_thread::sleep_for(cycle_detection_interval);
-    {  // TODO(students): detect deadlock
+    cycle_detection_cv_.wait(lock, [this] {
+      return !enable_cycle_detection_ || full_detection_requested_ || !newly_blocked_.empty();
+    });
+    std::vector<txn_id_t> starts;
+    if (full_detection_requested_) {
+      for (const auto &[txn_id, edges] : waits_for_) {
+        starts.push_back(txn_id);
+      }
+      std::sort(starts.begin(), starts.end());
+    } else {
+      starts = newly_blocked_;
+    }
+    full_detection_requested_ = false;
+    newly_blocked_.clear();
+
+    // a new cycle goes through a transaction that got a new edge, only search from those
+    std::vector<std::shared_ptr<LockRequestQueue>> victim_queues;
+    std::unordered_set<txn_id_t> visited;
+    for (txn_id_t start : starts) {
+      std::vector<txn_id_t> path;
+      txn_id_t victim;
+      while (FindCycle(start, &path, &visited, &victim)) {
+        TransactionManager::GetTransaction(victim)->SetState(TransactionState::ABORTED);
+        // the victim waits for nobody anymore, which breaks the cycle
+        waits_for_.erase(victim);
+        auto queue = waiting_queues_.find(victim);
+        if (queue != waiting_queues_.end()) {
+          victim_queues.push_back(std::move(queue->second));
+          waiting_queues_.erase(queue);
+        }
+        path.clear();
+        visited.clear();
+      }
+    }
+
+    // wake up the victims, without holding the graph latch, which is taken after the latches of queues
+    lock.unlock();
+    for (const auto &queue : victim_queues) {
+      { std::scoped_lock queue_lock(queue->latch_); }
+      queue->cv_.notify_all();
     }
+    lock.lock();
   }
 }
 
@@ -12,10 +12,13 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
 #include <mutex>  // NOLINT
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.h"
 #include "storage/table/table_heap.h"
@@ -32,7 +35,19 @@ auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level)
     txn = new Transaction(next_txn_id_++, isolation_level);
   }
 
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    // the snapshot holds the versions of the transactions that committed so far
+    std::scoped_lock lock(commit_latch_);
+    txn->SetReadTs(last_commit_ts_);
+    snapshot_read_ts_.insert(txn->GetReadTs());
+  }
+
   if (enable_logging) {
+    {
+      // a checkpoint that does not find the transaction yet comes before its first log record
+      std::scoped_lock lock(active_txns_latch_);
+      active_txns_[txn->GetTransactionId()] = log_manager_->GetNextLSN();
+    }
     LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
     lsn_t lsn = log_manager_->AppendLogRecord(&record);
     txn->SetPrevLSN(lsn);
@@ -43,11 +58,28 @@ auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level)
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
-  txn->SetState(TransactionState::COMMITTED);
+auto TransactionManager::Commit(Transaction *txn) -> bool {
+  // The writes have locked their tuples, validating the reads now makes the transaction serializable at this point.
+  // A transaction wounded before it got to commit is rolled back, and one that has committed is not wounded anymore.
+  if ((txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && !ValidateReads(txn)) ||
+      !lock_manager_->TryCommit(txn)) {
+    Abort(txn);
+    return false;
+  }
 
-  // Perform all deletes before we commit.
+  // Stamp the versions written with the commit timestamp, all of them at once for the snapshots.
   auto write_set = txn->GetWriteSet();
+  auto written = GetWrittenTuples(txn);
+  if (!written.empty()) {
+    std::scoped_lock lock(commit_latch_);
+    timestamp_t commit_ts = last_commit_ts_ + 1;
+    for (const auto &[table, rid] : written) {
+      table->CommitTuple(rid, txn, commit_ts);
+    }
+    last_commit_ts_ = commit_ts;
+  }
+
+  // Perform all deletes before we commit.
   while (!write_set->empty()) {
     auto &item = write_set->back();
     auto *table = item.table_;
@@ -59,15 +91,35 @@ void TransactionManager::Commit(Transaction *txn) {
   }
   write_set->clear();
 
+  timestamp_t watermark = EndSnapshot(txn);
+  for (const auto &[table, rid] : written) {
+    table->PruneVersions(rid, watermark);
+  }
+
+  if (enable_logging) {
+    LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    lsn_t lsn = log_manager_->AppendLogRecord(&record);
+    txn->SetPrevLSN(lsn);
+    EndInLog(txn);
+    // group commit: the commit record is made persistent together with the others appended meanwhile
+    log_manager_->WaitForFlush(lsn);
+  }
+
   // Release all the locks.
+  for (const auto &[table, rid] : written) {
+    table->UnlockVersion(rid, true);
+  }
+  txn->GetReadSet()->clear();
   ReleaseLocks(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
+  return true;
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
   // Rollback before releasing the lock.
+  auto written = GetWrittenTuples(txn);
   auto table_write_set = txn->GetWriteSet();
   while (!table_write_set->empty()) {
     auto &item = table_write_set->back();
@@ -78,7 +130,7 @@ void TransactionManager::Abort(Transaction *txn) {
       // Note that this also releases the lock when holding the page latch.
       table->ApplyDelete(item.rid_, txn);
     } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
+      table->RollbackUpdate(item.tuple_, item.rid_, txn);
     }
     table_write_set->pop_back();
   }
@@ -108,13 +160,63 @@ void TransactionManager::Abort(Transaction *txn) {
   }
   table_write_set->clear();
   index_write_set->clear();
+  EndSnapshot(txn);
+
+  if (enable_logging) {
+    // an aborted transaction is undone during recovery whether or not its abort record made it to disk
+    LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    lsn_t lsn = log_manager_->AppendLogRecord(&record);
+    txn->SetPrevLSN(lsn);
+    EndInLog(txn);
+  }
 
   // Release all the locks.
+  for (const auto &[table, rid] : written) {
+    table->UnlockVersion(rid, false);
+  }
+  txn->GetReadSet()->clear();
   ReleaseLocks(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+auto TransactionManager::ValidateReads(Transaction *txn) -> bool {
+  auto read_set = txn->GetReadSet();
+  return std::all_of(read_set->begin(), read_set->end(), [txn](const TableReadRecord &item) {
+    return item.table_->ValidateRead(item.rid_, item.version_, txn);
+  });
+}
+
+auto TransactionManager::GetWrittenTuples(Transaction *txn) -> std::vector<std::pair<TableHeap *, RID>> {
+  std::vector<std::pair<TableHeap *, RID>> written;
+  for (const auto &item : *txn->GetWriteSet()) {
+    written.emplace_back(item.table_, item.rid_);
+  }
+  // a tuple written more than once is unlocked once
+  auto key = [](const std::pair<TableHeap *, RID> &tuple) { return std::make_pair(tuple.first, tuple.second.Get()); };
+  std::sort(written.begin(), written.end(), [&](const auto &a, const auto &b) { return key(a) < key(b); });
+  written.erase(std::unique(written.begin(), written.end()), written.end());
+  return written;
+}
+
+auto TransactionManager::GetActiveTransactionTable() -> std::vector<std::pair<txn_id_t, lsn_t>> {
+  std::scoped_lock lock(active_txns_latch_);
+  return {active_txns_.begin(), active_txns_.end()};
+}
+
+void TransactionManager::EndInLog(Transaction *txn) {
+  std::scoped_lock lock(active_txns_latch_);
+  active_txns_.erase(txn->GetTransactionId());
+}
+
+auto TransactionManager::EndSnapshot(Transaction *txn) -> timestamp_t {
+  std::scoped_lock lock(commit_latch_);
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    snapshot_read_ts_.erase(snapshot_read_ts_.find(txn->GetReadTs()));
+  }
+  return snapshot_read_ts_.empty() ? last_commit_ts_.load() : *snapshot_read_ts_.begin();
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
@@ -0,0 +1,156 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_free_hash_table.cpp
+//
+// Identification: src/container/hash/lock_free_hash_table.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstring>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "container/hash/lock_free_hash_table.h"
+
+namespace bustub {
+
+template <typename K, typename V>
+LockFreeHashTable<K, V>::LockFreeHashTable(size_t max_entries) : capacity_(8), hash_shift_(61) {
+  // keep the load factor at or below 1/2, so that probe sequences stay short
+  while (capacity_ < 2 * max_entries) {
+    capacity_ <<= 1;
+    hash_shift_--;
+  }
+  mask_ = capacity_ - 1;
+  slots_ = std::make_unique<std::atomic<uint64_t>[]>(capacity_);
+  for (size_t i = 0; i < capacity_; i++) {
+    slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+  }
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::Pack(const K &key, const V &value) -> uint64_t {
+  uint32_t key_bits;
+  uint32_t value_bits;
+  memcpy(&key_bits, &key, sizeof(uint32_t));
+  memcpy(&value_bits, &value, sizeof(uint32_t));
+  return (static_cast<uint64_t>(key_bits) << 32) | value_bits;
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::KeyOf(uint64_t slot) -> K {
+  auto key_bits = static_cast<uint32_t>(slot >> 32);
+  K key;
+  memcpy(&key, &key_bits, sizeof(uint32_t));
+  return key;
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::ValueOf(uint64_t slot) -> V {
+  auto value_bits = static_cast<uint32_t>(slot);
+  V value;
+  memcpy(&value, &value_bits, sizeof(uint32_t));
+  return value;
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::HomeOf(const K &key) const -> size_t {
+  // Fibonacci hashing, so that strided keys (e.g. page ids of one parallel BPM shard) still spread over the table
+  return static_cast<size_t>((Pack(key, V{}) >> 32) * 0x9E3779B97F4A7C15ULL >> hash_shift_);
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::Find(const K &key, V &value) -> bool {
+  while (true) {
+    uint64_t version = version_.load(std::memory_order_acquire);
+    if ((version & 1) != 0) {
+      continue;  // a writer is moving entries
+    }
+    bool found = false;
+    uint64_t entry = EMPTY_SLOT;
+    for (size_t i = HomeOf(key), probes = 0; probes < capacity_; i = (i + 1) & mask_, probes++) {
+      entry = slots_[i].load(std::memory_order_acquire);
+      if (entry == EMPTY_SLOT) {
+        break;
+      }
+      if (KeyOf(entry) == key) {
+        found = true;
+        break;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version_.load(std::memory_order_relaxed) == version) {
+      if (found) {
+        value = ValueOf(entry);
+      }
+      return found;
+    }
+  }
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::Probe(const K &key) const -> size_t {
+  size_t i = HomeOf(key);
+  while (true) {
+    uint64_t entry = slots_[i].load(std::memory_order_relaxed);
+    if (entry == EMPTY_SLOT || KeyOf(entry) == key) {
+      return i;
+    }
+    i = (i + 1) & mask_;
+  }
+}
+
+template <typename K, typename V>
+void LockFreeHashTable<K, V>::Insert(const K &key, const V &value) {
+  std::scoped_lock<std::mutex> lock(write_latch_);
+  uint64_t entry = Pack(key, value);
+  BUSTUB_ASSERT(entry >> 32 != EMPTY_SLOT >> 32, "the key with all bits set is reserved");
+  size_t i = Probe(key);
+  if (slots_[i].load(std::memory_order_relaxed) == EMPTY_SLOT) {
+    // always leave one empty slot, so that every probe sequence terminates
+    BUSTUB_ENSURE(size_.load(std::memory_order_relaxed) + 1 < capacity_, "lock-free hash table is full");
+    size_++;
+  }
+  // Filling an empty slot or updating a value in place moves no entry, so readers need not retry.
+  slots_[i].store(entry, std::memory_order_release);
+}
+
+template <typename K, typename V>
+auto LockFreeHashTable<K, V>::Remove(const K &key) -> bool {
+  std::scoped_lock<std::mutex> lock(write_latch_);
+  size_t i = Probe(key);
+  if (slots_[i].load(std::memory_order_relaxed) == EMPTY_SLOT) {
+    return false;
+  }
+
+  uint64_t version = version_.load(std::memory_order_relaxed);
+  version_.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // Backward-shift deletion: pull every later entry of the cluster that may live in the hole into it.
+  for (size_t j = (i + 1) & mask_;; j = (j + 1) & mask_) {
+    uint64_t entry = slots_[j].load(std::memory_order_relaxed);
+    if (entry == EMPTY_SLOT) {
+      break;
+    }
+    size_t home = HomeOf(KeyOf(entry));
+    bool movable = j > i ? (home <= i || home > j) : (home <= i && home > j);
+    if (movable) {
+      slots_[i].store(entry, std::memory_order_relaxed);
+      i = j;
+    }
+  }
+  slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+  size_--;
+
+  version_.store(version + 2, std::memory_order_release);
+  return true;
+}
+
+template class LockFreeHashTable<page_id_t, frame_id_t>;
+
+}  // namespace bustub
@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.h
+//
+// Identification: src/include/buffer/buffer_access_strategy.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class BufferPoolManager;
+
+/**
+ * BufferAccessStrategy lets a large scan read its pages through a small private ring of frames, in the style of
+ * PostgreSQL's ring buffers.
+ *
+ * A page the scan misses on is read into the frame the scan used ring_size misses ago, as long as nobody else
+ * started using the page in it; otherwise the scan takes a new frame as usual and puts it into the ring. Pages the
+ * scan reads or hits are never recorded as history in the replacer. The scan thus keeps cycling through its own few
+ * frames, and the working set of everybody else stays in the pool.
+ *
+ * A strategy belongs to a single scan, and must not be used by several threads at the same time.
+ */
+class BufferAccessStrategy {
+ public:
+  /**
+   * @brief Create a new strategy.
+   * @param ring_size number of frames the scan may cycle through, per buffer pool instance
+   */
+  explicit BufferAccessStrategy(size_t ring_size = SCAN_RING_SIZE) : ring_size_(ring_size) {
+    BUSTUB_ASSERT(ring_size > 0, "a ring needs at least one frame");
+  }
+
+  DISALLOW_COPY_AND_MOVE(BufferAccessStrategy);
+
+  /** @return the number of frames in the ring of every buffer pool instance */
+  auto GetRingSize() const -> size_t { return ring_size_; }
+
+  /**
+   * @brief Advance the ring of a buffer pool instance to its next slot.
+   * @param bpm the buffer pool instance the scan misses on
+   * @return the slot, holding the frame to be reused or INVALID_FRAME_ID; the caller stores the frame it uses there
+   */
+  auto NextSlot(const BufferPoolManager *bpm) -> frame_id_t & {
+    auto &ring = rings_[bpm];
+    if (ring.frames_.empty()) {
+      ring.frames_.resize(ring_size_, INVALID_FRAME_ID);
+    }
+    auto &slot = ring.frames_[ring.next_];
+    ring.next_ = (ring.next_ + 1) % ring_size_;
+    return slot;
+  }
+
+ private:
+  struct Ring {
+    std::vector<frame_id_t> frames_;
+    size_t next_{0};
+  };
+
+  size_t ring_size_;
+  std::unordered_map<const BufferPoolManager *, Ring> rings_;
+};
+
+}  // namespace bustub
@@ -15,7 +15,11 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/buffer_pool_stats.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
@@ -87,6 +91,44 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual auto GetPoolSize() -> size_t = 0;
 
+  /**
+   * Fetch the requested page for a scan that reads it through the given access strategy, so that the scan does not
+   * push the pages of other queries out of the pool. By default, this is a plain fetch.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy of the scan, nullptr for a plain fetch
+   * @return the requested page
+   */
+  virtual auto FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+    return FetchPage(page_id);
+  }
+
+  /**
+   * Hint that the pages [start_page_id, start_page_id + count) are about to be fetched, e.g. by a sequential scan.
+   * The buffer pool may read them into free or evictable frames in the background. This is only a hint: by default it
+   * does nothing, and prefetched pages are not pinned.
+   * @param start_page_id id of the first page to be prefetched
+   * @param count number of pages to be prefetched
+   */
+  virtual void PrefetchPages(page_id_t start_page_id, size_t count) {}
+
+  /**
+   * Take a snapshot of the dirty page table for a checkpoint: every page whose changes may not all be on disk, with a
+   * lower bound of the LSN of the oldest such change (its recLSN). A page that is not listed has all changes logged so
+   * far on disk. Pages are only tracked if the buffer pool has a log manager.
+   * @return the page ids and recLSNs, in no particular order
+   */
+  virtual auto GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> = 0;
+
+  /**
+   * Take a copy of the statistics of the buffer pool. Buffer pools that do not keep statistics only report their size.
+   * @return the statistics, summed over all shards of the buffer pool
+   */
+  virtual auto GetStats() -> BufferPoolStats {
+    BufferPoolStats stats;
+    stats.pool_size_ = GetPoolSize();
+    return stats;
+  }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -12,14 +12,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
 #include <list>
 #include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_stats.h"
 #include "buffer/lru_k_replacer.h"
 #include "common/config.h"
-#include "container/hash/extendible_hash_table.h"
+#include "container/hash/lock_free_hash_table.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
@@ -42,6 +50,23 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, size_t replacer_k = LRUK_REPLACER_K,
                             LogManager *log_manager = nullptr);
 
+  /**
+   * @brief Creates a new BufferPoolManagerInstance that is one shard of a ParallelBufferPoolManager.
+   *
+   * A shard only allocates page ids that are congruent to instance_index modulo num_instances, so that the
+   * parallel manager can route every page id back to the shard that owns it.
+   *
+   * @param pool_size the size of the buffer pool
+   * @param num_instances total number of BPIs in the parallel BPM
+   * @param instance_index index of this BPI in the parallel BPM
+   * @param disk_manager the disk manager
+   * @param replacer_k the lookback constant k for the LRU-K replacer
+   * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   */
+  BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
+                            DiskManager *disk_manager, size_t replacer_k = LRUK_REPLACER_K,
+                            LogManager *log_manager = nullptr);
+
   /**
    * @brief Destroy an existing BufferPoolManagerInstance.
    */
@@ -53,6 +78,60 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @brief Return the pointer to all the pages in the buffer pool. */
   auto GetPages() -> Page * { return pages_; }
 
+  /**
+   * @brief Start reading the given pages into free or evictable frames, on background workers.
+   *
+   * Pages that are already in the buffer pool or that were never allocated are skipped. A fetch of a page while its
+   * read is in flight waits for that read instead of issuing its own.
+   *
+   * A prefetched page is not pinned, but it is kept out of the replacer until it is fetched: with LRU-K a page seen
+   * once is the first victim, so the next prefetch or miss would evict it again before the scan gets to it. At most a
+   * quarter of the pool holds prefetched pages that were not fetched yet, and a frame that is needed when nothing
+   * else is evictable is taken from the oldest of them.
+   *
+   * @param start_page_id id of the first page to be prefetched
+   * @param count number of pages to be prefetched
+   */
+  void PrefetchPages(page_id_t start_page_id, size_t count) override;
+
+  /**
+   * @brief Fetch the requested page through the access strategy of a scan. A hit pins the page without making it any
+   * hotter in the replacer, and a miss reads the page into the scan's ring of frames.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy of the scan, nullptr for a plain fetch
+   * @return nullptr if page_id cannot be fetched, otherwise pointer to the requested page
+   */
+  auto FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * override;
+
+  /**
+   * @brief Start the background page cleaner, which writes dirty, unpinned pages ahead of their eviction so that
+   * foreground fetches rarely have to write a victim back themselves.
+   *
+   * Every page_cleaner_interval, the cleaner makes sure that the clean_fraction of the evictable frames that the
+   * replacer would evict next hold clean pages.
+   *
+   * @param clean_fraction fraction of the evictable frames to keep clean, in [0, 1]
+   */
+  void StartPageCleaner(double clean_fraction);
+
+  /** @brief Stop the background page cleaner, if it is running. */
+  void StopPageCleaner();
+
+  /** @brief Return the number of pages written back by the page cleaner. */
+  auto GetPagesCleaned() const -> size_t { return stats_.pages_cleaned_.load(); }
+
+  /** @brief Return the number of dirty victims written back by foreground fetches and new pages. */
+  auto GetForegroundWrites() const -> size_t { return stats_.dirty_write_backs_.load(); }
+
+  /** @brief Return the pages of this instance that are dirty, pinned or being written back, with their recLSNs. */
+  auto GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> override;
+
+  /** @brief Return a copy of the statistics of this instance. Takes no latch. */
+  auto GetStats() -> BufferPoolStats override { return stats_.Read(pool_size_); }
+
+  /** @brief Return the fraction of free and evictable frames whose page is clean, 1 if there are none. */
+  auto GetCleanFrameRatio() -> double;
+
  protected:
   /**
    * TODO(P1): Add implementation
@@ -101,6 +180,14 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   auto FetchPgImp(page_id_t page_id) -> Page * override;
 
+  /**
+   * @brief Fetch the requested page, for a scan if a strategy is given.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy of the scan, or nullptr
+   * @return nullptr if page_id cannot be fetched, otherwise pointer to the requested page
+   */
+  auto FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page *;
+
   /**
    * TODO(P1): Add implementation
    *
@@ -159,27 +246,80 @@ class BufferPoolManagerInstance : public BufferPoolManager {
 
   /** Number of pages in the buffer pool. */
   const size_t pool_size_;
+  /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
+  const uint32_t num_instances_ = 1;
+  /** Index of this BPI in the parallel BPM (if present, otherwise just 0) */
+  const uint32_t instance_index_ = 0;
   /** The next page id to be allocated  */
   std::atomic<page_id_t> next_page_id_ = 0;
-  /** Bucket size for the extendible hash table */
-  const size_t bucket_size_ = 4;
 
   /** Array of buffer pool pages. */
   Page *pages_;
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. Please ignore this for P1. */
-  LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  ExtendibleHashTable<page_id_t, frame_id_t> *page_table_;
+  LogManager *log_manager_;
+  /** Page table for keeping track of buffer pool pages. Lookups take no lock, so hits never contend on the table. */
+  LockFreeHashTable<page_id_t, frame_id_t> *page_table_;
   /** Replacer to find unpinned pages for replacement. */
   LRUKReplacer *replacer_;
   /** List of free frames that don't have any pages on them. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this
-   * comment to describe what it protects. */
+  /**
+   * Per-frame I/O-in-flight flag. A frame with I/O in flight is pinned by the thread doing the I/O, already mapped to
+   * its new page in the page table, and its data must not be read until the flag is cleared.
+   */
+  std::vector<bool> io_in_flight_;
+  /**
+   * Per-frame number of writes of a page that was marked clean before it reached disk, by the page cleaner or a
+   * flush. A clean page is only on disk once its count is zero.
+   */
+  std::vector<size_t> writes_in_flight_;
+  /** Per-frame condition variables, notified when the I/O on the frame completes. Waited on with latch_. */
+  std::condition_variable *io_cv_;
+  /** A dirty page that was evicted and is being written back. */
+  struct WriteBack {
+    /** The frame the page is written back from. */
+    frame_id_t frame_id_;
+    /** The recLSN of the page, until the write back is done the page is still in the dirty page table. */
+    lsn_t rec_lsn_;
+  };
+  /** Pages whose dirty contents are being written back, and are not yet readable from disk. */
+  std::unordered_map<page_id_t, WriteBack> write_back_table_;
+  /**
+   * This latch protects the page table, the replacer, the free list, the I/O state above and the book-keeping fields
+   * of every page. It is never held across disk I/O, and neither across the log flush that a page write waits for:
+   * pages are pinned to keep them in their frames while they are read or written without the latch. A page that
+   * others may have pinned is written from a copy taken under its read latch, so the write is never torn and never
+   * carries a change whose log record is not flushed.
+   */
   std::mutex latch_;
 
+  /** Background page cleaner thread, nullptr if not running. */
+  std::thread *page_cleaner_thread_{nullptr};
+  /** Fraction of the evictable frames the page cleaner keeps clean. */
+  double clean_fraction_{0};
+  /** True while the page cleaner should keep running. */
+  bool enable_page_cleaner_{false};
+  /** Notified to wake up the page cleaner early. Waited on with latch_. */
+  std::condition_variable page_cleaner_cv_;
+
+  /** Prefetch worker threads, started on the first prefetch. */
+  std::vector<std::thread> prefetch_workers_;
+  /** Prefetches to be read: the reserved frame, and the dirty victim to write back from it first, if any. */
+  std::deque<std::pair<frame_id_t, page_id_t>> prefetch_queue_;
+  /** True while the prefetch workers should keep running. */
+  bool enable_prefetch_{true};
+  /** Notified when prefetches are queued. Waited on with latch_. */
+  std::condition_variable prefetch_cv_;
+  /** Frames holding prefetched pages that were not fetched yet, oldest first. They are not evictable. */
+  std::list<frame_id_t> prefetched_frames_;
+  /** Per-frame flag, true if the frame is in prefetched_frames_. */
+  std::vector<bool> is_prefetched_;
+
+  /** Statistics of this instance, updated without holding latch_. */
+  BufferPoolCounters stats_;
+
   /**
    * @brief Allocate a page on disk. Caller should acquire the latch before
    * calling this function.
@@ -187,6 +327,114 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   auto AllocatePage() -> page_id_t;
 
+  /**
+   * @brief Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions
+   * to validate input data and ensure that a parallel BPM is routing requests to the correct BPI.
+   * @param page_id
+   */
+  void ValidatePageId(page_id_t page_id) const;
+
+  /**
+   * @brief Pick a frame for a new page, either from the free list or by evicting a victim. A dirty victim is
+   * registered in the write-back table; the caller must write it back once the latch is released. Caller should
+   * acquire the latch before calling this function.
+   *
+   * With a strategy, the frame in the next slot of the scan's ring is reused if its page was not touched by anybody
+   * but scans since; otherwise the frame picked as usual takes its place in the ring.
+   *
+   * @param[out] frame_id the frame to be reused
+   * @param[out] victim_page_id the dirty page that must be written back from the frame, or INVALID_PAGE_ID
+   * @param strategy the access strategy of the scan the frame is for, or nullptr
+   * @return false if all frames are pinned
+   */
+  auto AcquireFrame(frame_id_t *frame_id, page_id_t *victim_page_id, BufferAccessStrategy *strategy = nullptr)
+      -> bool;
+
+  /**
+   * @brief Mark the I/O on a frame as finished and wake up the threads waiting for it. Caller should acquire the latch
+   * before calling this function.
+   * @param frame_id the frame whose I/O has completed
+   * @param victim_page_id the page written back from the frame, or INVALID_PAGE_ID
+   */
+  void FinishFrameIO(frame_id_t frame_id, page_id_t victim_page_id);
+
+  /**
+   * @brief Pin a resident page to write it back without the latch, and mark it clean: whoever dirties it again in the
+   * meantime unpins it as dirty. Caller should acquire the latch before calling this function.
+   * @param frame_id the frame of the page
+   */
+  void BeginPageWrite(frame_id_t frame_id);
+
+  /**
+   * @brief Unpin a page once it is written back. If nobody dirtied it again, it is on disk and leaves the dirty page
+   * table. Caller should acquire the latch before calling this function.
+   * @param frame_id the frame of the page
+   */
+  void EndPageWrite(frame_id_t frame_id);
+
+  /**
+   * @brief Note that a page is pinned by somebody who may change it: its changes from now on are not on disk, so its
+   * recLSN is set to the next LSN unless it already has one. Caller should acquire the latch before calling this
+   * function.
+   * @param page the page that was pinned
+   */
+  void PinRecLSN(Page *page);
+
+  /**
+   * @brief Read a page from disk, recording the read latency.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPageFromDisk(page_id_t page_id, char *page_data);
+
+  /**
+   * @brief Write ahead: wait until the log is persistent up to the LSN of a page that is about to be written.
+   * @param page_data raw page data
+   */
+  void FlushLogForPage(const char *page_data);
+
+  /**
+   * @brief Write a page to disk, recording the write latency.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePageToDisk(page_id_t page_id, const char *page_data);
+
+  /**
+   * @brief Write pages to disk in one batch, so that a disk manager that can have several writes in flight does them
+   * all at once, and wait until all of them are done. Records the write latency of every page.
+   * @param pages ids and data of the pages
+   */
+  void WritePagesToDisk(const std::vector<std::pair<page_id_t, const char *>> &pages);
+
+  /**
+   * @brief Wait on the condition variable of a frame until the predicate holds, recording the time waited as pin wait
+   * time if the predicate did not hold right away. Caller should hold the latch in lock.
+   */
+  template <typename Predicate>
+  void WaitForFrame(std::unique_lock<std::mutex> &lock, frame_id_t frame_id, Predicate pred) {
+    if (pred()) {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    io_cv_[frame_id].wait(lock, pred);
+    stats_.pin_wait_.Record(std::chrono::steady_clock::now() - start);
+  }
+
+  /** @brief Body of the page cleaner thread. */
+  void RunPageCleaner();
+
+  /** @brief Body of a prefetch worker thread. */
+  void RunPrefetchWorker();
+
+  /**
+   * @brief Forget that a frame holds a prefetched page that was not fetched yet, if it does. Caller should acquire the
+   * latch before calling this function.
+   * @param frame_id the frame
+   * @return true if the frame held such a page
+   */
+  auto ForgetPrefetch(frame_id_t frame_id) -> bool;
+
   /**
    * @brief Deallocate a page on disk. Caller should acquire the latch before
    * calling this function.
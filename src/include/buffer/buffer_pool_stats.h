@@ -0,0 +1,129 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.h
+//
+// Identification: src/include/buffer/buffer_pool_stats.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/** Number of buckets of a latency histogram. Bucket 0 counts latencies below 1us, bucket i those in [2^(i-1), 2^i) us,
+ * and the last bucket everything above. */
+static constexpr size_t LATENCY_BUCKETS = 24;
+
+/**
+ * LatencyStats is a point-in-time copy of a LatencyHistogram.
+ */
+struct LatencyStats {
+  /** Number of samples per bucket. */
+  std::array<uint64_t, LATENCY_BUCKETS> buckets_{};
+  /** Number of samples. */
+  uint64_t count_{0};
+  /** Sum of all samples, in microseconds. */
+  uint64_t total_us_{0};
+
+  /** @return the mean latency in microseconds, 0 if there are no samples */
+  auto MeanMicros() const -> double;
+
+  /**
+   * @param quantile the quantile, in [0, 1]
+   * @return an upper bound of the given quantile of the latency in microseconds, 0 if there are no samples
+   */
+  auto QuantileMicros(double quantile) const -> uint64_t;
+
+  /** Add the samples of another histogram to this one. */
+  void Merge(const LatencyStats &other);
+};
+
+/**
+ * LatencyHistogram counts latencies in power-of-two buckets. Recording a sample is a couple of relaxed atomic
+ * increments, so that it can be done on hot paths without taking a latch.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram() = default;
+  DISALLOW_COPY_AND_MOVE(LatencyHistogram);
+
+  /** Record one sample. */
+  void Record(std::chrono::nanoseconds latency);
+
+  /** @return a copy of the histogram. Samples recorded concurrently may or may not be included. */
+  auto Read() const -> LatencyStats;
+
+ private:
+  std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_us_{0};
+};
+
+/**
+ * BufferPoolStats is a point-in-time copy of the counters of a buffer pool, for sizing the pool and spotting
+ * regressions. The counters only ever grow, so the activity over an interval is the difference of two copies.
+ */
+struct BufferPoolStats {
+  /** Number of frames. */
+  size_t pool_size_{0};
+  /** Fetches that found their page in the pool. */
+  uint64_t hits_{0};
+  /** Fetches that had to read their page from disk, or failed because every frame was pinned. */
+  uint64_t misses_{0};
+  /** Pages dropped from the pool to make room for another page. */
+  uint64_t evictions_{0};
+  /** Dirty victims written back by foreground fetches and new pages before their frame could be reused. */
+  uint64_t dirty_write_backs_{0};
+  /** Dirty pages written back ahead of their eviction by the page cleaner. */
+  uint64_t pages_cleaned_{0};
+  /** Pages read ahead by the prefetch workers. */
+  uint64_t pages_prefetched_{0};
+  /** Time fetches spent waiting for the I/O of other threads on the page they pinned. Only waits are recorded. */
+  LatencyStats pin_wait_;
+  /** Latency of page reads. */
+  LatencyStats read_latency_;
+  /** Latency of page writes. */
+  LatencyStats write_latency_;
+
+  /** @return the fraction of fetches that were hits, 0 if there were none */
+  auto HitRate() const -> double;
+
+  /** Add the counters of another buffer pool, e.g. another shard, to these ones. */
+  void Merge(const BufferPoolStats &other);
+};
+
+/**
+ * BufferPoolCounters are the live counters behind BufferPoolStats. All of them can be bumped without holding any
+ * latch; every buffer pool instance owns its own set, so threads working on different shards never share them.
+ */
+struct BufferPoolCounters {
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> evictions_{0};
+  std::atomic<uint64_t> dirty_write_backs_{0};
+  std::atomic<uint64_t> pages_cleaned_{0};
+  std::atomic<uint64_t> pages_prefetched_{0};
+  LatencyHistogram pin_wait_;
+  LatencyHistogram read_latency_;
+  LatencyHistogram write_latency_;
+
+  /**
+   * @param pool_size the number of frames of the buffer pool
+   * @return a copy of the counters
+   */
+  auto Read(size_t pool_size) const -> BufferPoolStats;
+};
+
+}  // namespace bustub
@@ -15,7 +15,9 @@
 #include <limits>
 #include <list>
 #include <mutex>  // NOLINT
+#include <set>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "common/config.h"
@@ -23,6 +25,9 @@
 
 namespace bustub {
 
+/** The kind of access that brings a frame to the replacer's attention. */
+enum class AccessType { Unknown = 0, Lookup, Scan, Index };
+
 /**
  * LRUKReplacer implements the LRU-k replacement policy.
  *
@@ -33,6 +38,14 @@ namespace bustub {
  * A frame with less than k historical references is given
  * +inf as its backward k-distance. When multiple frames have +inf backward
  * k-distance, classical LRU algorithm is used to choose victim.
+ *
+ * Evictable frames are kept ordered by their eviction priority, so that
+ * Evict, RecordAccess and SetEvictable all run in O(log n) instead of
+ * scanning every frame in the pool.
+ *
+ * Scan accesses do not count as history: a frame only ever accessed by scans
+ * is evicted before every other frame, and a scan access to a frame with a
+ * history leaves it untouched, so big scans cannot flush the working set.
  */
 class LRUKReplacer {
  public:
@@ -87,8 +100,10 @@ class LRUKReplacer {
    * is invalid.
    *
    * @param frame_id id of frame that received a new access.
+   * @param access_type type of access that was received. A scan access only
+   * moves a frame that no other kind of access has seen yet.
    */
-  void RecordAccess(frame_id_t frame_id);
+  void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown);
 
   /**
    * TODO(P1): Add implementation
@@ -140,20 +155,42 @@ class LRUKReplacer {
    */
   auto Size() -> size_t;
 
+  /**
+   * @brief Return the evictable frames that Evict() would pick next, in the order it would pick them, without
+   * evicting any of them.
+   *
+   * @param max_frames the maximum number of frames to return
+   * @return up to max_frames evictable frames, the next victim first
+   */
+  auto NextVictims(size_t max_frames) -> std::vector<frame_id_t>;
+
+  /**
+   * @brief Return whether the frame is evictable and was only ever accessed by scans since it entered the replacer.
+   * @param frame_id id of frame to be checked
+   */
+  auto IsEvictableScanOnly(frame_id_t frame_id) -> bool;
+
   class Frame {
    public:
     explicit Frame(size_t size);
     void Evict();
     void Access(size_t timestamp);
-    auto GetLastKthAcc(size_t timestamp) const -> size_t;
-    auto GetLastAcc(size_t timestamp) const -> size_t;
+    /** Record a scan access, which only counts for a frame that has seen nothing but scans. */
+    void AccessScan(size_t timestamp);
+    /** @return the oldest access still remembered, i.e. the kth last access, or the first one with < k accesses */
+    auto GetEarliestAcc() const -> size_t;
+    /** @return true if the frame has at least k accesses, i.e. a finite backward k-distance */
+    auto HasKAccesses() const -> bool;
     inline auto GetEvictable() const -> bool { return evictable_; }
     inline void SetEvictable(bool evictable) { evictable_ = evictable; }
     inline auto IsInReplacer() const -> bool { return in_replacer_; }
+    inline auto IsScanOnly() const -> bool { return scan_only_; }
 
    private:
     bool in_replacer_{false};
     bool evictable_{false};
+    /** True if every access so far was a scan. The last one is then kept as the first access. */
+    bool scan_only_{false};
     size_t size_;
     size_t access_ptr_{0};
     std::vector<size_t> last_access_timestamp_;
@@ -162,8 +199,24 @@ class LRUKReplacer {
  private:
   // TODO(student): implement me! You can replace these member variables as you
   // like. Remove maybe_unused if you start using them.
+  /** (earliest remembered access, frame) of an evictable frame; the smallest entry of a set is its victim. */
+  using FrameKey = std::pair<size_t, frame_id_t>;
+
+  /** Put an evictable frame into the set matching its history. Caller must hold latch_. */
+  void Enqueue(frame_id_t frame_id);
+  /** Take an evictable frame out of its set. Caller must hold latch_. */
+  void Dequeue(frame_id_t frame_id);
+  /** @return the set that an evictable frame with the given history belongs to */
+  auto SetOf(const Frame &frame) -> std::set<FrameKey> &;
+
   size_t current_timestamp_{0};
   std::vector<Frame> frame_arr_;
+  /** Evictable frames only accessed by scans, ordered by their last access. They are evicted first. */
+  std::set<FrameKey> scan_set_;
+  /** Evictable frames with less than k accesses (+inf backward k-distance), ordered by their first access. */
+  std::set<FrameKey> history_set_;
+  /** Evictable frames with k or more accesses, ordered by their kth last access, i.e. largest k-distance first. */
+  std::set<FrameKey> cache_set_;
   size_t curr_size_{0};
   size_t replacer_size_;
   size_t k_;
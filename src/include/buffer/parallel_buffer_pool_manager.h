@@ -0,0 +1,134 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parallel_buffer_pool_manager.h
+//
+// Identification: src/include/buffer/parallel_buffer_pool_manager.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "recovery/log_manager.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * ParallelBufferPoolManager shards the buffer pool over several independent BufferPoolManagerInstances, each with
+ * its own latch, page table and replacer. A page always lives in the instance `page_id % num_instances`, so
+ * operations on pages owned by different instances never contend on the same latch.
+ */
+class ParallelBufferPoolManager : public BufferPoolManager {
+ public:
+  /**
+   * Creates a new ParallelBufferPoolManager.
+   * @param num_instances the number of individual BufferPoolManagerInstances to store
+   * @param pool_size the pool size of each BufferPoolManagerInstance
+   * @param disk_manager the disk manager
+   * @param replacer_k the lookback constant k for the LRU-K replacer of every instance
+   * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   */
+  ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
+                            size_t replacer_k = LRUK_REPLACER_K, LogManager *log_manager = nullptr);
+
+  /**
+   * Destroys an existing ParallelBufferPoolManager.
+   */
+  ~ParallelBufferPoolManager() override;
+
+  DISALLOW_COPY_AND_MOVE(ParallelBufferPoolManager);
+
+  /** @return size of the buffer pool, i.e. the total number of frames over all instances */
+  auto GetPoolSize() -> size_t override;
+
+  /** @return the number of instances the buffer pool is sharded over */
+  auto GetNumInstances() const -> size_t { return num_instances_; }
+
+  /** Prefetch the given pages, every instance reads the ones it owns. */
+  void PrefetchPages(page_id_t start_page_id, size_t count) override;
+
+  /** Fetch the requested page through the access strategy of a scan, from the instance that owns it. */
+  auto FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * override;
+
+  /** @return the dirty page tables of all instances together */
+  auto GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> override;
+
+  /** @return the statistics of all instances, summed up */
+  auto GetStats() -> BufferPoolStats override;
+
+  /**
+   * @param instance_index index of the instance
+   * @return the statistics of a single instance, to spot shards that are hotter than the others
+   */
+  auto GetInstanceStats(size_t instance_index) -> BufferPoolStats;
+
+ protected:
+  /**
+   * @param page_id id of page
+   * @return pointer to the BufferPoolManagerInstance responsible for handling given page id
+   */
+  auto GetBufferPoolManager(page_id_t page_id) -> BufferPoolManagerInstance *;
+
+  /**
+   * Fetch the requested page from the buffer pool.
+   * @param page_id id of page to be fetched
+   * @return the requested page
+   */
+  auto FetchPgImp(page_id_t page_id) -> Page * override;
+
+  /**
+   * Unpin the target page from the buffer pool.
+   * @param page_id id of page to be unpinned
+   * @param is_dirty true if the page should be marked as dirty, false otherwise
+   * @return false if the page pin count is <= 0 before this call, true otherwise
+   */
+  auto UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool override;
+
+  /**
+   * Flushes the target page to disk.
+   * @param page_id id of page to be flushed, cannot be INVALID_PAGE_ID
+   * @return false if the page could not be found in the page table, true otherwise
+   */
+  auto FlushPgImp(page_id_t page_id) -> bool override;
+
+  /**
+   * Creates a new page in the buffer pool. Instances are tried in round-robin order, starting from a different
+   * instance on every call, and the first instance that has a free or evictable frame serves the request.
+   * @param[out] page_id id of created page
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  auto NewPgImp(page_id_t *page_id) -> Page * override;
+
+  /**
+   * Deletes a page from the buffer pool.
+   * @param page_id id of page to be deleted
+   * @return false if the page exists but could not be deleted, true if the page didn't exist or deletion succeeded
+   */
+  auto DeletePgImp(page_id_t page_id) -> bool override;
+
+  /**
+   * Flushes all the pages in the buffer pool to disk.
+   */
+  void FlushAllPgsImp() override;
+
+ private:
+  /** Number of BufferPoolManagerInstances. */
+  const size_t num_instances_;
+  /** Pool size of every BufferPoolManagerInstance. */
+  const size_t pool_size_;
+  /** The BufferPoolManagerInstances, instance i owns the page ids congruent to i modulo num_instances_. */
+  std::vector<BufferPoolManagerInstance *> instances_;
+  /** The instance NewPgImp starts probing from; advanced on every call. */
+  std::atomic<size_t> next_instance_{0};
+};
+}  // namespace bustub
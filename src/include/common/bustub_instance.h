@@ -25,6 +25,7 @@
 #include "catalog/catalog.h"
 #include "common/config.h"
 #include "common/util/string_util.h"
+#include "concurrency/transaction.h"
 #include "libfort/lib/fort.hpp"
 #include "type/value.h"
 
@@ -41,6 +42,18 @@ class CheckpointManager;
 class Catalog;
 class ExecutionEngine;
 
+/** How a file-backed BusTub instance does page I/O. */
+enum class DiskManagerType {
+  /** DiskManager, one file stream shared by all page I/O. */
+  FSTREAM,
+  /** DiskManagerPosix, positional reads and writes that do not serialize. */
+  POSIX,
+  /** DiskManagerPosix with O_DIRECT, bypassing the OS page cache. */
+  POSIX_DIRECT,
+  /** DiskManagerAsync, which keeps batches of page I/O in flight with io_uring. */
+  ASYNC,
+};
+
 class ResultWriter {
  public:
   ResultWriter() = default;
@@ -211,9 +224,24 @@ class BustubInstance {
   auto MakeExecutorContext(Transaction *txn) -> std::unique_ptr<ExecutorContext>;
 
  public:
-  explicit BustubInstance(const std::string &db_file_name);
+  /**
+   * Create a BusTub instance backed by a database file.
+   * @param db_file_name the database file
+   * @param bpm_num_instances number of shards of the buffer pool; with more than one shard, pages are spread over a
+   * ParallelBufferPoolManager so that page accesses don't contend on a single latch
+   * @param disk_manager_type how pages are read from and written to the database file
+   * @param deadlock_policy whether the lock manager detects deadlocks, or prevents them by wound-wait or wait-die
+   */
+  explicit BustubInstance(const std::string &db_file_name, size_t bpm_num_instances = 1,
+                          DiskManagerType disk_manager_type = DiskManagerType::FSTREAM,
+                          DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION);
 
-  BustubInstance();
+  /**
+   * Create an in-memory BusTub instance.
+   * @param bpm_num_instances number of shards of the buffer pool
+   * @param deadlock_policy whether the lock manager detects deadlocks, or prevents them by wound-wait or wait-die
+   */
+  explicit BustubInstance(size_t bpm_num_instances = 1, DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION);
 
   ~BustubInstance();
 
@@ -270,6 +298,8 @@ class BustubInstance {
   void CmdDisplayTables(ResultWriter &writer);
   void CmdDisplayIndices(ResultWriter &writer);
   void CmdDisplayHelp(ResultWriter &writer);
+  void CmdDisplayStats(ResultWriter &writer);
+  auto MakeBufferPoolManager(size_t bpm_num_instances) -> BufferPoolManager *;
   void WriteOneCell(const std::string &cell, ResultWriter &writer);
   std::unordered_map<std::string, std::string> session_variables_;
 };
@@ -21,6 +21,9 @@ namespace bustub {
 /** Cycle detection is performed every CYCLE_DETECTION_INTERVAL milliseconds. */
 extern std::chrono::milliseconds cycle_detection_interval;
 
+/** A running page cleaner checks the buffer pool every PAGE_CLEANER_INTERVAL, or sooner on a dirty eviction. */
+extern std::chrono::milliseconds page_cleaner_interval;
+
 /** True if logging should be enabled, false otherwise. */
 extern std::atomic<bool> enable_logging;
 
@@ -28,6 +31,7 @@ extern std::atomic<bool> enable_logging;
 extern std::chrono::duration<int64_t> log_timeout;
 
 static constexpr int INVALID_PAGE_ID = -1;                                           // invalid page id
+static constexpr int INVALID_FRAME_ID = -1;                                          // invalid frame id
 static constexpr int INVALID_TXN_ID = -1;                                            // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                               // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                             // the header page id
@@ -36,6 +40,12 @@ static constexpr int BUFFER_POOL_SIZE = 10;
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * BUSTUB_PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                               // size of extendible hash bucket
 static constexpr int LRUK_REPLACER_K = 10;  // lookback window for lru-k replacer
+static constexpr int READ_AHEAD_PAGES = 16;  // pages a sequential scan asks the buffer pool to prefetch
+static constexpr int PREFETCH_WORKERS = 4;   // threads per buffer pool instance reading prefetched pages
+static constexpr int SCAN_RING_SIZE = 16;    // frames a scan with a BufferAccessStrategy cycles through
+static constexpr int ASYNC_IO_QUEUE_DEPTH = 64;  // page I/Os DiskManagerAsync keeps in flight at most
+static constexpr int ASYNC_IO_WORKERS = 8;       // threads running page I/O for DiskManagerAsync without io_uring
+static constexpr int LOG_SEGMENT_SIZE = 16 * 1024 * 1024;  // size at which the log moves on to a new segment file
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
@@ -43,6 +53,10 @@ using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
+using timestamp_t = int64_t;   // commit timestamp type
+
+static constexpr timestamp_t TXN_START_TS = 1LL << 62;  // timestamps of uncommitted versions, plus the txn id
+static constexpr timestamp_t MAX_TS = INT64_MAX;        // end timestamp of a version that was not replaced
 
 static constexpr int VARCHAR_DEFAULT_LENGTH = 128;  // default length for varchar when constructing the column
 
@@ -0,0 +1,84 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// coding_util.h
+//
+// Identification: src/include/common/util/coding_util.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * CodingUtil provides the building blocks of compact binary formats: varints and checksums.
+ *
+ * A varint stores 7 bits per byte, least significant first, with the high bit set on every byte but the last, so that
+ * small values take a single byte and a 32-bit value takes at most MAX_VARINT_SIZE bytes.
+ */
+class CodingUtil {
+ public:
+  /** The size of the largest 32-bit varint. */
+  static constexpr int MAX_VARINT_SIZE = 5;
+
+  /** @return the number of bytes the value takes as a varint */
+  static inline auto VarintSize(uint32_t value) -> int {
+    int size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  /**
+   * Write a varint.
+   * @param dest where to write the varint, with room for VarintSize(value) bytes
+   * @param value the value
+   * @return the number of bytes written
+   */
+  static inline auto PutVarint(char *dest, uint32_t value) -> int {
+    int size = 0;
+    while (value >= 0x80) {
+      dest[size++] = static_cast<char>(value | 0x80);
+      value >>= 7;
+    }
+    dest[size++] = static_cast<char>(value);
+    return size;
+  }
+
+  /**
+   * Read a varint.
+   * @param[in,out] pos where the varint starts, moved past it
+   * @param end the end of the readable data
+   * @param[out] value the value
+   * @return false if the varint does not end before end, or is longer than MAX_VARINT_SIZE bytes
+   */
+  static inline auto GetVarint(const char **pos, const char *end, uint32_t *value) -> bool {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT_SIZE && *pos < end; shift += 7) {
+      auto byte = static_cast<uint8_t>(*(*pos)++);
+      result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @return the CRC32C (Castagnoli) checksum of the data. Uses the CRC32 instruction of SSE 4.2 where the CPU has it,
+   * and a lookup table otherwise.
+   */
+  static auto Crc32c(const char *data, size_t size) -> uint32_t;
+};
+
+}  // namespace bustub
@@ -13,10 +13,13 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <list>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -32,6 +35,24 @@ class TransactionManager;
 
 /**
  * LockManager handles transactions asking for locks on records.
+ *
+ * It implements multi-granularity two-phase locking: tables are locked in IS, IX, S, SIX or X mode and rows in S or X
+ * mode, each resource with a FIFO queue of lock requests. Row queues are spread over shards with a latch each, so that
+ * looking up the queues of different rows does not serialize.
+ *
+ * Intention locks on a table are granted on a fast path while no S, SIX or X lock is requested on it: the lock is
+ * only counted in the queue, without taking its latch. An S, SIX or X request turns the fast path off for the table
+ * and waits for the counted intention locks it conflicts with.
+ *
+ * Deadlocks are detected on a waits-for graph that is kept up to date as requests block: a waiting transaction has
+ * an edge to every transaction whose request in the queue it waits for. A new cycle can only close when a transaction
+ * blocks, so the detection thread only searches from the transactions that blocked since its last run, right after
+ * they block, and aborts the youngest transaction of a cycle. A transaction that waits for longer than
+ * cycle_detection_interval asks for a search over the whole graph.
+ *
+ * Deadlocks can be prevented instead, by wound-wait or wait-die on the transaction ids, which order transactions by
+ * age. Then no transaction ever waits for a younger one, or never for an older one, so there is no cycle to detect and
+ * no detection thread.
  */
 class LockManager {
  public:
@@ -61,7 +82,8 @@ class LockManager {
     bool granted_{false};
   };
 
-  class LockRequestQueue {
+  /** Shared with the transactions waiting in it, which keeps a row queue alive until none of them still needs it */
+  class LockRequestQueue : public std::enable_shared_from_this<LockRequestQueue> {
    public:
     /** List of lock requests for the same resource (table or row) */
     std::list<LockRequest *> request_queue_;
@@ -71,22 +93,41 @@ class LockManager {
     txn_id_t upgrading_ = INVALID_TXN_ID;
     /** coordination */
     std::mutex latch_;
+    /** The number of IS and IX locks granted on the fast path, which are not in request_queue_ */
+    std::atomic<uint32_t> fast_path_is_{0};
+    std::atomic<uint32_t> fast_path_ix_{0};
+    /** The number of S, SIX and X requests in request_queue_, granted or not, which turn the fast path off */
+    std::atomic<uint32_t> strong_requests_{0};
   };
 
   /**
-   * Creates a new lock manager configured for the deadlock detection policy.
+   * Creates a new lock manager configured for the deadlock policy.
+   * @param deadlock_policy detect deadlocks in a background thread, or prevent them
    */
-  LockManager() {
-    enable_cycle_detection_ = true;
-    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+  explicit LockManager(DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION)
+      : deadlock_policy_(deadlock_policy) {
+    enable_cycle_detection_ = deadlock_policy_ == DeadlockPolicy::DETECTION;
+    if (enable_cycle_detection_) {
+      cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+    }
   }
 
   ~LockManager() {
-    enable_cycle_detection_ = false;
+    if (cycle_detection_thread_ == nullptr) {
+      return;
+    }
+    {
+      std::scoped_lock lock(waits_for_latch_);
+      enable_cycle_detection_ = false;
+    }
+    cycle_detection_cv_.notify_all();
     cycle_detection_thread_->join();
     delete cycle_detection_thread_;
   }
 
+  /** @return how the lock manager deals with deadlocks */
+  inline auto GetDeadlockPolicy() const -> DeadlockPolicy { return deadlock_policy_; }
+
   /**
    * [LOCK_NOTE]
    *
@@ -264,6 +305,14 @@ class LockManager {
    */
   auto UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool;
 
+  /**
+   * Move the transaction to COMMITTED, unless the deadlock policy aborted it in the meantime. The state is set under
+   * the graph latch, like the wounds, so that a transaction is never wounded once it has committed.
+   * @param txn the transaction that commits
+   * @return false if the transaction was aborted, and has to be rolled back instead
+   */
+  auto TryCommit(Transaction *txn) -> bool;
+
   /*** Graph API ***/
 
   /**
@@ -292,27 +341,157 @@ class LockManager {
    */
   auto GetEdgeList() -> std::vector<std::pair<txn_id_t, txn_id_t>>;
 
+  /**
+   * @return the number of rows that have a lock request queue
+   */
+  auto GetRowQueueCount() -> size_t;
+
   /**
    * Runs cycle detection in the background.
    */
   auto RunCycleDetection() -> void;
 
+  /** The number of shards of the row lock table. */
+  static constexpr size_t NUM_ROW_LOCK_SHARDS = 64;
+
  private:
+  /** A part of the row lock table, for the rows whose hash falls into it. */
+  struct RowLockShard {
+    /** Structure that holds lock requests for a given RID */
+    std::unordered_map<RID, std::shared_ptr<LockRequestQueue>> row_lock_map_;
+    /** Coordination */
+    std::mutex latch_;
+  };
+
+  /** @return whether locks in the two modes can be held on a resource at the same time */
+  static auto AreCompatible(LockMode held_mode, LockMode requested_mode) -> bool;
+
+  /** @return whether a lock held in held_mode may be upgraded to requested_mode */
+  static auto CanUpgrade(LockMode held_mode, LockMode requested_mode) -> bool;
+
+  /** @return whether the mode is S, SIX or X, which turns the fast path off */
+  static auto IsStrong(LockMode lock_mode) -> bool {
+    return lock_mode == LockMode::SHARED || lock_mode == LockMode::SHARED_INTENTION_EXCLUSIVE ||
+           lock_mode == LockMode::EXCLUSIVE;
+  }
+
+  /** @brief Set the transaction to ABORTED and throw a TransactionAbortException. */
+  [[noreturn]] static void AbortTransaction(Transaction *txn, AbortReason abort_reason);
+
+  /** @brief Abort the transaction if its isolation level and state do not allow it to take the lock. */
+  static void CheckLockAllowed(Transaction *txn, LockMode lock_mode);
+
+  /** @brief Move the transaction from GROWING to SHRINKING if releasing a lock in the mode ends its growing phase. */
+  static void UpdateStateOnUnlock(Transaction *txn, LockMode lock_mode);
+
+  /** @return the set of tables the transaction holds locks on in the mode */
+  static auto GetTableLockSet(Transaction *txn, LockMode lock_mode) -> std::shared_ptr<std::unordered_set<table_oid_t>>;
+
+  /** @return whether the transaction holds a lock on the table, and its mode */
+  static auto GetTableLockMode(Transaction *txn, table_oid_t oid, LockMode *lock_mode) -> bool;
+
+  /** @return the set of rows the transaction holds locks on in the mode, S or X */
+  static auto GetRowLockSet(Transaction *txn, LockMode lock_mode)
+      -> std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>>;
+
+  /** @return the lock request queue of a table, created if there is none */
+  auto GetTableQueue(table_oid_t oid) -> std::shared_ptr<LockRequestQueue>;
+
+  /** @return the lock request queue of a row, created if there is none */
+  auto GetRowQueue(const RID &rid) -> std::shared_ptr<LockRequestQueue>;
+
+  /** @return the queue of the row, or nullptr if it has none */
+  auto FindRowQueue(const RID &rid) -> std::shared_ptr<LockRequestQueue>;
+
+  /**
+   * Drop the queue of the row if no request is left in it and no thread holds it to enqueue or wait. The caller must
+   * not hold the queue itself.
+   */
+  void DropRowQueueIfUnused(const RID &rid);
+
+  /** @return whether an intention lock was granted on the fast path */
+  static auto TryFastPathLock(LockRequestQueue *queue, LockMode lock_mode) -> bool;
+
+  /** @brief Release an intention lock granted on the fast path. */
+  static void ReleaseFastPathLock(LockRequestQueue *queue, LockMode lock_mode);
+
+  /** @brief Turn an intention lock granted on the fast path into a granted request in the queue, to upgrade it. */
+  static void MoveFastPathLockToQueue(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode, table_oid_t oid);
+
+  /** @brief Move all intention locks the transaction holds on the fast path into their queues, before it blocks. */
+  void PublishFastPathLocks(Transaction *txn);
+
+  /**
+   * @return whether the request can be granted: it is compatible with the granted requests and the fast path locks,
+   * and with the requests waiting in front of it
+   * @param[out] blockers the transactions of the requests in the queue it is not compatible with
+   */
+  static auto IsGrantable(const LockRequestQueue &queue, const LockRequest &request, std::vector<txn_id_t> *blockers)
+      -> bool;
+
+  /**
+   * Enqueue a request and wait until it is granted, or the transaction is aborted. An upgrade goes in front of the
+   * waiting requests and replaces the granted request of the transaction once granted.
+   * @return false if the transaction was aborted while waiting
+   */
+  auto AcquireLock(Transaction *txn, LockRequestQueue *queue, LockRequest *request, bool upgrade) -> bool;
+
+  /** @brief Remove the granted request of the transaction from the queue, and wake up the waiting requests. */
+  void ReleaseLock(LockRequestQueue *queue, txn_id_t txn_id);
+
+  /** @brief Replace the edges of a waiting transaction, and have the new ones searched for cycles. */
+  void UpdateWaitsFor(txn_id_t txn_id, LockRequestQueue *queue, const std::vector<txn_id_t> &blockers);
+
+  /** @brief Remove the edges of a transaction that does not wait anymore. */
+  void ClearWaitsFor(txn_id_t txn_id);
+
+  /** @brief Remove the edges of the transactions waiting in the queue to a transaction whose request left it. */
+  void RemoveWaitsForEdgesTo(const LockRequestQueue &queue, txn_id_t txn_id);
+
+  /**
+   * Apply wound-wait or wait-die to a transaction about to wait for the blockers, and record the queue it waits in.
+   * @param[out] wounded_queues the queues the wounded transactions wait in, to wake them up
+   * @return false if the transaction is aborted instead of waiting
+   */
+  auto PreventDeadlock(Transaction *txn, LockRequestQueue *queue, const std::vector<txn_id_t> &blockers,
+                       std::vector<std::shared_ptr<LockRequestQueue>> *wounded_queues) -> bool;
+
+  /** @brief Have the detection thread search the whole waits-for graph for cycles. */
+  void RequestCycleDetection();
+
+  /**
+   * Depth-first search for a cycle from a transaction, visiting the transactions it waits for in ascending order.
+   * Expects waits_for_latch_ to be held.
+   * @param[out] victim the youngest transaction of the cycle found
+   * @return whether a cycle was found
+   */
+  auto FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::unordered_set<txn_id_t> *visited,
+                 txn_id_t *victim) -> bool;
+
   /** Fall 2022 */
   /** Structure that holds lock requests for a given table oid */
   std::unordered_map<table_oid_t, std::shared_ptr<LockRequestQueue>> table_lock_map_;
-  /** Coordination */
-  std::mutex table_lock_map_latch_;
+  /** Coordination, shared to look up a queue and exclusive to add one */
+  std::shared_mutex table_lock_map_latch_;
 
-  /** Structure that holds lock requests for a given RID */
-  std::unordered_map<RID, std::shared_ptr<LockRequestQueue>> row_lock_map_;
-  /** Coordination */
-  std::mutex row_lock_map_latch_;
+  /** The row lock table, by the hash of the RID */
+  std::array<RowLockShard, NUM_ROW_LOCK_SHARDS> row_lock_shards_;
 
+  /** How deadlocks are dealt with */
+  const DeadlockPolicy deadlock_policy_;
   std::atomic<bool> enable_cycle_detection_;
-  std::thread *cycle_detection_thread_;
+  std::thread *cycle_detection_thread_{nullptr};
   /** Waits-for graph representation. */
   std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_;
+  /** The queue each waiting transaction waits in, to wake it up when it is aborted, with any policy */
+  std::unordered_map<txn_id_t, std::shared_ptr<LockRequestQueue>> waiting_queues_;
+  /** The transactions that got new edges since the last search */
+  std::vector<txn_id_t> newly_blocked_;
+  /** Whether the next search goes over the whole graph */
+  bool full_detection_requested_{false};
+  /** For waking up the detection thread */
+  std::condition_variable cycle_detection_cv_;
+  /** Coordination, taken after the latch of a queue */
   std::mutex waits_for_latch_;
 };
 
@@ -45,9 +45,24 @@ namespace bustub {
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
- * Transaction isolation level.
+ * Transaction isolation level. SNAPSHOT_ISOLATION reads the versions committed before the transaction began, without
+ * taking locks, while its writes take locks as in REPEATABLE_READ and abort on a version committed after it began.
+ * OPTIMISTIC takes no locks: it remembers the versions of the tuples it reads, and commits only if none of them has
+ * changed since (optimistic concurrency control). It aborts right away on a tuple another transaction is writing.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION, OPTIMISTIC };
+
+/**
+ * How the lock manager deals with deadlocks.
+ */
+enum class DeadlockPolicy {
+  /** Wait for any lock, and abort the youngest transaction of a cycle in the waits-for graph. */
+  DETECTION,
+  /** An older transaction aborts the younger ones it would wait for, a younger one waits. */
+  WOUND_WAIT,
+  /** An older transaction waits for younger ones, a younger one aborts instead of waiting for an older one. */
+  WAIT_DIE
+};
 
 /**
  * Type of write operation.
@@ -75,6 +90,20 @@ class TableWriteRecord {
   TableHeap *table_;
 };
 
+/**
+ * ReadRecord tracks the version of a tuple an OPTIMISTIC transaction read.
+ */
+class TableReadRecord {
+ public:
+  TableReadRecord(RID rid, uint64_t version, TableHeap *table) : rid_(rid), version_(version), table_(table) {}
+
+  RID rid_;
+  /** The version word of the tuple when it was read, validated on commit. */
+  uint64_t version_;
+  /** The table heap specifies which table this read record is for. */
+  TableHeap *table_;
+};
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -170,9 +199,11 @@ class Transaction {
         is_table_lock_set_{new std::unordered_set<table_oid_t>},
         ix_table_lock_set_{new std::unordered_set<table_oid_t>},
         six_table_lock_set_{new std::unordered_set<table_oid_t>},
+        fast_path_table_lock_set_{new std::unordered_set<table_oid_t>},
         s_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>},
         x_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>} {
     // Initialize the sets that will be tracked.
+    table_read_set_ = std::make_shared<std::deque<TableReadRecord>>();
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
@@ -192,6 +223,9 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline auto GetIsolationLevel() const -> IsolationLevel { return isolation_level_; }
 
+  /** @return the list of table read records of this transaction, only kept for OPTIMISTIC */
+  inline auto GetReadSet() -> std::shared_ptr<std::deque<TableReadRecord>> { return table_read_set_; }
+
   /** @return the list of table write records of this transaction */
   inline auto GetWriteSet() -> std::shared_ptr<std::deque<TableWriteRecord>> { return table_write_set_; }
 
@@ -263,6 +297,11 @@ class Transaction {
     return six_table_lock_set_;
   }
 
+  /** @return the set of tables whose IS or IX lock was granted on the fast path of the lock manager */
+  inline auto GetFastPathTableLockSet() -> std::shared_ptr<std::unordered_set<table_oid_t>> {
+    return fast_path_table_lock_set_;
+  }
+
   /** @return true if rid (belong to table oid) is shared locked by this transaction */
   auto IsRowSharedLocked(const table_oid_t &oid, const RID &rid) -> bool {
     auto row_lock_set = s_row_lock_set_->find(oid);
@@ -314,6 +353,15 @@ class Transaction {
    */
   inline void SetState(TransactionState state) { state_ = state; }
 
+  /** @return the commit timestamp of the snapshot a SNAPSHOT_ISOLATION transaction reads */
+  inline auto GetReadTs() const -> timestamp_t { return read_ts_; }
+
+  /** Set the commit timestamp of the snapshot to read. */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return the timestamp the versions written by this transaction carry until it commits */
+  inline auto GetTempTs() const -> timestamp_t { return TXN_START_TS + txn_id_; }
+
   /** @return the previous LSN */
   inline auto GetPrevLSN() -> lsn_t { return prev_lsn_; }
 
@@ -333,12 +381,16 @@ class Transaction {
   /** The ID of this transaction. */
   txn_id_t txn_id_;
 
+  /** The tuples read by an OPTIMISTIC transaction. */
+  std::shared_ptr<std::deque<TableReadRecord>> table_read_set_;
   /** The undo set of table tuples. */
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** The commit timestamp of the snapshot, for SNAPSHOT_ISOLATION. */
+  timestamp_t read_ts_{0};
 
   std::mutex latch_;
 
@@ -358,6 +410,8 @@ class Transaction {
   std::shared_ptr<std::unordered_set<table_oid_t>> is_table_lock_set_;
   std::shared_ptr<std::unordered_set<table_oid_t>> ix_table_lock_set_;
   std::shared_ptr<std::unordered_set<table_oid_t>> six_table_lock_set_;
+  /** LockManager: the tables among the IS and IX locked ones that are not in the lock request queue. */
+  std::shared_ptr<std::unordered_set<table_oid_t>> fast_path_table_lock_set_;
 
   /** LockManager: the set of row locks held by this transaction. */
   std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> s_row_lock_set_;
@@ -13,9 +13,13 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>  // NOLINT
+#include <set>
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
@@ -45,10 +49,12 @@ class TransactionManager {
       -> Transaction *;
 
   /**
-   * Commits a transaction.
+   * Commits a transaction. An OPTIMISTIC transaction whose reads fail validation is aborted instead, and so is a
+   * transaction that the deadlock policy aborted.
    * @param txn the transaction to commit
+   * @return true if the transaction committed, false if it was aborted instead
    */
-  void Commit(Transaction *txn);
+  auto Commit(Transaction *txn) -> bool;
 
   /**
    * Aborts a transaction
@@ -77,6 +83,14 @@ class TransactionManager {
     return res;
   }
 
+  /**
+   * Take a snapshot of the active transaction table for a checkpoint: every transaction whose commit or abort record
+   * is not in the log yet, with a lower bound of the LSN of its first log record. A transaction that is not in the
+   * snapshot has no log records before it, or has ended in the log. Only tracked while logging is enabled.
+   * @return the transaction ids and their first LSNs, in no particular order
+   */
+  auto GetActiveTransactionTable() -> std::vector<std::pair<txn_id_t, lsn_t>>;
+
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
 
@@ -134,12 +148,42 @@ class TransactionManager {
     }
   }
 
+  /**
+   * Leave the active transaction table, once the commit or abort record of the transaction is in the log.
+   * @param txn the transaction that ended
+   */
+  void EndInLog(Transaction *txn);
+
+  /** @return whether the tuples an OPTIMISTIC transaction read are unchanged, and no other transaction writes them */
+  static auto ValidateReads(Transaction *txn) -> bool;
+
+  /** @return the tuples the transaction wrote, each once */
+  static auto GetWrittenTuples(Transaction *txn) -> std::vector<std::pair<TableHeap *, RID>>;
+
+  /**
+   * Forget the snapshot of a transaction that ends.
+   * @return the lowest read timestamp of the running snapshots, or the last commit timestamp if none
+   */
+  auto EndSnapshot(Transaction *txn) -> timestamp_t;
+
   std::atomic<txn_id_t> next_txn_id_{0};
-  LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
+
+  /** The transactions that have not ended in the log, and a lower bound of the LSN of their first log record. */
+  std::unordered_map<txn_id_t, lsn_t> active_txns_;
+  /** Protects active_txns_. */
+  std::mutex active_txns_latch_;
+
+  /** The commit timestamp of the last transaction that committed writes. */
+  std::atomic<timestamp_t> last_commit_ts_{0};
+  /** The read timestamps of the running SNAPSHOT_ISOLATION transactions. */
+  std::multiset<timestamp_t> snapshot_read_ts_;
+  /** Serializes commit timestamps with the snapshots taken, protects snapshot_read_ts_. */
+  std::mutex commit_latch_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_free_hash_table.h
+//
+// Identification: src/include/container/hash/lock_free_hash_table.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+/**
+ * lock_free_hash_table.h
+ *
+ * Implementation of a fixed-capacity, open-addressing hash table whose lookups take no lock
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+
+#include "container/hash/hash_table.h"
+
+namespace bustub {
+
+/**
+ * LockFreeHashTable is an open-addressing (linear probing) hash table for 32-bit keys and values, meant to be used as
+ * the page table of the buffer pool.
+ *
+ * Every slot is a single atomic word holding both the key and the value, so a lookup never sees a torn entry.
+ * Lookups are lock-free and never write shared memory: they validate against a table version that writers bump
+ * around any operation that moves entries (removal uses backward-shift deletion, so there are no tombstones), and
+ * retry if it changed. Inserts and removes are serialized by a writer latch.
+ *
+ * The capacity is fixed at construction; the buffer pool never maps more pages than it has frames.
+ *
+ * @tparam K key type, 4 bytes wide; the key with all bits set (e.g. INVALID_PAGE_ID) cannot be stored
+ * @tparam V value type, 4 bytes wide
+ */
+template <typename K, typename V>
+class LockFreeHashTable : public HashTable<K, V> {
+  static_assert(sizeof(K) == sizeof(uint32_t) && sizeof(V) == sizeof(uint32_t), "keys and values must be 32-bit");
+
+ public:
+  /**
+   * @brief Create a new LockFreeHashTable.
+   * @param max_entries the maximum number of entries the table has to hold at the same time
+   */
+  explicit LockFreeHashTable(size_t max_entries);
+
+  /**
+   * @brief Find the value associated with the given key, without taking any lock.
+   * @param key The key to be searched.
+   * @param[out] value The value associated with the key.
+   * @return True if the key is found, false otherwise.
+   */
+  auto Find(const K &key, V &value) -> bool override;
+
+  /**
+   * @brief Insert the given key-value pair into the hash table. If the key already exists, the value is updated.
+   * Throws if the table would exceed its capacity.
+   * @param key The key to be inserted.
+   * @param value The value to be inserted.
+   */
+  void Insert(const K &key, const V &value) override;
+
+  /**
+   * @brief Given the key, remove the corresponding key-value pair in the hash table.
+   * @param key The key to be deleted.
+   * @return True if the key exists, false otherwise.
+   */
+  auto Remove(const K &key) -> bool override;
+
+  /** @return the number of entries in the table */
+  auto Size() const -> size_t { return size_.load(); }
+
+  /** @return the number of slots in the table */
+  auto GetCapacity() const -> size_t { return capacity_; }
+
+ private:
+  /** A slot with all bits set is empty. */
+  static constexpr uint64_t EMPTY_SLOT = ~static_cast<uint64_t>(0);
+
+  static auto Pack(const K &key, const V &value) -> uint64_t;
+  static auto KeyOf(uint64_t slot) -> K;
+  static auto ValueOf(uint64_t slot) -> V;
+  /** @return the slot the key hashes to */
+  auto HomeOf(const K &key) const -> size_t;
+  /** @return the slot holding the key, or the empty slot ending its probe sequence. Caller must hold write_latch_. */
+  auto Probe(const K &key) const -> size_t;
+
+  size_t capacity_;
+  size_t mask_;
+  int hash_shift_;
+  std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+  std::atomic<size_t> size_{0};
+  /** Odd while a writer is moving entries. Lookups that observe a change retry. */
+  std::atomic<uint64_t> version_{0};
+  /** Serializes writers. */
+  std::mutex write_latch_;
+};
+
+}  // namespace bustub
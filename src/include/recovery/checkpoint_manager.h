@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +22,26 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * The master record tells recovery where the end checkpoint record of the last complete checkpoint is.
+ */
+struct MasterRecord {
+  /** Offset of the log write that holds the end checkpoint record, the record is at or after it. */
+  int32_t end_checkpoint_offset_;
+  /** LSN of the end checkpoint record. */
+  lsn_t end_checkpoint_lsn_;
+};
+
+/**
+ * CheckpointManager creates fuzzy checkpoints, which neither block transactions nor write pages.
+ *
+ * BeginCheckpoint logs a begin checkpoint record and takes a snapshot of the active transaction table and of the dirty
+ * page table of the buffer pool, with the recLSN of every dirty page. EndCheckpoint logs both tables in an end
+ * checkpoint record, together with the offset in the log where recovery has to start reading: the oldest log record
+ * that is either a change that may not be on disk yet or a record of a transaction that may have to be undone. Once
+ * that record is persistent, the master record points to it, and the log segments before the scan start are dropped.
+ *
+ * Dirty pages are left to the page cleaner and to evictions, whatever they write moves the start of recovery forward
+ * for the next checkpoint.
  */
 class CheckpointManager {
  public:
@@ -31,13 +53,27 @@ class CheckpointManager {
 
   ~CheckpointManager() = default;
 
+  /** Start a checkpoint: log the begin checkpoint record and take the tables. Transactions keep running. */
   void BeginCheckpoint();
+
+  /** Complete the checkpoint: log the end checkpoint record, and point the master record to it once persistent. */
   void EndCheckpoint();
 
+  /** @return the offset in the log from which on recovery reads the log after the last checkpoint, 0 before any */
+  inline auto GetScanStart() const -> int { return scan_start_; }
+
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+
+  /** LSN of the begin checkpoint record of the checkpoint in progress. */
+  lsn_t begin_checkpoint_lsn_{INVALID_LSN};
+  /** The tables of the checkpoint in progress. */
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+  /** Where recovery starts reading the log after the last complete checkpoint. */
+  int scan_start_{0};
 };
 
 }  // namespace bustub
@@ -13,9 +13,14 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>  // NOLINT
-#include <future>              // NOLINT
-#include <mutex>               // NOLINT
+#include <cstdint>
+#include <deque>
+#include <future>  // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -25,16 +30,25 @@ namespace bustub {
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * There are two log buffers. Appenders fill the active one while the other one is being written out; the flush
+ * swaps them. An append reserves its LSN and its space in the active buffer together, with a single compare-and-swap
+ * on reserve_state_, and then copies the record in without holding any latch. A flush seals the active buffer by
+ * swapping, waits for the appenders that still copy into it, and writes it out with one WriteLog.
+ *
+ * Committing transactions only wait until the persistent LSN passes their commit record (group commit): all commits
+ * that land in the same buffer become durable with the same write.
  */
 class LogManager {
  public:
-  explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+  explicit LogManager(DiskManager *disk_manager) : persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+    log_size_ = disk_manager_ == nullptr ? 0 : std::max(disk_manager_->GetLogSize(), 0);
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
   ~LogManager() {
+    StopFlushThread();
     delete[] log_buffer_;
     delete[] flush_buffer_;
     log_buffer_ = nullptr;
@@ -46,29 +60,109 @@ class LogManager {
 
   auto AppendLogRecord(LogRecord *log_record) -> lsn_t;
 
-  inline auto GetNextLSN() -> lsn_t { return next_lsn_; }
+  /**
+   * Write out all log records appended so far, right now. Used to force the log before a page is written back.
+   */
+  void Flush();
+
+  /**
+   * Wait until the log record with the given LSN is persistent, asking the flush thread to flush early.
+   * @param lsn the LSN to wait for
+   */
+  void WaitForFlush(lsn_t lsn);
+
+  inline auto GetNextLSN() -> lsn_t { return ReserveLSN(reserve_state_.load()); }
   inline auto GetPersistentLSN() -> lsn_t { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline auto GetLogBuffer() -> char * { return log_buffer_; }
+  inline auto GetDiskManager() -> DiskManager * { return disk_manager_; }
+
+  /**
+   * Continue after the LSNs that are already in the log, e.g. the next LSN recovery found, and at the end of the log
+   * as it is on disk now. Must be called before anything is appended.
+   * @param lsn the next LSN
+   */
+  inline void SetNextLSN(lsn_t lsn) {
+    reserve_state_ = PackReserveState(lsn, ReserveBufferIndex(reserve_state_.load()), 0);
+    persistent_lsn_ = lsn - 1;
+    log_size_ = disk_manager_ == nullptr ? 0 : std::max(disk_manager_->GetLogSize(), 0);
+  }
+
+  /** @return the number of WriteLog calls so far, every one of them makes a group of log records persistent */
+  inline auto GetNumLogWrites() const -> size_t { return num_log_writes_.load(); }
+
+  /**
+   * Find where a persistent log record is in the log file. Reading the log from the returned offset on reads the
+   * record, maybe after a few earlier ones.
+   * @param lsn the LSN of the log record
+   * @return the offset of the log write that holds the log record, -1 if the log record is not persistent or was
+   * written before this log manager was created or before the offsets were forgotten
+   */
+  auto GetLogOffset(lsn_t lsn) -> int;
+
+  /**
+   * Forget where the log records before the given LSN are, once they are not needed by recovery anymore.
+   * @param lsn the first LSN whose offset may still be asked for
+   */
+  void ForgetLogOffsetsBefore(lsn_t lsn);
 
  private:
-  // TODO(students): you may add your own member variables
+  /** @brief The reserve state packs the next LSN (high 32 bits), the active buffer (bit 31) and its offset. */
+  static auto PackReserveState(lsn_t lsn, uint64_t buffer_index, uint64_t offset) -> uint64_t {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(lsn)) << 32) | (buffer_index << 31) | offset;
+  }
+  static auto ReserveLSN(uint64_t state) -> lsn_t { return static_cast<lsn_t>(state >> 32); }
+  static auto ReserveBufferIndex(uint64_t state) -> uint64_t { return (state >> 31) & 1; }
+  static auto ReserveOffset(uint64_t state) -> uint64_t { return state & ((uint64_t{1} << 31) - 1); }
+
+  /** @brief Encode a log record, whose LSN and size are set, into the log buffer at dest, checksum included. */
+  static void SerializeLogRecord(const LogRecord &log_record, char *dest);
+
+  /** @return the given log buffer */
+  inline auto GetBuffer(uint64_t buffer_index) -> char * { return buffer_index == 0 ? log_buffer_ : flush_buffer_; }
+
+  /** @brief Get a log record of the given size to fit into the active buffer, by flushing it or waiting for a flush. */
+  void WaitForSpace(uint64_t size);
+
+  /** @brief Swap the buffers and write out the one that was active. flush_latch_ must be held. */
+  void FlushActiveBuffer();
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /**
+   * The next LSN, the active buffer and the offset of the first unreserved byte in it, see PackReserveState. An
+   * append reserves its LSN and space with a compare-and-swap, so log records are laid out in the order of their LSNs.
+   */
+  std::atomic<uint64_t> reserve_state_{0};
+  /** Number of bytes copied into each buffer so far. A buffer is complete once this reaches the reserved offset. */
+  std::atomic<uint64_t> filled_[2]{};
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
+  /** Number of WriteLog calls. */
+  std::atomic<size_t> num_log_writes_{0};
+  /** Size of the log file. Written by the flush with flush_latch_ held. */
+  int log_size_;
+  /** The first LSN and the offset in the log file of every log write since the offsets were last forgotten. */
+  std::deque<std::pair<lsn_t, int>> write_offsets_;
 
   char *log_buffer_;
   char *flush_buffer_;
 
+  /** Protects the flags below and write_offsets_, and is held to wait on cv_ and flush_cv_. */
   std::mutex latch_;
+  /** Held by the one thread flushing the log. */
+  std::mutex flush_latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
+  /** True while the flush thread should keep running. */
+  bool enable_flush_{false};
+  /** True if somebody is waiting for the next flush. */
+  bool flush_requested_{false};
 
+  /** Notified after every buffer swap and every write of the log. */
   std::condition_variable cv_;
+  /** Notified to wake up the flush thread early. */
+  std::condition_variable flush_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
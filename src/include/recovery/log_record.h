@@ -12,10 +12,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "common/util/coding_util.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
@@ -32,31 +37,85 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** The start of a fuzzy checkpoint. */
+  BEGIN_CHECKPOINT,
+  /** The end of a fuzzy checkpoint, with the tables it took. */
+  END_CHECKPOINT,
+  /** Inserting an entry into a B+ tree leaf page. */
+  BTREE_INSERT,
+  /** Deleting an entry from a B+ tree leaf page. */
+  BTREE_DELETE,
+  /** A structure modification of a B+ tree on insert: splits, up to a new root. */
+  BTREE_SPLIT,
+  /** A structure modification of a B+ tree on remove: redistributions and merges, down to an empty tree. */
+  BTREE_MERGE,
+};
+
+/**
+ * The change of a B+ tree structure modification to one page. Applying it again gives the same page, so it can be
+ * redone without regard to what is on the page.
+ */
+struct IndexPageChange {
+  enum class Kind : uint8_t {
+    /** The page is replaced by data, its header and its entries. */
+    IMAGE = 0,
+    /** Only the parent page id of the page is set, to value. */
+    PARENT,
+    /** The root page id of the index named data is set to value in the header page. */
+    ROOT,
+  };
+
+  Kind kind_;
+  page_id_t page_id_;
+  page_id_t value_{INVALID_PAGE_ID};
+  std::string data_;
 };
 
 /**
  * For every write operation on the table page, you should write ahead a corresponding log record.
  *
- * For EACH log record, HEADER is like (5 fields in common, 20 bytes in total).
- *---------------------------------------------
- * | size | LSN | transID | prevLSN | LogType |
- *---------------------------------------------
+ * Log records are encoded compactly: all integers but the checksum are varints (see CodingUtil), so that small values
+ * take a single byte. For EACH log record, HEADER is like (6 fields in common, 9 to 25 bytes in total).
+ *-------------------------------------------------------------------------
+ * | checksum | size | LSN | transID | LSN - prevLSN (0 if none) | LogType |
+ *-------------------------------------------------------------------------
+ * The checksum is the CRC32C of everything after it, up to the size of the record, so that recovery can tell a record
+ * that was only partly written before a crash from a complete one. The type is a single byte.
+ *
+ * A RID is written as its page id and slot number, and a tuple as its size (a fixed-size int32) and data.
  * For insert type log record
- *---------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
+ *---------------------------
+ * | HEADER | RID | tuple |
+ *---------------------------
  * For delete type (including markdelete, rollbackdelete, applydelete)
- *----------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
- * For update type log record
- *-----------------------------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
- *-----------------------------------------------------------------------------------
+ *---------------------------
+ * | HEADER | RID | tuple |
+ *---------------------------
+ * For update type log record, only the bytes that change: the old and the new tuple share a prefix and a suffix of
+ * the given lengths, and the bytes in between are logged with their sizes. Redo and undo find the rest on the page.
+ *-----------------------------------------------------------------------------------------------------------
+ * | HEADER | RID | prefix | suffix | old_middle_size | old_middle_data | new_middle_size | new_middle_data |
+ *-----------------------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *------------------------------------
+ * For end checkpoint type log record, whose prevLSN is the LSN of its begin checkpoint record
+ *------------------------------------------------------------------------------------------------------------
+ * | HEADER | scan_start | num_txns | (txn_id, first_lsn) * num_txns | num_pages | (page_id, rec_lsn) * num_pages |
+ *------------------------------------------------------------------------------------------------------------
+ * For B+ tree leaf insert and delete type log records, the entry (key and value) and the slot it is inserted at or
+ * deleted from. A delete also logs the entry next to it, which undo puts it back beside: the entry before it, or for
+ * the first slot the entry after it, empty if there is none.
+ *-------------------------------------------------------------------------------------------------------------
+ * | HEADER | page_id | slot | entry_size | entry_data | neighbor_size | neighbor_data (delete only) |
+ *-------------------------------------------------------------------------------------------------------------
+ * For B+ tree split and merge type log records, which belong to no transaction and are never undone, the changes to
+ * every page the structure modification touched. An image change is the page up to its last entry, a parent change
+ * the new parent page id, and a root change the new root page id and the name of the index.
+ *---------------------------------------------------------------------------------------------
+ * | HEADER | num_changes | (kind, page_id, value, data_size, data) * num_changes |
+ *---------------------------------------------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
@@ -67,7 +126,9 @@ class LogRecord {
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {
+    size_ = GetSizeForLSN(lsn_);
+  }
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &rid, const Tuple &tuple)
@@ -82,7 +143,8 @@ class LogRecord {
       delete_tuple_ = tuple;
     }
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
+    body_size_ = RIDSize(rid) + sizeof(int32_t) + tuple.GetLength();
+    size_ = GetSizeForLSN(lsn_);
   }
 
   // constructor for UPDATE type
@@ -94,20 +156,90 @@ class LogRecord {
         update_rid_(update_rid),
         old_tuple_(old_tuple),
         new_tuple_(new_tuple) {
+    // the bytes both tuples have in common at their beginning and at their end are not logged
+    uint32_t old_size = old_tuple.GetLength();
+    uint32_t new_size = new_tuple.GetLength();
+    uint32_t common = std::min(old_size, new_size);
+    while (update_prefix_ < common && old_tuple.GetData()[update_prefix_] == new_tuple.GetData()[update_prefix_]) {
+      update_prefix_++;
+    }
+    while (update_suffix_ < common - update_prefix_ &&
+           old_tuple.GetData()[old_size - 1 - update_suffix_] == new_tuple.GetData()[new_size - 1 - update_suffix_]) {
+      update_suffix_++;
+    }
+    uint32_t old_middle = old_size - update_prefix_ - update_suffix_;
+    uint32_t new_middle = new_size - update_prefix_ - update_suffix_;
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
+    body_size_ = RIDSize(update_rid) + VarintSize(update_prefix_) + VarintSize(update_suffix_) +
+                 VarintSize(old_middle) + old_middle + VarintSize(new_middle) + new_middle;
+    size_ = GetSizeForLSN(lsn_);
   }
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
-      : size_(HEADER_SIZE),
-        txn_id_(txn_id),
+      : txn_id_(txn_id),
         prev_lsn_(prev_lsn),
         log_record_type_(log_record_type),
         prev_page_id_(prev_page_id),
         page_id_(page_id) {
-    // calculate log record size, header size + sizeof(prev_page_id) + sizeof(page_id)
-    size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
+    // calculate log record size, header size + size of prev_page_id + size of page_id
+    body_size_ = VarintSize(prev_page_id_) + VarintSize(page_id_);
+    size_ = GetSizeForLSN(lsn_);
+  }
+
+  // constructor for END_CHECKPOINT type
+  LogRecord(lsn_t begin_checkpoint_lsn, int32_t scan_start, std::vector<std::pair<txn_id_t, lsn_t>> active_txns,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : txn_id_(INVALID_TXN_ID),
+        prev_lsn_(begin_checkpoint_lsn),
+        log_record_type_(LogRecordType::END_CHECKPOINT),
+        scan_start_(scan_start),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    // calculate log record size
+    body_size_ = VarintSize(scan_start_) + VarintSize(active_txns_.size()) + VarintSize(dirty_pages_.size());
+    for (const auto &[txn_id, first_lsn] : active_txns_) {
+      body_size_ += VarintSize(txn_id) + VarintSize(first_lsn);
+    }
+    for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+      body_size_ += VarintSize(page_id) + VarintSize(rec_lsn);
+    }
+    size_ = GetSizeForLSN(lsn_);
+  }
+
+  // constructor for BTREE_INSERT/BTREE_DELETE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id, int32_t slot,
+            std::string entry, std::string neighbor_entry = {})
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        page_id_(page_id),
+        index_slot_(slot),
+        index_entry_(std::move(entry)),
+        index_neighbor_entry_(std::move(neighbor_entry)) {
+    assert(log_record_type == LogRecordType::BTREE_INSERT || log_record_type == LogRecordType::BTREE_DELETE);
+    // calculate log record size
+    body_size_ = VarintSize(page_id_) + VarintSize(index_slot_) + VarintSize(index_entry_.size()) +
+                 static_cast<int32_t>(index_entry_.size());
+    if (log_record_type == LogRecordType::BTREE_DELETE) {
+      body_size_ += VarintSize(index_neighbor_entry_.size()) + static_cast<int32_t>(index_neighbor_entry_.size());
+    }
+    size_ = GetSizeForLSN(lsn_);
+  }
+
+  // constructor for BTREE_SPLIT/BTREE_MERGE type
+  LogRecord(LogRecordType log_record_type, std::vector<IndexPageChange> index_changes)
+      : txn_id_(INVALID_TXN_ID),
+        prev_lsn_(INVALID_LSN),
+        log_record_type_(log_record_type),
+        index_changes_(std::move(index_changes)) {
+    assert(log_record_type == LogRecordType::BTREE_SPLIT || log_record_type == LogRecordType::BTREE_MERGE);
+    // calculate log record size
+    body_size_ = VarintSize(index_changes_.size());
+    for (const auto &change : index_changes_) {
+      body_size_ += IndexPageChangeSize(change);
+    }
+    size_ = GetSizeForLSN(lsn_);
   }
 
   ~LogRecord() = default;
@@ -120,16 +252,61 @@ class LogRecord {
 
   inline auto GetInsertRID() -> RID & { return insert_rid_; }
 
+  /** @return the old tuple, or only the bytes that changed if the record was read from the log */
   inline auto GetOriginalTuple() -> Tuple & { return old_tuple_; }
 
+  /** @return the new tuple, or only the bytes that changed if the record was read from the log */
   inline auto GetUpdateTuple() -> Tuple & { return new_tuple_; }
 
   inline auto GetUpdateRID() -> RID & { return update_rid_; }
 
   inline auto GetNewPageRecord() -> page_id_t { return prev_page_id_; }
 
+  /** @return the offset in the log from which on recovery reads the log after the checkpoint */
+  inline auto GetScanStart() -> int32_t { return scan_start_; }
+
+  /** @return the transactions that were active at the checkpoint, and a lower bound of their first LSN */
+  inline auto GetActiveTxns() -> std::vector<std::pair<txn_id_t, lsn_t>> & { return active_txns_; }
+
+  /** @return the pages that were dirty at the checkpoint, and a lower bound of their first change not on disk */
+  inline auto GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> & { return dirty_pages_; }
+
+  /** @return the B+ tree page a leaf insert or delete changes */
+  inline auto GetIndexPageId() -> page_id_t { return page_id_; }
+
+  /** @return the slot of the entry a leaf insert or delete changes */
+  inline auto GetIndexSlot() -> int32_t { return index_slot_; }
+
+  /** @return the bytes of the entry a leaf insert or delete changes */
+  inline auto GetIndexEntry() -> std::string & { return index_entry_; }
+
+  /** @return the bytes of the entry before the one a leaf delete deletes, or after it for the first slot */
+  inline auto GetIndexNeighborEntry() -> std::string & { return index_neighbor_entry_; }
+
+  /** @return the changes of a B+ tree structure modification to each page */
+  inline auto GetIndexChanges() -> std::vector<IndexPageChange> & { return index_changes_; }
+
+  /** @return the number of bytes an index page change takes in the log */
+  static auto IndexPageChangeSize(const IndexPageChange &change) -> int32_t {
+    return sizeof(uint8_t) + VarintSize(change.page_id_) + VarintSize(change.value_) +
+           VarintSize(change.data_.size()) + static_cast<int32_t>(change.data_.size());
+  }
+
+  /** @return the size of the record in the log once it is appended, an upper bound of it before */
   inline auto GetSize() -> int32_t { return size_; }
 
+  /** @return the size the record takes in the log with the given LSN, which is part of the header */
+  inline auto GetSizeForLSN(lsn_t lsn) const -> int32_t {
+    int32_t size = CHECKSUM_SIZE + VarintSize(lsn) + VarintSize(txn_id_) + VarintSize(GetPrevLSNDelta(lsn)) +
+                   sizeof(uint8_t) + body_size_;
+    // the size includes its own varint
+    int32_t size_of_size = 1;
+    while (VarintSize(size + size_of_size) > size_of_size) {
+      size_of_size++;
+    }
+    return size + size_of_size;
+  }
+
   inline auto GetLSN() -> lsn_t { return lsn_; }
 
   inline auto GetTxnId() -> txn_id_t { return txn_id_; }
@@ -173,10 +350,47 @@ class LogRecord {
   Tuple old_tuple_;
   Tuple new_tuple_;
 
-  // case4: for new page operation
+  // for an update that was read from the log, old_tuple_ and new_tuple_ only hold the bytes between the two
+  uint32_t update_prefix_{0};
+  uint32_t update_suffix_{0};
+
+  // case4: for new page operation, and the page of a B+ tree leaf insert or delete
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case5: for end checkpoint, the active transaction table and the dirty page table
+  int32_t scan_start_{0};
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+
+  // case6: for B+ tree leaf insert and delete
+  int32_t index_slot_{0};
+  std::string index_entry_;
+  std::string index_neighbor_entry_;
+
+  // case7: for B+ tree structure modifications
+  std::vector<IndexPageChange> index_changes_;
+
+  // the size of everything after the header
+  int32_t body_size_{0};
+
+  static constexpr int32_t CHECKSUM_SIZE = sizeof(uint32_t);
+  /** The smallest header, with single-byte varints, and the largest one. */
+  static constexpr int32_t MIN_HEADER_SIZE = CHECKSUM_SIZE + 4 + sizeof(uint8_t);
+  static constexpr int32_t MAX_HEADER_SIZE = CHECKSUM_SIZE + 4 * CodingUtil::MAX_VARINT_SIZE + sizeof(uint8_t);
+
+  /** @return the number of bytes an integer takes as a varint, negative ones take the most */
+  template <typename T>
+  static auto VarintSize(T value) -> int32_t {
+    return CodingUtil::VarintSize(static_cast<uint32_t>(value));
+  }
+
+  static auto RIDSize(const RID &rid) -> int32_t { return VarintSize(rid.GetPageId()) + VarintSize(rid.GetSlotNum()); }
+
+  /** @return how the previous LSN is logged for the given LSN of the record: the distance back to it, 0 if none */
+  inline auto GetPrevLSNDelta(lsn_t lsn) const -> uint32_t {
+    return prev_lsn_ == INVALID_LSN ? 0 : static_cast<uint32_t>(lsn - prev_lsn_);
+  }
 };  // namespace bustub
 
 }  // namespace bustub
@@ -13,44 +13,172 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <mutex>   // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "recovery/log_manager.h"
 #include "recovery/log_record.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo repeats history: it reads the log from the beginning and applies every change that is newer than the page it
+ * changes, according to the page LSN. While it reads, it dispatches the log records to worker threads by page id, so
+ * that the changes to a page are applied in LSN order while different pages are redone in parallel. Undo then rolls
+ * back the transactions that were still active at the end of the log, newest change first.
+ *
+ * After a checkpoint, recovery only reads the log from the scan start the checkpoint logged, and before the checkpoint
+ * it only redoes the changes to the pages in its dirty page table, from their recLSN on.
+ *
+ * B+ tree pages are recovered the same way. Leaf inserts and deletes are redone and undone on their leaf page, while
+ * structure modifications belong to no transaction: they are redone but never undone, like nested top actions.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /**
+   * @param disk_manager the disk manager of the log
+   * @param buffer_pool_manager the buffer pool the pages are recovered in
+   * @param log_manager the log manager that continues the log after recovery, see Redo
+   * @param num_redo_workers the number of threads that redo changes in parallel
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+              size_t num_redo_workers = std::max(1U, std::thread::hardware_concurrency()))
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        log_manager_(log_manager),
+        num_redo_workers_(std::max<size_t>(num_redo_workers, 1)),
+        offset_(0) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
+  /** Recover without continuing the log afterwards. */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t num_redo_workers = std::max(1U, std::thread::hardware_concurrency()))
+      : LogRecovery(disk_manager, buffer_pool_manager, nullptr, num_redo_workers) {}
+
   ~LogRecovery() {
     delete[] log_buffer_;
     log_buffer_ = nullptr;
   }
 
+  /**
+   * Redo the log. With a log manager, the log is cut after its last complete log record, and the log manager continues
+   * it with the LSN after the last one in the log, so that new log records neither follow a torn record nor reuse
+   * LSNs that are already in the log or on pages.
+   */
   void Redo();
+  /**
+   * Roll back the transactions that were still active at the end of the log. With a log manager, they are logged as
+   * aborted once the rolled back pages are on disk, so that a later recovery does not roll them back again.
+   */
   void Undo();
-  auto DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool;
+  /**
+   * Deserialize a whole log record.
+   * @param data where the log record starts
+   * @param size the number of bytes that can be read at data
+   * @param[out] log_record the log record
+   * @return false if there is no complete log record with a matching checksum
+   */
+  static auto DeserializeLogRecord(const char *data, int size, LogRecord *log_record) -> bool;
+
+  /** @return the LSN after the last log record found by Redo, where the log manager continues */
+  inline auto GetNextLSN() const -> lsn_t { return next_lsn_; }
+
+  /** @return the offset in the log from which on Redo read the log, 0 without a checkpoint */
+  inline auto GetScanStart() const -> int { return scan_start_; }
+
+  /** Size of the chunks of the log that redo reads at once, a chunk always holds a whole log record. */
+  static constexpr int REDO_CHUNK_SIZE = 64 * LOG_BUFFER_SIZE;
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** Where a log record of an active transaction is in the log, and the previous log record of the transaction. */
+  struct UndoEntry {
+    int offset_;
+    lsn_t prev_lsn_;
+  };
+
+  /** @return the redo worker that owns the page */
+  inline auto RedoWorker(page_id_t page_id) const -> size_t { return static_cast<size_t>(page_id) % num_redo_workers_; }
+
+  /**
+   * @brief Deserialize the header of a log record, and the ids of the pages it changes, but not its tuples. If the
+   * record does not end within size bytes, only its size is deserialized, which is then bigger than size.
+   * @return false if there is no valid log record, or if its checksum does not match
+   */
+  static auto DeserializeLogRecordHeader(const char *data, int size, LogRecord *log_record) -> bool;
+
+  /** @brief Deserialize a log record like DeserializeLogRecordHeader, with its body if with_body is set. */
+  static auto ParseLogRecord(const char *data, int size, LogRecord *log_record, bool with_body, bool verify_checksum)
+      -> bool;
+
+  /** @return the tuple with the bytes between its first prefix and its last suffix bytes replaced by middle */
+  static auto SpliceTuple(const Tuple &tuple, uint32_t prefix, uint32_t suffix, const Tuple &middle) -> Tuple;
+
+  /** @brief Find the last complete checkpoint through the master record, if there is one, and take its tables. */
+  void ReadLastCheckpoint();
+
+  /** @return false if the change of the log record to the page is on disk for sure, according to the checkpoint */
+  auto NeedsRedo(page_id_t page_id, lsn_t lsn) const -> bool;
+
+  /** @return the page a log record changes, INVALID_PAGE_ID for the records of transaction begin and end */
+  static auto GetChangedPageId(const LogRecord &log_record) -> page_id_t;
+
+  /** @brief Redo the log records of one worker at the given positions of a chunk of the log, in order. */
+  void RedoLogRecords(size_t worker, const std::vector<char> &chunk, const std::vector<int> &positions);
+
+  /** @brief Redo the change of a log record to one page, if the page does not have it yet. */
+  void RedoLogRecord(size_t worker, const LogRecord &log_record);
+
+  /** @brief Redo the changes of a B+ tree structure modification to the pages of one worker. */
+  void RedoIndexChanges(size_t worker, const LogRecord &log_record);
+
+  /** @brief Roll back the change of a log record. */
+  void UndoLogRecord(const LogRecord &log_record);
+
+  /** @brief Roll back a B+ tree leaf insert or delete. */
+  void UndoIndexLogRecord(const LogRecord &log_record);
+
+  /** @return the leaf page and slot of an entry that was on the given leaf page, INVALID_PAGE_ID if none */
+  auto FindLeafEntry(page_id_t page_id, const std::string &entry) -> std::pair<page_id_t, int>;
+
+  /** @return the leaf page and slot of an entry, from the given leaf page on to the right, INVALID_PAGE_ID if none */
+  auto FindLeafEntryFrom(page_id_t page_id, const std::string &entry) -> std::pair<page_id_t, int>;
+
+  /** @return the leftmost leaf page of the B+ tree the page is in, INVALID_PAGE_ID if none */
+  auto FindLeftmostLeaf(page_id_t page_id, size_t entry_size) -> page_id_t;
+
+  /** @return the page itself, or if it was deleted by a merge, the page it was merged into in the end */
+  auto ResolveLeafPage(page_id_t page_id) -> page_id_t;
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  /** The log manager that continues the log after recovery, nullptr if none. */
+  LogManager *log_manager_;
+  const size_t num_redo_workers_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** Mapping the log sequence number to log file offset for undos, only for the records of active transactions. */
+  std::unordered_map<lsn_t, UndoEntry> lsn_mapping_;
+  /** The LSN after the last log record. */
+  lsn_t next_lsn_{0};
+  /** The LSN of the begin checkpoint record of the last checkpoint, INVALID_LSN without one. */
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  /** The dirty page table of the last checkpoint, page ids and recLSNs. */
+  std::unordered_map<page_id_t, lsn_t> dirty_pages_;
+  /** The offset in the log from which on the log is read. */
+  int scan_start_{0};
 
-  int offset_ __attribute__((__unused__));  // NOLINT
+  /** The offset of the next log record to read. */
+  int offset_;  // NOLINT
   char *log_buffer_;
 };
 
@@ -13,26 +13,61 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <fstream>
 #include <future>  // NOLINT
-#include <mutex>   // NOLINT
+#include <map>
+#include <mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
 
 namespace bustub {
 
+/**
+ * DiskRequest is a page read or write handed to DiskManager::Submit.
+ */
+struct DiskRequest {
+  /** True for a write, false for a read. */
+  bool is_write_;
+  /** The page data to be written, or the buffer to read the page into. Must stay valid until the request is done. */
+  char *data_;
+  /** Id of the page. */
+  page_id_t page_id_;
+  /** Fulfilled when the request is done, or given an exception if it failed. */
+  std::promise<void> callback_;
+  /** When the request was handed to the disk manager. */
+  std::chrono::steady_clock::time_point submit_time_{};
+  /** If set, receives the time from submit_time_ until the request was done, before callback_ is fulfilled. */
+  std::chrono::nanoseconds *latency_{nullptr};
+
+  /** Mark the request as done. */
+  void Finish() {
+    if (latency_ != nullptr) {
+      *latency_ = std::chrono::steady_clock::now() - submit_time_;
+    }
+    callback_.set_value();
+  }
+};
+
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is a sequence of segment files. Offsets in the log count from the beginning of the first segment ever
+ * written, and the segment that starts at offset n is named <db>.log.n, except for the one at offset 0, which is
+ * <db>.log. A log write goes to one segment, a new one is started once the last one has reached the segment size.
+ * Segments at the beginning of the log can be dropped once recovery no longer needs them.
  */
 class DiskManager {
  public:
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param log_segment_size the size at which the log moves on to a new segment file
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, int log_segment_size = LOG_SEGMENT_SIZE);
 
   /** FOR TEST / LEADERBOARD ONLY, used by DiskManagerMemory */
   DiskManager() = default;
@@ -42,7 +77,7 @@ class DiskManager {
   /**
    * Shut down the disk manager and close all the file resources.
    */
-  void ShutDown();
+  virtual void ShutDown();
 
   /**
    * Write a page to the database file.
@@ -58,22 +93,89 @@ class DiskManager {
    */
   virtual void ReadPage(page_id_t page_id, char *page_data);
 
+  /**
+   * Submit page reads and writes in one batch. Requests may complete in any order, and each one signals its own
+   * callback. By default, the requests are executed one after the other before this returns; disk managers that can
+   * keep several I/Os in flight override this.
+   * @param requests the requests
+   */
+  virtual void Submit(std::vector<DiskRequest> requests);
+
+  /**
+   * Start writing a page to the database file.
+   * @param page_id id of the page
+   * @param page_data raw page data, must stay valid until the write is done
+   * @return a future that becomes ready when the write is done
+   */
+  auto WritePageAsync(page_id_t page_id, const char *page_data) -> std::future<void>;
+
+  /**
+   * Start reading a page from the database file.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer, must stay valid until the read is done
+   * @return a future that becomes ready when the read is done
+   */
+  auto ReadPageAsync(page_id_t page_id, char *page_data) -> std::future<void>;
+
   /**
    * Flush the entire log buffer into disk.
    * @param log_data raw log data
    * @param size size of log entry
    */
-  void WriteLog(char *log_data, int size);
+  virtual void WriteLog(char *log_data, int size);
 
   /**
-   * Read a log entry from the log file.
-   * @param[out] log_data output buffer
+   * Read a log entry from the log, which may span several segments.
+   * @param[out] log_data output buffer, zero-filled past the end of the log
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
-   * @return true if the read was successful, false otherwise
+   * @param offset offset of the log entry in the log
+   * @return true if the read was successful, false if the offset is past the end of the log or was truncated
    */
   auto ReadLog(char *log_data, int size, int offset) -> bool;
 
+  /** @return the size of the log in bytes, including the segments that were truncated */
+  auto GetLogSize() -> int;
+
+  /** @return the offset of the oldest byte of the log that was not truncated */
+  auto GetLogStart() -> int;
+
+  /** @return the number of log segments that were not truncated */
+  auto GetNumLogSegments() -> size_t;
+
+  /**
+   * Drop the log segments that end at or before the given offset. The last segment is always kept.
+   * @param offset the offset from which on the log is still needed
+   */
+  void TruncateLog(int offset);
+
+  /**
+   * Drop the log from the given offset on, e.g. a log record that was torn by a crash, so that the log continues there.
+   * @param offset the offset at which the log ends from now on
+   */
+  void TruncateLogTail(int offset);
+
+  /**
+   * Move the segments TruncateLog drops into a directory instead of deleting them.
+   * @param archive_dir the archive directory, created if needed, or empty to delete the segments
+   */
+  void SetLogArchiveDirectory(const std::string &archive_dir);
+
+  /**
+   * Replace the master record, which tells recovery where the last complete checkpoint is. The master record is
+   * written to a file of its own next to the log, and replaced atomically.
+   * @param data the master record
+   * @param size size of the master record
+   */
+  virtual void WriteMasterRecord(const char *data, int size);
+
+  /**
+   * Read the master record.
+   * @param[out] data output buffer
+   * @param size size of the master record
+   * @return false if there is no master record yet
+   */
+  virtual auto ReadMasterRecord(char *data, int size) -> bool;
+
   /** @return the number of disk flushes */
   auto GetNumFlushes() const -> int;
 
@@ -94,14 +196,31 @@ class DiskManager {
 
  protected:
   auto GetFileSize(const std::string &file_name) -> int;
-  // stream to write log file
+  /** @return the file name of the log segment that starts at the given offset */
+  auto GetLogSegmentName(int segment_start) const -> std::string;
+  /** Find the log segments on disk and open the last one for appending. */
+  void OpenLogSegments();
+  // stream to write the last log segment
   std::fstream log_io_;
   std::string log_name_;
+  // the log segments that were not truncated, by their offset in the log
+  std::map<int, std::string> log_segments_;
+  int log_segment_size_{LOG_SEGMENT_SIZE};
+  // size of the log, up to the end of the last segment
+  int log_size_{0};
+  // stream to read log segments, open on the segment at log_read_segment_, or -1 if none
+  std::ifstream log_read_io_;
+  int log_read_segment_{-1};
+  std::string log_archive_dir_;
+  // protects the log segments and the log streams
+  std::mutex log_io_latch_;
+  // file of the master record
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
   int num_flushes_{0};
-  int num_writes_{0};
+  std::atomic<int> num_writes_{0};
   bool flush_log_{false};
   std::future<void> *flush_log_f_{nullptr};
   // With multiple buffer pool instances, need to protect file access
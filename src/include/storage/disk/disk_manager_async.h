@@ -0,0 +1,144 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_manager_async.h
+//
+// Identification: src/include/storage/disk/disk_manager_async.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <sys/uio.h>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+#include "storage/disk/disk_manager_posix.h"
+
+namespace bustub {
+
+/**
+ * DiskManagerAsync keeps many page reads and writes in flight at once. Submit queues a whole batch of requests and
+ * returns right away; every request signals its callback when it is done.
+ *
+ * Requests are submitted to an io_uring and reaped by a completion thread. Where io_uring is not available, e.g. an
+ * older kernel, a sandbox that forbids it, or not Linux at all, a pool of worker threads runs the requests with
+ * pread/pwrite instead, which works on any regular file.
+ */
+class DiskManagerAsync : public DiskManagerPosix {
+ public:
+  /**
+   * Creates a new asynchronous disk manager that writes to the specified database file.
+   * @param db_file the file name of the database file to write to
+   * @param direct_io true to bypass the OS page cache
+   * @param queue_depth the maximum number of requests in flight, Submit waits while there are that many
+   * @param use_io_uring false to always use the worker threads, e.g. to compare both
+   */
+  explicit DiskManagerAsync(const std::string &db_file, bool direct_io = false,
+                            size_t queue_depth = ASYNC_IO_QUEUE_DEPTH, bool use_io_uring = true);
+
+  /** Waits for all requests in flight, then destroys the disk manager. */
+  ~DiskManagerAsync() override;
+
+  /**
+   * Wait for all requests in flight, then shut down the disk manager and close all the file resources.
+   */
+  void ShutDown() override;
+
+  /**
+   * Submit page reads and writes. Returns once all of them are queued, which only waits if queue_depth requests are
+   * already in flight. A read past the end of the file fills the rest of the page with zeros, and a request that fails
+   * gives its callback an exception.
+   * @param requests the requests
+   */
+  void Submit(std::vector<DiskRequest> requests) override;
+
+  /** @return true if requests go to an io_uring, false if they are run by worker threads */
+  auto UsesIoUring() const -> bool { return ring_fd_ != -1; }
+
+ private:
+  /** A request that was handed to the kernel. */
+  struct InFlight {
+    DiskRequest request_;
+    /** The aligned buffer of a direct I/O request whose data is not aligned, nullptr otherwise. */
+    char *bounce_buffer_;
+    /** The I/O vector of the request, pointing at the data or at the bounce buffer. */
+    struct iovec iov_;
+  };
+
+  /** @brief Set up the io_uring, return false if that is not possible. */
+  auto SetUpRing() -> bool;
+
+  /** @brief Unmap and close the io_uring. */
+  void TearDownRing();
+
+  /** @brief Hand the requests to the io_uring, waiting for free slots as needed. */
+  void SubmitToRing(std::vector<DiskRequest> *requests);
+
+  /** @brief Body of the io_uring completion thread. */
+  void RunCompletionThread();
+
+  /** @brief Body of a worker thread, used without io_uring. */
+  void RunWorker();
+
+  /**
+   * @brief Finish the request in a slot whose I/O transferred the given number of bytes, or failed with -errno, and
+   * free the slot. A short write is completed synchronously.
+   */
+  void Complete(size_t slot, int result);
+
+  /** @brief Stop the completion thread or the workers once the requests in flight are done. */
+  void Stop();
+
+  /** Maximum number of requests in flight. */
+  const size_t queue_depth_;
+
+  /** File descriptor of the io_uring, -1 if the workers are used. */
+  int ring_fd_{-1};
+  /** The memory mappings of the io_uring: submission ring, completion ring, and submission queue entries. */
+  void *sq_ring_{nullptr};
+  void *cq_ring_{nullptr};
+  void *sqes_{nullptr};
+  size_t sq_ring_size_{0};
+  size_t cq_ring_size_{0};
+  size_t sqes_size_{0};
+  /** Pointers to the fields of the rings, set up from the offsets the kernel reports. */
+  unsigned *sq_tail_{nullptr};
+  unsigned *sq_mask_{nullptr};
+  unsigned *sq_array_{nullptr};
+  unsigned *cq_head_{nullptr};
+  unsigned *cq_tail_{nullptr};
+  unsigned *cq_mask_{nullptr};
+  void *cqes_{nullptr};
+  /** The completion thread, if the io_uring is used. */
+  std::thread completion_thread_;
+
+  /** One slot per request in flight, indexed by the user data of the submission queue entry minus one. */
+  std::vector<InFlight> slots_;
+  /** Slots that are not in flight. */
+  std::vector<size_t> free_slots_;
+
+  /** Worker threads, if the io_uring is not used. */
+  std::vector<std::thread> workers_;
+  /** Requests the workers have not picked up yet. */
+  std::deque<DiskRequest> queue_;
+  /** Number of requests queued or being run by the workers. */
+  size_t num_queued_{0};
+
+  /** True once Stop was called. */
+  bool stopped_{false};
+  /** Protects the submission ring, the slots, the queue, and the counters above. */
+  std::mutex latch_;
+  /** Notified when a slot is freed or a request is queued. Waited on with latch_. */
+  std::condition_variable cv_;
+};
+
+}  // namespace bustub
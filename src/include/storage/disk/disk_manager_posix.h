@@ -0,0 +1,74 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_manager_posix.h
+//
+// Identification: src/include/storage/disk/disk_manager_posix.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+
+#include "common/config.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * DiskManagerPosix does page I/O on a plain file descriptor with positional pread/pwrite. Unlike DiskManager, which
+ * funnels every page through one shared file stream under a latch, concurrent reads and writes of different pages do
+ * not wait for each other. The log is still handled by DiskManager.
+ *
+ * With direct I/O, the database file is opened with O_DIRECT so that pages bypass the OS page cache and the buffer
+ * pool is the only cache. Page buffers that are not aligned to the I/O alignment go through an aligned bounce buffer.
+ * If the file system does not support direct I/O, the file is opened without it.
+ */
+class DiskManagerPosix : public DiskManager {
+ public:
+  /** Alignment of the buffers, offsets and sizes of direct I/O. */
+  static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+  /**
+   * Creates a new disk manager that writes to the specified database file.
+   * @param db_file the file name of the database file to write to
+   * @param direct_io true to bypass the OS page cache
+   */
+  explicit DiskManagerPosix(const std::string &db_file, bool direct_io = false);
+
+  ~DiskManagerPosix() override;
+
+  /**
+   * Shut down the disk manager and close all the file resources.
+   */
+  void ShutDown() override;
+
+  /**
+   * Write a page to the database file.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePage(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Read a page from the database file. The part of the page beyond the end of the file reads as zeros.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPage(page_id_t page_id, char *page_data) override;
+
+  /** @return true if the database file is opened for direct I/O */
+  auto IsDirectIO() const -> bool { return direct_io_; }
+
+ protected:
+  /** File descriptor of the database file, -1 once shut down. */
+  int db_fd_{-1};
+  /** True if db_fd_ was opened with O_DIRECT. */
+  bool direct_io_{false};
+};
+
+}  // namespace bustub
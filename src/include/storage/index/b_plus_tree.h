@@ -10,12 +10,17 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <mutex>  // NOLINT
 #include <queue>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "common/rwlatch.h"
 #include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
@@ -33,15 +38,32 @@ namespace bustub {
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * With a log manager, changes are logged physiologically: a leaf insert or delete as its entry and slot in the leaf,
+ * on behalf of the transaction, and a structure modification (split, merge or redistribution) as one record of
+ * changes to all the pages it touched, on behalf of no transaction, so that it is never undone.
+ *
+ * Concurrent inserts and removes crab latches down the tree. They write latch the pages on their way in the page set
+ * of the transaction, and release all of them once a page is safe, that is once it cannot split or merge and so cannot
+ * change its parent. The root page id has a latch of its own, taken like the latch of a parent of the root. As most
+ * inserts and removes do not split or merge, they first descend optimistically with read latches and write latch only
+ * the leaf page, and only crab down with write latches if the leaf page turns out not to be safe.
+ *
+ * Lookups and iterators take no latches at all, they couple page versions instead (optimistic lock coupling). A page
+ * is read at the version it has when it is not write latched, and the read counts only if the version is still the
+ * same afterwards. A child is found through its parent only if the parent still has its version once the version of
+ * the child is read, otherwise the lookup starts over from the root.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
+  friend class IndexIterator<KeyType, ValueType, KeyComparator>;
   using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
 
  public:
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     LogManager *log_manager = nullptr);
 
   // Returns true if this B+ tree has no keys and values.
   auto IsEmpty() const -> bool;
@@ -76,27 +98,87 @@ class BPlusTree {
   void RemoveFromFile(const std::string &file_name, Transaction *transaction = nullptr);
 
  private:
+  /** The pages a structure modification changed, logged together once it is done. */
+  struct StructureChange {
+    /** Pages that changed as a whole. */
+    std::vector<page_id_t> changed_pages_;
+    /** Pages of which only the parent page id changed. */
+    std::vector<page_id_t> reparented_pages_;
+    /** Pages that were deleted, and the page each was merged into, INVALID_PAGE_ID if none. */
+    std::vector<std::pair<page_id_t, page_id_t>> freed_pages_;
+    bool root_changed_{false};
+    /** The pages the operation holds write latches on, nullptr for the root latch. */
+    std::deque<Page *> *page_set_{nullptr};
+  };
+
+  /** What a descent latches the pages for. */
+  enum class Operation { INSERT, REMOVE };
+
   void UpdateRootPageId(int insert_record = 0);
 
-  // return the page id of the target leaf page
-  auto GetLeafPageId(const KeyType &key) -> page_id_t;
+  // log the insert or delete of an entry of a leaf page
+  void LogLeafChange(LogRecordType type, LeafPage *leaf_page, int slot, const MappingType &entry,
+                     const MappingType *neighbor_entry, Transaction *transaction);
+
+  // log a structure modification
+  void LogStructureChange(LogRecordType type, const StructureChange &change);
+
+  /**
+   * Descend to the leaf page of the key without latches, coupling page versions.
+   * @param leftmost descend to the leftmost leaf page instead
+   * @param[out] version the version the leaf page was found at, which its reads are to be validated against
+   * @return the leaf page, pinned, nullptr if the tree is empty
+   */
+  auto FindLeafPageOptimistic(const KeyType &key, bool leftmost, uint64_t *version) -> Page *;
+
+  /**
+   * Descend to the leaf page of the key, crabbing write latches. The pages the operation still needs are kept write
+   * latched in the page set, the root latch first and the leaf page last.
+   * @return the leaf page, nullptr if the tree is empty, in which case the root latch is held
+   */
+  auto FindLeafPage(const KeyType &key, Operation op, std::deque<Page *> *page_set) -> Page *;
+
+  /**
+   * Descend like a read to the leaf page of the key, and write latch only the leaf page, for an insert or remove that
+   * does not split or merge it.
+   * @return the leaf page in the page set, nullptr with nothing latched if the leaf page is not safe for the operation
+   * or the tree is empty
+   */
+  auto FindSafeLeafPage(const KeyType &key, Operation op, std::deque<Page *> *page_set) -> Page *;
+
+  // return true if the operation cannot split or merge the page
+  auto IsSafe(BPlusTreePage *page, Operation op) const -> bool;
+
+  // write unlatch and unpin the pages of the page set, and release the root latch if it is in there
+  void ReleasePageSet(std::deque<Page *> *page_set, bool is_dirty);
+
+  // fetch a page, write latched in the page set if it is not there yet, which keeps a pin of its own
+  auto FetchLatchedPage(page_id_t page_id, StructureChange *change) -> Page *;
+
+  // delete the pages a structure modification freed, and retry the ones that lookups still had pinned before
+  void DeleteFreedPages(const StructureChange &change);
+
+  // write unlatch and unpin a page once it is split, it is the last page of the page set
+  void ReleaseSplitPage(page_id_t page_id, StructureChange *change);
 
-  auto GetStartPageId() -> page_id_t;
+  // set the parent page id of a page under its write latch
+  void SetParentPageId(page_id_t page_id, page_id_t parent_page_id, StructureChange *change);
 
   auto GetSiblingPageId(const page_id_t &page_id) const -> std::pair<page_id_t, page_id_t>;
 
   // split the internal page recurrsively
   void InsertToInternalPageRecur(const KeyType &key, const page_id_t &l_value, const page_id_t &r_value,
-                                 const page_id_t &internal_page_id);
+                                 const page_id_t &internal_page_id, StructureChange *change);
 
   // try to steal a key from the left/right sibling leaf page
   // success return true
-  auto StealFromSiblingLeafPage(const page_id_t &leaf_page_id) -> bool;
+  auto StealFromSiblingLeafPage(const page_id_t &leaf_page_id, StructureChange *change) -> bool;
 
   // remove the page/key pair from the internal page recurrsively
-  void DeleteFromInternalPageRecur(const page_id_t &removed_page_id, page_id_t internal_page_id);
+  void DeleteFromInternalPageRecur(const page_id_t &removed_page_id, page_id_t internal_page_id,
+                                   StructureChange *change);
 
-  auto StealFromSiblingInternalPage(const page_id_t &internal_page_id) -> bool;
+  auto StealFromSiblingInternalPage(const page_id_t &internal_page_id, StructureChange *change) -> bool;
 
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
@@ -105,11 +187,18 @@ class BPlusTree {
 
   // member variable
   std::string index_name_;
-  page_id_t root_page_id_;
+  std::atomic<page_id_t> root_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
+  LogManager *log_manager_;
+  /** Protects root_page_id_ from changes, lookups only read it. */
+  ReaderWriterLatch root_latch_;
+  /** Pages that were freed while a lookup had them pinned, deleted by a later structure modification. */
+  std::vector<page_id_t> pinned_freed_pages_;
+  /** Protects pinned_freed_pages_. */
+  std::mutex pinned_freed_pages_latch_;
 };
 
 }  // namespace bustub
@@ -19,12 +19,24 @@ namespace bustub {
 
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTree;
+
+/**
+ * An iterator reads the leaf pages optimistically, without latching them. It keeps a copy of the current entry, read
+ * at a version of its leaf page. When the leaf page has changed since, the iterator finds its way back from the root,
+ * to the first entry after the copy.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
  public:
   // you may define your own constructor based on your member variables
   IndexIterator();
-  IndexIterator(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index, BufferPoolManager *buffer_pool_manager);
+  // iterator at the first entry of the tree
+  explicit IndexIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree);
+  // iterator at the first entry whose key is not less than the key
+  IndexIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree, const KeyType &key);
+  IndexIterator(IndexIterator &&other) noexcept;
   ~IndexIterator();  // NOLINT
 
   auto IsEnd() -> bool;
@@ -34,24 +46,34 @@ class IndexIterator {
   auto operator++() -> IndexIterator &;
 
   auto operator==(const IndexIterator &itr) const -> bool {
-    if (leaf_page_ptr_ == nullptr || itr.leaf_page_ptr_ == nullptr) {
-      return leaf_page_ptr_ == itr.leaf_page_ptr_;
+    if (page_ == nullptr || itr.page_ == nullptr) {
+      return page_ == itr.page_;
     }
-    return leaf_page_ptr_->GetPageId() == itr.leaf_page_ptr_->GetPageId() && index_ == itr.index_;
+    return page_->GetPageId() == itr.page_->GetPageId() && index_ == itr.index_;
   }
 
-  auto operator!=(const IndexIterator &itr) const -> bool {
-    if (leaf_page_ptr_ == nullptr || itr.leaf_page_ptr_ == nullptr) {
-      return leaf_page_ptr_ != itr.leaf_page_ptr_;
-    }
-    return leaf_page_ptr_->GetPageId() != itr.leaf_page_ptr_->GetPageId() || index_ != itr.index_;
-  }
+  auto operator!=(const IndexIterator &itr) const -> bool { return !(*this == itr); }
 
  private:
-  // add your own private member variables here
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page_ptr_;
-  int index_;
-  BufferPoolManager *buffer_pool_manager_;
+  /**
+   * @brief Find the first entry from the root on, the first entry whose key is not less than the key, or the first
+   * entry whose key is greater than the key.
+   */
+  void Seek(const KeyType *key, bool inclusive);
+
+  /**
+   * @brief Copy the entry at index_ of the leaf page, or of the leaf pages after it if it is past the end.
+   * @return false if a leaf page changed meanwhile, the iterator has no page then
+   */
+  auto Settle() -> bool;
+
+  BPlusTree<KeyType, ValueType, KeyComparator> *tree_{nullptr};
+  // the pinned leaf page, nullptr at the end
+  Page *page_{nullptr};
+  // the version of the leaf page the entry was read at
+  uint64_t version_{0};
+  int index_{0};
+  MappingType entry_;
 };
 
 }  // namespace bustub
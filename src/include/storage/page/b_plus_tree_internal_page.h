@@ -46,6 +46,7 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   void ReplaceKey(const KeyType &before_key, const KeyType &after_key, const KeyComparator &comparator);
 
   auto GetValue(const KeyType &key, const KeyComparator &comparator) const -> ValueType;
+  auto GetBoundedSize() const -> int;
   auto InsertKey(const KeyType &key, const ValueType &l_value, const ValueType &r_value,
                  const KeyComparator &comparator) -> bool;
   auto InsertKeyAndSplitTwo(const KeyType &key, const ValueType &l_value, const ValueType &r_value,
@@ -58,6 +59,7 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   auto MergeInternalPage(BPlusTreeInternalPage &tb_merged_page, BPlusTreeInternalPage &parent_page) -> page_id_t;
 
  private:
+  auto UpperBound(const KeyType &key, const KeyComparator &comparator, int first) const -> int;
   auto InsertKeyIgnoreFirst(const KeyType &key, const ValueType &l_value, const ValueType &r_value,
                             const KeyComparator &comparator) -> bool;
   // Flexible array member for page data.
@@ -52,6 +52,8 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   auto ValueAt(int index) const -> ValueType;
   auto HasKey(const KeyType &key, const KeyComparator &comparator) const -> bool;
   auto GetKeyIndex(const KeyType &key, const KeyComparator &comparator) const -> int;
+  auto LowerBound(const KeyType &key, const KeyComparator &comparator) const -> int;
+  auto GetBoundedSize() const -> int;
   auto GetElem(int index) -> const MappingType &;
 
   auto GetValue(const KeyType &key, const KeyComparator &comparator, ValueType &result) const -> bool;
@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <thread>  // NOLINT
 
 #include "common/config.h"
 #include "common/rwlatch.h"
@@ -49,10 +51,16 @@ class Page {
   inline auto IsDirty() -> bool { return is_dirty_; }
 
   /** Acquire the page write latch. */
-  inline void WLatch() { rwlatch_.WLock(); }
+  inline void WLatch() {
+    rwlatch_.WLock();
+    version_.fetch_add(1);
+  }
 
   /** Release the page write latch. */
-  inline void WUnlatch() { rwlatch_.WUnlock(); }
+  inline void WUnlatch() {
+    version_.fetch_add(1);
+    rwlatch_.WUnlock();
+  }
 
   /** Acquire the page read latch. */
   inline void RLatch() { rwlatch_.RLock(); }
@@ -60,6 +68,26 @@ class Page {
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /**
+   * Start an optimistic read of the page, which takes no latch: wait until the page is not write latched, and read it
+   * only if ValidateVersion confirms afterwards that it was not write latched meanwhile.
+   * @return the version of the page
+   */
+  inline auto ReadVersion() -> uint64_t {
+    uint64_t version = version_.load();
+    while ((version & 1) == 1) {
+      std::this_thread::yield();
+      version = version_.load();
+    }
+    return version;
+  }
+
+  /** @return true if the page was not write latched since ReadVersion returned the version */
+  inline auto ValidateVersion(uint64_t version) -> bool {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+  }
+
   /** @return the page LSN. */
   inline auto GetLSN() -> lsn_t { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
@@ -86,8 +114,15 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /**
+   * A lower bound of the LSN of the oldest change to the page that may not be on disk yet (the recLSN), while the page
+   * is dirty or pinned. INVALID_LSN while the page on disk is current and nobody can change it.
+   */
+  lsn_t rec_lsn_ = INVALID_LSN;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
+  /** Counts write latches and unlatches, odd while the page is write latched. */
+  std::atomic<uint64_t> version_{0};
 };
 
 }  // namespace bustub
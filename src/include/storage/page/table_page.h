@@ -36,13 +36,30 @@ namespace bustub {
  *  ----------------------------------------------------------------------------
  *  | PageId (4)| LSN (4)| PrevPageId (4)| NextPageId (4)| FreeSpacePointer(4) |
  *  ----------------------------------------------------------------------------
- *  ----------------------------------------------------------------
- *  | TupleCount (4) | Tuple_1 offset (4) | Tuple_1 size (4) | ... |
- *  ----------------------------------------------------------------
+ *  ------------------------------
+ *  | TupleCount (4) | Epoch (4) |
+ *  ------------------------------
+ *  ----------------------------------------------------------------------------------------------------------
+ *  | Tuple_1 offset (4) | Tuple_1 size (4) | Tuple_1 begin ts (8) | Tuple_1 end ts (8) | Tuple_1 version (8) |
+ *  ----------------------------------------------------------------------------------------------------------
+ *  ----------------
+ *  | Tuple_2 ... |
+ *  ----------------
  *
+ * The begin and end timestamps of a tuple are the commit timestamps of the transactions that wrote and replaced it,
+ * see TableHeap. The version word is bumped by every committed write of the tuple, and has its lock bit set while a
+ * transaction writes it, for the validation of optimistic transactions. Both are only meaningful to the table heap of
+ * the epoch the page carries: timestamps restart with every TransactionManager, so the tuples of a page from another
+ * epoch count as committed before any snapshot, with unlocked version words. Recovery and the tuple operations here
+ * leave the timestamps and the version words alone.
  */
 class TablePage : public Page {
  public:
+  static constexpr size_t SIZE_TABLE_PAGE_HEADER = 28;
+  static constexpr size_t SIZE_TUPLE = 32;
+  /** The size of the largest tuple a page holds */
+  static constexpr size_t MAX_TUPLE_SIZE = BUSTUB_PAGE_SIZE - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE;
+
   /**
    * Initialize the TablePage header.
    * @param page_id the page ID of this table page
@@ -84,6 +101,15 @@ class TablePage : public Page {
   auto InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager)
       -> bool;
 
+  /**
+   * Insert a tuple into the given slot, which must be free or the next new one. Recovery uses this to redo an insert
+   * or to undo a delete, where the tuple has to get back its RID. Not logged.
+   * @param tuple tuple to insert
+   * @param rid rid the tuple gets
+   * @return true if the insert is successful (i.e. the slot is free and there is enough space)
+   */
+  auto InsertTupleAt(const Tuple &tuple, const RID &rid) -> bool;
+
   /**
    * Mark a tuple as deleted. This does not actually delete the tuple.
    * @param rid rid of the tuple to mark as deleted
@@ -123,32 +149,68 @@ class TablePage : public Page {
    */
   auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) -> bool;
 
-  /** @return the rid of the first tuple in this page */
+  /**
+   * Read a tuple with its timestamps, even if it is marked as deleted.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @param[out] begin_ts the commit timestamp of the transaction that wrote the tuple
+   * @param[out] end_ts the commit timestamp of the transaction that replaced or deleted the tuple, MAX_TS if none
+   * @param epoch the epoch of the table heap
+   * @return false if the slot is empty
+   */
+  auto GetTupleVersion(const RID &rid, Tuple *tuple, timestamp_t *begin_ts, timestamp_t *end_ts, uint32_t epoch)
+      -> bool;
+
+  /**
+   * Read the timestamps of a tuple, see GetTupleVersion.
+   * @return false if the slot is empty
+   */
+  auto GetTupleTimestamps(const RID &rid, timestamp_t *begin_ts, timestamp_t *end_ts, uint32_t epoch) -> bool;
+
+  /**
+   * Set the timestamps of a tuple. A page of another epoch first gets the timestamps of tuples committed before any
+   * snapshot for all its tuples, and the given epoch.
+   */
+  void SetTupleTimestamps(const RID &rid, timestamp_t begin_ts, timestamp_t end_ts, uint32_t epoch);
+
+  /**
+   * @param rid rid of the tuple, which may be in an empty slot
+   * @param epoch the epoch of the table heap
+   * @return the version word of the tuple, 0 for a page of another epoch
+   */
+  auto GetVersionWord(const RID &rid, uint32_t epoch) -> uint64_t;
+
+  /** Set the version word of a tuple, a page of another epoch is reset first like in SetTupleTimestamps. */
+  void SetVersionWord(const RID &rid, uint64_t version, uint32_t epoch);
 
   /**
    * @param[out] first_rid the RID of the first tuple in this page
+   * @param include_deleted whether to stop at deleted tuples and empty slots too
    * @return true if the first tuple exists, false otherwise
    */
-  auto GetFirstTupleRid(RID *first_rid) -> bool;
+  auto GetFirstTupleRid(RID *first_rid, bool include_deleted = false) -> bool;
 
   /**
    * @param cur_rid the RID of the current tuple
    * @param[out] next_rid the RID of the tuple following the current tuple
+   * @param include_deleted whether to stop at deleted tuples and empty slots too
    * @return true if the next tuple exists, false otherwise
    */
-  auto GetNextTupleRid(const RID &cur_rid, RID *next_rid) -> bool;
+  auto GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool include_deleted = false) -> bool;
 
  private:
   static_assert(sizeof(page_id_t) == 4);
 
-  static constexpr size_t SIZE_TABLE_PAGE_HEADER = 24;
-  static constexpr size_t SIZE_TUPLE = 8;
   static constexpr size_t OFFSET_PREV_PAGE_ID = 8;
   static constexpr size_t OFFSET_NEXT_PAGE_ID = 12;
   static constexpr size_t OFFSET_FREE_SPACE = 16;
   static constexpr size_t OFFSET_TUPLE_COUNT = 20;
-  static constexpr size_t OFFSET_TUPLE_OFFSET = 24;  // Naming things is hard.
-  static constexpr size_t OFFSET_TUPLE_SIZE = 28;
+  static constexpr size_t OFFSET_EPOCH = 24;
+  static constexpr size_t OFFSET_TUPLE_OFFSET = 28;  // Naming things is hard.
+  static constexpr size_t OFFSET_TUPLE_SIZE = 32;
+  static constexpr size_t OFFSET_TUPLE_BEGIN_TS = 36;
+  static constexpr size_t OFFSET_TUPLE_END_TS = 44;
+  static constexpr size_t OFFSET_TUPLE_VERSION = 52;
 
   /** @return pointer to the end of the current free space, see header comment */
   auto GetFreeSpacePointer() -> uint32_t { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_FREE_SPACE); }
@@ -205,5 +267,26 @@ class TablePage : public Page {
   static auto UnsetDeletedFlag(uint32_t tuple_size) -> uint32_t {
     return static_cast<uint32_t>(tuple_size & (~DELETE_MASK));
   }
+
+  /** @return the epoch of the table heap that set the timestamps of the tuples */
+  auto GetEpoch() -> uint32_t { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_EPOCH); }
+
+  /** Set the epoch of the timestamps. */
+  void SetEpoch(uint32_t epoch) { memcpy(GetData() + OFFSET_EPOCH, &epoch, sizeof(uint32_t)); }
+
+  /** Take over a page of another epoch: tuples committed before any snapshot, with unlocked version words. */
+  void ResetEpoch(uint32_t epoch);
+
+  /** @return the timestamp at the given offset of the slot, which is not aligned */
+  auto GetTimestamp(uint32_t slot_num, size_t offset) -> timestamp_t {
+    timestamp_t ts;
+    memcpy(&ts, GetData() + offset + SIZE_TUPLE * slot_num, sizeof(timestamp_t));
+    return ts;
+  }
+
+  /** Set the timestamp at the given offset of the slot. */
+  void SetTimestamp(uint32_t slot_num, size_t offset, timestamp_t ts) {
+    memcpy(GetData() + offset + SIZE_TUPLE * slot_num, &ts, sizeof(timestamp_t));
+  }
 };
 }  // namespace bustub
@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
@@ -23,6 +27,16 @@ namespace bustub {
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * Tuples are multi-versioned. The newest version of a tuple is on its page, stamped with a begin and an end timestamp:
+ * the commit timestamps of the transactions that wrote it and that replaced or deleted it, or the temporary timestamp
+ * of a transaction that has not committed yet. An update or a committed delete moves the version it replaces to the
+ * version chain of the RID, which is kept in memory. A SNAPSHOT_ISOLATION transaction reads the version whose
+ * timestamps enclose its read timestamp, on the page or in the chain, without locks; other transactions read the
+ * newest version. Versions no snapshot can see anymore are pruned from the chains when transactions commit.
+ *
+ * Every write also locks the version word of the tuple on its page until the transaction ends, and a commit bumps it.
+ * An OPTIMISTIC transaction records the version words of the tuples it reads, and validates them on commit.
  */
 class TableHeap {
   friend class TableIterator;
@@ -91,16 +105,69 @@ class TableHeap {
   void RollbackDelete(const RID &rid, Transaction *txn);
 
   /**
-   * Read a tuple from the table.
+   * Called on abort to rollback an update, back to the version it replaced.
+   * @param old_tuple the tuple before the update
+   * @param rid rid of the updated tuple
+   * @param txn transaction performing the rollback
+   */
+  void RollbackUpdate(const Tuple &old_tuple, const RID &rid, Transaction *txn);
+
+  /**
+   * Called on commit, before ApplyDelete, to replace the temporary timestamps the transaction stamped on the versions
+   * of a tuple with its commit timestamp.
+   * @param rid rid of a tuple the transaction wrote
+   * @param txn the committing transaction
+   * @param commit_ts the commit timestamp
+   */
+  void CommitTuple(const RID &rid, Transaction *txn, timestamp_t commit_ts);
+
+  /**
+   * Drop the versions of a tuple that no snapshot can see anymore.
+   * @param rid rid of the tuple
+   * @param watermark the lowest read timestamp of the running snapshots, or the last commit timestamp if none
+   */
+  void PruneVersions(const RID &rid, timestamp_t watermark);
+
+  /**
+   * Called when a transaction ends, to unlock the version word of a tuple it wrote.
+   * @param rid rid of the tuple
+   * @param committed whether the transaction committed, which bumps the version
+   */
+  void UnlockVersion(const RID &rid, bool committed);
+
+  /**
+   * Called on commit of an OPTIMISTIC transaction, after all its writes locked their tuples.
+   * @param rid rid of a tuple the transaction read
+   * @param version the version word of the tuple when it was read
+   * @param txn the committing transaction
+   * @return whether the tuple is still at the version, and no other transaction is writing it
+   */
+  auto ValidateRead(const RID &rid, uint64_t version, Transaction *txn) -> bool;
+
+  /** @return whether the transaction reads snapshots, rather than the newest versions */
+  static auto IsSnapshotRead(Transaction *txn) -> bool {
+    return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+  }
+
+  /**
+   * Read a tuple from the table. A snapshot reads the version visible to it, which may be deleted or replaced.
    * @param rid rid of the tuple to read
    * @param tuple output variable for the tuple
    * @param txn transaction performing the read
+   * @param acquire_read_lock whether to latch the page, false if the caller holds its latch already
+   * @param strategy access strategy of the scan reading the tuple, nullptr for a plain fetch of its page
    * @return true if the read was successful (i.e. the tuple exists)
    */
-  auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool acquire_read_lock = true) -> bool;
+  auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool acquire_read_lock = true,
+                BufferAccessStrategy *strategy = nullptr) -> bool;
 
-  /** @return the begin iterator of this table */
-  auto Begin(Transaction *txn) -> TableIterator;
+  /**
+   * @param txn transaction performing the scan
+   * @param strategy access strategy to fetch the pages of the scan with, nullptr for plain fetches. It must outlive
+   * the iterator.
+   * @return the begin iterator of this table
+   */
+  auto Begin(Transaction *txn, BufferAccessStrategy *strategy = nullptr) -> TableIterator;
 
   /** @return the end iterator of this table */
   auto End() -> TableIterator;
@@ -109,10 +176,43 @@ class TableHeap {
   inline auto GetFirstPageId() const -> page_id_t { return first_page_id_; }
 
  private:
+  /** A version of a tuple that was replaced or deleted. */
+  struct TupleVersion {
+    Tuple tuple_;
+    timestamp_t begin_ts_;
+    timestamp_t end_ts_;
+  };
+
+  /** @return whether the transaction sees a version with the timestamps */
+  static auto IsVisible(Transaction *txn, timestamp_t begin_ts, timestamp_t end_ts) -> bool;
+
+  /** @return whether a snapshot writing a tuple with the timestamps would overwrite a version it cannot see */
+  static auto IsWriteConflict(Transaction *txn, timestamp_t begin_ts, timestamp_t end_ts) -> bool;
+
+  /** @return whether the version chain of the tuple has a version the transaction sees, read into tuple */
+  auto GetVersionFromChain(const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
+
+  /** @brief Add a version to the version chain of a tuple. */
+  void AppendVersion(const RID &rid, const Tuple &tuple, timestamp_t begin_ts, timestamp_t end_ts);
+
+  /** @return whether the transaction has written the tuple, according to its write set */
+  auto HasWritten(Transaction *txn, const RID &rid) -> bool;
+
+  /** @return whether another transaction is writing the tuple, the page must be latched */
+  auto IsLockedByOther(TablePage *page, const RID &rid, Transaction *txn) -> bool;
+
+  /** The bit of a version word that is set while a transaction writes the tuple. */
+  static constexpr uint64_t VERSION_LOCK_BIT = 1ULL << 63;
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  /** The epoch of the timestamps this table heap stamps on its pages, unique to it */
+  uint32_t epoch_;
+  /** The replaced versions of the tuples, oldest first */
+  std::unordered_map<RID, std::vector<TupleVersion>> version_chains_;
+  std::mutex version_chains_latch_;
 };
 
 }  // namespace bustub
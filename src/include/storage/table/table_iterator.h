@@ -14,6 +14,7 @@
 
 #include <cassert>
 
+#include "buffer/buffer_access_strategy.h"
 #include "common/rid.h"
 #include "concurrency/transaction.h"
 #include "storage/table/tuple.h"
@@ -29,10 +30,14 @@ class TableIterator {
   friend class Cursor;
 
  public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        txn_(other.txn_),
+        strategy_(other.strategy_),
+        read_ahead_until_(other.read_ahead_until_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -54,13 +59,26 @@ class TableIterator {
     table_heap_ = other.table_heap_;
     *tuple_ = *other.tuple_;
     txn_ = other.txn_;
+    strategy_ = other.strategy_;
+    read_ahead_until_ = other.read_ahead_until_;
     return *this;
   }
 
  private:
+  /**
+   * Ask the buffer pool to prefetch the pages after the given one, if the pages already asked for run low. Table heaps
+   * allocate their pages in increasing id order, so the next pages of a scan usually are the next page ids.
+   * @param next_page_id the page the scan moves to
+   */
+  void ReadAhead(page_id_t next_page_id);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** Access strategy the pages of the scan are fetched with, nullptr for plain fetches. */
+  BufferAccessStrategy *strategy_;
+  /** End (exclusive) of the pages asked to be prefetched so far. */
+  page_id_t read_ahead_until_{0};
 };
 
 }  // namespace bustub
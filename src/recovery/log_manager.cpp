@@ -12,6 +12,12 @@
 
 #include "recovery/log_manager.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "common/macros.h"
+#include "common/util/coding_util.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +28,260 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::scoped_lock lock(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  enable_flush_ = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock lock(latch_);
+    while (enable_flush_) {
+      flush_cv_.wait_for(lock, log_timeout, [this] { return flush_requested_ || !enable_flush_; });
+      flush_requested_ = false;
+      lock.unlock();
+      Flush();
+      lock.lock();
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::scoped_lock lock(latch_);
+    flush_thread = flush_thread_;
+    flush_thread_ = nullptr;
+    enable_flush_ = false;
+  }
+  if (flush_thread == nullptr) {
+    return;
+  }
+  flush_cv_.notify_all();
+  // wake up the appenders waiting for space, they flush by themselves from now on
+  cv_.notify_all();
+  flush_thread->join();
+  delete flush_thread;
+  // the log records appended while the thread was stopping
+  Flush();
+  enable_logging = false;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t { return INVALID_LSN; }
+auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t {
+  // the size before the LSN is known is an upper bound
+  BUSTUB_ASSERT(log_record->size_ <= LOG_BUFFER_SIZE, "log record does not fit into the log buffer");
+
+  // reserve the LSN and the space together, so that the log records in a buffer are in LSN order
+  uint64_t state = reserve_state_.load();
+  uint64_t size;
+  while (true) {
+    // the LSN is a varint in the header, the size depends on it
+    size = static_cast<uint64_t>(log_record->GetSizeForLSN(static_cast<lsn_t>(ReserveLSN(state))));
+    if (ReserveOffset(state) + size > static_cast<uint64_t>(LOG_BUFFER_SIZE)) {
+      WaitForSpace(size);
+      state = reserve_state_.load();
+      continue;
+    }
+    uint64_t reserved = PackReserveState(ReserveLSN(state) + 1, ReserveBufferIndex(state), ReserveOffset(state) + size);
+    if (reserve_state_.compare_exchange_weak(state, reserved)) {
+      break;
+    }
+  }
+
+  // the buffer is not written out before it is filled up to its reserved offset, which includes this record
+  log_record->lsn_ = ReserveLSN(state);
+  log_record->size_ = static_cast<int32_t>(size);
+  uint64_t buffer_index = ReserveBufferIndex(state);
+  SerializeLogRecord(*log_record, GetBuffer(buffer_index) + ReserveOffset(state));
+  filled_[buffer_index].fetch_add(size);
+  return log_record->lsn_;
+}
+
+void LogManager::SerializeLogRecord(const LogRecord &log_record, char *dest) {
+  // the checksum goes in front once everything after it is written
+  char *pos = dest + LogRecord::CHECKSUM_SIZE;
+  auto put_varint = [&pos](auto value) { pos += CodingUtil::PutVarint(pos, static_cast<uint32_t>(value)); };
+  auto put_rid = [&put_varint](const RID &rid) {
+    put_varint(rid.GetPageId());
+    put_varint(rid.GetSlotNum());
+  };
+  auto put_bytes = [&pos, &put_varint](const char *data, uint32_t size) {
+    put_varint(size);
+    memcpy(pos, data, size);
+    pos += size;
+  };
+  put_varint(log_record.size_);
+  put_varint(log_record.lsn_);
+  put_varint(log_record.txn_id_);
+  put_varint(log_record.GetPrevLSNDelta(log_record.lsn_));
+  *pos++ = static_cast<char>(log_record.log_record_type_);
+
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      put_rid(log_record.insert_rid_);
+      log_record.insert_tuple_.SerializeTo(pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      put_rid(log_record.delete_rid_);
+      log_record.delete_tuple_.SerializeTo(pos);
+      break;
+    case LogRecordType::UPDATE: {
+      put_rid(log_record.update_rid_);
+      uint32_t prefix = log_record.update_prefix_;
+      uint32_t suffix = log_record.update_suffix_;
+      put_varint(prefix);
+      put_varint(suffix);
+      put_bytes(log_record.old_tuple_.GetData() + prefix, log_record.old_tuple_.GetLength() - prefix - suffix);
+      put_bytes(log_record.new_tuple_.GetData() + prefix, log_record.new_tuple_.GetLength() - prefix - suffix);
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      put_varint(log_record.prev_page_id_);
+      put_varint(log_record.page_id_);
+      break;
+    case LogRecordType::END_CHECKPOINT:
+      put_varint(log_record.scan_start_);
+      put_varint(log_record.active_txns_.size());
+      for (const auto &[txn_id, first_lsn] : log_record.active_txns_) {
+        put_varint(txn_id);
+        put_varint(first_lsn);
+      }
+      put_varint(log_record.dirty_pages_.size());
+      for (const auto &[page_id, rec_lsn] : log_record.dirty_pages_) {
+        put_varint(page_id);
+        put_varint(rec_lsn);
+      }
+      break;
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+      put_varint(log_record.page_id_);
+      put_varint(log_record.index_slot_);
+      put_bytes(log_record.index_entry_.data(), log_record.index_entry_.size());
+      if (log_record.log_record_type_ == LogRecordType::BTREE_DELETE) {
+        put_bytes(log_record.index_neighbor_entry_.data(), log_record.index_neighbor_entry_.size());
+      }
+      break;
+    case LogRecordType::BTREE_SPLIT:
+    case LogRecordType::BTREE_MERGE:
+      put_varint(log_record.index_changes_.size());
+      for (const auto &change : log_record.index_changes_) {
+        *pos++ = static_cast<char>(change.kind_);
+        put_varint(change.page_id_);
+        put_varint(change.value_);
+        put_bytes(change.data_.data(), change.data_.size());
+      }
+      break;
+    default:
+      break;
+  }
+
+  auto checked_size = static_cast<size_t>(log_record.size_ - LogRecord::CHECKSUM_SIZE);
+  uint32_t checksum = CodingUtil::Crc32c(dest + LogRecord::CHECKSUM_SIZE, checked_size);
+  memcpy(dest, &checksum, sizeof(uint32_t));
+}
+
+void LogManager::WaitForSpace(uint64_t size) {
+  auto fits = [this, size] { return ReserveOffset(reserve_state_.load()) + size <= LOG_BUFFER_SIZE; };
+  {
+    std::unique_lock lock(latch_);
+    if (enable_flush_) {
+      // let the flush thread swap the buffers
+      flush_requested_ = true;
+      flush_cv_.notify_one();
+      cv_.wait(lock, [&] { return fits() || !enable_flush_; });
+      return;
+    }
+  }
+  std::scoped_lock flush_lock(flush_latch_);
+  if (!fits()) {
+    FlushActiveBuffer();
+  }
+}
+
+void LogManager::Flush() {
+  std::scoped_lock flush_lock(flush_latch_);
+  FlushActiveBuffer();
+}
+
+void LogManager::FlushActiveBuffer() {
+  // seal the active buffer by making the other one active, it was written out by the previous flush
+  uint64_t state = reserve_state_.load();
+  do {
+    if (ReserveOffset(state) == 0) {
+      return;
+    }
+  } while (!reserve_state_.compare_exchange_weak(
+      state, PackReserveState(ReserveLSN(state), 1 - ReserveBufferIndex(state), 0)));
+  {
+    std::scoped_lock lock(latch_);
+  }
+  cv_.notify_all();
+
+  // wait for the appenders that reserved space in the sealed buffer but still copy their records into it
+  uint64_t buffer_index = ReserveBufferIndex(state);
+  uint64_t size = ReserveOffset(state);
+  while (filled_[buffer_index].load() != size) {
+    std::this_thread::yield();
+  }
+
+  disk_manager_->WriteLog(GetBuffer(buffer_index), static_cast<int>(size));
+  filled_[buffer_index] = 0;
+  num_log_writes_ += 1;
+  {
+    std::scoped_lock lock(latch_);
+    write_offsets_.emplace_back(persistent_lsn_ + 1, log_size_);
+    log_size_ += static_cast<int>(size);
+    persistent_lsn_ = ReserveLSN(state) - 1;
+  }
+  cv_.notify_all();
+}
+
+auto LogManager::GetLogOffset(lsn_t lsn) -> int {
+  std::scoped_lock lock(latch_);
+  if (lsn > persistent_lsn_ || write_offsets_.empty() || lsn < write_offsets_.front().first) {
+    return -1;
+  }
+  // the last write that starts at or before the LSN
+  auto write = std::upper_bound(write_offsets_.begin(), write_offsets_.end(), lsn,
+                                [](lsn_t lsn, const std::pair<lsn_t, int> &write) { return lsn < write.first; });
+  return std::prev(write)->second;
+}
+
+void LogManager::ForgetLogOffsetsBefore(lsn_t lsn) {
+  std::scoped_lock lock(latch_);
+  // keep the write that holds the LSN
+  while (write_offsets_.size() > 1 && write_offsets_[1].first <= lsn) {
+    write_offsets_.pop_front();
+  }
+}
+
+void LogManager::WaitForFlush(lsn_t lsn) {
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  {
+    std::unique_lock lock(latch_);
+    if (enable_flush_) {
+      flush_requested_ = true;
+      flush_cv_.notify_one();
+      cv_.wait(lock, [&] { return persistent_lsn_ >= lsn || !enable_flush_; });
+      if (persistent_lsn_ >= lsn) {
+        return;
+      }
+    }
+  }
+  Flush();
+}
 
 }  // namespace bustub
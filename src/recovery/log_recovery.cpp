@@ -12,15 +12,318 @@
 
 #include "recovery/log_recovery.h"
 
+#include <cstring>
+#include <exception>
+#include <future>  // NOLINT
+#include <memory>
+#include <queue>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "common/exception.h"
+#include "common/macros.h"
+#include "recovery/checkpoint_manager.h"
+#include "storage/page/b_plus_tree_internal_page.h"
+#include "storage/page/b_plus_tree_leaf_page.h"
+#include "storage/page/header_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+namespace {
+
+/** @return a tuple with a copy of the data */
+auto MakeTuple(const char *data, uint32_t size) -> Tuple {
+  std::vector<char> storage(sizeof(int32_t) + size);
+  memcpy(storage.data(), &size, sizeof(int32_t));
+  memcpy(storage.data() + sizeof(int32_t), data, size);
+  Tuple tuple;
+  tuple.DeserializeFrom(storage.data());
+  return tuple;
+}
+
+/**
+ * The entries of a B+ tree leaf page as bytes, as the log does not know the types of keys and values. They follow the
+ * header of the page, each as big as the entries in the log records.
+ */
+class LeafEntries {
+ public:
+  LeafEntries(char *data, size_t entry_size)
+      : data_(data), page_(reinterpret_cast<BPlusTreePage *>(data)), entry_size_(entry_size) {}
+
+  auto IsLeaf() const -> bool { return page_->IsLeafPage(); }
+
+  auto GetSize() const -> int { return page_->GetSize(); }
+
+  auto GetNextPageId() const -> page_id_t {
+    page_id_t next_page_id;
+    memcpy(&next_page_id, data_ + NEXT_PAGE_ID_OFFSET, sizeof(page_id_t));
+    return next_page_id;
+  }
+
+  /** @return the slot of the entry, -1 if the page does not have it */
+  auto Find(const std::string &entry) const -> int {
+    for (int slot = 0; slot < GetSize(); slot++) {
+      if (memcmp(Entry(slot), entry.data(), entry_size_) == 0) {
+        return slot;
+      }
+    }
+    return -1;
+  }
+
+  void Insert(int slot, const std::string &entry) {
+    if (slot < 0 || slot > GetSize() || Entry(GetSize() + 1) > data_ + BUSTUB_PAGE_SIZE) {
+      throw Exception("a B+ tree insert does not match the page");
+    }
+    memmove(Entry(slot + 1), Entry(slot), (GetSize() - slot) * entry_size_);
+    memcpy(Entry(slot), entry.data(), entry_size_);
+    page_->IncreaseSize(1);
+  }
+
+  void Remove(int slot) {
+    if (slot < 0 || slot >= GetSize()) {
+      throw Exception("a B+ tree delete does not match the page");
+    }
+    memmove(Entry(slot), Entry(slot + 1), (GetSize() - slot - 1) * entry_size_);
+    page_->IncreaseSize(-1);
+  }
+
+ private:
+  /** The next page id is the last field of the leaf page header. */
+  static constexpr size_t NEXT_PAGE_ID_OFFSET = LEAF_PAGE_HEADER_SIZE - sizeof(page_id_t);
+
+  auto Entry(int slot) const -> char * { return data_ + LEAF_PAGE_HEADER_SIZE + slot * entry_size_; }
+
+  char *data_;
+  BPlusTreePage *page_;
+  size_t entry_size_;
+};
+
+}  // namespace
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
- * incomplete log record
+ * incomplete or corrupt log record
  */
-auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool { return false; }
+auto LogRecovery::DeserializeLogRecord(const char *data, int size, LogRecord *log_record) -> bool {
+  return ParseLogRecord(data, size, log_record, true, true) && log_record->size_ <= size;
+}
+
+auto LogRecovery::DeserializeLogRecordHeader(const char *data, int size, LogRecord *log_record) -> bool {
+  return ParseLogRecord(data, size, log_record, false, true);
+}
+
+auto LogRecovery::ParseLogRecord(const char *data, int size, LogRecord *log_record, bool with_body,
+                                 bool verify_checksum) -> bool {
+  const char *pos = data + LogRecord::CHECKSUM_SIZE;
+  const char *end = data + size;
+  auto get_varint = [&pos, &end](auto *value) {
+    uint32_t varint;
+    if (!CodingUtil::GetVarint(&pos, end, &varint)) {
+      return false;
+    }
+    *value = static_cast<std::remove_pointer_t<decltype(value)>>(varint);
+    return true;
+  };
+  auto get_rid = [&get_varint](RID *rid) {
+    page_id_t page_id;
+    uint32_t slot_num;
+    if (!get_varint(&page_id) || !get_varint(&slot_num)) {
+      return false;
+    }
+    rid->Set(page_id, slot_num);
+    return true;
+  };
+  auto get_tuple = [&pos, &end](Tuple *tuple) {
+    int32_t tuple_size;
+    if (end - pos < static_cast<int>(sizeof(int32_t))) {
+      return false;
+    }
+    memcpy(&tuple_size, pos, sizeof(int32_t));
+    if (tuple_size < 0 || end - pos - static_cast<int>(sizeof(int32_t)) < tuple_size) {
+      return false;
+    }
+    tuple->DeserializeFrom(pos);
+    pos += sizeof(int32_t) + tuple_size;
+    return true;
+  };
+  auto get_bytes = [&pos, &end, &get_varint](Tuple *tuple) {
+    uint32_t bytes_size;
+    if (!get_varint(&bytes_size) || static_cast<uint32_t>(end - pos) < bytes_size) {
+      return false;
+    }
+    *tuple = MakeTuple(pos, bytes_size);
+    pos += bytes_size;
+    return true;
+  };
+  auto get_string = [&pos, &end, &get_varint](std::string *bytes) {
+    uint32_t bytes_size;
+    if (!get_varint(&bytes_size) || static_cast<uint32_t>(end - pos) < bytes_size) {
+      return false;
+    }
+    bytes->assign(pos, bytes_size);
+    pos += bytes_size;
+    return true;
+  };
+
+  // the header: checksum, size, LSN, transaction id, previous LSN and type
+  if (size < LogRecord::CHECKSUM_SIZE || !get_varint(&log_record->size_) ||
+      log_record->size_ < LogRecord::MIN_HEADER_SIZE || log_record->size_ > LOG_BUFFER_SIZE) {
+    return false;
+  }
+  if (log_record->size_ > size) {
+    // incomplete, only the size is known
+    return true;
+  }
+  end = data + log_record->size_;
+  uint32_t checksum;
+  memcpy(&checksum, data, sizeof(uint32_t));
+  if (verify_checksum && checksum != CodingUtil::Crc32c(data + LogRecord::CHECKSUM_SIZE,
+                                                        log_record->size_ - LogRecord::CHECKSUM_SIZE)) {
+    return false;
+  }
+  uint32_t prev_lsn_delta;
+  if (!get_varint(&log_record->lsn_) || !get_varint(&log_record->txn_id_) || !get_varint(&prev_lsn_delta) ||
+      pos == end || log_record->lsn_ < 0) {
+    return false;
+  }
+  log_record->prev_lsn_ = prev_lsn_delta == 0 ? INVALID_LSN : log_record->lsn_ - static_cast<lsn_t>(prev_lsn_delta);
+  log_record->log_record_type_ = static_cast<LogRecordType>(static_cast<uint8_t>(*pos++));
+
+  // the ids of the pages the record changes, then the rest of the body
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      return get_rid(&log_record->insert_rid_) && (!with_body || get_tuple(&log_record->insert_tuple_));
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return get_rid(&log_record->delete_rid_) && (!with_body || get_tuple(&log_record->delete_tuple_));
+    case LogRecordType::UPDATE:
+      return get_rid(&log_record->update_rid_) &&
+             (!with_body || (get_varint(&log_record->update_prefix_) && get_varint(&log_record->update_suffix_) &&
+                             get_bytes(&log_record->old_tuple_) && get_bytes(&log_record->new_tuple_)));
+    case LogRecordType::NEWPAGE:
+      return get_varint(&log_record->prev_page_id_) && get_varint(&log_record->page_id_);
+    case LogRecordType::BEGIN:
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+    case LogRecordType::BEGIN_CHECKPOINT:
+      return true;
+    case LogRecordType::END_CHECKPOINT: {
+      if (!with_body) {
+        return true;
+      }
+      uint32_t num_txns;
+      if (!get_varint(&log_record->scan_start_) || !get_varint(&num_txns)) {
+        return false;
+      }
+      log_record->active_txns_.clear();
+      for (uint32_t i = 0; i < num_txns; i++) {
+        auto &[txn_id, first_lsn] = log_record->active_txns_.emplace_back();
+        if (!get_varint(&txn_id) || !get_varint(&first_lsn)) {
+          return false;
+        }
+      }
+      uint32_t num_pages;
+      if (!get_varint(&num_pages)) {
+        return false;
+      }
+      log_record->dirty_pages_.clear();
+      for (uint32_t i = 0; i < num_pages; i++) {
+        auto &[page_id, rec_lsn] = log_record->dirty_pages_.emplace_back();
+        if (!get_varint(&page_id) || !get_varint(&rec_lsn)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case LogRecordType::BTREE_INSERT:
+      return get_varint(&log_record->page_id_) && get_varint(&log_record->index_slot_) &&
+             (!with_body || get_string(&log_record->index_entry_));
+    case LogRecordType::BTREE_DELETE:
+      return get_varint(&log_record->page_id_) && get_varint(&log_record->index_slot_) &&
+             (!with_body || (get_string(&log_record->index_entry_) && get_string(&log_record->index_neighbor_entry_)));
+    case LogRecordType::BTREE_SPLIT:
+    case LogRecordType::BTREE_MERGE: {
+      // the pages are needed to dispatch the record, so the body is always read
+      uint32_t num_changes;
+      if (!get_varint(&num_changes)) {
+        return false;
+      }
+      log_record->index_changes_.clear();
+      for (uint32_t i = 0; i < num_changes; i++) {
+        if (pos == end) {
+          return false;
+        }
+        auto &change = log_record->index_changes_.emplace_back();
+        change.kind_ = static_cast<IndexPageChange::Kind>(static_cast<uint8_t>(*pos++));
+        if (change.kind_ > IndexPageChange::Kind::ROOT || !get_varint(&change.page_id_) ||
+            !get_varint(&change.value_) || !get_string(&change.data_)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+auto LogRecovery::SpliceTuple(const Tuple &tuple, uint32_t prefix, uint32_t suffix, const Tuple &middle) -> Tuple {
+  if (prefix + suffix > tuple.GetLength()) {
+    throw Exception("an update does not match the tuple on the page");
+  }
+  std::vector<char> data(prefix + middle.GetLength() + suffix);
+  memcpy(data.data(), tuple.GetData(), prefix);
+  memcpy(data.data() + prefix, middle.GetData(), middle.GetLength());
+  memcpy(data.data() + prefix + middle.GetLength(), tuple.GetData() + tuple.GetLength() - suffix, suffix);
+  return MakeTuple(data.data(), data.size());
+}
+
+void LogRecovery::ReadLastCheckpoint() {
+  checkpoint_lsn_ = INVALID_LSN;
+  dirty_pages_.clear();
+  scan_start_ = 0;
+  MasterRecord master_record;
+  if (!disk_manager_->ReadMasterRecord(reinterpret_cast<char *>(&master_record), sizeof(MasterRecord))) {
+    return;
+  }
+  // the end checkpoint record is in the log write the master record points to, which fits into a log buffer
+  std::vector<char> log_write(LOG_BUFFER_SIZE);
+  if (!disk_manager_->ReadLog(log_write.data(), LOG_BUFFER_SIZE, master_record.end_checkpoint_offset_)) {
+    return;
+  }
+  LogRecord log_record;
+  int pos = 0;
+  while (true) {
+    if (!DeserializeLogRecordHeader(log_write.data() + pos, LOG_BUFFER_SIZE - pos, &log_record) ||
+        pos + log_record.size_ > LOG_BUFFER_SIZE) {
+      // not there after all, reading the whole log is always correct
+      return;
+    }
+    if (log_record.lsn_ == master_record.end_checkpoint_lsn_ &&
+        log_record.log_record_type_ == LogRecordType::END_CHECKPOINT) {
+      break;
+    }
+    pos += log_record.size_;
+  }
+  if (!DeserializeLogRecord(log_write.data() + pos, LOG_BUFFER_SIZE - pos, &log_record)) {
+    return;
+  }
+  checkpoint_lsn_ = log_record.prev_lsn_;
+  scan_start_ = log_record.scan_start_;
+  dirty_pages_.insert(log_record.dirty_pages_.begin(), log_record.dirty_pages_.end());
+}
+
+auto LogRecovery::NeedsRedo(page_id_t page_id, lsn_t lsn) const -> bool {
+  if (lsn >= checkpoint_lsn_) {
+    return true;
+  }
+  // before the checkpoint, only the pages in its dirty page table can miss changes, from their recLSN on
+  auto dirty_page = dirty_pages_.find(page_id);
+  return dirty_page != dirty_pages_.end() && dirty_page->second <= lsn;
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +332,511 @@ auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  BUSTUB_ASSERT(!enable_logging, "Recovery must not be logged.");
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  next_lsn_ = 0;
+  // everything that has to be redone or may have to be undone comes after the scan start of the last checkpoint
+  ReadLastCheckpoint();
+  offset_ = scan_start_;
+
+  // While the workers redo the log records in a chunk of the log, the next chunk is read ahead in the background.
+  std::vector<std::thread> workers;
+  std::vector<std::exception_ptr> errors(num_redo_workers_);
+  auto join_workers = [&] {
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+    for (auto &error : errors) {
+      if (error != nullptr) {
+        std::rethrow_exception(error);
+      }
+    }
+  };
+
+  const int log_size = disk_manager_->GetLogSize();
+  auto read_ahead = [this, log_size](int offset) {
+    return std::async(std::launch::async, [this, log_size, offset] {
+      std::vector<char> data(std::min(REDO_CHUNK_SIZE, log_size - offset));
+      disk_manager_->ReadLog(data.data(), static_cast<int>(data.size()), offset);
+      return data;
+    });
+  };
+  int read_offset = offset_;
+  std::future<std::vector<char>> next_read;
+  if (read_offset < log_size) {
+    next_read = read_ahead(read_offset);
+  }
+  // the start of a record that continues in the next read, it is put in front of it
+  std::vector<char> carry;
+  bool end_of_log = false;
+  while (!end_of_log && next_read.valid()) {
+    std::vector<char> data = next_read.get();
+    read_offset += static_cast<int>(data.size());
+    const bool last_chunk = read_offset == log_size;
+    if (!last_chunk) {
+      next_read = read_ahead(read_offset);
+    }
+    if (carry.empty()) {
+      carry = std::move(data);
+    } else {
+      carry.insert(carry.end(), data.begin(), data.end());
+    }
+    auto chunk = std::make_shared<std::vector<char>>(std::move(carry));
+
+    // Only the headers are read here, the workers deserialize the records they redo.
+    std::vector<std::vector<int>> positions(num_redo_workers_);
+    int pos = 0;
+    LogRecord log_record;
+    const auto chunk_size = static_cast<int>(chunk->size());
+    while (pos < chunk_size) {
+      if (!last_chunk && chunk_size - pos < LogRecord::MAX_HEADER_SIZE) {
+        // the header may continue in the next chunk
+        break;
+      }
+      if (!DeserializeLogRecordHeader(chunk->data() + pos, chunk_size - pos, &log_record)) {
+        // the end of the log, or a record that was torn by the crash
+        end_of_log = true;
+        break;
+      }
+      if (pos + log_record.size_ > chunk_size) {
+        // the record continues in the next chunk, or was only partly written before the crash if there is none
+        end_of_log = last_chunk;
+        break;
+      }
+      next_lsn_ = std::max(next_lsn_, log_record.lsn_ + 1);
+
+      txn_id_t txn_id = log_record.txn_id_;
+      if (txn_id == INVALID_TXN_ID) {
+        // not part of any transaction, like checkpoints and B+ tree structure modifications
+      } else if (log_record.log_record_type_ == LogRecordType::COMMIT ||
+          log_record.log_record_type_ == LogRecordType::ABORT) {
+        // the transaction is done, it is not undone
+        auto it = active_txn_.find(txn_id);
+        if (it != active_txn_.end()) {
+          for (lsn_t lsn = it->second; lsn != INVALID_LSN;) {
+            auto entry = lsn_mapping_.find(lsn);
+            if (entry == lsn_mapping_.end()) {
+              break;
+            }
+            lsn = entry->second.prev_lsn_;
+            lsn_mapping_.erase(entry);
+          }
+          active_txn_.erase(it);
+        }
+      } else {
+        active_txn_[txn_id] = log_record.lsn_;
+        lsn_mapping_[log_record.lsn_] = {offset_ + pos, log_record.prev_lsn_};
+      }
+
+      page_id_t page_id = GetChangedPageId(log_record);
+      bool redo_page = page_id != INVALID_PAGE_ID && NeedsRedo(page_id, log_record.lsn_);
+      if (redo_page) {
+        positions[RedoWorker(page_id)].push_back(pos);
+      }
+      // a B+ tree structure modification goes to every worker that owns one of its pages
+      std::vector<bool> index_workers(num_redo_workers_);
+      if (log_record.log_record_type_ != LogRecordType::BTREE_SPLIT &&
+          log_record.log_record_type_ != LogRecordType::BTREE_MERGE) {
+        log_record.index_changes_.clear();
+      }
+      for (const auto &change : log_record.index_changes_) {
+        size_t worker = RedoWorker(change.page_id_);
+        if (!index_workers[worker] && NeedsRedo(change.page_id_, log_record.lsn_)) {
+          index_workers[worker] = true;
+          positions[worker].push_back(pos);
+        }
+      }
+      // a new page is linked to its previous page, which may belong to another worker
+      if (log_record.log_record_type_ == LogRecordType::NEWPAGE && log_record.prev_page_id_ != INVALID_PAGE_ID &&
+          NeedsRedo(log_record.prev_page_id_, log_record.lsn_) &&
+          (!redo_page || RedoWorker(log_record.prev_page_id_) != RedoWorker(page_id))) {
+        positions[RedoWorker(log_record.prev_page_id_)].push_back(pos);
+      }
+      pos += log_record.size_;
+    }
+
+    join_workers();
+    for (size_t i = 0; i < num_redo_workers_; i++) {
+      workers.emplace_back([this, i, chunk, &errors, chunk_positions = std::move(positions[i])] {
+        try {
+          RedoLogRecords(i, *chunk, chunk_positions);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+    offset_ += pos;
+    carry.assign(chunk->begin() + pos, chunk->end());
+  }
+  join_workers();
+
+  if (log_manager_ != nullptr) {
+    // the log ends with the last complete log record, offset_ is right after it
+    disk_manager_->TruncateLogTail(offset_);
+    log_manager_->SetNextLSN(next_lsn_);
+  }
+}
+
+auto LogRecovery::GetChangedPageId(const LogRecord &log_record) -> page_id_t {
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      return log_record.insert_rid_.GetPageId();
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return log_record.delete_rid_.GetPageId();
+    case LogRecordType::UPDATE:
+      return log_record.update_rid_.GetPageId();
+    case LogRecordType::NEWPAGE:
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+      return log_record.page_id_;
+    default:
+      // B+ tree structure modifications change more than one page
+      return INVALID_PAGE_ID;
+  }
+}
+
+void LogRecovery::RedoLogRecords(size_t worker, const std::vector<char> &chunk, const std::vector<int> &positions) {
+  for (int pos : positions) {
+    // the checksum was verified when the chunk was read
+    LogRecord log_record;
+    ParseLogRecord(chunk.data() + pos, static_cast<int>(chunk.size()) - pos, &log_record, true, false);
+    RedoLogRecord(worker, log_record);
+  }
+}
+
+void LogRecovery::RedoLogRecord(size_t worker, const LogRecord &log_record) {
+  if (log_record.log_record_type_ == LogRecordType::BTREE_SPLIT ||
+      log_record.log_record_type_ == LogRecordType::BTREE_MERGE) {
+    RedoIndexChanges(worker, log_record);
+    return;
+  }
+  if (log_record.log_record_type_ == LogRecordType::NEWPAGE && log_record.prev_page_id_ != INVALID_PAGE_ID &&
+      RedoWorker(log_record.prev_page_id_) == worker && NeedsRedo(log_record.prev_page_id_, log_record.lsn_)) {
+    // the link from the previous page is not logged by itself, setting it again does no harm
+    auto *prev_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(log_record.prev_page_id_));
+    if (prev_page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to redo a page in");
+    }
+    prev_page->WLatch();
+    bool is_dirty = prev_page->GetNextPageId() != log_record.page_id_;
+    if (is_dirty) {
+      prev_page->SetNextPageId(log_record.page_id_);
+    }
+    prev_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(log_record.prev_page_id_, is_dirty);
+  }
+
+  page_id_t page_id = GetChangedPageId(log_record);
+  if (RedoWorker(page_id) != worker || !NeedsRedo(page_id, log_record.lsn_)) {
+    return;
+  }
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to redo a page in");
+  }
+  page->WLatch();
+  // a page that was written after the change already has it. Initializing a page is redone even if the page has the
+  // LSN of its initialization and no later one, which does no harm, as a fresh page has LSN 0 like the first record.
+  bool is_dirty = page->GetLSN() < log_record.lsn_ ||
+                  (log_record.log_record_type_ == LogRecordType::NEWPAGE && page->GetLSN() == log_record.lsn_);
+  if (is_dirty) {
+    Tuple old_tuple;
+    switch (log_record.log_record_type_) {
+      case LogRecordType::INSERT:
+        page->InsertTupleAt(log_record.insert_tuple_, log_record.insert_rid_);
+        break;
+      case LogRecordType::MARKDELETE:
+        page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE:
+        page->ApplyDelete(log_record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE:
+        // the tuple on the page is the old tuple, as the changes to the page before are redone
+        page->GetTuple(log_record.update_rid_, &old_tuple, nullptr, nullptr);
+        page->UpdateTuple(
+            SpliceTuple(old_tuple, log_record.update_prefix_, log_record.update_suffix_, log_record.new_tuple_),
+            &old_tuple, log_record.update_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::NEWPAGE:
+        page->Init(page_id, BUSTUB_PAGE_SIZE, log_record.prev_page_id_, nullptr, nullptr);
+        break;
+      case LogRecordType::BTREE_INSERT:
+        LeafEntries(page->GetData(), log_record.index_entry_.size())
+            .Insert(log_record.index_slot_, log_record.index_entry_);
+        break;
+      case LogRecordType::BTREE_DELETE:
+        LeafEntries(page->GetData(), log_record.index_entry_.size()).Remove(log_record.index_slot_);
+        break;
+      default:
+        break;
+    }
+    page->SetLSN(log_record.lsn_);
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, is_dirty);
+}
+
+void LogRecovery::RedoIndexChanges(size_t worker, const LogRecord &log_record) {
+  for (const auto &change : log_record.index_changes_) {
+    if (RedoWorker(change.page_id_) != worker || !NeedsRedo(change.page_id_, log_record.lsn_)) {
+      continue;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(change.page_id_);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to redo a page in");
+    }
+    page->WLatch();
+    // the changes are idempotent, the LSN only keeps a page from going back to an older state
+    bool is_dirty = change.kind_ == IndexPageChange::Kind::ROOT || page->GetLSN() <= log_record.lsn_;
+    if (is_dirty) {
+      switch (change.kind_) {
+        case IndexPageChange::Kind::IMAGE:
+          memcpy(page->GetData(), change.data_.data(), change.data_.size());
+          page->SetLSN(log_record.lsn_);
+          break;
+        case IndexPageChange::Kind::PARENT:
+          reinterpret_cast<BPlusTreePage *>(page->GetData())->SetParentPageId(change.value_);
+          page->SetLSN(log_record.lsn_);
+          break;
+        case IndexPageChange::Kind::ROOT: {
+          // the header page has no LSN, records are set to their latest root page id in LSN order
+          auto *header_page = static_cast<HeaderPage *>(page);
+          if (change.value_ == INVALID_PAGE_ID) {
+            header_page->DeleteRecord(change.data_);
+          } else if (!header_page->UpdateRecord(change.data_, change.value_)) {
+            header_page->InsertRecord(change.data_, change.value_);
+          }
+          break;
+        }
+      }
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(change.page_id_, is_dirty);
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  BUSTUB_ASSERT(!enable_logging, "Recovery must not be logged.");
+  // roll back the changes of all active transactions together, newest first
+  std::priority_queue<lsn_t> undo_lsns;
+  for (const auto &[txn_id, lsn] : active_txn_) {
+    undo_lsns.push(lsn);
+  }
+
+  while (!undo_lsns.empty()) {
+    lsn_t lsn = undo_lsns.top();
+    undo_lsns.pop();
+    auto entry = lsn_mapping_.find(lsn);
+    if (entry == lsn_mapping_.end()) {
+      continue;
+    }
+    // a log record is never bigger than the log buffer, its header tells its size
+    LogRecord log_record;
+    if (!disk_manager_->ReadLog(log_buffer_, LogRecord::MAX_HEADER_SIZE, entry->second.offset_) ||
+        !DeserializeLogRecordHeader(log_buffer_, LogRecord::MAX_HEADER_SIZE, &log_record) ||
+        !disk_manager_->ReadLog(log_buffer_, log_record.size_, entry->second.offset_) ||
+        !DeserializeLogRecord(log_buffer_, log_record.size_, &log_record)) {
+      throw Exception("can't read a log record to undo");
+    }
+    UndoLogRecord(log_record);
+    if (entry->second.prev_lsn_ != INVALID_LSN) {
+      undo_lsns.push(entry->second.prev_lsn_);
+    }
+  }
+
+  if (log_manager_ != nullptr && !active_txn_.empty()) {
+    // The rolled back pages are written before the transactions are logged as aborted. From then on, redo does not
+    // bring their changes back and undo does not roll them back again, after later transactions reused their slots.
+    buffer_pool_manager_->FlushAllPages();
+    for (const auto &[txn_id, lsn] : active_txn_) {
+      LogRecord abort_record(txn_id, lsn, LogRecordType::ABORT);
+      log_manager_->AppendLogRecord(&abort_record);
+    }
+    log_manager_->Flush();
+  }
+  active_txn_.clear();
+  lsn_mapping_.clear();
+}
+
+void LogRecovery::UndoLogRecord(const LogRecord &log_record) {
+  if (log_record.log_record_type_ == LogRecordType::BTREE_INSERT ||
+      log_record.log_record_type_ == LogRecordType::BTREE_DELETE) {
+    UndoIndexLogRecord(log_record);
+    return;
+  }
+  page_id_t page_id = GetChangedPageId(log_record);
+  // nothing to undo for a transaction begin, and a new page is left behind empty
+  if (page_id == INVALID_PAGE_ID || log_record.log_record_type_ == LogRecordType::NEWPAGE) {
+    return;
+  }
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to undo a page in");
+  }
+  page->WLatch();
+  Tuple new_tuple;
+  Tuple old_tuple;
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      page->ApplyDelete(log_record.insert_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->InsertTupleAt(log_record.delete_tuple_, log_record.delete_rid_);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE:
+      // the tuple on the page is the new tuple, as the later changes of the transactions are undone
+      page->GetTuple(log_record.update_rid_, &new_tuple, nullptr, nullptr);
+      old_tuple = SpliceTuple(new_tuple, log_record.update_prefix_, log_record.update_suffix_, log_record.old_tuple_);
+      page->UpdateTuple(old_tuple, &new_tuple, log_record.update_rid_, nullptr, nullptr, nullptr);
+      break;
+    default:
+      break;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+auto LogRecovery::FindLeafEntry(page_id_t page_id, const std::string &entry) -> std::pair<page_id_t, int> {
+  // Later splits move entries to the right along the leaf chain, and merges to the page a freed page points to. Only
+  // borrowing from the right sibling moves them to the left, then the whole leaf chain is searched.
+  page_id = ResolveLeafPage(page_id);
+  std::pair<page_id_t, int> found = FindLeafEntryFrom(page_id, entry);
+  if (found.first == INVALID_PAGE_ID) {
+    found = FindLeafEntryFrom(FindLeftmostLeaf(page_id, entry.size()), entry);
+  }
+  return found;
+}
+
+auto LogRecovery::FindLeafEntryFrom(page_id_t page_id, const std::string &entry) -> std::pair<page_id_t, int> {
+  while (page_id != INVALID_PAGE_ID) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to undo a page in");
+    }
+    page->RLatch();
+    LeafEntries leaf(page->GetData(), entry.size());
+    int slot = leaf.IsLeaf() ? leaf.Find(entry) : -1;
+    page_id_t next_page_id = leaf.IsLeaf() ? leaf.GetNextPageId() : INVALID_PAGE_ID;
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    if (slot != -1) {
+      return {page_id, slot};
+    }
+    page_id = next_page_id;
+  }
+  return {INVALID_PAGE_ID, -1};
+}
+
+auto LogRecovery::FindLeftmostLeaf(page_id_t page_id, size_t entry_size) -> page_id_t {
+  // up to the root by the parent page ids, and down by the first child
+  bool at_root = false;
+  while (page_id != INVALID_PAGE_ID) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to undo a page in");
+    }
+    page->RLatch();
+    auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t next_page_id;
+    if (!at_root) {
+      at_root = tree_page->IsRootPage();
+      next_page_id = at_root ? page_id : tree_page->GetParentPageId();
+    } else if (tree_page->IsLeafPage()) {
+      next_page_id = INVALID_PAGE_ID;
+    } else {
+      // The keys are byte arrays, so in an internal page the child page id follows the key right where the record id
+      // follows it in a leaf page.
+      memcpy(&next_page_id, page->GetData() + INTERNAL_PAGE_HEADER_SIZE + entry_size - sizeof(RID), sizeof(page_id_t));
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    if (next_page_id == INVALID_PAGE_ID) {
+      return page_id;
+    }
+    page_id = next_page_id;
+  }
+  return INVALID_PAGE_ID;
+}
+
+auto LogRecovery::ResolveLeafPage(page_id_t page_id) -> page_id_t {
+  while (page_id != INVALID_PAGE_ID) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to undo a page in");
+    }
+    page->RLatch();
+    auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    bool freed = tree_page->GetPageType() == IndexPageType::INVALID_INDEX_PAGE;
+    page_id_t merged_into = tree_page->GetParentPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    if (!freed) {
+      return page_id;
+    }
+    page_id = merged_into;
+  }
+  return INVALID_PAGE_ID;
+}
+
+void LogRecovery::UndoIndexLogRecord(const LogRecord &log_record) {
+  // Undo is page-oriented like for table pages, but the entry may have been moved by structure modifications since.
+  page_id_t page_id;
+  int slot;
+  if (log_record.log_record_type_ == LogRecordType::BTREE_INSERT) {
+    std::tie(page_id, slot) = FindLeafEntry(log_record.page_id_, log_record.index_entry_);
+    if (page_id == INVALID_PAGE_ID) {
+      return;
+    }
+  } else {
+    // the deleted entry goes back beside its neighbor, or to its slot if the neighbor is gone as well
+    page_id = INVALID_PAGE_ID;
+    if (!log_record.index_neighbor_entry_.empty()) {
+      std::tie(page_id, slot) = FindLeafEntry(log_record.page_id_, log_record.index_neighbor_entry_);
+    }
+    if (page_id == INVALID_PAGE_ID) {
+      page_id = ResolveLeafPage(log_record.page_id_);
+      slot = log_record.index_slot_;
+    } else if (log_record.index_slot_ > 0) {
+      slot++;
+    }
+  }
+  if (page_id == INVALID_PAGE_ID) {
+    // the whole tree is gone
+    return;
+  }
+
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "no frame to undo a page in");
+  }
+  page->WLatch();
+  LeafEntries leaf(page->GetData(), log_record.index_entry_.size());
+  if (log_record.log_record_type_ == LogRecordType::BTREE_INSERT) {
+    leaf.Remove(slot);
+  } else {
+    leaf.Insert(std::min(slot, leaf.GetSize()), log_record.index_entry_);
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
 
 }  // namespace bustub
@@ -11,12 +11,17 @@
 //===----------------------------------------------------------------------===//
 
 #include <sys/stat.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -30,24 +35,16 @@ static char *buffer_used;
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
+DiskManager::DiskManager(const std::string &db_file, int log_segment_size)
+    : log_segment_size_(log_segment_size), file_name_(db_file) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
-
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
-  }
+  master_name_ = file_name_.substr(0, n) + ".master";
+  OpenLogSegments();
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
@@ -71,7 +68,10 @@ void DiskManager::ShutDown() {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
   }
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
   log_io_.close();
+  log_read_io_.close();
+  log_read_segment_ = -1;
 }
 
 /**
@@ -122,6 +122,85 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   }
 }
 
+/**
+ * Execute the requests one by one, in the calling thread
+ */
+void DiskManager::Submit(std::vector<DiskRequest> requests) {
+  for (auto &request : requests) {
+    if (request.is_write_) {
+      WritePage(request.page_id_, request.data_);
+    } else {
+      ReadPage(request.page_id_, request.data_);
+    }
+    request.Finish();
+  }
+}
+
+auto DiskManager::WritePageAsync(page_id_t page_id, const char *page_data) -> std::future<void> {
+  std::vector<DiskRequest> requests;
+  // the data of a write is only ever read from
+  requests.push_back({true, const_cast<char *>(page_data), page_id, std::promise<void>()});
+  auto future = requests[0].callback_.get_future();
+  Submit(std::move(requests));
+  return future;
+}
+
+auto DiskManager::ReadPageAsync(page_id_t page_id, char *page_data) -> std::future<void> {
+  std::vector<DiskRequest> requests;
+  requests.push_back({false, page_data, page_id, std::promise<void>()});
+  auto future = requests[0].callback_.get_future();
+  Submit(std::move(requests));
+  return future;
+}
+
+/**
+ * Find the segments of the log by their file names, and open the last one for appending, or create the first one
+ */
+void DiskManager::OpenLogSegments() {
+  namespace fs = std::filesystem;
+  fs::path log_path(log_name_);
+  fs::path log_dir = log_path.has_parent_path() ? log_path.parent_path() : fs::path(".");
+  std::string prefix = log_path.filename().string() + ".";
+  if (fs::exists(log_path)) {
+    log_segments_[0] = log_name_;
+  }
+  std::error_code error;
+  for (const auto &entry : fs::directory_iterator(log_dir, error)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    std::string suffix = name.substr(prefix.size());
+    if (suffix.size() > 10 || suffix.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    int64_t segment_start = std::stoll(suffix);
+    if (segment_start <= INT32_MAX) {
+      log_segments_[static_cast<int>(segment_start)] = entry.path().string();
+    }
+  }
+  if (log_segments_.empty()) {
+    log_segments_[0] = log_name_;
+  }
+
+  const auto &[last_start, last_name] = *log_segments_.rbegin();
+  log_io_.open(last_name, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
+  // directory or file does not exist
+  if (!log_io_.is_open()) {
+    log_io_.clear();
+    // create a new file
+    log_io_.open(last_name, std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
+    if (!log_io_.is_open()) {
+      throw Exception("can't open dblog file");
+    }
+  }
+  log_size_ = last_start + std::max(GetFileSize(last_name), 0);
+}
+
+auto DiskManager::GetLogSegmentName(int segment_start) const -> std::string {
+  return segment_start == 0 ? log_name_ : log_name_ + "." + std::to_string(segment_start);
+}
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
@@ -143,6 +222,16 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  if (!log_segments_.empty() && log_size_ - log_segments_.rbegin()->first >= log_segment_size_) {
+    // the last segment is full, a log write never spans two segments
+    log_io_.close();
+    log_segments_[log_size_] = GetLogSegmentName(log_size_);
+    log_io_.open(log_segments_[log_size_], std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
+    if (!log_io_.is_open()) {
+      throw Exception("can't open dblog file");
+    }
+  }
   // sequence write
   log_io_.write(log_data, size);
 
@@ -153,37 +242,183 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
   // needs to flush to keep disk file in sync
   log_io_.flush();
+  log_size_ += size;
   flush_log_ = false;
 }
 
 /**
- * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
- * @return: false means already reach the end
+ * Read the contents of the log into the given memory area, segment by segment
+ * @return: false means already reach the end, or the offset was truncated
  */
 auto DiskManager::ReadLog(char *log_data, int size, int offset) -> bool {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  if (log_segments_.empty() || offset < log_segments_.begin()->first || offset >= log_size_) {
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
-    return false;
+  int read_count = 0;
+  auto segment = std::prev(log_segments_.upper_bound(offset));
+  while (read_count < size && segment != log_segments_.end()) {
+    auto next_segment = std::next(segment);
+    int segment_end = next_segment == log_segments_.end() ? log_size_ : next_segment->first;
+    int count = std::min(size - read_count, segment_end - (offset + read_count));
+    if (count <= 0) {
+      break;
+    }
+    if (log_read_segment_ != segment->first) {
+      log_read_io_.close();
+      log_read_io_.open(segment->second, std::ios::binary | std::ios::in);
+      if (!log_read_io_.is_open()) {
+        LOG_DEBUG("I/O error while reading log");
+        log_read_segment_ = -1;
+        return false;
+      }
+      log_read_segment_ = segment->first;
+    }
+    log_read_io_.clear();
+    log_read_io_.seekg(offset + read_count - segment->first);
+    log_read_io_.read(log_data + read_count, count);
+    if (log_read_io_.bad()) {
+      LOG_DEBUG("I/O error while reading log");
+      return false;
+    }
+    read_count += log_read_io_.gcount();
+    if (log_read_io_.gcount() < count) {
+      break;
+    }
+    segment = next_segment;
   }
   // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
   if (read_count < size) {
-    log_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
 
   return true;
 }
 
+/**
+ * Returns the size of the log, everything in it was written by WriteLog
+ */
+auto DiskManager::GetLogSize() -> int {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return log_size_;
+}
+
+auto DiskManager::GetLogStart() -> int {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return log_segments_.empty() ? 0 : log_segments_.begin()->first;
+}
+
+auto DiskManager::GetNumLogSegments() -> size_t {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return log_segments_.size();
+}
+
+/**
+ * Delete or archive the segments before the offset, oldest first, so that a crash in between leaves a log without gaps
+ */
+void DiskManager::TruncateLog(int offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  while (log_segments_.size() > 1 && std::next(log_segments_.begin())->first <= offset) {
+    auto segment = log_segments_.begin();
+    if (log_read_segment_ == segment->first) {
+      log_read_io_.close();
+      log_read_segment_ = -1;
+    }
+    std::error_code error;
+    if (log_archive_dir_.empty()) {
+      std::filesystem::remove(segment->second, error);
+    } else {
+      // archived segments are always named by their offset, also the first one
+      std::string archive_name =
+          std::filesystem::path(log_name_).filename().string() + "." + std::to_string(segment->first);
+      std::filesystem::rename(segment->second, std::filesystem::path(log_archive_dir_) / archive_name, error);
+    }
+    if (error) {
+      throw Exception("can't truncate log segment " + segment->second);
+    }
+    log_segments_.erase(segment);
+  }
+}
+
+/**
+ * Delete the segments that start after the offset, and cut the last remaining one at the offset
+ */
+void DiskManager::TruncateLogTail(int offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  if (log_segments_.empty() || offset >= log_size_ || offset < log_segments_.begin()->first) {
+    return;
+  }
+  log_io_.close();
+  log_read_io_.close();
+  log_read_segment_ = -1;
+  std::error_code error;
+  while (log_segments_.rbegin()->first > offset) {
+    auto segment = std::prev(log_segments_.end());
+    std::filesystem::remove(segment->second, error);
+    if (error) {
+      throw Exception("can't truncate log segment " + segment->second);
+    }
+    log_segments_.erase(segment);
+  }
+  const auto &[last_start, last_name] = *log_segments_.rbegin();
+  std::filesystem::resize_file(last_name, offset - last_start, error);
+  if (error) {
+    throw Exception("can't truncate log segment " + last_name);
+  }
+  log_io_.open(last_name, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
+  if (!log_io_.is_open()) {
+    throw Exception("can't open dblog file");
+  }
+  log_size_ = offset;
+}
+
+void DiskManager::SetLogArchiveDirectory(const std::string &archive_dir) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  if (!archive_dir.empty()) {
+    std::error_code error;
+    std::filesystem::create_directories(archive_dir, error);
+    if (error) {
+      throw Exception("can't create log archive directory " + archive_dir);
+    }
+  }
+  log_archive_dir_ = archive_dir;
+}
+
+/**
+ * Write the master record to a temporary file and rename it over the old one, so that a crash leaves either the old
+ * or the new master record behind
+ */
+void DiskManager::WriteMasterRecord(const char *data, int size) {
+  if (master_name_.empty()) {
+    // no files, e.g. an in-memory disk manager
+    return;
+  }
+  std::string tmp_name = master_name_ + ".tmp";
+  {
+    std::ofstream master_io(tmp_name, std::ios::binary | std::ios::trunc | std::ios::out);
+    master_io.write(data, size);
+    master_io.flush();
+    if (master_io.bad()) {
+      throw Exception("can't write master record");
+    }
+  }
+  if (std::rename(tmp_name.c_str(), master_name_.c_str()) != 0) {
+    throw Exception("can't write master record");
+  }
+}
+
+/**
+ * Read the master record, return false if there is none
+ */
+auto DiskManager::ReadMasterRecord(char *data, int size) -> bool {
+  std::ifstream master_io(master_name_, std::ios::binary | std::ios::in);
+  if (!master_io.is_open()) {
+    return false;
+  }
+  master_io.read(data, size);
+  return master_io.gcount() == size;
+}
+
 /**
  * Returns number of flushes made so far
  */
@@ -0,0 +1,331 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_manager_async.cpp
+//
+// Identification: src/storage/disk/disk_manager_async.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_manager_async.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "common/macros.h"
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define BUSTUB_HAS_IO_URING
+#endif
+
+namespace bustub {
+
+DiskManagerAsync::DiskManagerAsync(const std::string &db_file, bool direct_io, size_t queue_depth, bool use_io_uring)
+    : DiskManagerPosix(db_file, direct_io), queue_depth_(queue_depth) {
+  BUSTUB_ASSERT(queue_depth > 0, "queue depth must be positive");
+  if (use_io_uring && SetUpRing()) {
+    slots_.resize(queue_depth_);
+    for (size_t i = queue_depth_; i > 0; i--) {
+      free_slots_.push_back(i - 1);
+    }
+    completion_thread_ = std::thread(&DiskManagerAsync::RunCompletionThread, this);
+    return;
+  }
+  for (size_t i = 0; i < std::min<size_t>(queue_depth_, ASYNC_IO_WORKERS); i++) {
+    workers_.emplace_back(&DiskManagerAsync::RunWorker, this);
+  }
+}
+
+DiskManagerAsync::~DiskManagerAsync() { Stop(); }
+
+void DiskManagerAsync::ShutDown() {
+  Stop();
+  DiskManagerPosix::ShutDown();
+}
+
+void DiskManagerAsync::Submit(std::vector<DiskRequest> requests) {
+  if (UsesIoUring()) {
+    SubmitToRing(&requests);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(latch_);
+  BUSTUB_ASSERT(!stopped_, "disk manager is shut down");
+  for (auto &request : requests) {
+    cv_.wait(lock, [&] { return num_queued_ < queue_depth_; });
+    queue_.push_back(std::move(request));
+    num_queued_++;
+    cv_.notify_all();
+  }
+}
+
+void DiskManagerAsync::RunWorker() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    // drain the queue before stopping
+    cv_.wait(lock, [&] { return stopped_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    DiskRequest request = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    if (request.is_write_) {
+      DiskManagerPosix::WritePage(request.page_id_, request.data_);
+    } else {
+      DiskManagerPosix::ReadPage(request.page_id_, request.data_);
+    }
+    request.Finish();
+
+    lock.lock();
+    num_queued_--;
+    cv_.notify_all();
+  }
+}
+
+void DiskManagerAsync::Complete(size_t slot, int result) {
+  std::unique_lock<std::mutex> lock(latch_);
+  DiskRequest request = std::move(slots_[slot].request_);
+  char *bounce_buffer = slots_[slot].bounce_buffer_;
+  lock.unlock();
+
+  char *buffer = bounce_buffer == nullptr ? request.data_ : bounce_buffer;
+  auto offset = static_cast<off_t>(request.page_id_) * BUSTUB_PAGE_SIZE;
+  if (result >= 0 && result < BUSTUB_PAGE_SIZE) {
+    if (request.is_write_) {
+      // short writes are rare on regular files, finish the page synchronously
+      while (result >= 0 && result < BUSTUB_PAGE_SIZE) {
+        ssize_t n = pwrite(db_fd_, buffer + result, BUSTUB_PAGE_SIZE - result, offset + result);
+        if (n == -1 && errno == EINTR) {
+          continue;
+        }
+        result = n <= 0 ? -(n == 0 ? EIO : errno) : result + static_cast<int>(n);
+      }
+    } else {
+      // the file ends before the page does
+      memset(buffer + result, 0, BUSTUB_PAGE_SIZE - result);
+    }
+  }
+  if (result >= 0 && !request.is_write_ && bounce_buffer != nullptr) {
+    memcpy(request.data_, bounce_buffer, BUSTUB_PAGE_SIZE);
+  }
+  std::free(bounce_buffer);
+  if (result < 0) {
+    request.callback_.set_exception(std::make_exception_ptr(Exception(
+        std::string("I/O error on page ") + std::to_string(request.page_id_) + ": " + std::strerror(-result))));
+  } else {
+    request.Finish();
+  }
+
+  lock.lock();
+  free_slots_.push_back(slot);
+  cv_.notify_all();
+}
+
+void DiskManagerAsync::Stop() {
+  std::unique_lock<std::mutex> lock(latch_);
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  cv_.notify_all();
+  if (!UsesIoUring()) {
+    lock.unlock();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+    return;
+  }
+
+#ifdef BUSTUB_HAS_IO_URING
+  // Once all requests are done, wake up the completion thread with a no-op, whose user data 0 marks no slot.
+  cv_.wait(lock, [&] { return free_slots_.size() == slots_.size(); });
+  unsigned tail = *sq_tail_;
+  auto *sqe = static_cast<io_uring_sqe *>(sqes_) + (tail & *sq_mask_);
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = 0;
+  sq_array_[tail & *sq_mask_] = tail & *sq_mask_;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  while (syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) < 0 && (errno == EINTR || errno == EAGAIN)) {
+  }
+  lock.unlock();
+  completion_thread_.join();
+  TearDownRing();
+#endif
+}
+
+#ifdef BUSTUB_HAS_IO_URING
+
+auto DiskManagerAsync::SetUpRing() -> bool {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  auto ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(queue_depth_), &params));
+  if (ring_fd < 0) {
+    LOG_WARN("io_uring is not available (%s), falling back to worker threads", std::strerror(errno));
+    return false;
+  }
+  ring_fd_ = ring_fd;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                  IORING_OFF_SQ_RING);
+  cq_ring_ = single_mmap ? sq_ring_
+                         : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    LOG_WARN("failed to map the io_uring, falling back to worker threads");
+    TearDownRing();
+    return false;
+  }
+
+  auto *sq = static_cast<char *>(sq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  return true;
+}
+
+void DiskManagerAsync::TearDownRing() {
+  if (sqes_ != nullptr && sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr && sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  sqes_ = cq_ring_ = sq_ring_ = nullptr;
+  close(ring_fd_);
+  ring_fd_ = -1;
+}
+
+void DiskManagerAsync::SubmitToRing(std::vector<DiskRequest> *requests) {
+  std::unique_lock<std::mutex> lock(latch_);
+  BUSTUB_ASSERT(!stopped_, "disk manager is shut down");
+  size_t next = 0;
+  while (next < requests->size()) {
+    cv_.wait(lock, [&] { return !free_slots_.empty(); });
+
+    // Fill submission queue entries for as many requests as there are free slots. Only this thread writes the tail,
+    // as it holds the latch, and the kernel only reads the entries once the new tail is published.
+    unsigned tail = *sq_tail_;
+    unsigned to_submit = 0;
+    for (; next < requests->size() && !free_slots_.empty(); next++) {
+      size_t slot = free_slots_.back();
+      free_slots_.pop_back();
+      InFlight &in_flight = slots_[slot];
+      in_flight.request_ = std::move((*requests)[next]);
+      DiskRequest &request = in_flight.request_;
+
+      char *buffer = request.data_;
+      in_flight.bounce_buffer_ = nullptr;
+      if (direct_io_ && reinterpret_cast<uintptr_t>(buffer) % DIRECT_IO_ALIGNMENT != 0) {
+        in_flight.bounce_buffer_ = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, BUSTUB_PAGE_SIZE));
+        if (request.is_write_) {
+          memcpy(in_flight.bounce_buffer_, buffer, BUSTUB_PAGE_SIZE);
+        }
+        buffer = in_flight.bounce_buffer_;
+      }
+      in_flight.iov_.iov_base = buffer;
+      in_flight.iov_.iov_len = BUSTUB_PAGE_SIZE;
+      if (request.is_write_) {
+        num_writes_ += 1;
+      }
+
+      auto *sqe = static_cast<io_uring_sqe *>(sqes_) + (tail & *sq_mask_);
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = request.is_write_ ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe->fd = db_fd_;
+      sqe->off = static_cast<uint64_t>(request.page_id_) * BUSTUB_PAGE_SIZE;
+      sqe->addr = reinterpret_cast<uint64_t>(&in_flight.iov_);
+      sqe->len = 1;
+      sqe->user_data = slot + 1;
+      sq_array_[tail & *sq_mask_] = tail & *sq_mask_;
+      tail++;
+      to_submit++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    while (to_submit > 0) {
+      auto submitted = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0);
+      if (submitted < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+          continue;
+        }
+        throw Exception(std::string("io_uring_enter failed: ") + std::strerror(errno));
+      }
+      to_submit -= static_cast<unsigned>(submitted);
+    }
+  }
+}
+
+void DiskManagerAsync::RunCompletionThread() {
+  auto *cqes = static_cast<io_uring_cqe *>(cqes_);
+  while (true) {
+    // only this thread moves the head
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      {
+        std::scoped_lock<std::mutex> lock(latch_);
+        if (stopped_ && free_slots_.size() == slots_.size()) {
+          return;
+        }
+      }
+      syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      continue;
+    }
+    for (; head != tail; head++) {
+      io_uring_cqe *cqe = cqes + (head & *cq_mask_);
+      uint64_t user_data = cqe->user_data;
+      int result = cqe->res;
+      // the entry may be reused as soon as the head passes it
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      if (user_data != 0) {
+        Complete(user_data - 1, result);
+      }
+    }
+  }
+}
+
+#else
+
+auto DiskManagerAsync::SetUpRing() -> bool { return false; }
+
+void DiskManagerAsync::TearDownRing() {}
+
+void DiskManagerAsync::SubmitToRing(std::vector<DiskRequest> *requests) {}
+
+void DiskManagerAsync::RunCompletionThread() {}
+
+#endif
+
+}  // namespace bustub
@@ -0,0 +1,132 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_manager_posix.cpp
+//
+// Identification: src/storage/disk/disk_manager_posix.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_manager_posix.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>  // NOLINT
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+namespace {
+
+/** @return this thread's page buffer that is aligned for direct I/O */
+auto AlignedPageBuffer() -> char * {
+  static thread_local std::unique_ptr<char, decltype(&std::free)> buffer(
+      static_cast<char *>(std::aligned_alloc(DiskManagerPosix::DIRECT_IO_ALIGNMENT, BUSTUB_PAGE_SIZE)), &std::free);
+  return buffer.get();
+}
+
+}  // namespace
+
+DiskManagerPosix::DiskManagerPosix(const std::string &db_file, bool direct_io) : DiskManager(db_file) {
+  // DiskManager opened (and if needed created) the database file as a stream, all page I/O goes through db_fd_ instead
+  {
+    std::scoped_lock scoped_db_io_latch(db_io_latch_);
+    db_io_.close();
+  }
+#ifdef O_DIRECT
+  if (direct_io) {
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if (db_fd_ == -1) {
+      LOG_WARN("direct I/O is not supported for %s, falling back to buffered I/O", db_file.c_str());
+    }
+    direct_io_ = db_fd_ != -1;
+  }
+#else
+  if (direct_io) {
+    LOG_WARN("direct I/O is not supported on this platform, falling back to buffered I/O");
+  }
+#endif
+  if (db_fd_ == -1) {
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (db_fd_ == -1) {
+    throw Exception("can't open db file");
+  }
+}
+
+DiskManagerPosix::~DiskManagerPosix() {
+  if (db_fd_ != -1) {
+    close(db_fd_);
+  }
+}
+
+void DiskManagerPosix::ShutDown() {
+  if (db_fd_ != -1) {
+    close(db_fd_);
+    db_fd_ = -1;
+  }
+  DiskManager::ShutDown();
+}
+
+void DiskManagerPosix::WritePage(page_id_t page_id, const char *page_data) {
+  auto offset = static_cast<off_t>(page_id) * BUSTUB_PAGE_SIZE;
+  if (direct_io_ && reinterpret_cast<uintptr_t>(page_data) % DIRECT_IO_ALIGNMENT != 0) {
+    char *aligned = AlignedPageBuffer();
+    memcpy(aligned, page_data, BUSTUB_PAGE_SIZE);
+    page_data = aligned;
+  }
+  num_writes_ += 1;
+  size_t written = 0;
+  while (written < BUSTUB_PAGE_SIZE) {
+    ssize_t n = pwrite(db_fd_, page_data + written, BUSTUB_PAGE_SIZE - written, offset + written);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    // check for I/O error
+    if (n <= 0) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    written += n;
+  }
+}
+
+void DiskManagerPosix::ReadPage(page_id_t page_id, char *page_data) {
+  auto offset = static_cast<off_t>(page_id) * BUSTUB_PAGE_SIZE;
+  char *buffer = page_data;
+  if (direct_io_ && reinterpret_cast<uintptr_t>(page_data) % DIRECT_IO_ALIGNMENT != 0) {
+    buffer = AlignedPageBuffer();
+  }
+  size_t read_count = 0;
+  while (read_count < BUSTUB_PAGE_SIZE) {
+    ssize_t n = pread(db_fd_, buffer + read_count, BUSTUB_PAGE_SIZE - read_count, offset + read_count);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      LOG_DEBUG("I/O error while reading");
+      return;
+    }
+    if (n == 0) {
+      // the file ends before the page does
+      break;
+    }
+    read_count += n;
+  }
+  memset(buffer + read_count, 0, BUSTUB_PAGE_SIZE - read_count);
+  if (buffer != page_data) {
+    memcpy(page_data, buffer, BUSTUB_PAGE_SIZE);
+  }
+}
+
+}  // namespace bustub
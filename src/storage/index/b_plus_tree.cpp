@@ -1,6 +1,8 @@
 #include "storage/index/b_plus_tree.h"
 
+#include <algorithm>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -10,13 +12,14 @@
 namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, LogManager *log_manager)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      internal_max_size_(internal_max_size),
+      log_manager_(log_manager) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -25,54 +28,218 @@ INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::IsEmpty() const -> bool { return root_page_id_ == INVALID_PAGE_ID; }
 
 /*
- * Helper function to get page id of the target leaf page
+ * Helper function to descend to the target leaf page, coupling versions
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::GetLeafPageId(const KeyType &key) -> page_id_t {
-  if (IsEmpty()) {
-    return INVALID_PAGE_ID;
+auto BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key, bool leftmost, uint64_t *version) -> Page * {
+  while (true) {
+    page_id_t page_id = root_page_id_;
+    if (page_id == INVALID_PAGE_ID) {
+      return nullptr;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      // every frame is pinned, start over once the others had a chance to unpin theirs
+      std::this_thread::yield();
+      continue;
+    }
+    uint64_t page_version = page->ReadVersion();
+    // the page may not be the root anymore by the time its version is read
+    bool is_valid = root_page_id_ == page_id;
+    while (is_valid) {
+      auto *page_ptr = reinterpret_cast<BPlusTreePage *>(page->GetData());
+      bool is_leaf = page_ptr->IsLeafPage();
+      // a page that is changed meanwhile may be of any type and size, searching it stays within its bounded size
+      if (!is_leaf && page_ptr->GetPageType() != IndexPageType::INTERNAL_PAGE) {
+        break;
+      }
+      page_id_t child_page_id = INVALID_PAGE_ID;
+      if (!is_leaf) {
+        auto *int_page_ptr = reinterpret_cast<InternalPage *>(page_ptr);
+        child_page_id = leftmost ? int_page_ptr->ValueAt(0) : int_page_ptr->GetValue(key, comparator_);
+      }
+      if (!page->ValidateVersion(page_version)) {
+        break;
+      }
+      if (is_leaf) {
+        *version = page_version;
+        return page;
+      }
+      Page *child_page = buffer_pool_manager_->FetchPage(child_page_id);
+      if (child_page == nullptr) {
+        std::this_thread::yield();
+        break;
+      }
+      uint64_t child_version = child_page->ReadVersion();
+      // the child is still the child of the page when its version is read
+      is_valid = page->ValidateVersion(page_version);
+      buffer_pool_manager_->UnpinPage(page_id, false);
+      page = child_page;
+      page_id = child_page_id;
+      page_version = child_version;
+    }
+    buffer_pool_manager_->UnpinPage(page_id, false);
   }
-  auto *page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(root_page_id_)->GetData());
-  while (page_ptr != nullptr) {
+}
+
+/*
+ * Helper function to descend to the target leaf page, crabbing latches
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Operation op, std::deque<Page *> *page_set) -> Page * {
+  root_latch_.WLock();
+  page_set->push_back(nullptr);
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    return nullptr;
+  }
+  page_id_t page_id = root_page_id_;
+  while (true) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    auto *page_ptr = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page->WLatch();
+    if (IsSafe(page_ptr, op)) {
+      // the ancestors do not change
+      ReleasePageSet(page_set, false);
+    }
+    page_set->push_back(page);
     if (page_ptr->IsLeafPage()) {
-      // is leaf page
-      auto ret = page_ptr->GetPageId();
-      buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
-      return ret;
+      return page;
     }
-    // is internal page
-    auto *int_page_ptr = reinterpret_cast<InternalPage *>(page_ptr);
+    page_id = reinterpret_cast<InternalPage *>(page_ptr)->GetValue(key, comparator_);
+  }
+}
 
-    page_id_t nxt_page_id = int_page_ptr->GetValue(key, comparator_);
-    buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
-    page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(nxt_page_id)->GetData());
+/*
+ * Helper function to descend optimistically to the target leaf page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindSafeLeafPage(const KeyType &key, Operation op, std::deque<Page *> *page_set) -> Page * {
+  root_latch_.RLock();
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    root_latch_.RUnlock();
+    return nullptr;
   }
-  return INVALID_PAGE_ID;
+  page_id_t page_id = root_page_id_;
+  Page *parent = nullptr;
+  while (true) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    auto *page_ptr = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page->RLatch();
+    bool is_leaf = page_ptr->IsLeafPage();
+    if (is_leaf) {
+      // the read latch of the parent keeps the leaf page from splitting or merging until it is write latched
+      page->RUnlatch();
+      page->WLatch();
+    }
+    if (parent == nullptr) {
+      root_latch_.RUnlock();
+    } else {
+      parent->RUnlatch();
+      buffer_pool_manager_->UnpinPage(parent->GetPageId(), false);
+    }
+    if (is_leaf) {
+      if (!IsSafe(page_ptr, op)) {
+        page->WUnlatch();
+        buffer_pool_manager_->UnpinPage(page_id, false);
+        return nullptr;
+      }
+      page_set->push_back(page);
+      return page;
+    }
+    page_id = reinterpret_cast<InternalPage *>(page_ptr)->GetValue(key, comparator_);
+    parent = page;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::IsSafe(BPlusTreePage *page, Operation op) const -> bool {
+  if (op == Operation::INSERT) {
+    // a leaf page splits when it gets full, an internal page when it overflows
+    return page->IsLeafPage() ? page->GetSize() + 1 < page->GetMaxSize() : page->GetSize() < page->GetMaxSize();
+  }
+  if (page->IsRootPage()) {
+    // the root leaf page goes when it gets empty, the root internal page when it is left with one child
+    return page->IsLeafPage() ? page->GetSize() > 1 : page->GetSize() > 2;
+  }
+  return page->IsLeafPage() ? page->GetSize() - 1 >= page->GetMinSize()
+                            : page->GetSize() - 1 >= std::max(2, page->GetMinSize());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleasePageSet(std::deque<Page *> *page_set, bool is_dirty) {
+  for (Page *page : *page_set) {
+    if (page == nullptr) {
+      root_latch_.WUnlock();
+      continue;
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+  }
+  page_set->clear();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FetchLatchedPage(page_id_t page_id, StructureChange *change) -> Page * {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  auto *page_set = change->page_set_;
+  if (std::find(page_set->begin(), page_set->end(), page) == page_set->end()) {
+    buffer_pool_manager_->FetchPage(page_id);
+    page->WLatch();
+    page_set->push_back(page);
+  }
+  return page;
 }
 
 /*
- * Helper function to get page id of the beginning leaf page
+ * Helper function to delete the pages a structure modification freed. A page that a lookup still has pinned cannot be
+ * deleted yet, it is kept and retried by the next structure modifications.
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::GetStartPageId() -> page_id_t {
-  if (IsEmpty()) {
-    return INVALID_PAGE_ID;
+void BPLUSTREE_TYPE::DeleteFreedPages(const StructureChange &change) {
+  if (change.changed_pages_.empty() && change.freed_pages_.empty()) {
+    return;
   }
-  auto *page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(root_page_id_)->GetData());
-  while (page_ptr != nullptr) {
-    if (page_ptr->IsLeafPage()) {
-      // is leaf page
-      auto ret = page_ptr->GetPageId();
-      buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
-      return ret;
-    }
-    // is internal page
-    auto *int_page_ptr = reinterpret_cast<InternalPage *>(page_ptr);
-    page_id_t nxt_page_id = int_page_ptr->ValueAt(0);
-    buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
-    page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(nxt_page_id)->GetData());
+  std::scoped_lock lock(pinned_freed_pages_latch_);
+  for (const auto &freed_page : change.freed_pages_) {
+    pinned_freed_pages_.push_back(freed_page.first);
   }
-  return INVALID_PAGE_ID;
+  // a lookup that still has a freed page pinned finds its version changed and starts over, unpinning it
+  auto is_deleted = [this](page_id_t page_id) { return buffer_pool_manager_->DeletePage(page_id); };
+  pinned_freed_pages_.erase(std::remove_if(pinned_freed_pages_.begin(), pinned_freed_pages_.end(), is_deleted),
+                            pinned_freed_pages_.end());
+}
+
+/*
+ * Helper function to release a page once it is split, before the split goes up to its parent. Nothing reaches the
+ * page or its new sibling but through the pages above it, which stay latched.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleaseSplitPage(page_id_t page_id, StructureChange *change) {
+  Page *page = change->page_set_->back();
+  BUSTUB_ASSERT(page != nullptr && page->GetPageId() == page_id, "the split page should be the last latched page");
+  change->page_set_->pop_back();
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+/*
+ * Helper function to reparent a page. A child that is not in the page set is latched only while it changes, the
+ * latch of its parent keeps others from changing the parent page id meanwhile.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetParentPageId(page_id_t page_id, page_id_t parent_page_id, StructureChange *change) {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  auto *page_set = change->page_set_;
+  bool is_latched = std::find(page_set->begin(), page_set->end(), page) != page_set->end();
+  if (!is_latched) {
+    page->WLatch();
+  }
+  reinterpret_cast<BPlusTreePage *>(page->GetData())->SetParentPageId(parent_page_id);
+  change->reparented_pages_.push_back(page_id);
+  if (!is_latched) {
+    page->WUnlatch();
+  }
+  buffer_pool_manager_->UnpinPage(page_id, true);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -98,13 +265,13 @@ auto BPLUSTREE_TYPE::GetSiblingPageId(const page_id_t &page_id) const -> std::pa
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::InsertToInternalPageRecur(const KeyType &key, const page_id_t &l_value, const page_id_t &r_value,
-                                               const page_id_t &internal_page_id) {
+                                               const page_id_t &internal_page_id, StructureChange *change) {
   // this function need to insert | ?????,l_value | key,r_value |
   // to the internal_page_id
-  auto *internal_page_ptr =
-      reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(internal_page_id)->GetData());
+  auto *internal_page_ptr = reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_id, change)->GetData());
   BUSTUB_ASSERT(internal_page_id == internal_page_ptr->GetPageId(),
                 "internal_page_id should equal to the page id fetched");
+  change->changed_pages_.push_back(internal_page_id);
   if (internal_page_ptr->GetSize() + 1 <= internal_page_ptr->GetMaxSize()) {
     // no need for split
     internal_page_ptr->InsertKey(key, l_value, r_value, comparator_);
@@ -118,8 +285,8 @@ void BPLUSTREE_TYPE::InsertToInternalPageRecur(const KeyType &key, const page_id
       Page *new_page_ptr = buffer_pool_manager_->NewPage(&new_root_page_id);
       auto *new_root_page_ptr = reinterpret_cast<InternalPage *>(new_page_ptr->GetData());
       new_root_page_ptr->Init(new_root_page_id, INVALID_PAGE_ID, internal_max_size_);
-      root_page_id_ = new_root_page_ptr->GetPageId();
-      UpdateRootPageId(false);
+      change->changed_pages_.push_back(new_root_page_id);
+      change->root_changed_ = true;
       internal_page_ptr->SetParentPageId(new_root_page_id);
 
       // create a new internal page
@@ -127,47 +294,49 @@ void BPLUSTREE_TYPE::InsertToInternalPageRecur(const KeyType &key, const page_id
       new_page_ptr = buffer_pool_manager_->NewPage(&new_internal_page_id);
       auto *new_internal_page_ptr = reinterpret_cast<InternalPage *>(new_page_ptr->GetData());
       new_internal_page_ptr->Init(new_internal_page_id, internal_page_ptr->GetParentPageId(), internal_max_size_);
+      change->changed_pages_.push_back(new_internal_page_id);
 
       // move the element
       KeyType m_key =
           internal_page_ptr->InsertKeyAndSplitTwo(key, l_value, r_value, comparator_, *new_internal_page_ptr);
       // std::cout<<"in file: "<<__FILE__<<" in line: "<<__LINE__<<" m_key: "<<m_key<<std::endl;
       for (int i = 0; i < new_internal_page_ptr->GetSize(); i++) {
-        page_id_t nxt_page_id = new_internal_page_ptr->ValueAt(i);
-        auto *page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(nxt_page_id)->GetData());
-        page_ptr->SetParentPageId(new_internal_page_ptr->GetPageId());
-        buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), true);
+        SetParentPageId(new_internal_page_ptr->ValueAt(i), new_internal_page_id, change);
       }
+      new_root_page_ptr->InsertKey(m_key, internal_page_id, new_internal_page_id, comparator_);
+      // lookups take the root as soon as it is recorded, so it is recorded once it is complete
+      root_page_id_ = new_root_page_id;
+      UpdateRootPageId(false);
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(new_internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(new_root_page_ptr->GetPageId(), true);
-      InsertToInternalPageRecur(m_key, internal_page_id, new_internal_page_id, new_root_page_id);
+      ReleaseSplitPage(internal_page_id, change);
     } else {
       // create a new internal page
       page_id_t new_internal_page_id;
       Page *new_page_ptr = buffer_pool_manager_->NewPage(&new_internal_page_id);
       auto *new_internal_page_ptr = reinterpret_cast<InternalPage *>(new_page_ptr->GetData());
       new_internal_page_ptr->Init(new_internal_page_id, internal_page_ptr->GetParentPageId(), internal_max_size_);
+      change->changed_pages_.push_back(new_internal_page_id);
 
       // move the element
       KeyType m_key =
           internal_page_ptr->InsertKeyAndSplitTwo(key, l_value, r_value, comparator_, *new_internal_page_ptr);
       for (int i = 0; i < new_internal_page_ptr->GetSize(); i++) {
-        page_id_t nxt_page_id = new_internal_page_ptr->ValueAt(i);
-        auto *page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(nxt_page_id)->GetData());
-        page_ptr->SetParentPageId(new_internal_page_id);
-        buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), true);
+        SetParentPageId(new_internal_page_ptr->ValueAt(i), new_internal_page_id, change);
       }
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(new_internal_page_ptr->GetPageId(), true);
-      InsertToInternalPageRecur(m_key, internal_page_id, new_internal_page_id, internal_page_ptr->GetParentPageId());
+      page_id_t parent_page_id = internal_page_ptr->GetParentPageId();
+      ReleaseSplitPage(internal_page_id, change);
+      InsertToInternalPageRecur(m_key, internal_page_id, new_internal_page_id, parent_page_id, change);
     }
   }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::StealFromSiblingLeafPage(const page_id_t &leaf_page_id) -> bool {
-  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(leaf_page_id)->GetData());
+auto BPLUSTREE_TYPE::StealFromSiblingLeafPage(const page_id_t &leaf_page_id, StructureChange *change) -> bool {
+  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(FetchLatchedPage(leaf_page_id, change)->GetData());
 
   auto ret = GetSiblingPageId(leaf_page_id);
   page_id_t left_sib_leaf_page_id = ret.first;
@@ -176,15 +345,17 @@ auto BPLUSTREE_TYPE::StealFromSiblingLeafPage(const page_id_t &leaf_page_id) ->
     // steal from left
     // std::cout<<"steal from left"<<std::endl;
     auto *left_sib_leaf_page_ptr =
-        reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(left_sib_leaf_page_id)->GetData());
+        reinterpret_cast<LeafPage *>(FetchLatchedPage(left_sib_leaf_page_id, change)->GetData());
     if (left_sib_leaf_page_ptr->GetSize() - 1 >= left_sib_leaf_page_ptr->GetMinSize()) {
       // can be steal
       // std::cout<<"left can be steal"<<std::endl;
       auto replace_pair = leaf_page_ptr->StealFromLeft(*left_sib_leaf_page_ptr);
       // stolen update parent key
-      auto *internal_page_ptr = reinterpret_cast<InternalPage *>(
-          buffer_pool_manager_->FetchPage(leaf_page_ptr->GetParentPageId())->GetData());
+      auto *internal_page_ptr =
+          reinterpret_cast<InternalPage *>(FetchLatchedPage(leaf_page_ptr->GetParentPageId(), change)->GetData());
       internal_page_ptr->ReplaceKey(replace_pair.first, replace_pair.second, comparator_);
+      change->changed_pages_.insert(change->changed_pages_.end(),
+                                    {leaf_page_id, left_sib_leaf_page_id, internal_page_ptr->GetPageId()});
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(left_sib_leaf_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), true);
@@ -197,15 +368,17 @@ auto BPLUSTREE_TYPE::StealFromSiblingLeafPage(const page_id_t &leaf_page_id) ->
     // steal from right
     // std::cout<<"steal from left"<<std::endl;
     auto *right_sib_leaf_page_ptr =
-        reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(right_sib_leaf_page_id)->GetData());
+        reinterpret_cast<LeafPage *>(FetchLatchedPage(right_sib_leaf_page_id, change)->GetData());
     if (right_sib_leaf_page_ptr->GetSize() - 1 >= right_sib_leaf_page_ptr->GetMinSize()) {
       // can be steal
       // std::cout<<"right can be steal"<<std::endl;
       auto replace_pair = leaf_page_ptr->StealFromRight(*right_sib_leaf_page_ptr);
       // stolen update parent key
-      auto *internal_page_ptr = reinterpret_cast<InternalPage *>(
-          buffer_pool_manager_->FetchPage(leaf_page_ptr->GetParentPageId())->GetData());
+      auto *internal_page_ptr =
+          reinterpret_cast<InternalPage *>(FetchLatchedPage(leaf_page_ptr->GetParentPageId(), change)->GetData());
       internal_page_ptr->ReplaceKey(replace_pair.first, replace_pair.second, comparator_);
+      change->changed_pages_.insert(change->changed_pages_.end(),
+                                    {leaf_page_id, right_sib_leaf_page_id, internal_page_ptr->GetPageId()});
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(right_sib_leaf_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), true);
@@ -220,9 +393,9 @@ auto BPLUSTREE_TYPE::StealFromSiblingLeafPage(const page_id_t &leaf_page_id) ->
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::StealFromSiblingInternalPage(const page_id_t &internal_page_id) -> bool {
-  auto *internal_page_ptr =
-      reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(internal_page_id)->GetData());
+auto BPLUSTREE_TYPE::StealFromSiblingInternalPage(const page_id_t &internal_page_id, StructureChange *change)
+    -> bool {
+  auto *internal_page_ptr = reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_id, change)->GetData());
   auto ret = GetSiblingPageId(internal_page_id);
   page_id_t left_sib_internal_page_id = ret.first;
   page_id_t right_sib_internal_page_id = ret.second;
@@ -230,19 +403,19 @@ auto BPLUSTREE_TYPE::StealFromSiblingInternalPage(const page_id_t &internal_page
     // steal from left
     // std::cout<<"steal from left"<<std::endl;
     auto *left_sib_internal_page_ptr =
-        reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(left_sib_internal_page_id)->GetData());
+        reinterpret_cast<InternalPage *>(FetchLatchedPage(left_sib_internal_page_id, change)->GetData());
     if (left_sib_internal_page_ptr->GetSize() - 1 >= std::max(2, left_sib_internal_page_ptr->GetMinSize())) {
       // 这里有一个点，应该是internal_page不能只剩一个，一个的时候意味着仅有一个pointer
       // can be steal
       // std::cout<<"left can be steal"<<std::endl;
-      auto *parent_page_ptr = reinterpret_cast<InternalPage *>(
-          buffer_pool_manager_->FetchPage(internal_page_ptr->GetParentPageId())->GetData());
+      auto *parent_page_ptr =
+          reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_ptr->GetParentPageId(), change)->GetData());
       auto sub_page_id = internal_page_ptr->StealFromLeftAndUpdateParent(*left_sib_internal_page_ptr, *parent_page_ptr);
       // stolen update parent key
-      auto *sub_page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(sub_page_id)->GetData());
-      sub_page_ptr->SetParentPageId(internal_page_ptr->GetPageId());
+      SetParentPageId(sub_page_id, internal_page_ptr->GetPageId(), change);
+      change->changed_pages_.insert(change->changed_pages_.end(),
+                                    {internal_page_id, left_sib_internal_page_id, parent_page_ptr->GetPageId()});
 
-      buffer_pool_manager_->UnpinPage(sub_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(parent_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(left_sib_internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
@@ -255,20 +428,20 @@ auto BPLUSTREE_TYPE::StealFromSiblingInternalPage(const page_id_t &internal_page
     // steal from right
     // std::cout<<"steal from right"<<std::endl;
     auto *right_sib_internal_page_ptr =
-        reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(right_sib_internal_page_id)->GetData());
+        reinterpret_cast<InternalPage *>(FetchLatchedPage(right_sib_internal_page_id, change)->GetData());
     if (right_sib_internal_page_ptr->GetSize() - 1 >= std::max(2, right_sib_internal_page_ptr->GetMinSize())) {
       // 这里有一个点，应该是internal_page不能只剩一个，一个的时候意味着仅有一个pointer
       // can be steal
       // std::cout<<"right can be steal"<<std::endl;
-      auto *parent_page_ptr = reinterpret_cast<InternalPage *>(
-          buffer_pool_manager_->FetchPage(internal_page_ptr->GetParentPageId())->GetData());
+      auto *parent_page_ptr =
+          reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_ptr->GetParentPageId(), change)->GetData());
       auto sub_page_id =
           internal_page_ptr->StealFromRightAndUpdateParent(*right_sib_internal_page_ptr, *parent_page_ptr);
       // stolen update parent key
-      auto *sub_page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(sub_page_id)->GetData());
-      sub_page_ptr->SetParentPageId(internal_page_ptr->GetPageId());
+      SetParentPageId(sub_page_id, internal_page_ptr->GetPageId(), change);
+      change->changed_pages_.insert(change->changed_pages_.end(),
+                                    {internal_page_id, right_sib_internal_page_id, parent_page_ptr->GetPageId()});
 
-      buffer_pool_manager_->UnpinPage(sub_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(parent_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(right_sib_internal_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
@@ -283,10 +456,11 @@ auto BPLUSTREE_TYPE::StealFromSiblingInternalPage(const page_id_t &internal_page
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_id, page_id_t internal_page_id) {
-  auto *internal_page_ptr =
-      reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(internal_page_id)->GetData());
+void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_id, page_id_t internal_page_id,
+                                                 StructureChange *change) {
+  auto *internal_page_ptr = reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_id, change)->GetData());
   internal_page_ptr->RemoveValue(removed_page_id);
+  change->changed_pages_.push_back(internal_page_id);
 
   if (internal_page_ptr->IsRootPage()) {
     // 如果是根节点，不受限制，需要额外操作
@@ -297,12 +471,11 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
       // 只剩一个pointer了，一个key都没有了
       // 删除这个page并且更新root_page
       root_page_id_ = tmp_zero;
-      auto *tmp_root_page_ptr = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(tmp_zero)->GetData());
-      tmp_root_page_ptr->SetParentPageId(INVALID_PAGE_ID);
-      buffer_pool_manager_->UnpinPage(tmp_zero, true);
+      SetParentPageId(tmp_zero, INVALID_PAGE_ID, change);
       UpdateRootPageId(false);
-      auto check_here = buffer_pool_manager_->DeletePage(internal_page_id);
-      BUSTUB_ASSERT(check_here == true, "the empty root page should not be pinned, and deleted successfully");
+      // the page is deleted once it is unlatched
+      change->freed_pages_.emplace_back(internal_page_id, INVALID_PAGE_ID);
+      change->root_changed_ = true;
     }
     return;
   }
@@ -312,10 +485,9 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
     // 只剩一个pointer，此时也是不合法的
     // need further ops
     // 同样的，是尝试先偷，偷不成就合并
-    auto stolen_from_sibling = StealFromSiblingInternalPage(internal_page_ptr->GetPageId());
+    auto stolen_from_sibling = StealFromSiblingInternalPage(internal_page_ptr->GetPageId(), change);
     if (!stolen_from_sibling) {
       // merge recursively here
-      std::cout << "merge internal page recursively here" << std::endl;
       // marked here (now pining page is internal_page_ptr)
 
       auto sib_page_id_pair = GetSiblingPageId(internal_page_ptr->GetPageId());
@@ -328,7 +500,7 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
         // merge the two
         tb_merged_internal_page_id = sib_page_id_pair.first;
         tb_merged_internal_page_ptr =
-            reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(tb_merged_internal_page_id)->GetData());
+            reinterpret_cast<InternalPage *>(FetchLatchedPage(tb_merged_internal_page_id, change)->GetData());
         // notice always merge the right to left, so should do swap
         std::swap(internal_page_ptr, tb_merged_internal_page_ptr);
         std::swap(internal_page_id, tb_merged_internal_page_id);
@@ -337,24 +509,21 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
         // merge the two
         tb_merged_internal_page_id = sib_page_id_pair.second;
         tb_merged_internal_page_ptr =
-            reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(tb_merged_internal_page_id)->GetData());
+            reinterpret_cast<InternalPage *>(FetchLatchedPage(tb_merged_internal_page_id, change)->GetData());
       }
       BUSTUB_ASSERT(tb_merged_internal_page_ptr != nullptr, "tb_merged_internal_page_ptr should not be nullptr");
 
       // merge tb_merged_leaf_page to leaf_page
       // and delete tb_merged_leaf_page
 
-      auto *parent_page_ptr = reinterpret_cast<InternalPage *>(
-          buffer_pool_manager_->FetchPage(internal_page_ptr->GetParentPageId())->GetData());
+      auto *parent_page_ptr =
+          reinterpret_cast<InternalPage *>(FetchLatchedPage(internal_page_ptr->GetParentPageId(), change)->GetData());
 
       page_id_t to_be_removed = internal_page_ptr->MergeInternalPage(*tb_merged_internal_page_ptr, *parent_page_ptr);
       // 这个to_be_removed是parent_page的东西
 
       for (int i = internal_page_ptr->GetSize() - 1; i >= 0; i--) {
-        auto *sub_page_ptr = reinterpret_cast<BPlusTreePage *>(
-            buffer_pool_manager_->FetchPage(internal_page_ptr->ValueAt(i))->GetData());
-        sub_page_ptr->SetParentPageId(internal_page_ptr->GetPageId());
-        buffer_pool_manager_->UnpinPage(internal_page_ptr->ValueAt(i), false);
+        SetParentPageId(internal_page_ptr->ValueAt(i), internal_page_ptr->GetPageId(), change);
         if (internal_page_ptr->ValueAt(i) == to_be_removed) {
           break;
         }
@@ -362,20 +531,134 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
 
       BUSTUB_ASSERT(to_be_removed == tb_merged_internal_page_id,
                     "to_be_removed should be equal to tb_merged_leaf_page_id");
+      change->changed_pages_.insert(change->changed_pages_.end(), {internal_page_id, parent_page_ptr->GetPageId()});
+      change->freed_pages_.emplace_back(tb_merged_internal_page_id, internal_page_id);
+      // the tb_merged_internal_page is deleted once it is unlatched
       buffer_pool_manager_->UnpinPage(tb_merged_internal_page_ptr->GetPageId(), true);
-
-      // buffer_pool_manager_->DeletePage(tb_merged_leaf_page_ptr->GetPageId());
-      BUSTUB_ASSERT(buffer_pool_manager_->DeletePage(tb_merged_internal_page_id) == true,
-                    "the tb_merged_leaf_page should be deleted!!");
       // merge leaf page means to delete one leaf page, so need to delete a key
       // from the internal page, do this deletion recursively
       buffer_pool_manager_->UnpinPage(parent_page_ptr->GetPageId(), true);
-      DeleteFromInternalPageRecur(to_be_removed, internal_page_ptr->GetParentPageId());
+      DeleteFromInternalPageRecur(to_be_removed, internal_page_ptr->GetParentPageId(), change);
     }
   }
   buffer_pool_manager_->UnpinPage(internal_page_ptr->GetPageId(), true);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogLeafChange(LogRecordType type, LeafPage *leaf_page, int slot, const MappingType &entry,
+                                   const MappingType *neighbor_entry, Transaction *transaction) {
+  if (!enable_logging || log_manager_ == nullptr) {
+    return;
+  }
+  // without a transaction, the change is redone but never undone
+  txn_id_t txn_id = transaction == nullptr ? INVALID_TXN_ID : transaction->GetTransactionId();
+  lsn_t prev_lsn = transaction == nullptr ? INVALID_LSN : transaction->GetPrevLSN();
+  LogRecord log_record(txn_id, prev_lsn, type, leaf_page->GetPageId(), slot,
+                       std::string(reinterpret_cast<const char *>(&entry), sizeof(MappingType)),
+                       neighbor_entry == nullptr
+                           ? std::string()
+                           : std::string(reinterpret_cast<const char *>(neighbor_entry), sizeof(MappingType)));
+  lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+  leaf_page->SetLSN(lsn);
+  if (transaction != nullptr) {
+    transaction->SetPrevLSN(lsn);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogStructureChange(LogRecordType type, const StructureChange &change) {
+  if (!enable_logging || log_manager_ == nullptr) {
+    return;
+  }
+  // a page is logged once, as a whole if it changed as a whole
+  std::vector<page_id_t> logged_pages;
+  std::vector<IndexPageChange> changes;
+  auto is_logged = [&](page_id_t page_id) {
+    return std::find(logged_pages.begin(), logged_pages.end(), page_id) != logged_pages.end();
+  };
+  std::vector<Page *> pages;
+  // the reparented pages that the operation does not hold are latched while their LSN is set
+  std::vector<Page *> latched_pages;
+  // A deleted page is still on disk as it was. It is marked free, with the page it was merged into as its parent, so
+  // that undo can follow the entries it had.
+  for (const auto &[page_id, merged_into] : change.freed_pages_) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    tree_page->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
+    tree_page->SetSize(0);
+    tree_page->SetParentPageId(merged_into);
+    changes.push_back(
+        {IndexPageChange::Kind::IMAGE, page_id, INVALID_PAGE_ID, std::string(page->GetData(), sizeof(BPlusTreePage))});
+    logged_pages.push_back(page_id);
+    pages.push_back(page);
+  }
+  for (page_id_t page_id : change.changed_pages_) {
+    if (is_logged(page_id)) {
+      continue;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    size_t image_size = tree_page->IsLeafPage()
+                            ? LEAF_PAGE_HEADER_SIZE + tree_page->GetSize() * sizeof(MappingType)
+                            : INTERNAL_PAGE_HEADER_SIZE + tree_page->GetSize() * sizeof(std::pair<KeyType, page_id_t>);
+    changes.push_back(
+        {IndexPageChange::Kind::IMAGE, page_id, INVALID_PAGE_ID, std::string(page->GetData(), image_size)});
+    logged_pages.push_back(page_id);
+    pages.push_back(page);
+  }
+  for (page_id_t page_id : change.reparented_pages_) {
+    if (is_logged(page_id)) {
+      continue;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (std::find(change.page_set_->begin(), change.page_set_->end(), page) == change.page_set_->end()) {
+      page->WLatch();
+      latched_pages.push_back(page);
+    }
+    changes.push_back({IndexPageChange::Kind::PARENT, page_id,
+                       reinterpret_cast<BPlusTreePage *>(page->GetData())->GetParentPageId(), std::string()});
+    logged_pages.push_back(page_id);
+    pages.push_back(page);
+  }
+  if (change.root_changed_) {
+    changes.push_back({IndexPageChange::Kind::ROOT, HEADER_PAGE_ID, root_page_id_, index_name_});
+  }
+  if (changes.empty()) {
+    return;
+  }
+
+  // A structure modification is logged in one record, so that redo finds it whole or not at all. Only one that does
+  // not fit into a log buffer, over a very deep tree, is split over several records.
+  auto append = [&](std::vector<IndexPageChange> record_changes, size_t first_page, size_t end_page) {
+    LogRecord log_record(type, std::move(record_changes));
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    for (size_t i = first_page; i < end_page; i++) {
+      pages[i]->SetLSN(lsn);
+    }
+  };
+  std::vector<IndexPageChange> record_changes;
+  size_t first_page = 0;
+  int32_t record_size = LogRecord(type, {}).GetSize();
+  for (size_t i = 0; i < changes.size(); i++) {
+    int32_t change_size = LogRecord::IndexPageChangeSize(changes[i]);
+    if (!record_changes.empty() && record_size + change_size > LOG_BUFFER_SIZE) {
+      append(std::move(record_changes), first_page, std::min(i, pages.size()));
+      record_changes.clear();
+      first_page = i;
+      record_size = LogRecord(type, {}).GetSize();
+    }
+    record_size += change_size;
+    record_changes.push_back(std::move(changes[i]));
+  }
+  append(std::move(record_changes), first_page, pages.size());
+  for (Page *page : latched_pages) {
+    page->WUnlatch();
+  }
+  for (Page *page : pages) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  }
+}
+
 /*****************************************************************************
  * SEARCH
  *****************************************************************************/
@@ -386,22 +669,24 @@ void BPLUSTREE_TYPE::DeleteFromInternalPageRecur(const page_id_t &removed_page_i
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) -> bool {
-  if (IsEmpty()) {
-    return false;
-  }
-  auto leaf_page_id = GetLeafPageId(key);
-  if (leaf_page_id == INVALID_PAGE_ID) {
-    return false;
-  }
-  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(leaf_page_id)->GetData());
-  ValueType res;
-  if (leaf_page_ptr->GetValue(key, comparator_, res)) {
-    result->push_back(res);
-    buffer_pool_manager_->UnpinPage(leaf_page_id, false);
-    return true;
+  while (true) {
+    uint64_t version;
+    Page *leaf_page = FindLeafPageOptimistic(key, false, &version);
+    if (leaf_page == nullptr) {
+      return false;
+    }
+    auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(leaf_page->GetData());
+    ValueType res;
+    bool found = leaf_page_ptr->GetValue(key, comparator_, res);
+    bool is_valid = leaf_page->ValidateVersion(version);
+    buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+    if (is_valid) {
+      if (found) {
+        result->push_back(res);
+      }
+      return found;
+    }
   }
-  buffer_pool_manager_->UnpinPage(leaf_page_id, false);
-  return false;
 }
 
 /*****************************************************************************
@@ -416,46 +701,70 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) -> bool {
-  if (IsEmpty()) {
+  const MappingType entry(key, value);
+  std::deque<Page *> local_page_set;
+  auto *page_set = transaction == nullptr ? &local_page_set : transaction->GetPageSet().get();
+  Page *leaf_page = FindSafeLeafPage(key, Operation::INSERT, page_set);
+  if (leaf_page == nullptr) {
+    leaf_page = FindLeafPage(key, Operation::INSERT, page_set);
+  }
+  if (leaf_page == nullptr) {
+    // the tree is empty, and stays so for others while the root latch is held
     page_id_t new_root_page_id;
     Page *new_page_ptr = buffer_pool_manager_->NewPage(&new_root_page_id);
     auto *new_root_page_ptr =
         reinterpret_cast<LeafPage *>(new_page_ptr->GetData());  // the new root page is a leaf node
     new_root_page_ptr->Init(new_root_page_id, INVALID_PAGE_ID, leaf_max_size_);
+    // lookups take the root as soon as it is recorded, and wait until the entry is in
+    new_page_ptr->WLatch();
     root_page_id_ = new_root_page_ptr->GetPageId();
     UpdateRootPageId(true);
+    // the empty tree is set up first, the entry then goes in like into any leaf
+    StructureChange change;
+    change.page_set_ = page_set;
+    change.changed_pages_.push_back(new_root_page_id);
+    change.root_changed_ = true;
+    LogStructureChange(LogRecordType::BTREE_SPLIT, change);
     auto ret = new_root_page_ptr->InsertValue(key, value, comparator_);
+    LogLeafChange(LogRecordType::BTREE_INSERT, new_root_page_ptr, 0, entry, nullptr, transaction);
+    new_page_ptr->WUnlatch();
     buffer_pool_manager_->UnpinPage(new_root_page_id, true);
+    ReleasePageSet(page_set, true);
     return ret;
   }
-  auto leaf_page_id = GetLeafPageId(key);
-  if (leaf_page_id == INVALID_PAGE_ID) {
-    return false;  // error occurred
-  }
-  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(leaf_page_id)->GetData());
-
-  BUSTUB_ASSERT(leaf_page_id == leaf_page_ptr->GetPageId(), "leaf_page_id should equal to the page id fetched");
+  StructureChange change;
+  change.page_set_ = page_set;
+  page_id_t leaf_page_id = leaf_page->GetPageId();
+  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(FetchLatchedPage(leaf_page_id, &change)->GetData());
 
   if (leaf_page_ptr->HasKey(key, comparator_)) {
     buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(),
                                     false);  // flush non-dirty page
-    return false;                            // duplicated key
+    ReleasePageSet(page_set, false);
+    return false;  // duplicated key
   }
   // maybe need to split
+  int slot = leaf_page_ptr->LowerBound(key, comparator_);
   if (leaf_page_ptr->GetSize() + 1 < leaf_page_ptr->GetMaxSize()) {
     // no need for split
     auto ret = leaf_page_ptr->InsertValue(key, value, comparator_);
+    LogLeafChange(LogRecordType::BTREE_INSERT, leaf_page_ptr, slot, entry, nullptr, transaction);
     buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(),
                                     true);  // flush dirty page
+    ReleasePageSet(page_set, true);
     return ret;
   }
+  // the insert is logged as if into the full page, the split after it moves the entry with the others
+  LogLeafChange(LogRecordType::BTREE_INSERT, leaf_page_ptr, slot, entry, nullptr, transaction);
   // page is full need to split
   page_id_t new_leaf_page_id;
   Page *new_page_ptr = buffer_pool_manager_->NewPage(&new_leaf_page_id);
 
   auto *new_leaf_page_ptr = reinterpret_cast<LeafPage *>(new_page_ptr->GetData());  // the new leaf page
   new_leaf_page_ptr->Init(new_leaf_page_id, leaf_page_ptr->GetParentPageId(), leaf_max_size_);
+  new_leaf_page_ptr->SetNextPageId(leaf_page_ptr->GetNextPageId());
   leaf_page_ptr->SetNextPageId(new_leaf_page_ptr->GetPageId());  // link the leaf page
+  change.changed_pages_.insert(change.changed_pages_.end(), {leaf_page_id, new_leaf_page_id});
   // till now the new leaf page is created
   KeyType m_key = leaf_page_ptr->InsertValueAndSplitTwo(key, value, comparator_, *new_leaf_page_ptr);
   // find the middle key
@@ -467,12 +776,15 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
     auto *new_root_page_ptr =
         reinterpret_cast<InternalPage *>(new_page_ptr->GetData());  // the new root page is a internal node
     new_root_page_ptr->Init(new_root_page_id, INVALID_PAGE_ID, internal_max_size_);
-    root_page_id_ = new_root_page_ptr->GetPageId();
-    UpdateRootPageId(false);
     leaf_page_ptr->SetParentPageId(new_root_page_ptr->GetPageId());
     new_leaf_page_ptr->SetParentPageId(new_root_page_ptr->GetPageId());
     // now just insert to the parent_page
     new_root_page_ptr->InsertKey(m_key, leaf_page_id, new_leaf_page_id, comparator_);
+    // lookups take the root as soon as it is recorded, so it is recorded once it is complete
+    root_page_id_ = new_root_page_id;
+    UpdateRootPageId(false);
+    change.changed_pages_.push_back(new_root_page_id);
+    change.root_changed_ = true;
     buffer_pool_manager_->UnpinPage(new_root_page_ptr->GetPageId(), true);
     buffer_pool_manager_->UnpinPage(new_leaf_page_ptr->GetPageId(), true);
     buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), true);
@@ -482,8 +794,12 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
     page_id_t parent_page_id = leaf_page_ptr->GetParentPageId();
     buffer_pool_manager_->UnpinPage(new_leaf_page_ptr->GetPageId(), true);
     buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), true);
-    InsertToInternalPageRecur(m_key, leaf_page_id, new_leaf_page_id, parent_page_id);
+    ReleaseSplitPage(leaf_page_id, &change);
+    InsertToInternalPageRecur(m_key, leaf_page_id, new_leaf_page_id, parent_page_id, &change);
   }
+  LogStructureChange(LogRecordType::BTREE_SPLIT, change);
+  ReleasePageSet(page_set, true);
+  DeleteFreedPages(change);
 
   return true;
 }
@@ -500,34 +816,51 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
-  // todo remove here
-  if (IsEmpty()) {
-    return;
+  std::deque<Page *> local_page_set;
+  auto *page_set = transaction == nullptr ? &local_page_set : transaction->GetPageSet().get();
+  Page *leaf_page = FindSafeLeafPage(key, Operation::REMOVE, page_set);
+  if (leaf_page == nullptr) {
+    leaf_page = FindLeafPage(key, Operation::REMOVE, page_set);
   }
-  auto leaf_page_id = GetLeafPageId(key);
-  if (leaf_page_id == INVALID_PAGE_ID) {
-    return;  // error occurred
+  if (leaf_page == nullptr) {
+    ReleasePageSet(page_set, false);
+    return;
   }
-  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(leaf_page_id)->GetData());
+  StructureChange change;
+  change.page_set_ = page_set;
+  page_id_t leaf_page_id = leaf_page->GetPageId();
+  auto *leaf_page_ptr = reinterpret_cast<LeafPage *>(FetchLatchedPage(leaf_page_id, &change)->GetData());
   if (!leaf_page_ptr->HasKey(key, comparator_)) {
+    buffer_pool_manager_->UnpinPage(leaf_page_id, false);
+    ReleasePageSet(page_set, false);
     return;  // no such a key
   }
   // delete start here
+  int slot = leaf_page_ptr->GetKeyIndex(key, comparator_);
+  const MappingType entry = leaf_page_ptr->GetElem(slot);
   leaf_page_ptr->RemoveValue(key, comparator_);
+  // undo puts the entry back beside its neighbor, which may have been moved to another page by then
+  const bool has_neighbor = slot > 0 || leaf_page_ptr->GetSize() > 0;
+  const MappingType neighbor_entry = has_neighbor ? leaf_page_ptr->GetElem(slot > 0 ? slot - 1 : 0) : MappingType{};
+  LogLeafChange(LogRecordType::BTREE_DELETE, leaf_page_ptr, slot, entry, has_neighbor ? &neighbor_entry : nullptr,
+                transaction);
   // 依然沿用insert的思路就是先调整好leaf_page，之后递归的去处理需要处理的internal_page
 
   if (leaf_page_ptr->IsRootPage()) {
     // 如果这是空的根节点，需要做删除操作，需要单独处理一下
     bool need_to_clear_tree = (leaf_page_ptr->GetSize() == 0);
-    buffer_pool_manager_->UnpinPage(root_page_id_, true);
+    buffer_pool_manager_->UnpinPage(leaf_page_id, true);
     if (need_to_clear_tree) {
-      // delete this page
+      // delete this page once it is unlatched
       BUSTUB_ASSERT(root_page_id_ == leaf_page_id, "the root leaf page should be root and leaf");
-      auto check_here = buffer_pool_manager_->DeletePage(root_page_id_);
-      BUSTUB_ASSERT(check_here == true, "the empty root page should not be pinned, and deleted successfully");
+      change.freed_pages_.emplace_back(root_page_id_, INVALID_PAGE_ID);
       root_page_id_ = INVALID_PAGE_ID;
       UpdateRootPageId(false);
+      change.root_changed_ = true;
+      LogStructureChange(LogRecordType::BTREE_MERGE, change);
     }
+    ReleasePageSet(page_set, true);
+    DeleteFreedPages(change);
     return;
   }
 
@@ -536,14 +869,13 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   if (leaf_page_ptr->GetSize() < leaf_page_ptr->GetMinSize()) {
     // stage1:
     // try to steal one k-v pair from the left/right sibling
-    auto stolen_from_sibling = StealFromSiblingLeafPage(leaf_page_ptr->GetPageId());
+    auto stolen_from_sibling = StealFromSiblingLeafPage(leaf_page_ptr->GetPageId(), &change);
     if (!stolen_from_sibling) {
       // steal failed
       // need for stage2
 
       // stage2:
       // failed to steal, need merge the leaf page
-      std::cout << "into stage2" << std::endl;
 
       // marked here (now pining page is leaf_page_ptr)
       auto sib_page_id_pair = GetSiblingPageId(leaf_page_ptr->GetPageId());
@@ -556,7 +888,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         // merge the two
         tb_merged_leaf_page_id = sib_page_id_pair.first;
         tb_merged_leaf_page_ptr =
-            reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(tb_merged_leaf_page_id)->GetData());
+            reinterpret_cast<LeafPage *>(FetchLatchedPage(tb_merged_leaf_page_id, &change)->GetData());
         // notice always merge the right to left, so should do swap
         std::swap(leaf_page_ptr, tb_merged_leaf_page_ptr);
         std::swap(leaf_page_id, tb_merged_leaf_page_id);
@@ -565,7 +897,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         // merge the two
         tb_merged_leaf_page_id = sib_page_id_pair.second;
         tb_merged_leaf_page_ptr =
-            reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(tb_merged_leaf_page_id)->GetData());
+            reinterpret_cast<LeafPage *>(FetchLatchedPage(tb_merged_leaf_page_id, &change)->GetData());
       }
       BUSTUB_ASSERT(tb_merged_leaf_page_ptr != nullptr, "tb_merged_leaf_page_ptr should not be nullptr");
 
@@ -573,19 +905,21 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
       // and delete tb_merged_leaf_page
       page_id_t to_be_removed = leaf_page_ptr->MergeLeafPage(*tb_merged_leaf_page_ptr);
       BUSTUB_ASSERT(to_be_removed == tb_merged_leaf_page_id, "to_be_removed should be equal to tb_merged_leaf_page_id");
+      change.changed_pages_.push_back(leaf_page_id);
+      change.freed_pages_.emplace_back(tb_merged_leaf_page_id, leaf_page_id);
+      // the tb_merged_leaf_page is deleted once it is unlatched
       buffer_pool_manager_->UnpinPage(tb_merged_leaf_page_ptr->GetPageId(), true);
-
-      // buffer_pool_manager_->DeletePage(tb_merged_leaf_page_ptr->GetPageId());
-      BUSTUB_ASSERT(buffer_pool_manager_->DeletePage(tb_merged_leaf_page_id) == true,
-                    "the tb_merged_leaf_page should be deleted!!");
       // merge leaf page means to delete one leaf page, so need to delete a key
       // from the internal page, do this deletion recursively
 
       // 从这边开始就是递归的从internal_page中开始删就行
-      DeleteFromInternalPageRecur(to_be_removed, leaf_page_ptr->GetParentPageId());
+      DeleteFromInternalPageRecur(to_be_removed, leaf_page_ptr->GetParentPageId(), &change);
     }
   }
   buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), true);
+  LogStructureChange(LogRecordType::BTREE_MERGE, change);
+  ReleasePageSet(page_set, true);
+  DeleteFreedPages(change);
 }
 
 /*****************************************************************************
@@ -597,15 +931,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE {
-  auto start_leaf_page_id = GetStartPageId();
-  if (start_leaf_page_id == INVALID_PAGE_ID) {
-    return INDEXITERATOR_TYPE(nullptr, 0, buffer_pool_manager_);
-  }
-  auto *start_leaf_page_ptr =
-      reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(start_leaf_page_id)->GetData());
-  return INDEXITERATOR_TYPE(start_leaf_page_ptr, 0, buffer_pool_manager_);
-}
+auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE { return INDEXITERATOR_TYPE(this); }
 
 /*
  * Input parameter is low key, find the leaf page that contains the input key
@@ -614,19 +940,12 @@ auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE {
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE {
-  auto start_leaf_page_id = GetLeafPageId(key);
-  if (start_leaf_page_id == INVALID_PAGE_ID) {
-    return INDEXITERATOR_TYPE(nullptr, 0, buffer_pool_manager_);
-  }
-  auto *start_leaf_page_ptr =
-      reinterpret_cast<LeafPage *>(buffer_pool_manager_->FetchPage(start_leaf_page_id)->GetData());
-
-  auto idx = start_leaf_page_ptr->GetKeyIndex(key, comparator_);
-  if (idx == -1) {
+  INDEXITERATOR_TYPE iterator(this, key);
+  if (iterator.IsEnd() || comparator_((*iterator).first, key) != 0) {
     // not found
     return Begin();
   }
-  return INDEXITERATOR_TYPE(start_leaf_page_ptr, idx, buffer_pool_manager_);
+  return iterator;
 }
 
 /*
@@ -635,7 +954,7 @@ auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::End() -> INDEXITERATOR_TYPE { return INDEXITERATOR_TYPE(nullptr, 0, buffer_pool_manager_); }
+auto BPLUSTREE_TYPE::End() -> INDEXITERATOR_TYPE { return INDEXITERATOR_TYPE(); }
 
 /**
  * @return Page id of the root of this tree
@@ -657,6 +976,8 @@ auto BPLUSTREE_TYPE::GetRootPageId() -> page_id_t { return root_page_id_; }
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   auto *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  // the header page is shared by all indexes
+  header_page->WLatch();
   if (root_page_id_ == INVALID_PAGE_ID) {
     // the root page has gone
     header_page->DeleteRecord(index_name_);
@@ -669,6 +990,7 @@ void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
       header_page->UpdateRecord(index_name_, root_page_id_);
     }
   }
+  header_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
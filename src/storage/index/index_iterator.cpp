@@ -5,6 +5,8 @@
 
 #include <cassert>
 
+#include "storage/index/b_plus_tree.h"
+
 namespace bustub {
 
 /*
@@ -15,41 +17,107 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator() = default;
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page_ptr, int index,
-                                  BufferPoolManager *buffer_pool_manager)
-    : leaf_page_ptr_(leaf_page_ptr), index_(index), buffer_pool_manager_(buffer_pool_manager) {}
+INDEXITERATOR_TYPE::IndexIterator(BPLUSTREE_TYPE *tree) : tree_(tree) { Seek(nullptr, true); }
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(BPLUSTREE_TYPE *tree, const KeyType &key) : tree_(tree) { Seek(&key, true); }
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&other) noexcept
+    : tree_(other.tree_), page_(other.page_), version_(other.version_), index_(other.index_), entry_(other.entry_) {
+  other.page_ = nullptr;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator() {
-  if (leaf_page_ptr_ != nullptr) {
-    buffer_pool_manager_->UnpinPage(leaf_page_ptr_->GetPageId(), true);
-    leaf_page_ptr_ = nullptr;
+  if (page_ != nullptr) {
+    tree_->buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+    page_ = nullptr;
   }
 };  // NOLINT
 
 INDEX_TEMPLATE_ARGUMENTS
-auto INDEXITERATOR_TYPE::IsEnd() -> bool { return leaf_page_ptr_ == nullptr; }
+auto INDEXITERATOR_TYPE::IsEnd() -> bool { return page_ == nullptr; }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto INDEXITERATOR_TYPE::operator*() -> const MappingType & { return leaf_page_ptr_->GetElem(index_); }
+auto INDEXITERATOR_TYPE::operator*() -> const MappingType & { return entry_; }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto INDEXITERATOR_TYPE::operator++() -> INDEXITERATOR_TYPE & {
-  if (index_ + 1 >= leaf_page_ptr_->GetSize()) {
-    page_id_t nxt_page_id = leaf_page_ptr_->GetNextPageId();
-    buffer_pool_manager_->UnpinPage(leaf_page_ptr_->GetPageId(), true);
-    if (nxt_page_id == INVALID_PAGE_ID) {
-      leaf_page_ptr_ = nullptr;
-      index_ = 0;
-    } else {
-      leaf_page_ptr_ =
-          reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(buffer_pool_manager_->FetchPage(nxt_page_id)->GetData());
+  index_++;
+  if (!Settle()) {
+    // the next entry is the first one after the current one, wherever it is now
+    KeyType key = entry_.first;
+    Seek(&key, false);
+  }
+  return *this;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Seek(const KeyType *key, bool inclusive) {
+  while (true) {
+    page_ = tree_->FindLeafPageOptimistic(key == nullptr ? KeyType() : *key, key == nullptr, &version_);
+    if (page_ == nullptr) {
+      // the tree is empty
+      return;
+    }
+    index_ = 0;
+    if (key != nullptr) {
+      auto *leaf_page_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_->GetData());
+      index_ = leaf_page_ptr->LowerBound(*key, tree_->comparator_);
+      if (!inclusive && index_ < leaf_page_ptr->GetBoundedSize() &&
+          tree_->comparator_(leaf_page_ptr->KeyAt(index_), *key) == 0) {
+        index_++;
+      }
+    }
+    if (Settle()) {
+      return;
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::Settle() -> bool {
+  BufferPoolManager *buffer_pool_manager = tree_->buffer_pool_manager_;
+  while (true) {
+    auto *leaf_page_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_->GetData());
+    if (index_ < leaf_page_ptr->GetBoundedSize()) {
+      MappingType entry = leaf_page_ptr->GetElem(index_);
+      if (!page_->ValidateVersion(version_)) {
+        break;
+      }
+      entry_ = entry;
+      return true;
+    }
+    page_id_t next_page_id = leaf_page_ptr->GetNextPageId();
+    if (!page_->ValidateVersion(version_)) {
+      break;
+    }
+    if (next_page_id == INVALID_PAGE_ID) {
+      buffer_pool_manager->UnpinPage(page_->GetPageId(), false);
+      page_ = nullptr;
       index_ = 0;
+      return true;
+    }
+    Page *next_page = buffer_pool_manager->FetchPage(next_page_id);
+    if (next_page == nullptr) {
+      // every frame is pinned, the entry is sought again from the root
+      break;
+    }
+    uint64_t next_version = next_page->ReadVersion();
+    // the next page is still the next leaf page when its version is read
+    bool is_valid = page_->ValidateVersion(version_);
+    buffer_pool_manager->UnpinPage(page_->GetPageId(), false);
+    page_ = next_page;
+    version_ = next_version;
+    index_ = 0;
+    if (!is_valid) {
+      break;
     }
-  } else {
-    index_++;
   }
-  return *this;
+  buffer_pool_manager->UnpinPage(page_->GetPageId(), false);
+  page_ = nullptr;
+  return false;
 }
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -74,19 +75,41 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::ReplaceKey(const KeyType &before_key, const
   }
 }
 
+/*
+ * Helper method to find the first index from first on whose key is larger than
+ * the input key, GetSize() if there is none
+ *
+ * Like the lower bound of the leaf page, the search is branch-free and compares
+ * the keys in place.
+ */
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetValue(const KeyType &key, const KeyComparator &comparator) const -> ValueType {
-  int l_index1 = 1;
-  int r_index1 = GetSize() - 1;
-  while (l_index1 <= r_index1) {
-    int m_index1 = l_index1 + (r_index1 - l_index1) / 2;
-    if (comparator(KeyAt(m_index1), key) <= 0) {
-      l_index1 = m_index1 + 1;
-    } else {
-      r_index1 = m_index1 - 1;
-    }
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::UpperBound(const KeyType &key, const KeyComparator &comparator, int first) const
+    -> int {
+  int n = GetBoundedSize() - first;
+  if (n <= 0) {
+    return first;
+  }
+  const MappingType *base = array_ + first;
+  while (n > 1) {
+    int half = n / 2;
+    base = comparator(base[half].first, key) <= 0 ? base + half : base;
+    n -= half;
   }
-  return ValueAt(l_index1 - 1);
+  return static_cast<int>(base - array_) + static_cast<int>(comparator(base->first, key) <= 0);
+}
+
+/*
+ * Helper method to get the size, bounded by the number of entries the page has
+ * room for, like the bounded size of the leaf page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetBoundedSize() const -> int {
+  return std::clamp(GetSize(), 0, static_cast<int>(INTERNAL_PAGE_SIZE));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetValue(const KeyType &key, const KeyComparator &comparator) const -> ValueType {
+  return array_[UpperBound(key, comparator, 1) - 1].second;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -103,16 +126,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertKey(const KeyType &key, const ValueTy
 
   // find l_value
   // find the correct position (the first place larger than key)
-  int l_index = 1;
-  int r_index = GetSize() - 1;
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) <= 0) {
-      l_index = m_index + 1;
-    } else {
-      r_index = m_index - 1;
-    }
-  }
+  int l_index = UpperBound(key, comparator, 1);
   // l_index is the first position larger than key
   for (int i = GetSize(); i >= l_index; i--) {
     swap(array_[i + 1], array_[i]);
@@ -137,16 +151,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertKeyIgnoreFirst(const KeyType &key, co
     -> bool {
   // find l_value
   // find the correct position (the first place larger than key)
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) <= 0) {
-      l_index = m_index + 1;
-    } else {
-      r_index = m_index - 1;
-    }
-  }
+  int l_index = UpperBound(key, comparator, 0);
   // l_index is the first position larger than key
   for (int i = GetSize(); i >= l_index; i--) {
     swap(array_[i + 1], array_[i]);
@@ -295,7 +300,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::StealFromRightAndUpdateParent(BPlusTreeInte
       SetValueAt(GetSize(), right_page.ValueAt(0));
       parent_page.SetKeyAt(i, right_page.KeyAt(1));
 
-      for (int j = 0; i < right_page.GetSize() - 1; j++) {
+      for (int j = 0; j < right_page.GetSize() - 1; j++) {
         swap(right_page.array_[j], right_page.array_[j + 1]);
       }
 
@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <sstream>
 
 #include "common/exception.h"
@@ -57,80 +58,75 @@ auto B_PLUS_TREE_LEAF_PAGE_TYPE::ValueAt(int index) const -> ValueType { return
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::HasKey(const KeyType &key, const KeyComparator &comparator) const -> bool {
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) >= 0) {
-      r_index = m_index - 1;
-    } else {
-      l_index = m_index + 1;
-    }
-  }
-  // l_index is the lower_bound
-  return IsIndexValid(l_index) && (comparator(KeyAt(l_index), key) == 0);
+  return GetKeyIndex(key, comparator) != -1;
 }
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetKeyIndex(const KeyType &key, const KeyComparator &comparator) const -> int {
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) >= 0) {
-      r_index = m_index - 1;
-    } else {
-      l_index = m_index + 1;
-    }
-  }
-  // l_index is the lower_bound
-  if (IsIndexValid(l_index) && comparator(KeyAt(l_index), key) == 0) {
-    return l_index;
+  int index = LowerBound(key, comparator);
+  if (index < GetBoundedSize() && comparator(array_[index].first, key) == 0) {
+    return index;
   }
   return -1;
 }
 
+/*
+ * Helper method to find the first index whose key is not less than the input key,
+ * GetSize() if there is none
+ *
+ * The search is branch-free: it halves the range about log2(GetSize()) times, a
+ * number that depends only on how many keys the page holds and not on the key, and
+ * picks the half with a conditional move rather than a jump, so it does not depend
+ * on the branch predictor guessing the comparisons. Keys are compared in place,
+ * without copying them out of the page.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::LowerBound(const KeyType &key, const KeyComparator &comparator) const -> int {
+  int n = GetBoundedSize();
+  if (n == 0) {
+    return 0;
+  }
+  const MappingType *base = array_;
+  while (n > 1) {
+    int half = n / 2;
+    base = comparator(base[half].first, key) < 0 ? base + half : base;
+    n -= half;
+  }
+  return static_cast<int>(base - array_) + static_cast<int>(comparator(base->first, key) < 0);
+}
+
+/*
+ * Helper method to get the size, bounded by the number of entries the page has
+ * room for. A lookup reads the page without a latch and may see any size until
+ * the read is validated, the bound keeps it on the page meanwhile.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetBoundedSize() const -> int {
+  return std::clamp(GetSize(), 0, static_cast<int>(LEAF_PAGE_SIZE));
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetElem(int index) -> const MappingType & { return array_[index]; }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetValue(const KeyType &key, const KeyComparator &comparator, ValueType &result) const
     -> bool {
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  // do binary search
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) >= 0) {
-      r_index = m_index - 1;
-    } else {
-      l_index = m_index + 1;
-    }
-  }
-  if (IsIndexValid(l_index) && comparator(KeyAt(l_index), key) == 0) {
-    result = ValueAt(l_index);
-    return true;
+  int index = GetKeyIndex(key, comparator);
+  if (index == -1) {
+    return false;
   }
-  return false;
+  result = array_[index].second;
+  return true;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::InsertValue(const KeyType &key, const ValueType &value,
                                              const KeyComparator &comparator) -> bool {
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) <= 0) {
-      l_index = m_index + 1;
-    } else {
-      r_index = m_index - 1;
-    }
-  }
-  // l_index is the first position larger than key
-  if (IsIndexValid(l_index) && comparator(KeyAt(l_index - 1), key) == 0) {
+  int l_index = LowerBound(key, comparator);
+  if (l_index < GetSize() && comparator(array_[l_index].first, key) == 0) {
     return false;
     // duplicated key, fail to insert
   }
+  // l_index is the first position not less than key, so larger than key as key is not a duplicate
   for (int i = GetSize(); i >= l_index; i--) {
     swap(array_[i + 1], array_[i]);
   }
@@ -192,18 +188,8 @@ auto B_PLUS_TREE_LEAF_PAGE_TYPE::InsertValueAndSplitTwo(const KeyType &key, cons
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveValue(const KeyType &key, const KeyComparator &comparator) -> bool {
   // remove the key
-  int l_index = 0;
-  int r_index = GetSize() - 1;
-  // do binary search
-  while (l_index <= r_index) {
-    int m_index = l_index + (r_index - l_index) / 2;
-    if (comparator(KeyAt(m_index), key) >= 0) {
-      r_index = m_index - 1;
-    } else {
-      l_index = m_index + 1;
-    }
-  }
-  if (comparator(KeyAt(l_index), key) == 0) {
+  int l_index = GetKeyIndex(key, comparator);
+  if (l_index != -1) {
     array_[l_index].first = KeyType{};
     array_[l_index].second = ValueType{};
     for (int i = l_index; i < GetSize() - 1; i++) {
@@ -10,7 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <random>
 
 #include "common/logger.h"
 #include "fmt/format.h"
@@ -18,16 +21,31 @@
 
 namespace bustub {
 
+/** @return an epoch for the timestamps of a new table heap, which differs from those of the earlier ones */
+static auto NextEpoch() -> uint32_t {
+  // pages keep the epoch of an earlier run of the database too, start from a random one
+  static std::atomic<uint32_t> next_epoch{std::random_device()()};
+  uint32_t epoch;
+  do {
+    epoch = next_epoch.fetch_add(1);
+  } while (epoch == 0);
+  return epoch;
+}
+
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
                      page_id_t first_page_id)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
       log_manager_(log_manager),
-      first_page_id_(first_page_id) {}
+      first_page_id_(first_page_id),
+      epoch_(NextEpoch()) {}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
                      Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+    : buffer_pool_manager_(buffer_pool_manager),
+      lock_manager_(lock_manager),
+      log_manager_(log_manager),
+      epoch_(NextEpoch()) {
   // Initialize the first table page.
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr,
@@ -37,7 +55,7 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
 }
 
 auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> bool {
-  if (tuple.size_ + 32 > BUSTUB_PAGE_SIZE) {  // larger than one page size
+  if (tuple.size_ > TablePage::MAX_TUPLE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
@@ -82,6 +100,8 @@ auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> b
       cur_page = new_page;
     }
   }
+  cur_page->SetTupleTimestamps(*rid, txn->GetTempTs(), MAX_TS, epoch_);
+  cur_page->SetVersionWord(*rid, cur_page->GetVersionWord(*rid, epoch_) | VERSION_LOCK_BIT, epoch_);
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
@@ -102,7 +122,19 @@ auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  timestamp_t begin_ts;
+  timestamp_t end_ts;
+  bool exists = page->GetTupleTimestamps(rid, &begin_ts, &end_ts, epoch_);
+  if (exists && (IsWriteConflict(txn, begin_ts, end_ts) || IsLockedByOther(page, rid, txn))) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (page->MarkDelete(rid, txn, lock_manager_, log_manager_)) {
+    page->SetTupleTimestamps(rid, begin_ts, txn->GetTempTs(), epoch_);
+    page->SetVersionWord(rid, page->GetVersionWord(rid, epoch_) | VERSION_LOCK_BIT, epoch_);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -121,7 +153,22 @@ auto TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
+  timestamp_t begin_ts;
+  timestamp_t end_ts;
+  bool exists = page->GetTupleTimestamps(rid, &begin_ts, &end_ts, epoch_);
+  if (exists && (IsWriteConflict(txn, begin_ts, end_ts) || IsLockedByOther(page, rid, txn))) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (is_updated) {
+    // the replaced version stays visible to the snapshots that see it
+    AppendVersion(rid, old_tuple, begin_ts, txn->GetTempTs());
+    page->SetTupleTimestamps(rid, txn->GetTempTs(), MAX_TS, epoch_);
+    page->SetVersionWord(rid, page->GetVersionWord(rid, epoch_) | VERSION_LOCK_BIT, epoch_);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
@@ -152,13 +199,162 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   // Rollback the delete.
   page->WLatch();
   page->RollbackDelete(rid, txn, log_manager_);
+  timestamp_t begin_ts;
+  timestamp_t end_ts;
+  if (page->GetTupleTimestamps(rid, &begin_ts, &end_ts, epoch_) && end_ts == txn->GetTempTs()) {
+    page->SetTupleTimestamps(rid, begin_ts, MAX_TS, epoch_);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
-auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool acquire_read_lock) -> bool {
+void TableHeap::RollbackUpdate(const Tuple &old_tuple, const RID &rid, Transaction *txn) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  Tuple new_tuple;
+  page->WLatch();
+  page->UpdateTuple(old_tuple, &new_tuple, rid, txn, lock_manager_, log_manager_);
+  {
+    // the old version goes back from the chain to the page, with its timestamps
+    std::scoped_lock lock(version_chains_latch_);
+    auto &chain = version_chains_[rid];
+    auto version = std::find_if(chain.rbegin(), chain.rend(),
+                                [&](const TupleVersion &v) { return v.end_ts_ == txn->GetTempTs(); });
+    if (version != chain.rend()) {
+      page->SetTupleTimestamps(rid, version->begin_ts_, MAX_TS, epoch_);
+      chain.erase(std::next(version).base());
+    }
+    if (chain.empty()) {
+      version_chains_.erase(rid);
+    }
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+}
+
+void TableHeap::CommitTuple(const RID &rid, Transaction *txn, timestamp_t commit_ts) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  timestamp_t temp_ts = txn->GetTempTs();
+  page->WLatch();
+  Tuple tuple;
+  timestamp_t begin_ts;
+  timestamp_t end_ts;
+  bool exists = page->GetTupleVersion(rid, &tuple, &begin_ts, &end_ts, epoch_);
+  if (exists && end_ts == temp_ts) {
+    // ApplyDelete removes the deleted version from the page, the snapshots that see it find it in the chain
+    if (begin_ts != temp_ts) {
+      AppendVersion(rid, tuple, begin_ts, commit_ts);
+    }
+    page->SetTupleTimestamps(rid, begin_ts == temp_ts ? commit_ts : begin_ts, commit_ts, epoch_);
+  } else if (exists && begin_ts == temp_ts) {
+    page->SetTupleTimestamps(rid, commit_ts, end_ts, epoch_);
+  }
+  {
+    std::scoped_lock lock(version_chains_latch_);
+    auto chain = version_chains_.find(rid);
+    if (chain != version_chains_.end()) {
+      for (auto &version : chain->second) {
+        version.begin_ts_ = version.begin_ts_ == temp_ts ? commit_ts : version.begin_ts_;
+        version.end_ts_ = version.end_ts_ == temp_ts ? commit_ts : version.end_ts_;
+      }
+    }
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+}
+
+void TableHeap::PruneVersions(const RID &rid, timestamp_t watermark) {
+  std::scoped_lock lock(version_chains_latch_);
+  auto chain = version_chains_.find(rid);
+  if (chain == version_chains_.end()) {
+    return;
+  }
+  // a version that ended before every snapshot, or that a transaction replaced itself, is seen by no snapshot
+  auto &versions = chain->second;
+  versions.erase(std::remove_if(versions.begin(), versions.end(),
+                                [&](const TupleVersion &version) {
+                                  return version.end_ts_ <= watermark ||
+                                         (version.begin_ts_ == version.end_ts_ && version.end_ts_ < TXN_START_TS);
+                                }),
+                 versions.end());
+  if (versions.empty()) {
+    version_chains_.erase(chain);
+  }
+}
+
+/** @return whether the transaction sees the writes of the transaction that stamped the timestamp */
+static auto Sees(Transaction *txn, timestamp_t ts) -> bool {
+  return ts == txn->GetTempTs() || (ts < TXN_START_TS && ts <= txn->GetReadTs());
+}
+
+void TableHeap::UnlockVersion(const RID &rid, bool committed) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  page->WLatch();
+  uint64_t version = page->GetVersionWord(rid, epoch_);
+  if ((version & VERSION_LOCK_BIT) != 0) {
+    page->SetVersionWord(rid, (version & ~VERSION_LOCK_BIT) + (committed ? 1 : 0), epoch_);
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+}
+
+auto TableHeap::ValidateRead(const RID &rid, uint64_t version, Transaction *txn) -> bool {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  page->RLatch();
+  bool valid = (page->GetVersionWord(rid, epoch_) & ~VERSION_LOCK_BIT) == version && !IsLockedByOther(page, rid, txn);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+  return valid;
+}
+
+auto TableHeap::HasWritten(Transaction *txn, const RID &rid) -> bool {
+  // the write sets of the transactions that validate are short
+  auto write_set = txn->GetWriteSet();
+  return std::any_of(write_set->begin(), write_set->end(),
+                     [&](const TableWriteRecord &item) { return item.table_ == this && item.rid_ == rid; });
+}
+
+auto TableHeap::IsLockedByOther(TablePage *page, const RID &rid, Transaction *txn) -> bool {
+  return (page->GetVersionWord(rid, epoch_) & VERSION_LOCK_BIT) != 0 && !HasWritten(txn, rid);
+}
+
+auto TableHeap::IsVisible(Transaction *txn, timestamp_t begin_ts, timestamp_t end_ts) -> bool {
+  return Sees(txn, begin_ts) && !Sees(txn, end_ts);
+}
+
+auto TableHeap::IsWriteConflict(Transaction *txn, timestamp_t begin_ts, timestamp_t end_ts) -> bool {
+  // first committer wins: the version must be the one the snapshot sees, and no one else may have deleted it
+  return IsSnapshotRead(txn) && (!Sees(txn, begin_ts) || (end_ts != MAX_TS && end_ts != txn->GetTempTs()));
+}
+
+auto TableHeap::GetVersionFromChain(const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+  std::scoped_lock lock(version_chains_latch_);
+  auto chain = version_chains_.find(rid);
+  if (chain == version_chains_.end()) {
+    return false;
+  }
+  for (auto version = chain->second.rbegin(); version != chain->second.rend(); ++version) {
+    if (IsVisible(txn, version->begin_ts_, version->end_ts_)) {
+      *tuple = version->tuple_;
+      tuple->rid_ = rid;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TableHeap::AppendVersion(const RID &rid, const Tuple &tuple, timestamp_t begin_ts, timestamp_t end_ts) {
+  std::scoped_lock lock(version_chains_latch_);
+  version_chains_[rid].push_back({tuple, begin_ts, end_ts});
+}
+
+auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool acquire_read_lock,
+                         BufferAccessStrategy *strategy) -> bool {
   // Find the page which contains the tuple.
-  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPageWithStrategy(rid.GetPageId(), strategy));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -168,7 +364,26 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool ac
   if (acquire_read_lock) {
     page->RLatch();
   }
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (IsSnapshotRead(txn)) {
+    // the version on the page is the newest one, the chain has the older ones
+    timestamp_t begin_ts;
+    timestamp_t end_ts;
+    res = page->GetTupleVersion(rid, tuple, &begin_ts, &end_ts, epoch_) && IsVisible(txn, begin_ts, end_ts);
+    res = res || GetVersionFromChain(rid, tuple, txn);
+  } else {
+    res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  }
+  if (res && txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    // the version read is validated on commit, a version another transaction is writing would not be
+    uint64_t version = page->GetVersionWord(rid, epoch_);
+    if ((version & VERSION_LOCK_BIT) == 0) {
+      txn->GetReadSet()->emplace_back(rid, version, this);
+    } else if (!HasWritten(txn, rid)) {
+      txn->SetState(TransactionState::ABORTED);
+      res = false;
+    }
+  }
   if (acquire_read_lock) {
     page->RUnlatch();
   }
@@ -176,16 +391,17 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool ac
   return res;
 }
 
-auto TableHeap::Begin(Transaction *txn) -> TableIterator {
+auto TableHeap::Begin(Transaction *txn, BufferAccessStrategy *strategy) -> TableIterator {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
   RID rid;
   auto page_id = first_page_id_;
   while (page_id != INVALID_PAGE_ID) {
-    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPageWithStrategy(page_id, strategy));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-    auto found_tuple = page->GetFirstTupleRid(&rid);
+    // A snapshot may see an older version of a deleted tuple, it starts at the first slot.
+    auto found_tuple = page->GetFirstTupleRid(&rid, IsSnapshotRead(txn));
     page->RUnlatch();
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (found_tuple) {
@@ -193,7 +409,7 @@ auto TableHeap::Begin(Transaction *txn) -> TableIterator {
     }
     page_id = page->GetNextPageId();
   }
-  return {this, rid, txn};
+  return {this, rid, txn, strategy};
 }
 
 auto TableHeap::End() -> TableIterator { return {this, RID(INVALID_PAGE_ID, 0), nullptr}; }
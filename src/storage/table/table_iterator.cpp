@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
 
 #include "common/exception.h"
@@ -18,11 +19,15 @@
 
 namespace bustub {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn), strategy_(strategy) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_)) {
-      throw bustub::Exception("read non-existing tuple");
+    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, true, strategy_)) {
+      if (!TableHeap::IsSnapshotRead(txn_)) {
+        throw bustub::Exception("read non-existing tuple");
+      }
+      // the snapshot does not see the first slot, go on to the first one it sees
+      ++(*this);
     }
   }
 }
@@ -39,30 +44,40 @@ auto TableIterator::operator->() -> Tuple * {
 
 auto TableIterator::operator++() -> TableIterator & {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+  auto cur_page =
+      static_cast<TablePage *>(buffer_pool_manager->FetchPageWithStrategy(tuple_->rid_.GetPageId(), strategy_));
   BUSTUB_ENSURE(cur_page != nullptr, "BPM full");  // all pages are pinned
 
   cur_page->RLatch();
-  RID next_tuple_rid;
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 &next_tuple_rid)) {  // end of this page
-    while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-      cur_page = next_page;
-      cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
-        break;
+  // a snapshot also visits the deleted slots, which may hold versions it sees, and skips the ones it does not see
+  bool snapshot_read = TableHeap::IsSnapshotRead(txn_);
+  while (true) {
+    RID next_tuple_rid;
+    if (!cur_page->GetNextTupleRid(tuple_->rid_, &next_tuple_rid, snapshot_read)) {  // end of this page
+      while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
+        ReadAhead(cur_page->GetNextPageId());
+        auto next_page =
+            static_cast<TablePage *>(buffer_pool_manager->FetchPageWithStrategy(cur_page->GetNextPageId(), strategy_));
+        cur_page->RUnlatch();
+        buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
+        cur_page = next_page;
+        cur_page->RLatch();
+        if (cur_page->GetFirstTupleRid(&next_tuple_rid, snapshot_read)) {
+          break;
+        }
       }
     }
-  }
-  tuple_->rid_ = next_tuple_rid;
+    tuple_->rid_ = next_tuple_rid;
 
-  if (*this != table_heap_->End()) {
+    if (*this == table_heap_->End()) {
+      break;
+    }
     // DO NOT ACQUIRE READ LOCK twice in a single thread otherwise it may deadlock.
     // See https://users.rust-lang.org/t/how-bad-is-the-potential-deadlock-mentioned-in-rwlocks-document/67234
-    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, false)) {
+    if (table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, false, strategy_)) {
+      break;
+    }
+    if (!snapshot_read) {
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       throw bustub::Exception("read non-existing tuple");
@@ -74,6 +89,20 @@ auto TableIterator::operator++() -> TableIterator & {
   return *this;
 }
 
+void TableIterator::ReadAhead(page_id_t next_page_id) {
+  page_id_t window_end = next_page_id + READ_AHEAD_PAGES;
+  if (window_end < read_ahead_until_) {
+    // the scan went back to earlier pages, start over
+    read_ahead_until_ = next_page_id;
+  }
+  if (next_page_id + READ_AHEAD_PAGES / 2 < read_ahead_until_) {
+    return;
+  }
+  page_id_t start_page_id = std::max(next_page_id, read_ahead_until_);
+  table_heap_->buffer_pool_manager_->PrefetchPages(start_page_id, window_end - start_page_id);
+  read_ahead_until_ = window_end;
+}
+
 auto TableIterator::operator++(int) -> TableIterator {
   TableIterator clone(*this);
   ++(*this);
@@ -0,0 +1,179 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy_test.cpp
+//
+// Identification: test/buffer/buffer_access_strategy_test.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_access_strategy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "concurrency/transaction.h"
+#include "gtest/gtest.h"
+#include "storage/disk/disk_manager_memory.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/table/table_heap.h"
+#include "test_util.h"  // NOLINT
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/** A disk manager that counts the reads of the pages below a boundary. */
+class CountingDiskManager : public DiskManagerUnlimitedMemory {
+ public:
+  void ReadPage(page_id_t page_id, char *page_data) override {
+    if (page_id < boundary_) {
+      reads_++;
+    }
+    DiskManagerUnlimitedMemory::ReadPage(page_id, page_data);
+  }
+
+  std::atomic<page_id_t> boundary_{0};
+  std::atomic<size_t> reads_{0};
+};
+
+// NOLINTNEXTLINE
+TEST(BufferAccessStrategyTest, RingReuseTest) {
+  const size_t buffer_pool_size = 10;
+  const size_t ring_size = 2;
+
+  auto *disk_manager = new DiskManagerUnlimitedMemory();
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 3 * buffer_pool_size; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    snprintf(bpm->FetchPage(page_id_temp)->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: the hot pages are the ones created last. They stay in the pool while a scan reads everything else, as
+  // the scan reuses at most ring_size frames.
+  BufferAccessStrategy strategy(ring_size);
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(2 * buffer_pool_size); ++page_id) {
+    auto *page = bpm->FetchPageWithStrategy(page_id, &strategy);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp(page->GetData(), ("page " + std::to_string(page_id)).c_str()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  size_t hot_hits = 0;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    hot_hits += static_cast<size_t>(bpm->GetPages()[i].GetPageId() >= static_cast<page_id_t>(2 * buffer_pool_size));
+  }
+  EXPECT_GE(hot_hits, buffer_pool_size - ring_size);
+
+  // Scenario: a page of the ring that somebody else uses is not recycled by the scan.
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(2 * buffer_pool_size - 1));
+    EXPECT_EQ(true, bpm->UnpinPage(2 * buffer_pool_size - 1, false));
+  }
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(ring_size); ++page_id) {
+    ASSERT_NE(nullptr, bpm->FetchPageWithStrategy(page_id, &strategy));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  bool resident = false;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    resident |= bpm->GetPages()[i].GetPageId() == static_cast<page_id_t>(2 * buffer_pool_size - 1);
+  }
+  EXPECT_TRUE(resident);
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferAccessStrategyTest, IndexHitRateDuringScanTest) {
+  const size_t buffer_pool_size = 64;
+  const int64_t num_keys = 2000;
+  const size_t num_tuples = 2000;  // about 500 pages, far more than the pool holds
+
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  Schema schema{{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 1024}}};
+
+  for (bool use_strategy : {false, true}) {
+    auto *disk_manager = new CountingDiskManager();
+    auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+    auto *txn = new Transaction(0);
+    page_id_t page_id_temp;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    ASSERT_EQ(HEADER_PAGE_ID, page_id_temp);
+
+    // the index is small enough to stay cached
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+    GenericKey<8> index_key;
+    for (int64_t key = 0; key < num_keys; key++) {
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, RID(static_cast<int32_t>(key >> 32), static_cast<int32_t>(key)), txn);
+    }
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+
+    auto *table = new TableHeap(bpm, nullptr, nullptr, txn);
+    disk_manager->boundary_ = table->GetFirstPageId();
+    for (size_t i = 0; i < num_tuples; i++) {
+      Tuple tuple({ValueFactory::GetIntegerValue(static_cast<int32_t>(i)),
+                   ValueFactory::GetVarcharValue(std::string(1000, 'a'))},
+                  &schema);
+      RID rid;
+      ASSERT_TRUE(table->InsertTuple(tuple, &rid, txn));
+    }
+
+    // warm up the index
+    std::vector<RID> result;
+    for (int round = 0; round < 2; round++) {
+      for (int64_t key = 0; key < num_keys; key++) {
+        index_key.SetFromInteger(key);
+        tree.GetValue(index_key, &result, txn);
+      }
+    }
+    disk_manager->reads_ = 0;
+
+    // Scenario: point lookups run while another thread scans the whole table.
+    std::atomic<bool> done{false};
+    std::thread scan_thread([&] {
+      BufferAccessStrategy strategy;
+      size_t count = 0;
+      for (auto it = table->Begin(txn, use_strategy ? &strategy : nullptr); it != table->End(); ++it) {
+        count++;
+      }
+      EXPECT_EQ(num_tuples, count);
+      done = true;
+    });
+    size_t lookups = 0;
+    for (int64_t key = 0; !done; key = (key + 1) % num_keys, lookups++) {
+      index_key.SetFromInteger(key);
+      result.clear();
+      ASSERT_TRUE(tree.GetValue(index_key, &result, txn));
+    }
+    scan_thread.join();
+
+    double hit_rate =
+        1 - static_cast<double>(disk_manager->reads_) / static_cast<double>(std::max<size_t>(lookups, 1));
+    std::cout << "strategy=" << use_strategy << " lookups=" << lookups << " index page reads=" << disk_manager->reads_
+              << " hit rate>=" << hit_rate << std::endl;
+    if (use_strategy) {
+      EXPECT_GE(hit_rate, 0.99);
+    }
+
+    delete table;
+    delete txn;
+    delete bpm;
+    delete disk_manager;
+  }
+}
+
+}  // namespace bustub
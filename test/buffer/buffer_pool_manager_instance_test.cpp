@@ -12,12 +12,18 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
+#include "storage/disk/disk_manager_memory.h"
 
 namespace bustub {
 
@@ -145,4 +151,312 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   delete disk_manager;
 }
 
+/** A disk manager whose reads take a long time, to make buffer pool misses expensive. */
+class SlowReadDiskManager : public DiskManagerUnlimitedMemory {
+ public:
+  explicit SlowReadDiskManager(std::chrono::milliseconds delay) : delay_(delay) {}
+
+  void ReadPage(page_id_t page_id, char *page_data) override {
+    std::this_thread::sleep_for(delay_);
+    DiskManagerUnlimitedMemory::ReadPage(page_id, page_data);
+  }
+
+ private:
+  std::chrono::milliseconds delay_;
+};
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ConcurrentMissTest) {
+  const size_t buffer_pool_size = 8;
+  const size_t num_pages = 32;
+  const size_t num_misses = 10;
+  const auto read_delay = std::chrono::milliseconds(50);
+
+  auto *disk_manager = new SlowReadDiskManager(read_delay);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  bpm->FlushAllPages();
+
+  // Scenario: the hot page stays pinned, so every fetch of it is a hit.
+  auto *hot_page = bpm->FetchPage(0);
+  ASSERT_NE(nullptr, hot_page);
+
+  // Scenario: another thread keeps missing on the oldest pages, every miss waits for a slow disk read.
+  std::atomic<bool> done{false};
+  std::thread miss_thread([&] {
+    for (size_t i = 0; i < num_misses; ++i) {
+      auto page_id = static_cast<page_id_t>(1 + i);
+      auto *page = bpm->FetchPage(page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(0, strcmp(page->GetData(), ("page " + std::to_string(page_id)).c_str()));
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+    }
+    done = true;
+  });
+
+  // Scenario: hits must not wait for the reads of other pages.
+  std::vector<int64_t> hit_latency_us;
+  while (!done) {
+    auto start = std::chrono::steady_clock::now();
+    auto *page = bpm->FetchPage(0);
+    auto end = std::chrono::steady_clock::now();
+    ASSERT_EQ(hot_page, page);
+    EXPECT_EQ(true, bpm->UnpinPage(0, false));
+    hit_latency_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+  }
+  miss_thread.join();
+
+  ASSERT_FALSE(hit_latency_us.empty());
+  std::sort(hit_latency_us.begin(), hit_latency_us.end());
+  auto p99 = hit_latency_us[hit_latency_us.size() * 99 / 100];
+  EXPECT_LT(p99, std::chrono::duration_cast<std::chrono::microseconds>(read_delay).count() / 2);
+
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, FlushAllWhileMissTest) {
+  const size_t buffer_pool_size = 2;
+  const auto read_delay = std::chrono::milliseconds(100);
+
+  auto *disk_manager = new SlowReadDiskManager(read_delay);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 3; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  bpm->FlushAllPages();
+  // page 2 is dirty in the first frame, page 1 is clean in the second one
+  auto *page = bpm->FetchPage(2);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page 2 changed");
+  EXPECT_EQ(true, bpm->UnpinPage(2, true));
+
+  // Scenario: a miss reads page 0 into the second frame, and all pages are flushed while that read is in flight.
+  std::thread miss_thread([bpm] {
+    auto *page = bpm->FetchPage(0);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp(page->GetData(), "page 0"));
+    EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  });
+  std::this_thread::sleep_for(read_delay / 5);
+  std::thread flush_thread([bpm] { bpm->FlushAllPages(); });
+  std::this_thread::sleep_for(read_delay / 5);
+
+  // Scenario: a second miss while the flush waits for the first one must not take the frame of page 2 away from it,
+  // and finds a frame all the same, as the flush does not keep page 2 pinned while it waits.
+  page = bpm->FetchPage(1);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "page 1"));
+  EXPECT_EQ(true, bpm->UnpinPage(1, false));
+  miss_thread.join();
+  flush_thread.join();
+
+  // the flush wrote page 2 itself to disk, rather than whatever page took its frame
+  char data[BUSTUB_PAGE_SIZE];
+  disk_manager->ReadPage(2, data);
+  EXPECT_EQ(0, strcmp(data, "page 2 changed"));
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, FlushWhileWriteLatchedTest) {
+  const size_t buffer_pool_size = 2;
+
+  auto *disk_manager = new DiskManagerUnlimitedMemory();
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  page_id_t page_id_temp;
+  auto *page = bpm->NewPage(&page_id_temp);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page 0");
+
+  // Scenario: a page is flushed while the thread that has it pinned is halfway through changing it.
+  page->WLatch();
+  snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page 0 half");
+  std::thread flush_thread([bpm] { EXPECT_EQ(true, bpm->FlushPage(0)); });
+  std::thread flush_all_thread([bpm] { bpm->FlushAllPages(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page 0 changed");
+  page->WUnlatch();
+  flush_thread.join();
+  flush_all_thread.join();
+
+  // the flushes waited for the change to be complete
+  char data[BUSTUB_PAGE_SIZE];
+  disk_manager->ReadPage(0, data);
+  EXPECT_EQ(0, strcmp(data, "page 0 changed"));
+  EXPECT_EQ(true, bpm->UnpinPage(0, true));
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PageCleanerTest) {
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManagerUnlimitedMemory();
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  // Scenario: without a cleaner, evicting dirty pages writes them back in the foreground.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 2 * buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  EXPECT_EQ(buffer_pool_size, bpm->GetForegroundWrites());
+  EXPECT_EQ(0, bpm->GetPagesCleaned());
+  EXPECT_DOUBLE_EQ(0, bpm->GetCleanFrameRatio());
+
+  // Scenario: the cleaner writes back every dirty evictable page.
+  bpm->StartPageCleaner(1);
+  for (int i = 0; i < 100 && bpm->GetCleanFrameRatio() < 1; ++i) {
+    std::this_thread::sleep_for(page_cleaner_interval);
+  }
+  EXPECT_DOUBLE_EQ(1, bpm->GetCleanFrameRatio());
+  EXPECT_EQ(buffer_pool_size, bpm->GetPagesCleaned());
+
+  // Scenario: evicting cleaned pages costs no foreground write, and their contents made it to disk.
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(buffer_pool_size); ++page_id) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp(page->GetData(), ("page " + std::to_string(page_id)).c_str()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_EQ(buffer_pool_size, bpm->GetForegroundWrites());
+  for (page_id_t page_id = buffer_pool_size; page_id < static_cast<page_id_t>(2 * buffer_pool_size); ++page_id) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp(page->GetData(), ("page " + std::to_string(page_id)).c_str()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  bpm->StopPageCleaner();
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PrefetchTest) {
+  const size_t buffer_pool_size = 8;
+  const size_t num_pages = 16;
+  const auto read_delay = std::chrono::milliseconds(50);
+
+  auto *disk_manager = new SlowReadDiskManager(read_delay);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: prefetched pages are read in the background, with at most a quarter of the pool per call.
+  bpm->PrefetchPages(0, num_pages);
+  std::this_thread::sleep_for(3 * read_delay);
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(buffer_pool_size / 4); ++page_id) {
+    auto start = std::chrono::steady_clock::now();
+    auto *page = bpm->FetchPage(page_id);
+    auto end = std::chrono::steady_clock::now();
+    ASSERT_NE(nullptr, page);
+    EXPECT_LT(end - start, read_delay / 2);
+    EXPECT_EQ(0, strcmp(page->GetData(), ("page " + std::to_string(page_id)).c_str()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  // Scenario: fetching a page whose prefetch is still in flight waits for that read.
+  bpm->PrefetchPages(2, 1);
+  auto *page = bpm->FetchPage(2);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "page 2"));
+  EXPECT_EQ(true, bpm->UnpinPage(2, false));
+
+  // Scenario: pages that were never allocated are not prefetched.
+  auto pages_prefetched = bpm->GetStats().pages_prefetched_;
+  bpm->PrefetchPages(num_pages, 4);
+  EXPECT_EQ(pages_prefetched, bpm->GetStats().pages_prefetched_);
+  // while an allocated page that is not in the buffer pool is
+  bpm->PrefetchPages(3, 1);
+  EXPECT_EQ(pages_prefetched + 1, bpm->GetStats().pages_prefetched_);
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, StatsTest) {
+  const size_t buffer_pool_size = 4;
+  const auto read_delay = std::chrono::milliseconds(20);
+
+  auto *disk_manager = new SlowReadDiskManager(read_delay);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, 2);
+
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 2 * buffer_pool_size; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: the second half of the new pages evicted the first half, and wrote every one of them back.
+  auto stats = bpm->GetStats();
+  EXPECT_EQ(buffer_pool_size, stats.pool_size_);
+  EXPECT_EQ(0, stats.hits_ + stats.misses_);
+  EXPECT_EQ(buffer_pool_size, stats.evictions_);
+  EXPECT_EQ(buffer_pool_size, stats.dirty_write_backs_);
+  EXPECT_EQ(buffer_pool_size, stats.write_latency_.count_);
+
+  // Scenario: fetching evicted pages misses, fetching them again hits.
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(buffer_pool_size); ++page_id) {
+    for (int i = 0; i < 2; i++) {
+      ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+    }
+  }
+  stats = bpm->GetStats();
+  EXPECT_EQ(buffer_pool_size, stats.hits_);
+  EXPECT_EQ(buffer_pool_size, stats.misses_);
+  EXPECT_DOUBLE_EQ(0.5, stats.HitRate());
+  EXPECT_EQ(2 * buffer_pool_size, stats.evictions_);
+  EXPECT_EQ(buffer_pool_size, stats.read_latency_.count_);
+  EXPECT_GE(stats.read_latency_.MeanMicros(), 1000 * read_delay.count());
+  EXPECT_GE(stats.read_latency_.QuantileMicros(0.5), 1000 * read_delay.count());
+  EXPECT_EQ(0, stats.pin_wait_.count_);
+
+  // Scenario: a fetch of a page whose read is in flight records the time it waited.
+  std::thread reader([bpm] {
+    ASSERT_NE(nullptr, bpm->FetchPage(buffer_pool_size));
+    EXPECT_EQ(true, bpm->UnpinPage(buffer_pool_size, false));
+  });
+  std::this_thread::sleep_for(read_delay / 4);
+  ASSERT_NE(nullptr, bpm->FetchPage(buffer_pool_size));
+  EXPECT_EQ(true, bpm->UnpinPage(buffer_pool_size, false));
+  reader.join();
+  stats = bpm->GetStats();
+  EXPECT_EQ(1, stats.pin_wait_.count_);
+  EXPECT_GT(stats.pin_wait_.total_us_, 0);
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -5,7 +5,10 @@
 #include "buffer/lru_k_replacer.h"
 
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <deque>
+#include <iostream>
 #include <memory>
 #include <random>
 #include <set>
@@ -97,4 +100,159 @@ TEST(LRUKReplacerTest, SampleTest) {
   lru_replacer.Remove(1);
   ASSERT_EQ(0, lru_replacer.Size());
 }
+
+/** Straightforward LRU-K that scans every frame on eviction, used as the reference policy. */
+class ReferenceLRUKReplacer {
+ public:
+  ReferenceLRUKReplacer(size_t num_frames, size_t k) : history_(num_frames), evictable_(num_frames, false), k_(k) {}
+
+  auto Evict(frame_id_t *frame_id) -> bool {
+    bool found = false;
+    bool best_inf = false;
+    size_t best_ts = 0;
+    for (size_t i = 0; i < history_.size(); i++) {
+      if (!evictable_[i] || history_[i].empty()) {
+        continue;
+      }
+      bool inf = history_[i].size() < k_;
+      // +inf frames are ordered by their first access, the others by their kth last access
+      size_t ts = history_[i].front();
+      if (!found || (inf && !best_inf) || (inf == best_inf && ts < best_ts)) {
+        found = true;
+        best_inf = inf;
+        best_ts = ts;
+        *frame_id = static_cast<frame_id_t>(i);
+      }
+    }
+    if (found) {
+      history_[*frame_id].clear();
+      evictable_[*frame_id] = false;
+    }
+    return found;
+  }
+
+  void RecordAccess(frame_id_t frame_id) {
+    history_[frame_id].push_back(timestamp_++);
+    if (history_[frame_id].size() > k_) {
+      history_[frame_id].pop_front();
+    }
+  }
+
+  void SetEvictable(frame_id_t frame_id, bool set_evictable) {
+    if (!history_[frame_id].empty()) {
+      evictable_[frame_id] = set_evictable;
+    }
+  }
+
+  void Remove(frame_id_t frame_id) {
+    if (evictable_[frame_id]) {
+      history_[frame_id].clear();
+      evictable_[frame_id] = false;
+    }
+  }
+
+  auto Size() -> size_t { return std::count(evictable_.begin(), evictable_.end(), true); }
+
+ private:
+  std::vector<std::deque<size_t>> history_;
+  std::vector<bool> evictable_;
+  size_t k_;
+  size_t timestamp_{0};
+};
+
+TEST(LRUKReplacerTest, ScanAccessTest) {
+  LRUKReplacer lru_replacer(4, 2);
+
+  // Scenario: frame 0 has a history, frames 1 and 2 are only seen by scans, frame 3 by a scan and then a lookup.
+  lru_replacer.RecordAccess(0);
+  lru_replacer.RecordAccess(1, AccessType::Scan);
+  lru_replacer.RecordAccess(2, AccessType::Scan);
+  lru_replacer.RecordAccess(3, AccessType::Scan);
+  lru_replacer.RecordAccess(3, AccessType::Lookup);
+  for (frame_id_t frame_id = 0; frame_id < 4; frame_id++) {
+    lru_replacer.SetEvictable(frame_id, true);
+  }
+  EXPECT_TRUE(lru_replacer.IsEvictableScanOnly(1));
+  EXPECT_FALSE(lru_replacer.IsEvictableScanOnly(3));
+
+  // Scenario: scans do not make frame 0 any hotter, and scan-only frames go first, least recently scanned first.
+  lru_replacer.RecordAccess(0, AccessType::Scan);
+  lru_replacer.RecordAccess(1, AccessType::Scan);
+  EXPECT_EQ((std::vector<frame_id_t>{2, 1, 0, 3}), lru_replacer.NextVictims(4));
+
+  int value;
+  lru_replacer.Evict(&value);
+  EXPECT_EQ(2, value);
+  lru_replacer.Evict(&value);
+  EXPECT_EQ(1, value);
+  lru_replacer.Evict(&value);
+  EXPECT_EQ(0, value);
+}
+
+TEST(LRUKReplacerTest, RandomizedReferenceTest) {
+  const size_t num_frames = 64;
+  for (size_t k : {1, 2, 3, 10}) {
+    LRUKReplacer lru_replacer(num_frames, k);
+    ReferenceLRUKReplacer reference(num_frames, k);
+    std::default_random_engine gen(k);
+    std::uniform_int_distribution<frame_id_t> frame_dist(0, num_frames - 1);
+    std::uniform_int_distribution<int> op_dist(0, 9);
+
+    for (size_t i = 0; i < 20000; i++) {
+      auto frame_id = frame_dist(gen);
+      auto op = op_dist(gen);
+      if (op < 5) {
+        lru_replacer.RecordAccess(frame_id);
+        reference.RecordAccess(frame_id);
+      } else if (op < 8) {
+        lru_replacer.SetEvictable(frame_id, op == 5 || op == 6);
+        reference.SetEvictable(frame_id, op == 5 || op == 6);
+      } else if (op < 9) {
+        lru_replacer.Remove(frame_id);
+        reference.Remove(frame_id);
+      } else {
+        frame_id_t victim = -1;
+        frame_id_t expected = -1;
+        ASSERT_EQ(reference.Evict(&expected), lru_replacer.Evict(&victim));
+        ASSERT_EQ(expected, victim);
+      }
+      ASSERT_EQ(reference.Size(), lru_replacer.Size());
+    }
+  }
+}
+
+TEST(LRUKReplacerTest, DISABLED_EvictBenchmark) {
+  const size_t k = 10;
+  const size_t num_ops = 1000000;
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (size_t num_frames : {1000, 10000, 100000}) {
+    LRUKReplacer lru_replacer(num_frames, k);
+    std::default_random_engine gen(0);
+    std::uniform_int_distribution<frame_id_t> frame_dist(0, num_frames - 1);
+    for (size_t i = 0; i < num_frames; i++) {
+      lru_replacer.RecordAccess(static_cast<frame_id_t>(i));
+      lru_replacer.SetEvictable(static_cast<frame_id_t>(i), true);
+    }
+
+    // Mimic a full buffer pool: every op pins a frame, and every tenth op is a miss that evicts a victim.
+    auto clock_start = std::chrono::system_clock::now();
+    for (size_t i = 0; i < num_ops; i++) {
+      frame_id_t frame_id = frame_dist(gen);
+      if (i % 10 == 0 && lru_replacer.Evict(&frame_id)) {
+        lru_replacer.RecordAccess(frame_id);
+        lru_replacer.SetEvictable(frame_id, true);
+        continue;
+      }
+      lru_replacer.RecordAccess(frame_id);
+      lru_replacer.SetEvictable(frame_id, false);
+      lru_replacer.SetEvictable(frame_id, true);
+    }
+    auto clock_end = std::chrono::system_clock::now();
+    auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+    std::cout << "frames=" << num_frames << " ops=" << num_ops << " time_ms=" << dur << std::endl;
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
 }  // namespace bustub
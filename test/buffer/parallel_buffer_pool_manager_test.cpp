@@ -0,0 +1,185 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parallel_buffer_pool_manager_test.cpp
+//
+// Identification: test/buffer/parallel_buffer_pool_manager_test.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/parallel_buffer_pool_manager.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/disk/disk_manager_memory.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, SampleTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 5;
+  const size_t num_instances = 2;
+  const size_t k = 5;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager, k);
+  EXPECT_EQ(num_instances * buffer_pool_size, bpm->GetPoolSize());
+
+  page_id_t page_id_temp;
+  auto *page0 = bpm->NewPage(&page_id_temp);
+
+  // Scenario: The buffer pool is empty. We should be able to create a new page.
+  ASSERT_NE(nullptr, page0);
+  EXPECT_EQ(0, page_id_temp);
+
+  // Scenario: Once we have a page, we should be able to read and write content.
+  snprintf(page0->GetData(), BUSTUB_PAGE_SIZE, "Hello");
+  EXPECT_EQ(0, strcmp(page0->GetData(), "Hello"));
+
+  // Scenario: New pages are spread round-robin, so every id is owned by exactly one instance.
+  std::vector<page_id_t> page_ids{page_id_temp};
+  for (size_t i = 1; i < buffer_pool_size * num_instances; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    page_ids.push_back(page_id_temp);
+  }
+  std::sort(page_ids.begin(), page_ids.end());
+  EXPECT_EQ(page_ids.end(), std::adjacent_find(page_ids.begin(), page_ids.end()));
+
+  // Scenario: Once all instances are full, we should not be able to create any new pages.
+  for (size_t i = 0; i < buffer_pool_size * num_instances; ++i) {
+    EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  }
+
+  // Scenario: After unpinning every page but page 0, new pages can be created again.
+  for (auto page_id : page_ids) {
+    if (page_id != 0) {
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, true));
+    }
+  }
+  for (size_t i = 1; i < buffer_pool_size * num_instances; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+
+  // Scenario: We should be able to fetch the data we wrote a while ago.
+  EXPECT_EQ(true, bpm->UnpinPage(0, true));
+  EXPECT_EQ(true, bpm->FlushPage(0));
+  page0 = bpm->FetchPage(0);
+  ASSERT_NE(nullptr, page0);
+  EXPECT_EQ(0, strcmp(page0->GetData(), "Hello"));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  EXPECT_EQ(true, bpm->DeletePage(0));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, ConcurrencyTest) {
+  const size_t num_threads = 8;
+  const size_t num_pages = 64;
+  const size_t num_instances = 4;
+
+  auto *disk_manager = new DiskManagerUnlimitedMemory();
+  auto *bpm = new ParallelBufferPoolManager(num_instances, 16, disk_manager);
+
+  std::vector<std::thread> threads;
+  for (size_t tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([bpm, tid] {
+      std::vector<page_id_t> page_ids;
+      for (size_t i = 0; i < num_pages; i++) {
+        page_id_t page_id;
+        auto *page = bpm->NewPage(&page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "%zu-%d", tid, page_id);
+        page_ids.push_back(page_id);
+        EXPECT_EQ(true, bpm->UnpinPage(page_id, true));
+      }
+      for (auto page_id : page_ids) {
+        auto *page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        EXPECT_EQ(0, strcmp(page->GetData(), (std::to_string(tid) + "-" + std::to_string(page_id)).c_str()));
+        EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, DISABLED_ShardingBenchmark) {
+  const size_t total_frames = 1024;
+  const size_t num_pages = 2048;
+  const size_t ops_per_thread = 200000;
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (size_t num_instances : {1, 4, 16}) {
+    for (size_t num_threads : {1, 4, 16}) {
+      auto *disk_manager = new DiskManagerUnlimitedMemory();
+      auto *bpm = new ParallelBufferPoolManager(num_instances, total_frames / num_instances, disk_manager);
+      for (size_t i = 0; i < num_pages; i++) {
+        page_id_t page_id;
+        if (bpm->NewPage(&page_id) != nullptr) {
+          bpm->UnpinPage(page_id, true);
+        }
+      }
+
+      auto clock_start = std::chrono::system_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t tid = 0; tid < num_threads; tid++) {
+        threads.emplace_back([bpm, tid] {
+          std::default_random_engine gen(tid);
+          // Skewed access, most fetches hit a hot set that fits in the pool.
+          std::uniform_int_distribution<page_id_t> hot(0, num_pages / 4 - 1);
+          std::uniform_int_distribution<page_id_t> cold(0, num_pages - 1);
+          for (size_t i = 0; i < ops_per_thread; i++) {
+            page_id_t page_id = i % 10 == 0 ? cold(gen) : hot(gen);
+            if (bpm->FetchPage(page_id) != nullptr) {
+              bpm->UnpinPage(page_id, false);
+            }
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto clock_end = std::chrono::system_clock::now();
+      auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+      std::cout << "instances=" << num_instances << " threads=" << num_threads
+                << " ops/ms=" << static_cast<double>(num_threads * ops_per_thread) / std::max<int64_t>(dur, 1)
+                << std::endl;
+
+      delete bpm;
+      delete disk_manager;
+    }
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
+}  // namespace bustub
@@ -2,7 +2,10 @@
  * deadlock_detection_test.cpp
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
 #include <random>
 #include <thread>  // NOLINT
 
@@ -21,7 +24,7 @@
       << "Test Failed Due to Time Out";
 
 namespace bustub {
-TEST(LockManagerDeadlockDetectionTest, DISABLED_EdgeTest) {
+TEST(LockManagerDeadlockDetectionTest, EdgeTest) {
   LockManager lock_mgr{};
 
   const int num_nodes = 100;
@@ -63,7 +66,7 @@ TEST(LockManagerDeadlockDetectionTest, DISABLED_EdgeTest) {
   }
 }
 
-TEST(LockManagerDeadlockDetectionTest, DISABLED_BasicDeadlockDetectionTest) {
+TEST(LockManagerDeadlockDetectionTest, BasicDeadlockDetectionTest) {
   LockManager lock_mgr{};
   TransactionManager txn_mgr{&lock_mgr};
 
@@ -122,4 +125,240 @@ TEST(LockManagerDeadlockDetectionTest, DISABLED_BasicDeadlockDetectionTest) {
   delete txn0;
   delete txn1;
 }
+
+TEST(LockManagerDeadlockDetectionTest, CycleTest) {
+  LockManager lock_mgr{};
+
+  lock_mgr.AddEdge(3, 4);
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  txn_id_t txn_id = INVALID_TXN_ID;
+  EXPECT_FALSE(lock_mgr.HasCycle(&txn_id));
+
+  // the youngest transaction of the cycle is the victim
+  lock_mgr.AddEdge(2, 0);
+  EXPECT_TRUE(lock_mgr.HasCycle(&txn_id));
+  EXPECT_EQ(2, txn_id);
+
+  lock_mgr.RemoveEdge(1, 2);
+  EXPECT_FALSE(lock_mgr.HasCycle(&txn_id));
+  EXPECT_EQ(3, lock_mgr.GetEdgeList().size());
+}
+
+TEST(LockManagerDeadlockDetectionTest, ThreeWayDeadlockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t toid{0};
+  const int num_txns = 3;
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < num_txns; i++) {
+    txns.push_back(txn_mgr.Begin());
+    EXPECT_TRUE(lock_mgr.LockTable(txns[i], LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+    EXPECT_TRUE(lock_mgr.LockRow(txns[i], LockManager::LockMode::EXCLUSIVE, toid, RID{i, 0}));
+  }
+
+  // each transaction waits for the row of the next one, the youngest one closes the cycle
+  std::atomic<int> num_blocked{0};
+  std::vector<std::thread> threads;
+  std::chrono::steady_clock::duration victim_wait{};
+  for (int i = 0; i < num_txns; i++) {
+    threads.emplace_back([&, i] {
+      if (i == num_txns - 1) {
+        while (num_blocked.load() != num_txns - 1) {
+          std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      num_blocked++;
+      auto start = std::chrono::steady_clock::now();
+      bool res = lock_mgr.LockRow(txns[i], LockManager::LockMode::EXCLUSIVE, toid, RID{(i + 1) % num_txns, 0});
+      if (i == num_txns - 1) {
+        victim_wait = std::chrono::steady_clock::now() - start;
+        EXPECT_FALSE(res);
+        EXPECT_EQ(TransactionState::ABORTED, txns[i]->GetState());
+        txn_mgr.Abort(txns[i]);
+      } else {
+        EXPECT_TRUE(res);
+        txn_mgr.Commit(txns[i]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // the victim is found when it blocks, not at the next periodic run
+  EXPECT_LT(victim_wait, cycle_detection_interval);
+  EXPECT_TRUE(lock_mgr.GetEdgeList().empty());
+  for (auto *txn : txns) {
+    delete txn;
+  }
+}
+
+TEST(LockManagerDeadlockDetectionTest, WoundWaitTest) {
+  LockManager lock_mgr{DeadlockPolicy::WOUND_WAIT};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t toid{0};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+
+  // the younger transaction waits for the older one
+  std::thread t1([&] {
+    EXPECT_FALSE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+    EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+    txn_mgr.Abort(txn1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(TransactionState::GROWING, txn1->GetState());
+
+  // the older transaction wounds the younger one instead of waiting for it
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+  t1.join();
+  txn_mgr.Commit(txn0);
+  EXPECT_TRUE(lock_mgr.GetEdgeList().empty());
+
+  delete txn0;
+  delete txn1;
+}
+
+TEST(LockManagerDeadlockDetectionTest, WoundBeforeCommitTest) {
+  LockManager lock_mgr{DeadlockPolicy::WOUND_WAIT};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t toid{0};
+  RID rid{0, 0};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid));
+
+  // the older transaction wounds the younger one, which is running, and waits for it to release the row
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid));
+    txn_mgr.Commit(txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+
+  // the wounded transaction is rolled back when it tries to commit
+  txn_mgr.Commit(txn1);
+  EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+  t0.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0->GetState());
+
+  delete txn0;
+  delete txn1;
+}
+
+TEST(LockManagerDeadlockDetectionTest, WaitDieTest) {
+  LockManager lock_mgr{DeadlockPolicy::WAIT_DIE};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t toid{0};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+
+  // the older transaction waits for the younger one
+  std::thread t0([&] {
+    EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+    txn_mgr.Commit(txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(TransactionState::GROWING, txn0->GetState());
+
+  // the younger transaction dies instead of waiting for the older one
+  EXPECT_FALSE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+  EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+  txn_mgr.Abort(txn1);
+  t0.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0->GetState());
+
+  delete txn0;
+  delete txn1;
+}
+
+/** Short transactions that lock a few hot rows in random order, retried when aborted. */
+auto MeasureDeadlockPolicy(DeadlockPolicy deadlock_policy, size_t num_threads, size_t num_rows, size_t *num_aborts)
+    -> double {
+  const size_t txns_per_thread = 500;
+  const size_t rows_per_txn = 4;
+  LockManager lock_mgr{deadlock_policy};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+  std::atomic<size_t> aborts{0};
+
+  auto task = [&](size_t thread) {
+    std::mt19937 rng(thread);
+    std::uniform_int_distribution<size_t> rows(0, num_rows - 1);
+    std::vector<RID> rids;
+    for (size_t i = 0; i < txns_per_thread; i++) {
+      rids.clear();
+      while (rids.size() < rows_per_txn) {
+        RID rid{0, static_cast<uint32_t>(rows(rng))};
+        if (std::find(rids.begin(), rids.end(), rid) == rids.end()) {
+          rids.push_back(rid);
+        }
+      }
+      while (true) {
+        auto *txn = txn_mgr.Begin();
+        bool success = lock_mgr.LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, oid);
+        for (size_t j = 0; success && j < rids.size(); j++) {
+          success = lock_mgr.LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, rids[j]);
+        }
+        if (success) {
+          txn_mgr.Commit(txn);
+          delete txn;
+          break;
+        }
+        txn_mgr.Abort(txn);
+        delete txn;
+        aborts++;
+      }
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < num_threads; thread++) {
+    threads.emplace_back(task, thread);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  *num_aborts = aborts.load();
+  return static_cast<double>(num_threads * txns_per_thread) / elapsed;
+}
+
+// NOLINTNEXTLINE
+TEST(LockManagerDeadlockDetectionTest, DISABLED_DeadlockPolicyBenchmark) {
+  const size_t num_threads = 8;
+  std::cout << "<<< BEGIN" << std::endl;
+  for (size_t num_rows : {16, 256}) {
+    for (auto [deadlock_policy, name] : {std::make_pair(DeadlockPolicy::DETECTION, "detection"),
+                                         std::make_pair(DeadlockPolicy::WOUND_WAIT, "wound-wait"),
+                                         std::make_pair(DeadlockPolicy::WAIT_DIE, "wait-die")}) {
+      size_t num_aborts;
+      double throughput = MeasureDeadlockPolicy(deadlock_policy, num_threads, num_rows, &num_aborts);
+      std::cout << "rows=" << num_rows << " " << name << " txns/ms=" << throughput << " aborts=" << num_aborts
+                << std::endl;
+    }
+  }
+  std::cout << ">>> END" << std::endl;
+}
 }  // namespace bustub
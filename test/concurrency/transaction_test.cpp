@@ -12,11 +12,15 @@
 
 #include "concurrency/transaction.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <iostream>
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -34,6 +38,8 @@
 #include "execution/plans/nested_index_join_plan.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "gtest/gtest.h"
+#include "storage/disk/disk_manager_memory.h"
+#include "storage/table/table_heap.h"
 #include "test_util.h"  // NOLINT
 #include "type/value_factory.h"
 
@@ -119,4 +125,178 @@ TEST_F(TransactionTest, DISABLED_DirtyReadsTest) {
   delete txn1;
 }
 
+/** A table of integers, with a transaction manager for its transactions. */
+class CounterTable {
+ public:
+  explicit CounterTable(size_t num_rows) {
+    auto *txn = txn_mgr_.Begin();
+    table_ = std::make_unique<TableHeap>(&bpm_, &lock_mgr_, nullptr, txn);
+    rids_.resize(num_rows);
+    for (auto &rid : rids_) {
+      EXPECT_TRUE(table_->InsertTuple(MakeTuple(0), &rid, txn));
+    }
+    txn_mgr_.Commit(txn);
+    delete txn;
+  }
+
+  auto MakeTuple(int32_t value) -> Tuple { return Tuple({ValueFactory::GetIntegerValue(value)}, &schema_); }
+
+  /** @return the value of a row, or -1 if the transaction cannot read it */
+  auto Read(size_t row, Transaction *txn) -> int32_t {
+    Tuple tuple;
+    return table_->GetTuple(rids_[row], &tuple, txn) ? tuple.GetValue(&schema_, 0).GetAs<int32_t>() : -1;
+  }
+
+  auto Write(size_t row, int32_t value, Transaction *txn) -> bool {
+    return table_->UpdateTuple(MakeTuple(value), rids_[row], txn);
+  }
+
+  DiskManagerUnlimitedMemory disk_manager_;
+  BufferPoolManagerInstance bpm_{16, &disk_manager_};
+  LockManager lock_mgr_;
+  TransactionManager txn_mgr_{&lock_mgr_};
+  Schema schema_{{Column{"a", TypeId::INTEGER}}};
+  std::unique_ptr<TableHeap> table_;
+  std::vector<RID> rids_;
+};
+
+// NOLINTNEXTLINE
+TEST(OptimisticTransactionTest, ValidationTest) {
+  CounterTable table(2);
+  auto &txn_mgr = table.txn_mgr_;
+
+  // a read of a tuple another transaction wrote and committed meanwhile fails validation
+  auto *txn1 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto *txn2 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(0, table.Read(0, txn1));
+  EXPECT_TRUE(table.Write(1, 1, txn1));
+  EXPECT_EQ(0, table.Read(0, txn2));
+  EXPECT_TRUE(table.Write(0, 1, txn2));
+  EXPECT_TRUE(txn_mgr.Commit(txn2));
+  CheckCommitted(txn2);
+  EXPECT_FALSE(txn_mgr.Commit(txn1));
+  CheckAborted(txn1);
+  delete txn1;
+  delete txn2;
+
+  // the aborted write was rolled back, the reads of a transaction validate against its own writes
+  auto *txn3 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(1, table.Read(0, txn3));
+  EXPECT_EQ(0, table.Read(1, txn3));
+  EXPECT_TRUE(table.Write(1, 2, txn3));
+  EXPECT_EQ(2, table.Read(1, txn3));
+  txn_mgr.Commit(txn3);
+  CheckCommitted(txn3);
+  delete txn3;
+
+  // a tuple another transaction is writing cannot be read or written
+  auto *txn4 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto *txn5 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto *txn6 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_TRUE(table.Write(0, 3, txn4));
+  EXPECT_EQ(-1, table.Read(0, txn5));
+  CheckAborted(txn5);
+  EXPECT_FALSE(table.Write(0, 4, txn6));
+  CheckAborted(txn6);
+  txn_mgr.Abort(txn6);
+  txn_mgr.Abort(txn5);
+  txn_mgr.Abort(txn4);
+  delete txn4;
+  delete txn5;
+  delete txn6;
+
+  // unlocked again by the abort, at the committed version
+  auto *txn7 = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(1, table.Read(0, txn7));
+  EXPECT_EQ(2, table.Read(1, txn7));
+  txn_mgr.Commit(txn7);
+  CheckCommitted(txn7);
+  delete txn7;
+}
+
+/**
+ * Increment random rows from several threads, each transaction reads two rows and writes both.
+ * @return the committed transactions per millisecond
+ */
+auto MeasureIncrements(IsolationLevel isolation_level, size_t num_rows, size_t *num_aborts) -> double {
+  const size_t num_threads = 8;
+  const size_t txns_per_thread = 1000;
+  CounterTable table(num_rows);
+  std::atomic<size_t> aborts{0};
+
+  auto task = [&](size_t thread) {
+    std::mt19937 rng(thread);
+    std::uniform_int_distribution<size_t> rows(0, num_rows - 1);
+    for (size_t i = 0; i < txns_per_thread; i++) {
+      size_t row1 = rows(rng);
+      size_t row2 = rows(rng);
+      while (row2 == row1) {
+        row2 = rows(rng);
+      }
+      while (true) {
+        auto *txn = table.txn_mgr_.Begin(nullptr, isolation_level);
+        bool success = true;
+        if (isolation_level != IsolationLevel::OPTIMISTIC) {
+          success = table.lock_mgr_.LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, 0) &&
+                    table.lock_mgr_.LockRow(txn, LockManager::LockMode::EXCLUSIVE, 0, table.rids_[row1]) &&
+                    table.lock_mgr_.LockRow(txn, LockManager::LockMode::EXCLUSIVE, 0, table.rids_[row2]);
+        }
+        for (size_t row : {row1, row2}) {
+          int32_t value = success ? table.Read(row, txn) : -1;
+          success = value >= 0 && table.Write(row, value + 1, txn);
+        }
+        if (success) {
+          table.txn_mgr_.Commit(txn);
+          success = txn->GetState() == TransactionState::COMMITTED;
+        } else {
+          table.txn_mgr_.Abort(txn);
+        }
+        delete txn;
+        if (success) {
+          break;
+        }
+        aborts++;
+      }
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < num_threads; thread++) {
+    threads.emplace_back(task, thread);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  // no increment is lost
+  auto *txn = table.txn_mgr_.Begin();
+  int64_t sum = 0;
+  for (size_t row = 0; row < num_rows; row++) {
+    sum += table.Read(row, txn);
+  }
+  table.txn_mgr_.Commit(txn);
+  delete txn;
+  EXPECT_EQ(2 * num_threads * txns_per_thread, sum);
+
+  *num_aborts = aborts.load();
+  return static_cast<double>(num_threads * txns_per_thread) / elapsed;
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticTransactionTest, DISABLED_OptimisticBenchmark) {
+  std::cout << "<<< BEGIN" << std::endl;
+  for (size_t num_rows : {8, 4096}) {
+    for (auto [isolation_level, name] : {std::make_pair(IsolationLevel::REPEATABLE_READ, "2pl"),
+                                         std::make_pair(IsolationLevel::OPTIMISTIC, "occ")}) {
+      size_t num_aborts;
+      double throughput = MeasureIncrements(isolation_level, num_rows, &num_aborts);
+      std::cout << "rows=" << num_rows << " " << name << " txns/ms=" << throughput << " aborts=" << num_aborts
+                << std::endl;
+    }
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
 }  // namespace bustub
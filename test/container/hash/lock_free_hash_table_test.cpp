@@ -0,0 +1,170 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_free_hash_table_test.cpp
+//
+// Identification: test/container/hash/lock_free_hash_table_test.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "container/hash/lock_free_hash_table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "container/hash/extendible_hash_table.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(LockFreeHashTableTest, SampleTest) {
+  auto table = std::make_unique<LockFreeHashTable<page_id_t, frame_id_t>>(10);
+  EXPECT_EQ(32, table->GetCapacity());
+
+  for (int i = 0; i < 10; i++) {
+    table->Insert(i * 32, i);  // every key hashes to a different slot, or collides; both must work
+  }
+  EXPECT_EQ(10, table->Size());
+
+  frame_id_t result;
+  EXPECT_TRUE(table->Find(96, result));
+  EXPECT_EQ(3, result);
+  EXPECT_FALSE(table->Find(97, result));
+
+  table->Insert(96, 42);
+  EXPECT_EQ(10, table->Size());
+  EXPECT_TRUE(table->Find(96, result));
+  EXPECT_EQ(42, result);
+
+  EXPECT_TRUE(table->Remove(96));
+  EXPECT_FALSE(table->Remove(96));
+  EXPECT_FALSE(table->Find(96, result));
+  EXPECT_EQ(9, table->Size());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(i != 3, table->Find(i * 32, result));
+  }
+}
+
+TEST(LockFreeHashTableTest, RandomizedReferenceTest) {
+  const size_t max_entries = 64;
+  auto table = std::make_unique<LockFreeHashTable<page_id_t, frame_id_t>>(max_entries);
+  std::unordered_map<page_id_t, frame_id_t> reference;
+
+  std::mt19937 gen(15445);
+  std::uniform_int_distribution<page_id_t> key_dist(0, 255);
+  for (int i = 0; i < 100000; i++) {
+    page_id_t key = key_dist(gen);
+    frame_id_t value;
+    if (gen() % 2 == 0 && reference.size() < max_entries) {
+      table->Insert(key, i);
+      reference[key] = i;
+    } else {
+      EXPECT_EQ(reference.erase(key) == 1, table->Remove(key));
+    }
+    page_id_t probe = key_dist(gen);
+    auto it = reference.find(probe);
+    ASSERT_EQ(it != reference.end(), table->Find(probe, value));
+    if (it != reference.end()) {
+      EXPECT_EQ(it->second, value);
+    }
+  }
+  EXPECT_EQ(reference.size(), table->Size());
+}
+
+TEST(LockFreeHashTableTest, ConcurrentReadWriteTest) {
+  const int num_readers = 4;
+  const int num_stable = 32;
+  auto table = std::make_unique<LockFreeHashTable<page_id_t, frame_id_t>>(128);
+
+  // Keys that never change must always be found, however much the writer moves entries around them.
+  for (int i = 0; i < num_stable; i++) {
+    table->Insert(i * 2, i);
+  }
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (int tid = 0; tid < num_readers; tid++) {
+    readers.emplace_back([&table, &done] {
+      while (!done) {
+        for (int i = 0; i < num_stable; i++) {
+          frame_id_t value = -1;
+          ASSERT_TRUE(table->Find(i * 2, value));
+          ASSERT_EQ(i, value);
+        }
+      }
+    });
+  }
+  std::thread writer([&table] {
+    for (int round = 0; round < 2000; round++) {
+      for (int i = 0; i < 64; i++) {
+        table->Insert(i * 2 + 1, round);
+      }
+      for (int i = 0; i < 64; i++) {
+        table->Remove(i * 2 + 1);
+      }
+    }
+  });
+  writer.join();
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(num_stable, table->Size());
+}
+
+template <typename Table>
+static auto MeasureFindOpsPerMs(Table *table, size_t num_threads, page_id_t num_keys) -> double {
+  const size_t ops_per_thread = 1000000;
+  std::atomic<size_t> found{0};
+  auto clock_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([table, tid, num_keys, &found] {
+      std::default_random_engine gen(tid);
+      std::uniform_int_distribution<page_id_t> key_dist(0, num_keys - 1);
+      size_t local_found = 0;
+      for (size_t i = 0; i < ops_per_thread; i++) {
+        frame_id_t value;
+        local_found += static_cast<size_t>(table->Find(key_dist(gen), value));
+      }
+      found += local_found;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - clock_start);
+  EXPECT_EQ(num_threads * ops_per_thread, found.load());
+  return static_cast<double>(num_threads * ops_per_thread) / std::max<int64_t>(dur.count(), 1);
+}
+
+// NOLINTNEXTLINE
+TEST(LockFreeHashTableTest, DISABLED_HitPathBenchmark) {
+  const page_id_t num_keys = 1024;  // a page table for a pool of 1024 frames, every lookup hits
+  auto lock_free = std::make_unique<LockFreeHashTable<page_id_t, frame_id_t>>(num_keys);
+  auto extendible = std::make_unique<ExtendibleHashTable<page_id_t, frame_id_t>>(4);
+  for (page_id_t i = 0; i < num_keys; i++) {
+    lock_free->Insert(i, i);
+    extendible->Insert(i, i);
+  }
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (size_t num_threads : {1, 4, 16, 64}) {
+    std::cout << "threads=" << num_threads
+              << " extendible ops/ms=" << MeasureFindOpsPerMs(extendible.get(), num_threads, num_keys)
+              << " lock_free ops/ms=" << MeasureFindOpsPerMs(lock_free.get(), num_threads, num_keys) << std::endl;
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
+}  // namespace bustub
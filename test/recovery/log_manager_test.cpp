@@ -0,0 +1,324 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_manager_test.cpp
+//
+// Identification: test/recovery/log_manager_test.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+/** A disk manager whose log writes take a while, like a log write followed by an fsync. */
+class SlowLogDiskManager : public DiskManager {
+ public:
+  SlowLogDiskManager(const std::string &db_file, std::chrono::microseconds write_log_latency)
+      : DiskManager(db_file), write_log_latency_(write_log_latency) {}
+
+  void WriteLog(char *log_data, int size) override {
+    std::this_thread::sleep_for(write_log_latency_);
+    DiskManager::WriteLog(log_data, size);
+  }
+
+ private:
+  std::chrono::microseconds write_log_latency_;
+};
+
+/** @return all log records in the log file, in the order in which they are laid out */
+auto ReadLogRecords(DiskManager *disk_manager) -> std::vector<LogRecord> {
+  std::vector<char> log(disk_manager->GetLogSize());
+  disk_manager->ReadLog(log.data(), static_cast<int>(log.size()), 0);
+  std::vector<LogRecord> records;
+  int offset = 0;
+  LogRecord record;
+  while (LogRecovery::DeserializeLogRecord(log.data() + offset, static_cast<int>(log.size()) - offset, &record)) {
+    records.push_back(record);
+    offset += record.GetSize();
+  }
+  EXPECT_EQ(log.size(), offset);
+  return records;
+}
+
+}  // namespace
+
+class LogManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    remove("test.db");
+    remove("test.log");
+  }
+
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+  }
+};
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, AppendAndFlushTest) {
+  DiskManager disk_manager("test.db");
+  LogManager log_manager(&disk_manager);
+
+  // a serialized tuple: its size, then its data
+  char data[16];
+  int32_t tuple_size = sizeof(data) - sizeof(int32_t);
+  memcpy(data, &tuple_size, sizeof(int32_t));
+  memset(data + sizeof(int32_t), 'x', tuple_size);
+  Tuple tuple;
+  tuple.DeserializeFrom(data);
+  RID rid(3, 7);
+
+  LogRecord begin(0, INVALID_LSN, LogRecordType::BEGIN);
+  EXPECT_EQ(0, log_manager.AppendLogRecord(&begin));
+  LogRecord insert(0, begin.GetLSN(), LogRecordType::INSERT, rid, tuple);
+  EXPECT_EQ(1, log_manager.AppendLogRecord(&insert));
+  LogRecord commit(0, insert.GetLSN(), LogRecordType::COMMIT);
+  EXPECT_EQ(2, log_manager.AppendLogRecord(&commit));
+  EXPECT_EQ(3, log_manager.GetNextLSN());
+  EXPECT_EQ(INVALID_LSN, log_manager.GetPersistentLSN());
+
+  // without a flush thread, waiting for a record flushes the log right away
+  log_manager.WaitForFlush(commit.GetLSN());
+  EXPECT_EQ(2, log_manager.GetPersistentLSN());
+  EXPECT_EQ(1, log_manager.GetNumLogWrites());
+  // nothing new to write
+  log_manager.Flush();
+  EXPECT_EQ(1, log_manager.GetNumLogWrites());
+
+  auto records = ReadLogRecords(&disk_manager);
+  ASSERT_EQ(3, records.size());
+  EXPECT_EQ(LogRecordType::BEGIN, records[0].GetLogRecordType());
+  EXPECT_EQ(LogRecordType::INSERT, records[1].GetLogRecordType());
+  EXPECT_EQ(LogRecordType::COMMIT, records[2].GetLogRecordType());
+  for (lsn_t lsn = 0; lsn < 3; lsn++) {
+    EXPECT_EQ(lsn, records[lsn].GetLSN());
+    EXPECT_EQ(lsn - 1, records[lsn].GetPrevLSN());
+    EXPECT_EQ(0, records[lsn].GetTxnId());
+  }
+  EXPECT_EQ(insert.GetSize(), records[1].GetSize());
+
+  // the body of the insert record: the RID, then the tuple
+  EXPECT_EQ(rid, records[1].GetInsertRID());
+  Tuple &logged_tuple = records[1].GetInsertTuple();
+  ASSERT_EQ(tuple_size, logged_tuple.GetLength());
+  EXPECT_EQ(0, memcmp(data + sizeof(int32_t), logged_tuple.GetData(), logged_tuple.GetLength()));
+
+  // Scenario: a record whose bytes change, e.g. one torn by a crash, does not match its checksum.
+  std::vector<char> log(disk_manager.GetLogSize());
+  ASSERT_TRUE(disk_manager.ReadLog(log.data(), static_cast<int>(log.size()), 0));
+  LogRecord record;
+  int insert_offset = records[0].GetSize();
+  ASSERT_TRUE(LogRecovery::DeserializeLogRecord(log.data() + insert_offset, insert.GetSize(), &record));
+  log[insert_offset + insert.GetSize() - 1] ^= 1;
+  EXPECT_FALSE(LogRecovery::DeserializeLogRecord(log.data() + insert_offset, insert.GetSize(), &record));
+  // and a record that is cut off is incomplete
+  EXPECT_FALSE(LogRecovery::DeserializeLogRecord(log.data(), records[0].GetSize() - 1, &record));
+
+  disk_manager.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, UpdateRecordTest) {
+  DiskManager disk_manager("test.db");
+  LogManager log_manager(&disk_manager);
+
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 40};
+  Column col3{"c", TypeId::INTEGER};
+  Schema schema{{col1, col2, col3}};
+  std::string text(40, 'x');
+  Tuple old_tuple({ValueFactory::GetIntegerValue(1), ValueFactory::GetVarcharValue(text),
+                   ValueFactory::GetIntegerValue(3)},
+                  &schema);
+  Tuple new_tuple({ValueFactory::GetIntegerValue(1), ValueFactory::GetVarcharValue(text),
+                   ValueFactory::GetIntegerValue(4)},
+                  &schema);
+  RID rid(3, 7);
+
+  LogRecord update(0, INVALID_LSN, LogRecordType::UPDATE, rid, old_tuple, new_tuple);
+  log_manager.AppendLogRecord(&update);
+  log_manager.Flush();
+  // only the changed byte of the last column is logged, not both tuples
+  EXPECT_LT(update.GetSize(), 24);
+  EXPECT_LT(update.GetSize(), old_tuple.GetLength());
+
+  auto records = ReadLogRecords(&disk_manager);
+  ASSERT_EQ(1, records.size());
+  EXPECT_EQ(LogRecordType::UPDATE, records[0].GetLogRecordType());
+  EXPECT_EQ(rid, records[0].GetUpdateRID());
+  EXPECT_EQ(1, records[0].GetOriginalTuple().GetLength());
+  EXPECT_EQ(3, records[0].GetOriginalTuple().GetData()[0]);
+  EXPECT_EQ(1, records[0].GetUpdateTuple().GetLength());
+  EXPECT_EQ(4, records[0].GetUpdateTuple().GetData()[0]);
+
+  disk_manager.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, ConcurrentAppendTest) {
+  const size_t num_threads = 8;
+  // enough records to fill the log buffers a few times, a BEGIN record takes at least 9 bytes
+  const size_t records_per_thread = 3 * LOG_BUFFER_SIZE / 9 / num_threads;
+
+  DiskManager disk_manager("test.db");
+  LogManager log_manager(&disk_manager);
+  log_manager.RunFlushThread();
+  EXPECT_TRUE(enable_logging);
+
+  std::vector<std::thread> threads;
+  for (size_t tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&log_manager, records_per_thread, tid] {
+      lsn_t prev_lsn = INVALID_LSN;
+      for (size_t i = 0; i < records_per_thread; i++) {
+        LogRecord record(static_cast<txn_id_t>(tid), prev_lsn, LogRecordType::BEGIN);
+        lsn_t lsn = log_manager.AppendLogRecord(&record);
+        EXPECT_GT(lsn, prev_lsn);
+        prev_lsn = lsn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager.StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+
+  const auto num_records = static_cast<lsn_t>(num_threads * records_per_thread);
+  EXPECT_EQ(num_records - 1, log_manager.GetPersistentLSN());
+  EXPECT_GE(log_manager.GetNumLogWrites(), 3);
+
+  // every record made it to the log, in LSN order, and the records of a thread are chained by their previous LSNs
+  auto records = ReadLogRecords(&disk_manager);
+  ASSERT_EQ(num_records, records.size());
+  std::vector<lsn_t> last_lsn(num_threads, INVALID_LSN);
+  for (lsn_t lsn = 0; lsn < num_records; lsn++) {
+    ASSERT_EQ(lsn, records[lsn].GetLSN());
+    ASSERT_LT(records[lsn].GetTxnId(), num_threads);
+    EXPECT_EQ(last_lsn[records[lsn].GetTxnId()], records[lsn].GetPrevLSN());
+    last_lsn[records[lsn].GetTxnId()] = lsn;
+  }
+
+  disk_manager.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, GroupCommitTest) {
+  const size_t num_threads = 16;
+  const size_t commits_per_thread = 20;
+
+  SlowLogDiskManager disk_manager("test.db", std::chrono::milliseconds(2));
+  LogManager log_manager(&disk_manager);
+  LockManager lock_manager;
+  TransactionManager txn_manager(&lock_manager, &log_manager);
+  log_manager.RunFlushThread();
+
+  std::vector<std::thread> threads;
+  for (size_t tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&] {
+      for (size_t i = 0; i < commits_per_thread; i++) {
+        Transaction *txn = txn_manager.Begin();
+        txn_manager.Commit(txn);
+        // a commit returns once its commit record is persistent
+        EXPECT_GE(log_manager.GetPersistentLSN(), txn->GetPrevLSN());
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager.StopFlushThread();
+
+  // concurrent commits share their log writes, and none of them waited for the flush timeout
+  EXPECT_LT(log_manager.GetNumLogWrites(), num_threads * commits_per_thread);
+  auto records = ReadLogRecords(&disk_manager);
+  EXPECT_EQ(2 * num_threads * commits_per_thread, records.size());
+  EXPECT_EQ(2 * num_threads * commits_per_thread,
+            std::count_if(records.begin(), records.end(), [](LogRecord &record) {
+              return record.GetLogRecordType() == LogRecordType::BEGIN ||
+                     record.GetLogRecordType() == LogRecordType::COMMIT;
+            }));
+
+  disk_manager.ShutDown();
+}
+
+// Commit throughput with a simulated log write latency, with group commit and with every commit flushing the log
+// by itself.
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_GroupCommitBenchmark) {
+  const auto write_log_latency = std::chrono::microseconds(500);
+  const auto duration = std::chrono::seconds(1);
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (bool group_commit : {false, true}) {
+    for (size_t num_clients : {1, 4, 16, 64}) {
+      SlowLogDiskManager disk_manager("test.db", write_log_latency);
+      LogManager log_manager(&disk_manager);
+      LockManager lock_manager;
+      TransactionManager txn_manager(&lock_manager, &log_manager);
+      log_manager.RunFlushThread();
+
+      // without group commit, one commit at a time appends its record and waits for its own log write
+      std::mutex commit_latch;
+      std::atomic<size_t> num_commits{0};
+      auto clock_start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t tid = 0; tid < num_clients; tid++) {
+        threads.emplace_back([&] {
+          while (std::chrono::steady_clock::now() - clock_start < duration) {
+            Transaction *txn = txn_manager.Begin();
+            if (group_commit) {
+              txn_manager.Commit(txn);
+            } else {
+              std::scoped_lock lock(commit_latch);
+              txn_manager.Commit(txn);
+            }
+            delete txn;
+            num_commits += 1;
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto clock_end = std::chrono::steady_clock::now();
+      log_manager.StopFlushThread();
+      auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+      std::cout << "group_commit=" << group_commit << " clients=" << num_clients
+                << " commits/s=" << static_cast<double>(num_commits) * 1000 / std::max<int64_t>(dur, 1)
+                << " commits/log_write="
+                << static_cast<double>(num_commits) / std::max<size_t>(log_manager.GetNumLogWrites(), 1) << std::endl;
+
+      disk_manager.ShutDown();
+      remove("test.db");
+      remove("test.log");
+    }
+  }
+  std::cout << "<<< END" << std::endl;
+}
+
+}  // namespace bustub
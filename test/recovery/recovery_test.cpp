@@ -10,10 +10,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/parallel_buffer_pool_manager.h"
 #include "common/bustub_instance.h"
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
@@ -26,30 +37,160 @@
 #include "recovery/log_manager.h"
 #include "recovery/log_recovery.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/page/header_page.h"
+#include "storage/page/table_page.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "test_util.h"  // NOLINT
 
 namespace bustub {
 
+namespace {
+
+/** The data of every tuple in a table, by page id and slot number. */
+using TableContents = std::map<std::pair<page_id_t, uint32_t>, std::string>;
+
+auto ReadTable(TableHeap *table, TransactionManager *txn_manager) -> TableContents {
+  TableContents tuples;
+  Transaction *txn = txn_manager->Begin();
+  for (auto it = table->Begin(txn); it != table->End(); ++it) {
+    tuples[{it->GetRid().GetPageId(), it->GetRid().GetSlotNum()}] = std::string(it->GetData(), it->GetLength());
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  return tuples;
+}
+
+/** @return the files of the log segments of a database */
+auto LogSegmentFiles(const std::string &name) -> std::vector<std::filesystem::path> {
+  std::vector<std::filesystem::path> files;
+  for (const auto &entry : std::filesystem::directory_iterator(".")) {
+    if (entry.path().filename().string().rfind(name + ".log", 0) == 0) {
+      files.push_back(entry.path());
+    }
+  }
+  return files;
+}
+
+/** Remove the database file, the log segments and the master record of a database. */
+void RemoveDatabase(const std::string &name) {
+  std::filesystem::remove(name + ".db");
+  std::filesystem::remove(name + ".master");
+  for (const auto &file : LogSegmentFiles(name)) {
+    std::filesystem::remove(file);
+  }
+}
+
+/** Replace a database with a copy of another one, e.g. to recover from the same crash more than once. */
+void CopyDatabase(const std::string &from, const std::string &to) {
+  RemoveDatabase(to);
+  std::filesystem::copy_file(from + ".db", to + ".db");
+  if (std::filesystem::exists(from + ".master")) {
+    std::filesystem::copy_file(from + ".master", to + ".master");
+  }
+  for (const auto &file : LogSegmentFiles(from)) {
+    std::filesystem::copy_file(file, to + file.filename().string().substr(from.size()));
+  }
+}
+
+using IndexTree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+using IndexLeafPage = BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>>;
+using IndexInternalPage = BPlusTreeInternalPage<GenericKey<8>, page_id_t, GenericComparator<8>>;
+
+/** Collect the keys under a B+ tree page in order, and check that every page under it has the right parent. */
+void ReadIndexPage(BufferPoolManager *bpm, page_id_t page_id, page_id_t parent_page_id, std::vector<int64_t> *keys) {
+  Page *page = bpm->FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  EXPECT_EQ(parent_page_id, tree_page->GetParentPageId());
+  if (tree_page->IsLeafPage()) {
+    auto *leaf = reinterpret_cast<IndexLeafPage *>(tree_page);
+    for (int i = 0; i < leaf->GetSize(); i++) {
+      keys->push_back(leaf->KeyAt(i).ToString());
+    }
+  } else {
+    auto *internal = reinterpret_cast<IndexInternalPage *>(tree_page);
+    for (int i = 0; i < internal->GetSize(); i++) {
+      ReadIndexPage(bpm, internal->ValueAt(i), page_id, keys);
+    }
+  }
+  bpm->UnpinPage(page_id, false);
+}
+
+/** @return the keys of a B+ tree, after checking that its leaf chain has the same keys as the tree */
+auto ReadIndex(BufferPoolManager *bpm, const std::string &name) -> std::vector<int64_t> {
+  Page *header = bpm->FetchPage(HEADER_PAGE_ID);
+  page_id_t root_page_id = INVALID_PAGE_ID;
+  reinterpret_cast<HeaderPage *>(header->GetData())->GetRootId(name, &root_page_id);
+  bpm->UnpinPage(HEADER_PAGE_ID, false);
+  std::vector<int64_t> keys;
+  if (root_page_id == INVALID_PAGE_ID) {
+    return keys;
+  }
+  ReadIndexPage(bpm, root_page_id, INVALID_PAGE_ID, &keys);
+
+  // the leftmost leaf, and the leaves to its right
+  page_id_t page_id = root_page_id;
+  while (true) {
+    Page *page = bpm->FetchPage(page_id);
+    auto *tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t child_page_id =
+        tree_page->IsLeafPage() ? INVALID_PAGE_ID : reinterpret_cast<IndexInternalPage *>(tree_page)->ValueAt(0);
+    bpm->UnpinPage(page_id, false);
+    if (child_page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    page_id = child_page_id;
+  }
+  std::vector<int64_t> chain_keys;
+  while (page_id != INVALID_PAGE_ID) {
+    Page *page = bpm->FetchPage(page_id);
+    auto *leaf = reinterpret_cast<IndexLeafPage *>(page->GetData());
+    for (int i = 0; i < leaf->GetSize(); i++) {
+      chain_keys.push_back(leaf->KeyAt(i).ToString());
+    }
+    page_id_t next_page_id = leaf->GetNextPageId();
+    bpm->UnpinPage(page_id, false);
+    page_id = next_page_id;
+  }
+  EXPECT_EQ(keys, chain_keys);
+  return keys;
+}
+
+/** A disk manager whose page writes take a while. */
+class SlowPageDiskManager : public DiskManager {
+ public:
+  SlowPageDiskManager(const std::string &db_file, std::chrono::microseconds write_page_latency)
+      : DiskManager(db_file), write_page_latency_(write_page_latency) {}
+
+  void WritePage(page_id_t page_id, const char *page_data) override {
+    std::this_thread::sleep_for(write_page_latency_);
+    DiskManager::WritePage(page_id, page_data);
+  }
+
+ private:
+  std::chrono::microseconds write_page_latency_;
+};
+
+}  // namespace
+
 class RecoveryTest : public ::testing::Test {
  protected:
   // This function is called before every test.
-  void SetUp() override {
-    remove("test.db");
-    remove("test.log");
-  }
+  void SetUp() override { RemoveDatabase("test"); }
 
   // This function is called after every test.
   void TearDown() override {
     LOG_INFO("Tearing down the system..");
-    remove("test.db");
-    remove("test.log");
+    RemoveDatabase("test");
+    RemoveDatabase("crash");
   };
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -138,7 +279,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -217,7 +358,164 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, ParallelRedoTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->txn_manager_;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(5000);
+  for (auto &rid : rids) {
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  for (size_t i = 0; i < rids.size(); i += 3) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+  }
+  for (size_t i = 1; i < rids.size(); i += 5) {
+    test_table->UpdateTuple(ConstructTuple(&schema), rids[i], txn);
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  auto committed = ReadTable(test_table, txn_manager);
+  // some pages are on disk before the crash, they are not redone
+  for (size_t i = 0; i < rids.size(); i += 1000) {
+    bustub_instance->buffer_pool_manager_->FlushPage(rids[i].GetPageId());
+  }
+
+  // a transaction that is still running at the crash, its inserts reuse the slots freed by the deletes
+  Transaction *loser = txn_manager->Begin();
+  for (size_t i = 0; i < 500; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, loser));
+  }
+  for (size_t i = 2; i < rids.size(); i += 21) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], loser));
+  }
+  for (size_t i = 4; i < rids.size(); i += 9) {
+    if (i % 3 != 0) {
+      test_table->UpdateTuple(ConstructTuple(&schema), rids[i], loser);
+    }
+  }
+  // and some are on disk with the changes of the loser, they are undone
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  bustub_instance->buffer_pool_manager_->FlushPage(rids.back().GetPageId());
+  delete loser;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  // the log is flushed when the log manager stops, the pages in the buffer pool are lost
+  delete bustub_instance;
+  CopyDatabase("test", "crash");
+
+  for (size_t num_redo_workers : {1, 4}) {
+    CopyDatabase("crash", "test");
+    bustub_instance = new BustubInstance("test.db");
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, num_redo_workers);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_LT(0, log_recovery.GetNextLSN());
+
+    test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                               bustub_instance->log_manager_, first_page_id);
+    EXPECT_EQ(committed, ReadTable(test_table, bustub_instance->txn_manager_));
+    delete test_table;
+    delete bustub_instance;
+  }
+}
+
+// Restart time for a log of a few million records, by the number of redo workers.
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_RestartBenchmark) {
+  const size_t num_tuples = 2000000;
+  const size_t tuples_per_txn = 10000;
+  const size_t num_instances = 8;
+  const size_t pool_size = 512;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  page_id_t first_page_id;
+  int log_size;
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager);
+    ParallelBufferPoolManager bpm(num_instances, pool_size, &disk_manager, LRUK_REPLACER_K, &log_manager);
+    log_manager.RunFlushThread();
+    // fill the table page by page, a table heap would look for free space from its first page for every insert
+    txn_id_t txn_id = 0;
+    auto txn = std::make_unique<Transaction>(txn_id++);
+    page_id_t page_id;
+    auto *page = reinterpret_cast<TablePage *>(bpm.NewPage(&page_id));
+    page->Init(page_id, BUSTUB_PAGE_SIZE, INVALID_PAGE_ID, &log_manager, txn.get());
+    first_page_id = page_id;
+    for (size_t i = 0; i < num_tuples; i++) {
+      if (i > 0 && i % tuples_per_txn == 0) {
+        LogRecord commit(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+        log_manager.AppendLogRecord(&commit);
+        txn = std::make_unique<Transaction>(txn_id++);
+      }
+      RID rid;
+      if (!page->InsertTuple(tuple, &rid, txn.get(), nullptr, &log_manager)) {
+        page_id_t next_page_id;
+        auto *next_page = reinterpret_cast<TablePage *>(bpm.NewPage(&next_page_id));
+        next_page->Init(next_page_id, BUSTUB_PAGE_SIZE, page_id, &log_manager, txn.get());
+        page->SetNextPageId(next_page_id);
+        bpm.UnpinPage(page_id, true);
+        page = next_page;
+        page_id = next_page_id;
+        ASSERT_TRUE(page->InsertTuple(tuple, &rid, txn.get(), nullptr, &log_manager));
+      }
+    }
+    bpm.UnpinPage(page_id, true);
+    log_manager.StopFlushThread();
+    log_size = disk_manager.GetLogSize();
+    disk_manager.ShutDown();
+  }
+  CopyDatabase("test", "crash");
+
+  std::cout << "<<< BEGIN" << std::endl;
+  std::cout << "log_size=" << log_size << std::endl;
+  for (size_t num_redo_workers : {1, 2, 4, 8, 16}) {
+    CopyDatabase("crash", "test");
+    DiskManager disk_manager("test.db");
+    ParallelBufferPoolManager bpm(num_instances, pool_size, &disk_manager);
+    LogRecovery log_recovery(&disk_manager, &bpm, num_redo_workers);
+
+    auto clock_start = std::chrono::steady_clock::now();
+    log_recovery.Redo();
+    log_recovery.Undo();
+    auto clock_end = std::chrono::steady_clock::now();
+
+    TableHeap table(&bpm, nullptr, nullptr, first_page_id);
+    Transaction txn(0);
+    size_t num_recovered = 0;
+    for (auto it = table.Begin(&txn); it != table.End(); ++it) {
+      num_recovered++;
+    }
+    // the last transaction did not commit
+    EXPECT_EQ(num_tuples - tuples_per_txn, num_recovered);
+
+    auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+    std::cout << "redo_workers=" << num_redo_workers << " records=" << log_recovery.GetNextLSN()
+              << " restart_ms=" << dur << std::endl;
+    disk_manager.ShutDown();
+  }
+  std::cout << "<<< END" << std::endl;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -239,10 +537,8 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   Schema schema{cols};
 
   Tuple tuple = ConstructTuple(&schema);
-  auto val_0 = tuple.GetValue(&schema, 0);
-  auto val_1 = tuple.GetValue(&schema, 1);
 
-  // set log time out very high so that flush doesn't happen before checkpoint is performed
+  // set log time out very high so that only commits and the checkpoint flush the log
   log_timeout = std::chrono::seconds(15);
 
   // insert a ton of tuples
@@ -253,71 +549,621 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   }
   bustub_instance->txn_manager_->Commit(txn1);
 
+  // a transaction that is still running during the checkpoint
+  Transaction *txn2 = bustub_instance->txn_manager_->Begin();
+  RID rid2;
+  EXPECT_TRUE(test_table->InsertTuple(tuple, &rid2, txn2));
+
   // Do checkpoint
+  int num_writes = bustub_instance->disk_manager_->GetNumWrites();
   bustub_instance->checkpoint_manager_->BeginCheckpoint();
   bustub_instance->checkpoint_manager_->EndCheckpoint();
 
-  // Hacky
+  // the checkpoint is fuzzy, it did not write any page
+  EXPECT_EQ(num_writes, bustub_instance->disk_manager_->GetNumWrites());
+
+  // Verify the checkpoint made it to disk
+  lsn_t persistent_lsn = bustub_instance->log_manager_->GetPersistentLSN();
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+  EXPECT_EQ(persistent_lsn, (next_lsn - 1));
+  MasterRecord master_record;
+  ASSERT_TRUE(bustub_instance->disk_manager_->ReadMasterRecord(reinterpret_cast<char *>(&master_record),
+                                                               sizeof(MasterRecord)));
+  EXPECT_EQ(persistent_lsn, master_record.end_checkpoint_lsn_);
+
+  // find the end checkpoint record in the log write the master record points to
+  std::vector<char> log_write(LOG_BUFFER_SIZE);
+  ASSERT_TRUE(bustub_instance->disk_manager_->ReadLog(log_write.data(), LOG_BUFFER_SIZE,
+                                                      master_record.end_checkpoint_offset_));
+  LogRecord end_checkpoint;
+  for (int pos = 0; pos < LOG_BUFFER_SIZE; pos += end_checkpoint.GetSize()) {
+    ASSERT_TRUE(LogRecovery::DeserializeLogRecord(log_write.data() + pos, LOG_BUFFER_SIZE - pos, &end_checkpoint));
+    if (end_checkpoint.GetLSN() == master_record.end_checkpoint_lsn_) {
+      break;
+    }
+  }
+  ASSERT_EQ(LogRecordType::END_CHECKPOINT, end_checkpoint.GetLogRecordType());
+  EXPECT_EQ(bustub_instance->checkpoint_manager_->GetScanStart(), end_checkpoint.GetScanStart());
+
+  // only the running transaction is in the active transaction table
+  ASSERT_EQ(1, end_checkpoint.GetActiveTxns().size());
+  EXPECT_EQ(txn2->GetTransactionId(), end_checkpoint.GetActiveTxns()[0].first);
+  EXPECT_LE(end_checkpoint.GetActiveTxns()[0].second, txn2->GetPrevLSN());
+
+  // every dirty page in the buffer pool is in the dirty page table, and its first change is not before its recLSN
+  std::map<page_id_t, lsn_t> dirty_pages(end_checkpoint.GetDirtyPages().begin(),
+                                         end_checkpoint.GetDirtyPages().end());
   Page *pages = dynamic_cast<BufferPoolManagerInstance *>(bustub_instance->buffer_pool_manager_)->GetPages();
   size_t pool_size = bustub_instance->buffer_pool_manager_->GetPoolSize();
-
-  // make sure that all pages in the buffer pool are marked as non-dirty
-  bool all_pages_clean = true;
+  size_t num_dirty_pages = 0;
   for (size_t i = 0; i < pool_size; i++) {
     Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
+    if (page->GetPageId() != INVALID_PAGE_ID && page->IsDirty()) {
+      num_dirty_pages++;
+      ASSERT_EQ(1, dirty_pages.count(page->GetPageId()));
+      EXPECT_LE(dirty_pages[page->GetPageId()], page->GetLSN());
+    }
+  }
+  EXPECT_LT(0, num_dirty_pages);
 
-    if (page_id != INVALID_PAGE_ID && page->IsDirty()) {
-      all_pages_clean = false;
-      break;
+  log_timeout = std::chrono::seconds(1);
+  bustub_instance->txn_manager_->Commit(txn2);
+  delete txn;
+  delete txn1;
+  delete txn2;
+  delete test_table;
+
+  LOG_INFO("Shutdown System");
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointRecoveryTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->txn_manager_;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(2000);
+  for (auto &rid : rids) {
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  auto expected = ReadTable(test_table, txn_manager);
+  // everything so far is on disk, recovery does not need the log before the next transaction
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+
+  // a transaction that began before the checkpoint and is still running at the crash
+  Transaction *loser = txn_manager->Begin();
+  for (size_t i = 0; i < 200; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, loser));
+  }
+  for (size_t i = 0; i < rids.size(); i += 7) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], loser));
+  }
+  // a transaction that commits before the checkpoint, its changes are only in the buffer pool at the checkpoint
+  txn = txn_manager->Begin();
+  for (size_t i = 3; i < rids.size(); i += 7) {
+    Tuple tuple = ConstructTuple(&schema);
+    if (test_table->UpdateTuple(tuple, rids[i], txn)) {
+      expected[{rids[i].GetPageId(), rids[i].GetSlotNum()}] = std::string(tuple.GetData(), tuple.GetLength());
     }
   }
-  EXPECT_TRUE(all_pages_clean);
+  txn_manager->Commit(txn);
+  delete txn;
 
-  // compare each page in the buffer pool to that page's
-  // data on disk. ensure they match after the checkpoint
-  bool all_pages_match = true;
-  auto *disk_data = new char[BUSTUB_PAGE_SIZE];
-  for (size_t i = 0; i < pool_size; i++) {
-    Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  EXPECT_LT(0, bustub_instance->checkpoint_manager_->GetScanStart());
+
+  // a transaction that commits after the checkpoint
+  txn = txn_manager->Begin();
+  for (size_t i = 1; i < rids.size(); i += 7) {
+    Tuple tuple = ConstructTuple(&schema);
+    if (test_table->UpdateTuple(tuple, rids[i], txn)) {
+      expected[{rids[i].GetPageId(), rids[i].GetSlotNum()}] = std::string(tuple.GetData(), tuple.GetLength());
+    }
+  }
+  for (size_t i = 2; i < rids.size(); i += 7) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+    expected.erase({rids[i].GetPageId(), rids[i].GetSlotNum()});
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  // some pages are on disk with changes from after the checkpoint
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  bustub_instance->buffer_pool_manager_->FlushPage(rids.back().GetPageId());
+  delete loser;
+  delete test_table;
 
-    if (page_id != INVALID_PAGE_ID) {
-      bustub_instance->disk_manager_->ReadPage(page_id, disk_data);
-      if (std::memcmp(disk_data, page->GetData(), BUSTUB_PAGE_SIZE) != 0) {
-        all_pages_match = false;
-        break;
-      }
+  LOG_INFO("System crash");
+  delete bustub_instance;
+  CopyDatabase("test", "crash");
+
+  // recovery from the checkpoint and from the beginning of the log end up with the same table
+  for (bool from_checkpoint : {true, false}) {
+    CopyDatabase("crash", "test");
+    if (!from_checkpoint) {
+      remove("test.master");
+    }
+    bustub_instance = new BustubInstance("test.db");
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    if (from_checkpoint) {
+      EXPECT_LT(0, log_recovery.GetScanStart());
+    } else {
+      EXPECT_EQ(0, log_recovery.GetScanStart());
     }
+
+    test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                               bustub_instance->log_manager_, first_page_id);
+    EXPECT_EQ(expected, ReadTable(test_table, bustub_instance->txn_manager_));
+    delete test_table;
+    delete bustub_instance;
   }
+}
 
-  EXPECT_TRUE(all_pages_match);
-  delete[] disk_data;
+// A commit record that was torn by the crash does not count, its transaction is rolled back.
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, TornLogTailTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->txn_manager_;
 
-  // Verify all committed transactions flushed to disk
-  lsn_t persistent_lsn = bustub_instance->log_manager_->GetPersistentLSN();
-  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
-  EXPECT_EQ(persistent_lsn, (next_lsn - 1));
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
 
-  // verify log was flushed and each page's LSN <= persistent lsn
-  bool all_pages_lte = true;
-  for (size_t i = 0; i < pool_size; i++) {
-    Page *page = &pages[i];
-    page_id_t page_id = page->GetPageId();
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(200);
+  for (auto &rid : rids) {
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  auto expected = ReadTable(test_table, txn_manager);
 
-    if (page_id != INVALID_PAGE_ID && page->GetLSN() > persistent_lsn) {
-      all_pages_lte = false;
-      break;
+  // the commit record of this transaction is the last record in the log
+  txn = txn_manager->Begin();
+  for (size_t i = 0; i < rids.size(); i += 3) {
+    test_table->UpdateTuple(ConstructTuple(&schema), rids[i], txn);
+  }
+  for (size_t i = 0; i < 50; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+  {
+    // the last byte of the log is not what was written, it would turn the commit record into an abort record
+    std::fstream log_io("test.log", std::ios::binary | std::ios::in | std::ios::out);
+    log_io.seekg(-1, std::ios::end);
+    char byte;
+    log_io.read(&byte, 1);
+    log_io.seekp(-1, std::ios::end);
+    byte ^= 0x0f;
+    log_io.write(&byte, 1);
+  }
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  EXPECT_EQ(expected, ReadTable(test_table, bustub_instance->txn_manager_));
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ContinueLogAfterRecoveryTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = bustub_instance->txn_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  // few enough tuples to stay on the first page, a restarted buffer pool allocates the page ids from 0 on again
+  for (int i = 0; i < 20; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  bustub_instance->txn_manager_->Commit(txn);
+  delete txn;
+  // the pages are on disk with the LSNs of the first run
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  delete test_table;
+
+  LOG_INFO("System crash, the last log write is torn");
+  delete bustub_instance;
+  {
+    std::ofstream log_io("test.log", std::ios::binary | std::ios::app);
+    std::string garbage(100, '\xab');
+    log_io.write(garbage.data(), static_cast<std::streamsize>(garbage.size()));
+  }
+
+  bustub_instance = new BustubInstance("test.db");
+  {
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetNextLSN(), bustub_instance->log_manager_->GetNextLSN());
+  }
+
+  // the log continues after recovery, the changes only make it to disk through the log
+  bustub_instance->log_manager_->RunFlushThread();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  txn = bustub_instance->txn_manager_->Begin();
+  for (int i = 0; i < 20; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  bustub_instance->txn_manager_->Commit(txn);
+  delete txn;
+  auto expected = ReadTable(test_table, bustub_instance->txn_manager_);
+  EXPECT_EQ(40, expected.size());
+  delete test_table;
+
+  LOG_INFO("System crash after recovery");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  {
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+  }
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  EXPECT_EQ(expected, ReadTable(test_table, bustub_instance->txn_manager_));
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CrashTwiceTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = bustub_instance->txn_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  bustub_instance->txn_manager_->Commit(txn);
+  delete txn;
+  // by several transactions, so that the transaction ids after the restarts do not reach the one of the loser
+  std::vector<RID> rids(20);
+  for (size_t i = 0; i < rids.size(); i++) {
+    if (i % 5 == 0) {
+      txn = bustub_instance->txn_manager_->Begin();
+    }
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rids[i], txn));
+    if (i % 5 == 4) {
+      bustub_instance->txn_manager_->Commit(txn);
+      delete txn;
     }
   }
 
-  EXPECT_TRUE(all_pages_lte);
+  // the changes of the loser are on disk
+  txn = bustub_instance->txn_manager_->Begin();
+  for (int i = 0; i < 5; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+  }
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("First crash, before the loser commits");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  {
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+  }
+  bustub_instance->log_manager_->RunFlushThread();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  EXPECT_EQ(rids.size(), ReadTable(test_table, bustub_instance->txn_manager_).size());
 
+  // a later transaction reuses the slots the rolled back inserts of the loser left empty, its changes are on disk too
+  txn = bustub_instance->txn_manager_->Begin();
+  for (int i = 0; i < 5; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+    EXPECT_EQ(rids.size() + i, rid.GetSlotNum());
+  }
+  bustub_instance->txn_manager_->Commit(txn);
   delete txn;
-  delete txn1;
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  auto expected = ReadTable(test_table, bustub_instance->txn_manager_);
   delete test_table;
 
-  LOG_INFO("Shutdown System");
+  LOG_INFO("Second crash, the loser is not rolled back again");
   delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  {
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+  }
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  EXPECT_EQ(expected, ReadTable(test_table, bustub_instance->txn_manager_));
+  delete test_table;
+  delete bustub_instance;
+}
+
+// Transactions keep running while a checkpoint is taken with many dirty pages that are slow to write.
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointStallTest) {
+  const auto write_page_latency = std::chrono::milliseconds(5);
+  const size_t num_dirty_pages = 200;
+
+  SlowPageDiskManager disk_manager("test.db", write_page_latency);
+  LogManager log_manager(&disk_manager);
+  BufferPoolManagerInstance bpm(2 * num_dirty_pages, &disk_manager, LRUK_REPLACER_K, &log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_manager(&lock_manager, &log_manager);
+  CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+  log_manager.RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  // a checkpoint that wrote all dirty pages would take a second
+  Transaction *txn = txn_manager.Begin();
+  TableHeap test_table(&bpm, &lock_manager, &log_manager, txn);
+  for (size_t i = 0; i < num_dirty_pages; i++) {
+    page_id_t page_id;
+    auto *page = reinterpret_cast<TablePage *>(bpm.NewPage(&page_id));
+    ASSERT_NE(nullptr, page);
+    page->Init(page_id, BUSTUB_PAGE_SIZE, INVALID_PAGE_ID, &log_manager, txn);
+    bpm.UnpinPage(page_id, true);
+  }
+  txn_manager.Commit(txn);
+  delete txn;
+
+  std::atomic<bool> done{false};
+  size_t num_txns = 0;
+  auto max_latency = std::chrono::steady_clock::duration::zero();
+  std::thread client([&] {
+    while (!done) {
+      auto start = std::chrono::steady_clock::now();
+      Transaction *txn = txn_manager.Begin();
+      RID rid;
+      EXPECT_TRUE(test_table.InsertTuple(tuple, &rid, txn));
+      txn_manager.Commit(txn);
+      delete txn;
+      max_latency = std::max(max_latency, std::chrono::steady_clock::now() - start);
+      num_txns++;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  int num_writes = disk_manager.GetNumWrites();
+  auto start = std::chrono::steady_clock::now();
+  checkpoint_manager.BeginCheckpoint();
+  checkpoint_manager.EndCheckpoint();
+  auto checkpoint_time = std::chrono::steady_clock::now() - start;
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  done = true;
+  client.join();
+
+  // neither the checkpoint nor the transactions waited for the dirty pages, which are still dirty
+  EXPECT_EQ(num_writes, disk_manager.GetNumWrites());
+  EXPECT_LT(checkpoint_time, write_page_latency * num_dirty_pages / 4);
+  EXPECT_LT(max_latency, write_page_latency * num_dirty_pages / 4);
+  EXPECT_LT(0, num_txns);
+  EXPECT_LE(num_dirty_pages, bpm.GetDirtyPageTable().size());
+
+  log_manager.StopFlushThread();
+  disk_manager.ShutDown();
+}
+// The log is spread over many small segments, a checkpoint drops the ones recovery does not need anymore, and
+// recovery reads the rest across the segment boundaries.
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, SegmentedLogRecoveryTest) {
+  const int log_segment_size = LOG_BUFFER_SIZE;
+  const size_t pool_size = 50;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  page_id_t first_page_id;
+  TableContents expected;
+  {
+    DiskManager disk_manager("test.db", log_segment_size);
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(pool_size, &disk_manager, LRUK_REPLACER_K, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_manager.Begin();
+    TableHeap test_table(&bpm, &lock_manager, &log_manager, txn);
+    first_page_id = test_table.GetFirstPageId();
+    std::vector<RID> rids(5000);
+    for (auto &rid : rids) {
+      ASSERT_TRUE(test_table.InsertTuple(ConstructTuple(&schema), &rid, txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    bpm.FlushAllPages();
+    // a transaction that commits before the checkpoint, with changes that are only in the buffer pool
+    txn = txn_manager.Begin();
+    for (size_t i = 0; i < rids.size(); i += 11) {
+      ASSERT_TRUE(test_table.MarkDelete(rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    size_t num_segments = disk_manager.GetNumLogSegments();
+    EXPECT_LT(2, num_segments);
+
+    checkpoint_manager.BeginCheckpoint();
+    checkpoint_manager.EndCheckpoint();
+    // only the segments that end before the scan start of the checkpoint are gone
+    EXPECT_GT(num_segments, disk_manager.GetNumLogSegments());
+    EXPECT_LT(0, disk_manager.GetLogStart());
+    EXPECT_LE(disk_manager.GetLogStart(), checkpoint_manager.GetScanStart());
+    EXPECT_FALSE(std::filesystem::exists("test.log"));
+
+    // a transaction that commits after the checkpoint, and one that is still running at the crash
+    txn = txn_manager.Begin();
+    for (size_t i = 1; i < rids.size(); i += 11) {
+      test_table.UpdateTuple(ConstructTuple(&schema), rids[i], txn);
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    expected = ReadTable(&test_table, &txn_manager);
+    Transaction *loser = txn_manager.Begin();
+    for (size_t i = 2; i < rids.size(); i += 11) {
+      ASSERT_TRUE(test_table.MarkDelete(rids[i], loser));
+    }
+    delete loser;
+
+    LOG_INFO("System crash");
+    log_manager.StopFlushThread();
+    disk_manager.ShutDown();
+  }
+
+  DiskManager disk_manager("test.db", log_segment_size);
+  BufferPoolManagerInstance bpm(pool_size, &disk_manager);
+  LogRecovery log_recovery(&disk_manager, &bpm);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  EXPECT_LT(0, log_recovery.GetScanStart());
+  EXPECT_LE(disk_manager.GetLogStart(), log_recovery.GetScanStart());
+
+  LockManager lock_manager;
+  TransactionManager txn_manager(&lock_manager, nullptr);
+  TableHeap test_table(&bpm, &lock_manager, nullptr, first_page_id);
+  EXPECT_EQ(expected, ReadTable(&test_table, &txn_manager));
+  disk_manager.ShutDown();
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, IndexRecoveryTest) {
+  const size_t pool_size = 50;
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  std::vector<int64_t> expected;
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(pool_size, &disk_manager, LRUK_REPLACER_K, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    page_id_t header_page_id;
+    ASSERT_NE(nullptr, bpm.NewPage(&header_page_id));
+    ASSERT_EQ(HEADER_PAGE_ID, header_page_id);
+    bpm.UnpinPage(header_page_id, true);
+    // small pages, so that there are many splits and merges
+    IndexTree tree("index", &bpm, comparator, 4, 4, &log_manager);
+    GenericKey<8> index_key;
+    auto insert = [&](int64_t key, Transaction *txn) {
+      index_key.SetFromInteger(key);
+      return tree.Insert(index_key, RID(static_cast<page_id_t>(key), 0), txn);
+    };
+    auto remove = [&](int64_t key, Transaction *txn) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key, txn);
+    };
+
+    std::vector<int64_t> keys(300);
+    std::iota(keys.begin(), keys.end(), 1);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+    Transaction *txn = txn_manager.Begin();
+    for (int64_t key : keys) {
+      ASSERT_TRUE(insert(key, txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    bpm.FlushAllPages();
+    // a committed transaction whose changes are only in the buffer pool and the log
+    txn = txn_manager.Begin();
+    for (int64_t key : keys) {
+      if (key % 3 == 0) {
+        remove(key, txn);
+      }
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    expected = ReadIndex(&bpm, "index");
+    ASSERT_EQ(200, expected.size());
+
+    // a transaction that is still running at the crash, its splits and merges stay but its entries are undone
+    Transaction *loser = txn_manager.Begin();
+    for (int64_t key = 1000; key < 1100; key++) {
+      ASSERT_TRUE(insert(key, loser));
+    }
+    for (int64_t key = 1; key <= 150; key += 3) {
+      remove(key, loser);
+    }
+    delete loser;
+
+    LOG_INFO("System crash");
+    log_manager.StopFlushThread();
+    disk_manager.ShutDown();
+  }
+
+  DiskManager disk_manager("test.db");
+  BufferPoolManagerInstance bpm(pool_size, &disk_manager);
+  LogRecovery log_recovery(&disk_manager, &bpm);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  EXPECT_EQ(expected, ReadIndex(&bpm, "index"));
+  disk_manager.ShutDown();
+}
+
 }  // namespace bustub
@@ -2,11 +2,13 @@
  * b_plus_tree_contention_test.cpp
  */
 
+#include <algorithm>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
 #include <future>  // NOLINT
 #include <iostream>
+#include <mutex>  // NOLINT
 #include <thread>  // NOLINT
 
 #include "buffer/buffer_pool_manager_instance.h"
@@ -154,4 +156,142 @@ TEST(BPlusTreeTest, DISABLED_BPlusTreeContentionBenchmark2) {  // NOLINT
             << std::endl;
 }
 
+/**
+ * Lookups of preloaded keys with some inserts in between, by num_threads threads at once.
+ * @return the operations per millisecond
+ */
+double BPlusTreeReadWriteBenchmarkCall(size_t num_threads, int insert_percent, bool with_global_mutex) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  auto *disk_manager = new DiskManagerMemory(256 << 10);
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(256, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 32, 32);
+  page_id_t page_id;
+  auto *header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t num_keys = 10000;
+  GenericKey<8> index_key;
+  RID rid;
+  for (int64_t key = 0; key < num_keys; key++) {
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, rid);
+  }
+
+  const int ops_per_thread = 80000 / num_threads;
+  std::mutex mtx;
+  std::vector<std::thread> threads;
+  auto clock_start = std::chrono::system_clock::now();
+  for (size_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i] {
+      GenericKey<8> index_key;
+      RID rid;
+      std::vector<RID> result;
+      auto *transaction = new Transaction(static_cast<txn_id_t>(i + 1));
+      // new keys go behind the preloaded ones, in a range of their own per thread
+      int64_t next_key = num_keys + i * ops_per_thread;
+      uint64_t seed = i + 1;
+      for (int op = 0; op < ops_per_thread; op++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        bool is_insert = static_cast<int>((seed >> 33) % 100) < insert_percent;
+        index_key.SetFromInteger(is_insert ? next_key++ : static_cast<int64_t>((seed >> 17) % num_keys));
+        if (with_global_mutex) {
+          mtx.lock();
+        }
+        if (is_insert) {
+          rid.Set(0, op);
+          tree.Insert(index_key, rid, transaction);
+        } else {
+          result.clear();
+          tree.GetValue(index_key, &result, transaction);
+        }
+        if (with_global_mutex) {
+          mtx.unlock();
+        }
+      }
+      delete transaction;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto clock_end = std::chrono::system_clock::now();
+  auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  return static_cast<double>(ops_per_thread * num_threads) / std::max<int64_t>(dur.count(), 1);
+}
+
+TEST(BPlusTreeTest, DISABLED_BPlusTreeReadWriteContentionBenchmark) {  // NOLINT
+  std::cout << "This test will see how the B+ tree scales with threads under a mix of lookups and inserts."
+            << std::endl;
+  std::cout << "<<< BEGIN3" << std::endl;
+  for (int insert_percent : {0, 10, 50}) {
+    for (size_t num_threads : {1, 2, 4, 8}) {
+      double crabbing = BPlusTreeReadWriteBenchmarkCall(num_threads, insert_percent, false);
+      double serialized = BPlusTreeReadWriteBenchmarkCall(num_threads, insert_percent, true);
+      std::cout << "inserts " << insert_percent << "%, threads " << num_threads << ": " << crabbing
+                << " ops/ms, serialized " << serialized << " ops/ms" << std::endl;
+    }
+  }
+  std::cout << ">>> END3" << std::endl;
+}
+
+/**
+ * Lookups of random preloaded keys by one thread, in a tree with leaf pages of the given max size.
+ * @return the nanoseconds per lookup
+ */
+double BPlusTreeLookupBenchmarkCall(int leaf_max_size) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  auto *disk_manager = new DiskManagerMemory(256 << 10);
+  // enough frames for the whole tree, so that the lookups measure the page search rather than the disk
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(8192, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, leaf_max_size, 32);
+  page_id_t page_id;
+  auto *header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t num_keys = 10000;
+  GenericKey<8> index_key;
+  RID rid;
+  for (int64_t key = 0; key < num_keys; key++) {
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, rid);
+  }
+
+  const int num_lookups = 200000;
+  std::vector<RID> result;
+  uint64_t seed = 1;
+  auto clock_start = std::chrono::steady_clock::now();
+  for (int op = 0; op < num_lookups; op++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    index_key.SetFromInteger(static_cast<int64_t>((seed >> 17) % num_keys));
+    result.clear();
+    tree.GetValue(index_key, &result);
+  }
+  auto clock_end = std::chrono::steady_clock::now();
+  auto dur = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_end - clock_start);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  return static_cast<double>(dur.count()) / num_lookups;
+}
+
+TEST(BPlusTreeTest, DISABLED_BPlusTreeLookupBenchmark) {  // NOLINT
+  std::cout << "This test will see how the cost of a lookup grows with the size of the leaf pages." << std::endl;
+  std::cout << "<<< BEGIN4" << std::endl;
+  // 254 entries of a bigint key and a RID fill a whole page
+  for (int leaf_max_size : {4, 16, 64, 128, 254}) {
+    std::cout << "leaf_max_size " << leaf_max_size << ": " << BPlusTreeLookupBenchmarkCall(leaf_max_size)
+              << " ns/lookup" << std::endl;
+  }
+  std::cout << ">>> END4" << std::endl;
+}
+
 }  // namespace bustub
@@ -346,6 +346,77 @@ TEST(BPlusTreeDeleteTests, DeleteBasic) {
   remove("test.log");
 }
 
+TEST(BPlusTreeDeleteTests, DeletePinnedPageTest) {
+  // create KeyComparator and index schema
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  // create b+ tree
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 3, 3);
+  GenericKey<8> index_key;
+  RID rid;
+  // create transaction
+  Transaction *transaction = new Transaction(0);
+
+  // create and fetch header_page
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  std::vector<int64_t> keys = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  for (auto key : keys) {
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, rid, transaction);
+  }
+  page_id_t last_page_id;
+  bpm->NewPage(&last_page_id);
+  bpm->UnpinPage(last_page_id, false);
+
+  // a lookup has every page of the tree pinned while the merges free some of them
+  for (page_id_t tree_page_id = 1; tree_page_id < last_page_id; tree_page_id++) {
+    ASSERT_NE(nullptr, bpm->FetchPage(tree_page_id));
+  }
+  for (int64_t key = 1; key <= 8; key++) {
+    index_key.SetFromInteger(key);
+    tree.Remove(index_key, transaction);
+  }
+  for (page_id_t tree_page_id = 1; tree_page_id < last_page_id; tree_page_id++) {
+    bpm->UnpinPage(tree_page_id, false);
+  }
+
+  // the splits delete the freed pages once they are unpinned
+  for (int64_t key = 1; key <= 8; key++) {
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, rid, transaction);
+  }
+  auto misses = bpm->GetStats().misses_;
+  for (page_id_t tree_page_id = 1; tree_page_id < last_page_id; tree_page_id++) {
+    ASSERT_NE(nullptr, bpm->FetchPage(tree_page_id));
+    bpm->UnpinPage(tree_page_id, false);
+  }
+  EXPECT_GT(bpm->GetStats().misses_, misses);
+
+  std::vector<RID> rids;
+  for (auto key : keys) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids);
+    ASSERT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
 TEST(BPlusTreeDeleteTests, DeleteScale) {
   // create KeyComparator and index schema
   auto key_schema = ParseCreateStatement("a bigint");
@@ -10,11 +10,22 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <chrono>  // NOLINT
 #include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
+#include "buffer/buffer_pool_manager_instance.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/disk_manager_async.h"
+#include "storage/disk/disk_manager_posix.h"
 
 namespace bustub {
 
@@ -72,7 +83,303 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  const int log_segment_size = 100;
+  const int write_size = 64;
+  const int num_log_writes = 10;
+  std::string db_file("test.db");
+  std::vector<char> log(num_log_writes * write_size);
+  for (size_t i = 0; i < log.size(); i++) {
+    log[i] = static_cast<char>(i * 7);
+  }
+  {
+    auto dm = DiskManager(db_file, log_segment_size);
+    // the log manager swaps between two buffers
+    std::vector<char> buffers[2] = {std::vector<char>(write_size), std::vector<char>(write_size)};
+    for (int i = 0; i < num_log_writes; i++) {
+      std::memcpy(buffers[i % 2].data(), log.data() + i * write_size, write_size);
+      dm.WriteLog(buffers[i % 2].data(), write_size);
+    }
+    // a segment takes log writes until it has reached the segment size
+    EXPECT_EQ(num_log_writes / 2, dm.GetNumLogSegments());
+    EXPECT_EQ(num_log_writes * write_size, dm.GetLogSize());
+    dm.ShutDown();
+  }
+  EXPECT_TRUE(std::filesystem::exists("test.log"));
+  EXPECT_TRUE(std::filesystem::exists("test.log.128"));
+
+  // Scenario: the segments are found again when the log is opened, and reads span them.
+  auto dm = DiskManager(db_file, log_segment_size);
+  EXPECT_EQ(num_log_writes * write_size, dm.GetLogSize());
+  std::vector<char> buf(3 * write_size + 10);
+  ASSERT_TRUE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), 100));
+  EXPECT_EQ(0, std::memcmp(buf.data(), log.data() + 100, buf.size()));
+  // past the end of the log, the rest is zero-filled
+  ASSERT_TRUE(dm.ReadLog(buf.data(), static_cast<int>(buf.size()), static_cast<int>(log.size()) - 10));
+  EXPECT_EQ(0, std::memcmp(buf.data(), log.data() + log.size() - 10, 10));
+  EXPECT_EQ(0, buf[10]);
+  EXPECT_FALSE(dm.ReadLog(buf.data(), 1, static_cast<int>(log.size())));
+
+  // Scenario: only the segments that end at or before the offset are dropped.
+  dm.TruncateLog(300);
+  EXPECT_EQ(256, dm.GetLogStart());
+  EXPECT_EQ(num_log_writes / 2 - 2, dm.GetNumLogSegments());
+  EXPECT_FALSE(std::filesystem::exists("test.log"));
+  EXPECT_FALSE(std::filesystem::exists("test.log.128"));
+  EXPECT_FALSE(dm.ReadLog(buf.data(), 1, 255));
+  ASSERT_TRUE(dm.ReadLog(buf.data(), write_size, 256));
+  EXPECT_EQ(0, std::memcmp(buf.data(), log.data() + 256, write_size));
+
+  // Scenario: dropped segments go to the archive, but the last segment stays.
+  dm.SetLogArchiveDirectory("test_archive");
+  dm.TruncateLog(static_cast<int>(log.size()));
+  EXPECT_EQ(1, dm.GetNumLogSegments());
+  EXPECT_EQ(512, dm.GetLogStart());
+  EXPECT_TRUE(std::filesystem::exists("test_archive/test.log.256"));
+  EXPECT_TRUE(std::filesystem::exists("test_archive/test.log.384"));
+  EXPECT_EQ(num_log_writes * write_size, dm.GetLogSize());
+
+  dm.ShutDown();
+  remove("test.log.512");
+  std::filesystem::remove_all("test_archive");
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PosixReadWritePageTest) {
+  for (bool direct_io : {false, true}) {
+    // one byte off, so that direct I/O has to go through its bounce buffer
+    alignas(DiskManagerPosix::DIRECT_IO_ALIGNMENT) char buf[BUSTUB_PAGE_SIZE + 1] = {0};
+    alignas(DiskManagerPosix::DIRECT_IO_ALIGNMENT) char data[BUSTUB_PAGE_SIZE + 1] = {0};
+    std::string db_file("test.db");
+    auto dm = DiskManagerPosix(db_file, direct_io);
+    std::strncpy(data, "A test string.", BUSTUB_PAGE_SIZE);
+    std::strncpy(data + 1, "A test string.", BUSTUB_PAGE_SIZE);
+
+    dm.ReadPage(0, buf);  // tolerate empty read
+
+    dm.WritePage(0, data);
+    dm.ReadPage(0, buf);
+    EXPECT_EQ(std::memcmp(buf, data, BUSTUB_PAGE_SIZE), 0);
+
+    std::memset(buf, 0, sizeof(buf));
+    dm.WritePage(5, data + 1);
+    dm.ReadPage(5, buf + 1);
+    EXPECT_EQ(std::memcmp(buf + 1, data + 1, BUSTUB_PAGE_SIZE), 0);
+
+    // pages past the end of the file read as zeros
+    std::memset(buf, 1, sizeof(buf));
+    dm.ReadPage(6, buf);
+    EXPECT_EQ(0, buf[0]);
+    EXPECT_EQ(0, buf[BUSTUB_PAGE_SIZE - 1]);
+    EXPECT_EQ(2, dm.GetNumWrites());
+
+    dm.ShutDown();
+
+    // Scenario: the pages are still there when the file is opened by DiskManager.
+    auto stream_dm = DiskManager(db_file);
+    stream_dm.ReadPage(5, buf);
+    EXPECT_EQ(std::memcmp(buf, data + 1, BUSTUB_PAGE_SIZE), 0);
+    stream_dm.ShutDown();
+    remove("test.db");
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PosixConcurrentReadWriteTest) {
+  const int num_threads = 8;
+  const int pages_per_thread = 64;
+  auto dm = DiskManagerPosix("test.db");
+
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&dm, tid] {
+      char data[BUSTUB_PAGE_SIZE] = {0};
+      char buf[BUSTUB_PAGE_SIZE] = {0};
+      for (int i = 0; i < pages_per_thread; i++) {
+        page_id_t page_id = i * num_threads + tid;
+        snprintf(data, BUSTUB_PAGE_SIZE, "page %d", page_id);
+        dm.WritePage(page_id, data);
+        dm.ReadPage(page_id, buf);
+        EXPECT_EQ(0, std::strcmp(buf, data));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_threads * pages_per_thread, dm.GetNumWrites());
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, AsyncReadWriteTest) {
+  const int num_pages = 200;
+  for (bool use_io_uring : {true, false}) {
+    for (bool direct_io : {false, true}) {
+      auto dm = DiskManagerAsync("test.db", direct_io, 16, use_io_uring);
+      if (!use_io_uring) {
+        EXPECT_FALSE(dm.UsesIoUring());
+      }
+
+      // Scenario: a batch larger than the queue depth is written, and every write signals its own future and reports
+      // its own latency.
+      std::vector<std::vector<char>> pages(num_pages, std::vector<char>(BUSTUB_PAGE_SIZE));
+      std::vector<DiskRequest> requests;
+      std::vector<std::future<void>> futures;
+      std::vector<std::chrono::nanoseconds> latencies(num_pages, std::chrono::nanoseconds(-1));
+      auto submit_time = std::chrono::steady_clock::now();
+      for (int i = 0; i < num_pages; i++) {
+        snprintf(pages[i].data(), BUSTUB_PAGE_SIZE, "page %d", i);
+        requests.push_back({true, pages[i].data(), i, std::promise<void>(), submit_time, &latencies[i]});
+        futures.push_back(requests.back().callback_.get_future());
+      }
+      dm.Submit(std::move(requests));
+      for (int i = 0; i < num_pages; i++) {
+        futures[i].get();
+        EXPECT_GE(latencies[i].count(), 0);
+        EXPECT_LE(latencies[i], std::chrono::steady_clock::now() - submit_time);
+      }
+      EXPECT_EQ(num_pages, dm.GetNumWrites());
+
+      // Scenario: pages read back asynchronously, and pages past the end of the file read as zeros.
+      std::vector<char> buf(BUSTUB_PAGE_SIZE);
+      for (int i = 0; i < num_pages; i += 7) {
+        dm.ReadPageAsync(i, buf.data()).get();
+        EXPECT_EQ(0, std::strcmp(buf.data(), pages[i].data()));
+      }
+      buf[0] = 1;
+      dm.ReadPageAsync(num_pages, buf.data()).get();
+      EXPECT_EQ(0, buf[0]);
+
+      // Scenario: synchronous and asynchronous I/O can be mixed.
+      dm.WritePage(3, pages[5].data());
+      dm.ReadPageAsync(3, buf.data()).get();
+      EXPECT_EQ(0, std::strcmp(buf.data(), "page 5"));
+
+      dm.ShutDown();
+      remove("test.db");
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, AsyncFlushAllPagesTest) {
+  const size_t buffer_pool_size = 64;
+  auto *dm = new DiskManagerAsync("test.db");
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, dm);
+
+  page_id_t page_id;
+  for (size_t i = 0; i < buffer_pool_size; i++) {
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), BUSTUB_PAGE_SIZE, "page %d", page_id);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, true));
+  }
+  // the buffer pool hands all dirty pages to the disk manager in one batch
+  bpm->FlushAllPages();
+  delete bpm;
+
+  char buf[BUSTUB_PAGE_SIZE];
+  for (page_id = 0; page_id < static_cast<page_id_t>(buffer_pool_size); page_id++) {
+    dm->ReadPage(page_id, buf);
+    EXPECT_EQ(0, std::strcmp(buf, ("page " + std::to_string(page_id)).c_str()));
+  }
+  dm->ShutDown();
+  delete dm;
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DISABLED_IOBenchmark) {
+  const page_id_t num_pages = 4096;
+  const size_t ops_per_thread = 4096;
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (const char *name : {"fstream", "pread", "direct"}) {
+    for (size_t num_threads : {1, 4, 16}) {
+      std::unique_ptr<DiskManager> dm;
+      if (std::strcmp(name, "fstream") == 0) {
+        dm = std::make_unique<DiskManager>("test.db");
+      } else {
+        dm = std::make_unique<DiskManagerPosix>("test.db", std::strcmp(name, "direct") == 0);
+      }
+      char data[BUSTUB_PAGE_SIZE] = {0};
+      for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+        dm->WritePage(page_id, data);
+      }
+
+      auto clock_start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t tid = 0; tid < num_threads; tid++) {
+        threads.emplace_back([&dm, tid] {
+          alignas(DiskManagerPosix::DIRECT_IO_ALIGNMENT) char buf[BUSTUB_PAGE_SIZE] = {0};
+          std::default_random_engine gen(tid);
+          std::uniform_int_distribution<page_id_t> page(0, num_pages - 1);
+          // a read-mostly mix, like a buffer pool that is a bit too small
+          for (size_t i = 0; i < ops_per_thread; i++) {
+            if (i % 4 == 0) {
+              dm->WritePage(page(gen), buf);
+            } else {
+              dm->ReadPage(page(gen), buf);
+            }
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto clock_end = std::chrono::steady_clock::now();
+      auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+      std::cout << "disk_manager=" << name << " threads=" << num_threads
+                << " ops/ms=" << static_cast<double>(num_threads * ops_per_thread) / std::max<int64_t>(dur, 1)
+                << std::endl;
+
+      dm->ShutDown();
+      remove("test.db");
+      remove("test.log");
+    }
+  }
+
+  // A single thread keeping a queue depth worth of reads in flight, as the page cleaner and read-ahead do.
+  for (bool use_io_uring : {true, false}) {
+    for (bool direct_io : {false, true}) {
+      DiskManagerAsync dm("test.db", direct_io, ASYNC_IO_QUEUE_DEPTH, use_io_uring);
+      char data[BUSTUB_PAGE_SIZE] = {0};
+      for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+        dm.WritePage(page_id, data);
+      }
+      std::vector<char> buffers(ASYNC_IO_QUEUE_DEPTH * BUSTUB_PAGE_SIZE);
+      std::default_random_engine gen(0);
+      std::uniform_int_distribution<page_id_t> page(0, num_pages - 1);
+
+      auto clock_start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < 4 * ops_per_thread; i += ASYNC_IO_QUEUE_DEPTH) {
+        std::vector<DiskRequest> requests;
+        std::vector<std::future<void>> futures;
+        for (size_t j = 0; j < ASYNC_IO_QUEUE_DEPTH; j++) {
+          requests.push_back({false, buffers.data() + j * BUSTUB_PAGE_SIZE, page(gen), std::promise<void>()});
+          futures.push_back(requests.back().callback_.get_future());
+        }
+        dm.Submit(std::move(requests));
+        for (auto &future : futures) {
+          future.get();
+        }
+      }
+      auto clock_end = std::chrono::steady_clock::now();
+      auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+      std::cout << "disk_manager=async" << (dm.UsesIoUring() ? "-io_uring" : "-workers")
+                << (direct_io ? "-direct" : "") << " threads=1 reads/ms="
+                << static_cast<double>(4 * ops_per_thread) / std::max<int64_t>(dur, 1) << std::endl;
+
+      dm.ShutDown();
+      remove("test.db");
+      remove("test.log");
+    }
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
 }  // namespace bustub
@@ -0,0 +1,167 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// table_heap_test.cpp
+//
+// Identification: test/table/table_heap_test.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "concurrency/transaction.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "storage/disk/disk_manager_memory.h"
+#include "storage/table/table_heap.h"
+#include "storage/table/tuple.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/** A disk manager whose reads can be made to take as long as a read from an SSD. */
+class SlowReadDiskManager : public DiskManagerUnlimitedMemory {
+ public:
+  void ReadPage(page_id_t page_id, char *page_data) override {
+    if (slow_) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    DiskManagerUnlimitedMemory::ReadPage(page_id, page_data);
+  }
+
+  std::atomic<bool> slow_{false};
+};
+
+/** A buffer pool manager that ignores prefetch hints, i.e. reads every page of a scan synchronously. */
+class NoPrefetchBufferPoolManager : public BufferPoolManagerInstance {
+ public:
+  using BufferPoolManagerInstance::BufferPoolManagerInstance;
+
+  void PrefetchPages(page_id_t start_page_id, size_t count) override {}
+};
+
+static auto ScanTable(BufferPoolManager *bpm, SlowReadDiskManager *disk_manager, size_t num_tuples) -> int64_t {
+  Schema schema{{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 1024}}};
+  auto *txn = new Transaction(0);
+  auto *table = new TableHeap(bpm, nullptr, nullptr, txn);
+  for (size_t i = 0; i < num_tuples; i++) {
+    Tuple tuple({ValueFactory::GetIntegerValue(static_cast<int32_t>(i)),
+                 ValueFactory::GetVarcharValue(std::string(1000, 'a' + i % 26))},
+                &schema);
+    RID rid;
+    EXPECT_TRUE(table->InsertTuple(tuple, &rid, txn));
+  }
+
+  // the scan reads the whole table from disk
+  bpm->FlushAllPages();
+  disk_manager->slow_ = true;
+  auto clock_start = std::chrono::steady_clock::now();
+  size_t count = 0;
+  for (auto it = table->Begin(txn); it != table->End(); ++it) {
+    EXPECT_EQ(count, it->GetValue(&schema, 0).GetAs<int32_t>());
+    count++;
+  }
+  auto clock_end = std::chrono::steady_clock::now();
+  EXPECT_EQ(num_tuples, count);
+
+  delete table;
+  delete txn;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(clock_end - clock_start).count();
+}
+
+/** @return the first column of the tuples a scan of the table reads */
+static auto ScanValues(TableHeap *table, Transaction *txn, const Schema *schema) -> std::vector<int32_t> {
+  std::vector<int32_t> values;
+  for (auto it = table->Begin(txn); it != table->End(); ++it) {
+    values.push_back(it->GetValue(schema, 0).GetAs<int32_t>());
+  }
+  return values;
+}
+
+// NOLINTNEXTLINE
+TEST(TableHeapTest, SnapshotIsolationTest) {
+  auto *disk_manager = new DiskManagerUnlimitedMemory();
+  auto *bpm = new BufferPoolManagerInstance(16, disk_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  Schema schema{{Column{"a", TypeId::INTEGER}}};
+  auto make_tuple = [&schema](int32_t value) { return Tuple({ValueFactory::GetIntegerValue(value)}, &schema); };
+
+  auto *txn = txn_mgr.Begin();
+  auto *table = new TableHeap(bpm, &lock_manager, nullptr, txn);
+  std::vector<RID> rids(3);
+  for (int32_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(table->InsertTuple(make_tuple(i), &rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+
+  auto *reader = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto *writer = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(10), rids[0], writer));
+  EXPECT_TRUE(table->MarkDelete(rids[1], writer));
+  RID rid;
+  EXPECT_TRUE(table->InsertTuple(make_tuple(3), &rid, writer));
+  // a transaction sees its own writes, the others do not see them before or after it commits
+  EXPECT_EQ((std::vector<int32_t>{10, 2, 3}), ScanValues(table, writer, &schema));
+  EXPECT_EQ((std::vector<int32_t>{0, 1, 2}), ScanValues(table, reader, &schema));
+  txn_mgr.Commit(writer);
+  delete writer;
+  EXPECT_EQ((std::vector<int32_t>{0, 1, 2}), ScanValues(table, reader, &schema));
+  Tuple tuple;
+  EXPECT_TRUE(table->GetTuple(rids[1], &tuple, reader));
+  EXPECT_EQ(1, tuple.GetValue(&schema, 0).GetAs<int32_t>());
+
+  // a newer snapshot sees the committed writes
+  auto *later_reader = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ((std::vector<int32_t>{10, 2, 3}), ScanValues(table, later_reader, &schema));
+  EXPECT_FALSE(table->GetTuple(rids[1], &tuple, later_reader));
+
+  // the first committer wins, the old snapshot cannot overwrite the version it does not see
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(20), rids[0], reader));
+  EXPECT_EQ(TransactionState::ABORTED, reader->GetState());
+  txn_mgr.Abort(reader);
+  delete reader;
+
+  // an aborted update leaves the committed version
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(30), rids[2], later_reader));
+  EXPECT_EQ((std::vector<int32_t>{10, 30, 3}), ScanValues(table, later_reader, &schema));
+  txn_mgr.Abort(later_reader);
+  delete later_reader;
+  auto *last_reader = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ((std::vector<int32_t>{10, 2, 3}), ScanValues(table, last_reader, &schema));
+  txn_mgr.Commit(last_reader);
+  delete last_reader;
+
+  delete table;
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(TableHeapTest, DISABLED_ScanBenchmark) {
+  const size_t buffer_pool_size = 64;
+  const size_t num_tuples = 4000;  // about 1000 pages, far more than the pool holds
+
+  std::cout << "<<< BEGIN" << std::endl;
+  for (bool prefetch : {false, true}) {
+    auto *disk_manager = new SlowReadDiskManager();
+    BufferPoolManager *bpm = prefetch ? new BufferPoolManagerInstance(buffer_pool_size, disk_manager)
+                                      : new NoPrefetchBufferPoolManager(buffer_pool_size, disk_manager);
+    std::cout << "prefetch=" << prefetch << " scan_ms=" << ScanTable(bpm, disk_manager, num_tuples) << std::endl;
+    delete bpm;
+    delete disk_manager;
+  }
+  std::cout << ">>> END" << std::endl;
+}
+
+}  // namespace bustub
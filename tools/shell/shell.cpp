@@ -27,14 +27,25 @@ auto GetWidthOfUtf8(const void *beg, const void *end, size_t *width) -> int {
 auto main(int argc, char **argv) -> int {
   ft_set_u8strwid_func(&GetWidthOfUtf8);
 
-  auto bustub = std::make_unique<bustub::BustubInstance>("test.db");
-
   auto default_prompt = "bustub> ";
   auto emoji_prompt = "\U0001f6c1> ";  // the bathtub emoji
   bool use_emoji_prompt = false;
   bool disable_tty = false;
+  auto disk_manager_type = bustub::DiskManagerType::FSTREAM;
 
   for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--disk-manager=posix") == 0) {
+      disk_manager_type = bustub::DiskManagerType::POSIX;
+      continue;
+    }
+    if (strcmp(argv[i], "--disk-manager=direct") == 0) {
+      disk_manager_type = bustub::DiskManagerType::POSIX_DIRECT;
+      continue;
+    }
+    if (strcmp(argv[i], "--disk-manager=async") == 0) {
+      disk_manager_type = bustub::DiskManagerType::ASYNC;
+      continue;
+    }
     if (strcmp(argv[i], "--emoji-prompt") == 0) {
       use_emoji_prompt = true;
       break;
@@ -45,6 +56,8 @@ auto main(int argc, char **argv) -> int {
     }
   }
 
+  auto bustub = std::make_unique<bustub::BustubInstance>("test.db", 1, disk_manager_type);
+
   bustub->GenerateMockTable();
 
   if (bustub->buffer_pool_manager_ != nullptr) {
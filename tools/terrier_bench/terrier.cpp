@@ -114,12 +114,27 @@ auto ParseBool(const std::string &str) -> bool {
   throw bustub::Exception(fmt::format("unexpected arg: {}", str));
 }
 
+auto ParseDeadlockPolicy(const std::string &str) -> bustub::DeadlockPolicy {
+  if (str == "detection") {
+    return bustub::DeadlockPolicy::DETECTION;
+  }
+  if (str == "wound-wait") {
+    return bustub::DeadlockPolicy::WOUND_WAIT;
+  }
+  if (str == "wait-die") {
+    return bustub::DeadlockPolicy::WAIT_DIE;
+  }
+  throw bustub::Exception(fmt::format("unexpected arg: {}", str));
+}
+
 // NOLINTNEXTLINE
 auto main(int argc, char **argv) -> int {
   argparse::ArgumentParser program("bustub-terrier-bench");
   program.add_argument("--duration").help("run terrier bench for n milliseconds");
   program.add_argument("--force-create-index").help("create index in terrier bench");
   program.add_argument("--force-enable-update").help("use update statement in terrier bench");
+  program.add_argument("--bpm-instances").help("shard the buffer pool over n instances");
+  program.add_argument("--deadlock-policy").help("detection, wound-wait or wait-die");
 
   try {
     program.parse_args(argc, argv);
@@ -129,7 +144,17 @@ auto main(int argc, char **argv) -> int {
     return 1;
   }
 
-  auto bustub = std::make_unique<bustub::BustubInstance>();
+  size_t bpm_instances = 1;
+  if (program.present("--bpm-instances")) {
+    bpm_instances = std::stoul(program.get("--bpm-instances"));
+  }
+
+  auto deadlock_policy = bustub::DeadlockPolicy::DETECTION;
+  if (program.present("--deadlock-policy")) {
+    deadlock_policy = ParseDeadlockPolicy(program.get("--deadlock-policy"));
+  }
+
+  auto bustub = std::make_unique<bustub::BustubInstance>(bpm_instances, deadlock_policy);
   auto writer = bustub::SimpleStreamWriter(std::cerr);
 
   // create schema